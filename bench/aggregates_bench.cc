@@ -0,0 +1,206 @@
+// aggregates_bench.cc
+// 列式镜像上的 SIMD 聚合与等价 SQL 的耗时对比
+// 用法: aggregates_bench [行数=1000000] [重复次数=20]
+#include "simdkernels.h"
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Columns {
+    std::vector<int32_t> ids;
+    std::vector<double> prices;
+    std::vector<int32_t> stocks;
+};
+
+constexpr int32_t kLowStockThreshold = 10;
+constexpr double kRangeLow = 100.0;
+constexpr double kRangeHigh = 200.0;
+constexpr double kHistogramLow = 0.0;
+constexpr double kHistogramHigh = 1000.0;
+constexpr int kHistogramBins = 20;
+
+bool exec(sqlite3* db, const char* sql)
+{
+    char* error = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &error) != SQLITE_OK) {
+        std::fprintf(stderr, "SQL 执行失败: %s\n%s\n", error ? error : "", sql);
+        sqlite3_free(error);
+        return false;
+    }
+    return true;
+}
+
+// 与应用中的 products 表结构一致
+bool populate(sqlite3* db, const Columns& columns)
+{
+    if (!exec(db, R"(CREATE TABLE products (
+            id INTEGER PRIMARY KEY AUTOINCREMENT,
+            name TEXT NOT NULL,
+            price REAL NOT NULL CHECK (price >= 0),
+            stock INTEGER DEFAULT 0 CHECK (stock >= 0),
+            created_at DATETIME DEFAULT CURRENT_TIMESTAMP
+        ))")
+        || !exec(db, "CREATE INDEX idx_products_price ON products(price)")
+        || !exec(db, "CREATE INDEX idx_products_stock ON products(stock)")
+        || !exec(db, "BEGIN")) {
+        return false;
+    }
+
+    sqlite3_stmt* insert = nullptr;
+    sqlite3_prepare_v2(db, "INSERT INTO products (id, name, price, stock) VALUES (?, ?, ?, ?)", -1, &insert, nullptr);
+    for (std::size_t i = 0; i < columns.ids.size(); ++i) {
+        const std::string name = "product_" + std::to_string(columns.ids[i]);
+        sqlite3_bind_int(insert, 1, columns.ids[i]);
+        sqlite3_bind_text(insert, 2, name.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_double(insert, 3, columns.prices[i]);
+        sqlite3_bind_int(insert, 4, columns.stocks[i]);
+        sqlite3_step(insert);
+        sqlite3_reset(insert);
+    }
+    sqlite3_finalize(insert);
+    return exec(db, "COMMIT");
+}
+
+double sqlScalar(sqlite3* db, const char* sql)
+{
+    sqlite3_stmt* st = nullptr;
+    sqlite3_prepare_v2(db, sql, -1, &st, nullptr);
+    double value = 0.0;
+    if (sqlite3_step(st) == SQLITE_ROW) {
+        value = sqlite3_column_double(st, 0);
+    }
+    sqlite3_finalize(st);
+    return value;
+}
+
+std::vector<uint64_t> sqlHistogram(sqlite3* db)
+{
+    const std::string sql = "SELECT CAST((price - " + std::to_string(kHistogramLow) + ") * "
+        + std::to_string(kHistogramBins / (kHistogramHigh - kHistogramLow)) + " AS INTEGER) AS bin, COUNT(*)"
+        + " FROM products WHERE price >= " + std::to_string(kHistogramLow) + " AND price < "
+        + std::to_string(kHistogramHigh) + " GROUP BY bin";
+
+    std::vector<uint64_t> counts(kHistogramBins, 0);
+    sqlite3_stmt* st = nullptr;
+    sqlite3_prepare_v2(db, sql.c_str(), -1, &st, nullptr);
+    while (sqlite3_step(st) == SQLITE_ROW) {
+        const int bin = std::min(sqlite3_column_int(st, 0), kHistogramBins - 1);
+        counts[bin] += static_cast<uint64_t>(sqlite3_column_int64(st, 1));
+    }
+    sqlite3_finalize(st);
+    return counts;
+}
+
+// 返回每次调用的中位耗时（微秒），result 保存最后一次的结果
+double timeMedianUs(int repeats, const std::function<double()>& body, double& result)
+{
+    std::vector<double> samples;
+    samples.reserve(repeats);
+    for (int i = 0; i < repeats; ++i) {
+        const auto start = Clock::now();
+        result = body();
+        samples.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+void report(const char* name, double sqlUs, double scalarUs, double simdUs, double sqlValue, double simdValue)
+{
+    std::printf("%-20s %12.1f %12.1f %12.1f %9.1fx %9.1fx  %s\n", name, sqlUs, scalarUs, simdUs,
+        sqlUs / simdUs, scalarUs / simdUs,
+        std::abs(sqlValue - simdValue) <= 1e-6 * std::max(1.0, std::abs(sqlValue)) ? "ok" : "MISMATCH");
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    const std::size_t rows = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    const int repeats = argc > 2 ? std::max(1, std::atoi(argv[2])) : 20;
+
+    Columns columns;
+    columns.ids.reserve(rows);
+    columns.prices.reserve(rows);
+    columns.stocks.reserve(rows);
+
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<int> cents(0, 99999);
+    std::uniform_int_distribution<int32_t> stock(0, 500);
+    for (std::size_t i = 0; i < rows; ++i) {
+        columns.ids.push_back(static_cast<int32_t>(i + 1));
+        columns.prices.push_back(cents(rng) / 100.0);
+        columns.stocks.push_back(stock(rng));
+    }
+
+    sqlite3* db = nullptr;
+    if (sqlite3_open(":memory:", &db) != SQLITE_OK || !populate(db, columns)) {
+        return 1;
+    }
+
+    const std::size_t n = columns.ids.size();
+    const double* price = columns.prices.data();
+    const int32_t* stocks = columns.stocks.data();
+
+    std::printf("rows=%zu repeats=%d kernel=%s\n", rows, repeats, simd::activeKernel());
+    std::printf("%-20s %12s %12s %12s %10s %10s\n", "aggregate", "sql(us)", "scalar(us)", "simd(us)", "vs sql", "vs scalar");
+
+    // 每个聚合分别测 SQL、强制标量、SIMD 三种实现
+    auto run = [&](const char* name, const std::function<double()>& sql, const std::function<double()>& kernel) {
+        double sqlValue = 0.0, scalarValue = 0.0, simdValue = 0.0;
+        const double sqlUs = timeMedianUs(repeats, sql, sqlValue);
+        simd::forceScalar(true);
+        const double scalarUs = timeMedianUs(repeats, kernel, scalarValue);
+        simd::forceScalar(false);
+        const double simdUs = timeMedianUs(repeats, kernel, simdValue);
+        report(name, sqlUs, scalarUs, simdUs, sqlValue, simdValue);
+    };
+
+    run(
+        "inventory_value", [&]() { return sqlScalar(db, "SELECT SUM(price * stock) FROM products"); },
+        [&]() { return simd::sumProduct(price, stocks, n); });
+
+    run(
+        "low_stock_count",
+        [&]() { return sqlScalar(db, ("SELECT COUNT(*) FROM products WHERE stock < " + std::to_string(kLowStockThreshold)).c_str()); },
+        [&]() { return static_cast<double>(simd::countLess(stocks, n, kLowStockThreshold)); });
+
+    run(
+        "price_range_count",
+        [&]() {
+            return sqlScalar(db, ("SELECT COUNT(*) FROM products WHERE price BETWEEN " + std::to_string(kRangeLow)
+                                     + " AND " + std::to_string(kRangeHigh)).c_str());
+        },
+        [&]() { return static_cast<double>(simd::countInRange(price, n, kRangeLow, kRangeHigh)); });
+
+    // 直方图以各桶计数的加权和作为校验值
+    auto checksum = [](const std::vector<uint64_t>& counts) {
+        double sum = 0.0;
+        for (std::size_t i = 0; i < counts.size(); ++i) {
+            sum += static_cast<double>(counts[i]) * (i + 1);
+        }
+        return sum;
+    };
+    run(
+        "price_histogram", [&]() { return checksum(sqlHistogram(db)); },
+        [&]() {
+            std::vector<uint64_t> counts(kHistogramBins, 0);
+            simd::histogram(price, n, kHistogramLow, kHistogramHigh, kHistogramBins, counts.data());
+            return checksum(counts);
+        });
+
+    sqlite3_close(db);
+    return 0;
+}
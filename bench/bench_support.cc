@@ -0,0 +1,99 @@
+// bench_support.cc
+#include "bench_support.h"
+#include "dboperatethread.h"
+#include <sqlite3.h>
+
+#include <QEventLoop>
+#include <QTimer>
+#include <cstdio>
+#include <string>
+
+namespace {
+
+bool exec(sqlite3* db, const char* sql)
+{
+    char* error = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &error) != SQLITE_OK) {
+        std::fprintf(stderr, "SQL 执行失败: %s\n%s\n", error ? error : "", sql);
+        sqlite3_free(error);
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+namespace BenchSupport {
+
+void quietMessageHandler(QtMsgType type, const QMessageLogContext&, const QString& message)
+{
+    if (type != QtDebugMsg && type != QtInfoMsg) {
+        std::fprintf(stderr, "%s\n", qPrintable(message));
+    }
+}
+
+SQLite3Handler* startDatabase(DBOperateThread& dbThread, int timeoutMs)
+{
+    QEventLoop loop;
+    bool connected = false;
+    QObject::connect(&dbThread, &DBOperateThread::connected, &loop, [&]() {
+        connected = true;
+        loop.quit();
+    });
+    QTimer::singleShot(timeoutMs, &loop, &QEventLoop::quit);
+    if (dbThread.initialize()) {
+        dbThread.start();
+        loop.exec();
+    }
+    return connected ? dbThread.handler() : nullptr;
+}
+
+// 单独开一个连接在一个事务里批量插入，比逐条经处理器入队快得多；
+// 不带 SQLITE_OPEN_CREATE，库或表不存在时直接失败，表结构只由状态机维护
+bool seedProducts(const QString& dbFile, int rows, int stock)
+{
+    sqlite3* db = nullptr;
+    if (sqlite3_open_v2(dbFile.toUtf8().constData(), &db, SQLITE_OPEN_READWRITE, nullptr) != SQLITE_OK) {
+        std::fprintf(stderr, "无法打开数据库: %s\n", sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return false;
+    }
+    sqlite3_busy_timeout(db, 5000);
+
+    sqlite3_stmt* stmt = nullptr;
+    bool ok = exec(db, "BEGIN");
+    if (ok && sqlite3_prepare_v2(db, "INSERT INTO products (name, price, stock) VALUES (?1, ?2, ?3)", -1, &stmt, nullptr) != SQLITE_OK) {
+        std::fprintf(stderr, "预置商品失败: %s\n", sqlite3_errmsg(db));
+        ok = false;
+    }
+    for (int i = 0; i < rows && ok; ++i) {
+        const std::string name = "product_" + std::to_string(i);
+        sqlite3_bind_text(stmt, 1, name.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_double(stmt, 2, (i % 1000) + 0.99);
+        sqlite3_bind_int(stmt, 3, stock);
+        ok = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    ok = ok && exec(db, "COMMIT");
+    sqlite3_close(db);
+    return ok;
+}
+
+QJsonObject percentiles(std::vector<int64_t> micros)
+{
+    QJsonObject result;
+    result["count"] = static_cast<qint64>(micros.size());
+    if (micros.empty()) {
+        return result;
+    }
+    std::sort(micros.begin(), micros.end());
+    result["p50"] = percentile(micros, 0.50) / 1000.0;
+    result["p90"] = percentile(micros, 0.90) / 1000.0;
+    result["p99"] = percentile(micros, 0.99) / 1000.0;
+    result["p999"] = percentile(micros, 0.999) / 1000.0;
+    result["max"] = micros.back() / 1000.0;
+    return result;
+}
+
+} // namespace BenchSupport
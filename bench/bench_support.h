@@ -0,0 +1,43 @@
+// bench_support.h
+// 基准与压测程序共用的辅助函数：静默日志、启动数据库线程、预置商品数据、延迟分位数
+#ifndef BENCH_SUPPORT_H
+#define BENCH_SUPPORT_H
+
+#include <QJsonObject>
+#include <QString>
+#include <QtGlobal>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+class DBOperateThread;
+class SQLite3Handler;
+
+namespace BenchSupport {
+
+// 状态机每执行一条语句都会打印调试日志，基准运行期间只保留警告和错误
+void quietMessageHandler(QtMsgType type, const QMessageLogContext& context, const QString& message);
+
+// 启动数据库线程并等待连接建立（表结构由状态机连接时创建），超时或失败返回 nullptr
+SQLite3Handler* startDatabase(DBOperateThread& dbThread, int timeoutMs = 10000);
+
+// 向状态机已建好的 products 表插入 rows 行：name 为 product_<i>，price 为 i % 1000 + 0.99，库存均为 stock
+bool seedProducts(const QString& dbFile, int rows, int stock);
+
+// sorted 为升序样本，空样本返回 0
+template <typename T>
+T percentile(const std::vector<T>& sorted, double quantile)
+{
+    if (sorted.empty()) {
+        return T();
+    }
+    const std::size_t index = std::min(sorted.size() - 1, static_cast<std::size_t>(quantile * sorted.size()));
+    return sorted[index];
+}
+
+// 微秒样本 → {count, p50, p90, p99, p999, max}，单位毫秒
+QJsonObject percentiles(std::vector<int64_t> micros);
+
+} // namespace BenchSupport
+
+#endif // BENCH_SUPPORT_H
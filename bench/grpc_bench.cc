@@ -0,0 +1,154 @@
+// grpc_bench.cc
+// gRPC 接口压测：批量写入吞吐、全表流式读取耗时、多线程一元 GetProduct 的吞吐与延迟
+// 先用 qt_app --serve 启动服务
+// 用法: grpc_bench [地址=127.0.0.1:50051] [线程数=16] [秒数=10] [批量写入行数=20000]
+#include "bench_support.h"
+#include <grpcpp/grpcpp.h>
+#include "inventory.grpc.pb.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+namespace pb = qtapp::inventory;
+using Clock = std::chrono::steady_clock;
+
+double seconds(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+using BenchSupport::percentile;
+
+// 客户端流式写入 rows 行，返回服务端汇总
+bool bulkInsert(pb::Inventory::Stub& stub, int rows)
+{
+    grpc::ClientContext context;
+    pb::BulkInsertSummary summary;
+    const auto start = Clock::now();
+    auto writer = stub.BulkInsertProducts(&context, &summary);
+    for (int i = 0; i < rows; ++i) {
+        pb::AddProductRequest item;
+        item.set_name("grpc_bench_product_" + std::to_string(i));
+        item.set_price(1.0 + (i % 1000) / 10.0);
+        item.set_stock(1000);
+        if (!writer->Write(item)) {
+            break; // 服务端提前结束，原因见 Finish 的状态
+        }
+    }
+    writer->WritesDone();
+    const grpc::Status status = writer->Finish();
+    const double elapsed = seconds(start);
+    if (!status.ok()) {
+        std::fprintf(stderr, "批量写入失败: %d %s\n", status.error_code(), status.error_message().c_str());
+        return false;
+    }
+    std::printf("bulk: received=%lld inserted=%lld rejected=%lld batches=%lld elapsed=%.2fs rate=%.0f rows/s\n",
+        static_cast<long long>(summary.received()), static_cast<long long>(summary.inserted()),
+        static_cast<long long>(summary.rejected()), static_cast<long long>(summary.batches()), elapsed,
+        summary.inserted() / elapsed);
+    return true;
+}
+
+// 服务端流式读取全表，收集产品 id 供一元压测使用
+bool listAll(pb::Inventory::Stub& stub, std::vector<int64_t>& ids)
+{
+    grpc::ClientContext context;
+    pb::ListProductsRequest request;
+    request.set_page_size(1000);
+    const auto start = Clock::now();
+    auto reader = stub.ListProducts(&context, request);
+    pb::Product product;
+    while (reader->Read(&product)) {
+        ids.push_back(product.id());
+    }
+    const grpc::Status status = reader->Finish();
+    const double elapsed = seconds(start);
+    if (!status.ok()) {
+        std::fprintf(stderr, "流式读取失败: %d %s\n", status.error_code(), status.error_message().c_str());
+        return false;
+    }
+    std::printf("list: rows=%zu elapsed=%.2fs rate=%.0f rows/s\n", ids.size(), elapsed, ids.size() / elapsed);
+    return !ids.empty();
+}
+
+struct Worker {
+    std::vector<double> latenciesUs;
+    uint64_t ok = 0;
+    uint64_t errors = 0;
+};
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    const std::string address = argc > 1 ? argv[1] : "127.0.0.1:50051";
+    const int threads = argc > 2 ? std::max(1, std::atoi(argv[2])) : 16;
+    const int duration = argc > 3 ? std::max(1, std::atoi(argv[3])) : 10;
+    const int bulkRows = argc > 4 ? std::max(1, std::atoi(argv[4])) : 20000;
+
+    auto channel = grpc::CreateChannel(address, grpc::InsecureChannelCredentials());
+    auto stub = pb::Inventory::NewStub(channel);
+
+    std::printf("address=%s threads=%d seconds=%d bulk_rows=%d\n", address.c_str(), threads, duration, bulkRows);
+    std::vector<int64_t> ids;
+    if (!bulkInsert(*stub, bulkRows) || !listAll(*stub, ids)) {
+        return 1;
+    }
+
+    // 所有线程共用一个通道，调用在 HTTP/2 连接上多路复用
+    std::vector<Worker> workers(static_cast<size_t>(threads));
+    std::vector<std::thread> pool;
+    const auto start = Clock::now();
+    const auto deadline = start + std::chrono::seconds(duration);
+    for (int i = 0; i < threads; ++i) {
+        pool.emplace_back([&, i]() {
+            Worker& worker = workers[static_cast<size_t>(i)];
+            std::mt19937 rng(static_cast<unsigned>(i + 1));
+            std::uniform_int_distribution<std::size_t> pick(0, ids.size() - 1);
+            while (Clock::now() < deadline) {
+                grpc::ClientContext context;
+                context.set_deadline(std::chrono::system_clock::now() + std::chrono::seconds(10));
+                pb::GetByIdRequest request;
+                request.set_id(ids[pick(rng)]);
+                pb::Product reply;
+                const auto begin = Clock::now();
+                const grpc::Status status = stub->GetProduct(&context, request, &reply);
+                worker.latenciesUs.push_back(std::chrono::duration<double, std::micro>(Clock::now() - begin).count());
+                if (status.ok()) {
+                    worker.ok++;
+                } else {
+                    worker.errors++;
+                }
+            }
+        });
+    }
+    for (std::thread& thread : pool) {
+        thread.join();
+    }
+    const double elapsed = seconds(start);
+
+    std::vector<double> latencies;
+    uint64_t ok = 0, errors = 0;
+    for (const Worker& worker : workers) {
+        latencies.insert(latencies.end(), worker.latenciesUs.begin(), worker.latenciesUs.end());
+        ok += worker.ok;
+        errors += worker.errors;
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    std::printf("unary: calls=%zu ok=%llu errors=%llu elapsed=%.2fs\n", latencies.size(),
+        static_cast<unsigned long long>(ok), static_cast<unsigned long long>(errors), elapsed);
+    std::printf("throughput=%.0f calls/s\n", latencies.size() / elapsed);
+    std::printf("latency(us) p50=%.0f p90=%.0f p99=%.0f max=%.0f\n", percentile(latencies, 0.50),
+        percentile(latencies, 0.90), percentile(latencies, 0.99), latencies.empty() ? 0.0 : latencies.back());
+    return 0;
+}
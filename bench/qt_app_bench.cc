@@ -0,0 +1,339 @@
+// qt_app_bench.cc
+// 数据访问层的微基准（Google Benchmark）：
+//   OperationRequest 的构造与拷贝、addToQueue/dequeue 在多线程争用下的开销、
+//   handleQueryExecution 按语句形态的单条耗时、parseJsonResult 的 JSON 序列化与解析，
+//   以及 SQLite3Handler 在不同队列深度下的端到端吞吐
+// 用法: qt_app_bench [--benchmark_filter=<正则>] [--benchmark_out=<文件> --benchmark_out_format=json]
+// 需从构建目录运行（端到端基准要读取 statemachine/ 下的 SCXML 文件），数据库建在临时目录中
+// 跨提交对比见 bench/run_qt_app_bench.sh
+#include "bench_support.h"
+#include "dboperatethread.h"
+#include "sqlite3handler.h"
+#include "sqlite3statemachine.h"
+#include "version.h"
+#include <benchmark/benchmark.h>
+
+#include <QCoreApplication>
+#include <QEventLoop>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QTimer>
+#include <atomic>
+#include <cstdio>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+// 状态机的入队、出队与执行是私有的，经这里直接调用
+struct SQLite3StateMachineBenchAccess {
+    static bool connect(SQLite3StateMachine& machine) { return machine.connectToDatabase(); }
+    static void addToQueue(SQLite3StateMachine& machine, const OperationRequest& request) { machine.addToQueue(request); }
+    static OperationRequest dequeue(SQLite3StateMachine& machine) { return machine.dequeue(); }
+    static void execute(SQLite3StateMachine& machine, const OperationRequest& request)
+    {
+        if (request.isScalarType()) {
+            machine.handleScalarExecution(request);
+        } else {
+            machine.handleQueryExecution(request);
+        }
+    }
+};
+
+namespace {
+
+constexpr int kProductRows = 10000;
+constexpr int kEndToEndBatch = 1000; // 端到端基准每次迭代完成的操作数
+constexpr int kDrainInterval = 1024; // 每隔多少次执行清掉状态机投递给自己的出队事件
+
+QString g_dbFile;
+std::atomic<quint64> g_idSequence { 0 };
+SQLite3StateMachine* g_memoryQueue = nullptr; // 未连接：入队不落库
+SQLite3StateMachine* g_connectedMachine = nullptr; // 已连接：入队写 operation_queue，可执行语句
+DBOperateThread* g_dbThread = nullptr;
+SQLite3Handler* g_dbHandler = nullptr; // 连接失败时为空
+
+// 基准直接构造请求，ID 用自己的序号，与 OperationRequest 默认生成的 ID 区分开
+std::string nextId()
+{
+    return "bench_" + std::to_string(g_idSequence.fetch_add(1, std::memory_order_relaxed));
+}
+
+OperationRequest makeRequest(int stringParams)
+{
+    OperationRequest request("query");
+    request.setStringParam("query", "SELECT * FROM products WHERE id = :id");
+    for (int i = 0; i < stringParams; ++i) {
+        request.setStringParam("param_" + std::to_string(i), "value_" + std::to_string(i));
+    }
+    return request;
+}
+
+// 处理器返回给消费方的行格式
+QJsonArray makeRows(int rows)
+{
+    QJsonArray array;
+    for (int i = 0; i < rows; ++i) {
+        QJsonObject row;
+        row.insert("id", i + 1);
+        row.insert("name", QString("product_%1").arg(i));
+        row.insert("price", (i % 1000) + 0.99);
+        row.insert("stock", i % 500);
+        row.insert("created_at", "2024-01-01 00:00:00");
+        array.append(row);
+    }
+    return array;
+}
+
+// 执行后状态机会给自己投递一个出队事件；基准不跑事件循环，定期把它们清掉
+void drainPostedEvents(benchmark::State& state, SQLite3StateMachine* machine, int64_t iteration)
+{
+    if (iteration % kDrainInterval == 0) {
+        state.PauseTiming();
+        QCoreApplication::removePostedEvents(machine);
+        state.ResumeTiming();
+    }
+}
+
+} // namespace
+
+// ---------------------------------------------------------------- OperationRequest
+
+static void BM_OperationRequestConstruct(benchmark::State& state)
+{
+    const int params = static_cast<int>(state.range(0));
+    for (auto _ : state) {
+        OperationRequest request = makeRequest(params);
+        benchmark::DoNotOptimize(request);
+    }
+}
+BENCHMARK(BM_OperationRequestConstruct)->ArgName("params")->Arg(0)->Arg(4)->Arg(16);
+
+static void BM_OperationRequestCopy(benchmark::State& state)
+{
+    const OperationRequest source = makeRequest(static_cast<int>(state.range(0)));
+    for (auto _ : state) {
+        OperationRequest copy = source;
+        benchmark::DoNotOptimize(copy);
+    }
+}
+BENCHMARK(BM_OperationRequestCopy)->ArgName("params")->Arg(0)->Arg(4)->Arg(16);
+
+// ---------------------------------------------------------------- 队列
+
+// 每次迭代入队一个、出队一个；persist=1 时入队写 operation_queue、出队更新状态（都在队列锁内）
+static void BM_QueueAddDequeue(benchmark::State& state)
+{
+    SQLite3StateMachine* machine = state.range(0) ? g_connectedMachine : g_memoryQueue;
+    OperationRequest request = makeRequest(1);
+    for (auto _ : state) {
+        request.id = nextId();
+        SQLite3StateMachineBenchAccess::addToQueue(*machine, request);
+        OperationRequest next = SQLite3StateMachineBenchAccess::dequeue(*machine);
+        benchmark::DoNotOptimize(next);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_QueueAddDequeue)->ArgName("persist")->Arg(0)->Arg(1)->ThreadRange(1, 8)->UseRealTime();
+
+// ---------------------------------------------------------------- 语句执行
+
+struct StatementShape {
+    const char* label;
+    const char* type;
+    const char* query;
+};
+
+// 与 SQLite3Handler 中的语句构造保持一致
+const StatementShape kShapes[] = {
+    { "point_select", "query", "SELECT * FROM products WHERE id = :id" },
+    { "range_select_100", "query", "SELECT * FROM products WHERE price BETWEEN :minPrice AND :maxPrice ORDER BY price" },
+    { "count_scalar", "scalar", "SELECT COUNT(*) FROM products WHERE price BETWEEN :minPrice AND :maxPrice" },
+    { "update_by_id", "query", "UPDATE products SET stock = :stock WHERE id = :id" },
+    { "insert_user", "query", "INSERT INTO users (name, email, age) VALUES (:name, :email, :age)" },
+};
+
+static void BM_StatementExecution(benchmark::State& state)
+{
+    const StatementShape& shape = kShapes[state.range(0)];
+    state.SetLabel(shape.label);
+
+    int64_t iteration = 0;
+    for (auto _ : state) {
+        OperationRequest request(shape.type);
+        request.id = nextId();
+        request.setStringParam("query", shape.query);
+        const int productId = 1 + static_cast<int>(iteration % kProductRows);
+        request.setStringParam("id", std::to_string(productId));
+        // 价格 100~110 的区间约 100 行
+        request.setStringParam("minPrice", "100");
+        request.setStringParam("maxPrice", "110");
+        request.setStringParam("stock", std::to_string(productId % 500));
+        request.setStringParam("name", "bench");
+        request.setStringParam("email", request.id + "@example.com");
+        request.setStringParam("age", "30");
+
+        // 只绑定语句中出现的参数
+        for (auto it = request.string_params.begin(); it != request.string_params.end();) {
+            const bool used = it->first == "query" || std::string(shape.query).find(":" + it->first) != std::string::npos;
+            it = used ? std::next(it) : request.string_params.erase(it);
+        }
+
+        SQLite3StateMachineBenchAccess::execute(*g_connectedMachine, request);
+
+        OperationTiming timing;
+        g_connectedMachine->takeOperationTiming(QString::fromStdString(request.id), timing);
+        drainPostedEvents(state, g_connectedMachine, ++iteration);
+    }
+    QCoreApplication::removePostedEvents(g_connectedMachine);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_StatementExecution)->ArgName("shape")->DenseRange(0, static_cast<int>(std::size(kShapes)) - 1);
+
+// ---------------------------------------------------------------- JSON
+
+// 状态机把结果行序列化为紧凑 JSON
+static void BM_SerializeRows(benchmark::State& state)
+{
+    const QJsonArray rows = makeRows(static_cast<int>(state.range(0)));
+    for (auto _ : state) {
+        QString json = QString::fromUtf8(QJsonDocument(rows).toJson(QJsonDocument::Compact));
+        benchmark::DoNotOptimize(json);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SerializeRows)->ArgName("rows")->Arg(1)->Arg(100)->Arg(1000);
+
+// 处理器把 JSON 文本解析回 QVariant
+static void BM_ParseJsonResult(benchmark::State& state)
+{
+    const QString json = QString::fromUtf8(QJsonDocument(makeRows(static_cast<int>(state.range(0)))).toJson(QJsonDocument::Compact));
+    for (auto _ : state) {
+        QVariant result = SQLite3Handler::parseJsonResult(json);
+        benchmark::DoNotOptimize(result);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetBytesProcessed(state.iterations() * json.size() * static_cast<int64_t>(sizeof(QChar)));
+}
+BENCHMARK(BM_ParseJsonResult)->ArgName("rows")->Arg(1)->Arg(100)->Arg(1000);
+
+// ---------------------------------------------------------------- 端到端
+
+// 数据库线程在首次使用时启动，连接建立前阻塞等待
+SQLite3Handler* endToEndHandler()
+{
+    if (!g_dbThread) {
+        g_dbThread = new DBOperateThread(g_dbFile);
+        g_dbHandler = BenchSupport::startDatabase(*g_dbThread);
+    }
+    return g_dbHandler;
+}
+
+// 闭环：始终保持 depth 个操作在途，每完成一个补一个，直到完成 total 个
+bool runBatch(SQLite3Handler* handler, int depth, int total, bool writes)
+{
+    QEventLoop loop;
+    int submitted = 0;
+    int completed = 0;
+    int failed = 0;
+    auto submit = [&]() {
+        const int productId = 1 + submitted % kProductRows;
+        ++submitted;
+        QMetaObject::invokeMethod(handler, [handler, productId, writes]() {
+            if (writes) {
+                handler->updateProductStock(productId, productId % 500);
+            } else {
+                handler->getProductById(productId);
+            }
+        }, Qt::QueuedConnection);
+    };
+
+    QObject::connect(g_dbThread, &DBOperateThread::operationCompleted, &loop,
+        [&](const QString&, bool success, const QVariant&) {
+            ++completed;
+            if (!success) {
+                ++failed;
+            }
+            if (submitted < total) {
+                submit();
+            } else if (completed >= total) {
+                loop.quit();
+            }
+        });
+    for (int i = 0; i < depth && submitted < total; ++i) {
+        submit();
+    }
+    QTimer::singleShot(60000, &loop, &QEventLoop::quit);
+    loop.exec();
+    return completed >= total && failed == 0;
+}
+
+// range(0) 为在途操作数，range(1) 为 1 时全部是写入
+static void BM_HandlerThroughput(benchmark::State& state)
+{
+    SQLite3Handler* handler = endToEndHandler();
+    if (!handler) {
+        state.SkipWithError("数据库线程未能建立连接（是否在构建目录中运行？）");
+        return;
+    }
+    const int depth = static_cast<int>(state.range(0));
+    const bool writes = state.range(1) != 0;
+    state.SetLabel(writes ? "updateProductStock" : "getProductById");
+
+    for (auto _ : state) {
+        if (!runBatch(handler, depth, kEndToEndBatch, writes)) {
+            state.SkipWithError("操作失败或超时");
+            break;
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * kEndToEndBatch);
+}
+BENCHMARK(BM_HandlerThroughput)
+    ->ArgNames({ "depth", "writes" })
+    ->ArgsProduct({ { 1, 8, 64, 256 }, { 0, 1 } })
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+int main(int argc, char** argv)
+{
+    QCoreApplication app(argc, argv);
+    qInstallMessageHandler(BenchSupport::quietMessageHandler);
+
+    QTemporaryDir tempDir;
+    if (!tempDir.isValid()) {
+        return 1;
+    }
+    g_dbFile = tempDir.filePath("bench.db");
+
+    // 空库由状态机连接时建表，之后再预置商品
+    g_memoryQueue = new SQLite3StateMachine(g_dbFile);
+    g_connectedMachine = new SQLite3StateMachine(g_dbFile);
+    if (!SQLite3StateMachineBenchAccess::connect(*g_connectedMachine)) {
+        std::fprintf(stderr, "无法连接数据库: %s\n", qPrintable(g_dbFile));
+        return 1;
+    }
+    if (!BenchSupport::seedProducts(g_dbFile, kProductRows, 500)) {
+        return 1;
+    }
+
+    // 结果 JSON 的 context 中带上版本与提交，便于跨提交对比
+    benchmark::AddCustomContext("qt_app_version", VersionInfo::fullVersion());
+    benchmark::AddCustomContext("git", VersionInfo::gitInfo());
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    if (g_dbThread) {
+        g_dbThread->shutdown();
+        delete g_dbThread;
+    }
+    delete g_connectedMachine;
+    delete g_memoryQueue;
+    return 0;
+}
@@ -0,0 +1,183 @@
+// rest_load_bench.cc
+// REST 接口压测：多个长连接、每个连接保持固定数量的流水线请求，统计吞吐与延迟
+// 先用 qt_app --serve 启动服务
+// 用法: rest_load_bench [地址=http://127.0.0.1:9464] [连接数=16] [流水线深度=8] [秒数=10] [写比例%=10]
+#include "bench_support.h"
+#include <drogon/HttpClient.h>
+#include <trantor/net/EventLoopThreadPool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kSeedProducts = 100;
+
+// 每个连接的回调都在同一个事件循环线程中执行，统计不需要加锁
+struct Connection {
+    drogon::HttpClientPtr client;
+    std::mt19937 rng;
+    std::vector<double> latenciesUs;
+    uint64_t ok = 0;
+    uint64_t errors = 0; // 非 2xx 应答
+    uint64_t failures = 0; // 连接或超时失败
+};
+
+struct Run {
+    std::vector<int> productIds;
+    int writePercent = 10;
+    Clock::time_point deadline;
+    std::atomic<int> activeSlots { 0 };
+    std::promise<void> finished;
+};
+
+drogon::HttpRequestPtr makeRequest(Run& run, Connection& connection)
+{
+    std::uniform_int_distribution<std::size_t> pick(0, run.productIds.size() - 1);
+    std::uniform_int_distribution<int> percent(0, 99);
+    const std::string path = "/api/products/" + std::to_string(run.productIds[pick(connection.rng)]);
+
+    auto request = drogon::HttpRequest::newHttpRequest();
+    if (percent(connection.rng) < run.writePercent) {
+        request->setMethod(drogon::Post);
+        request->setPath(path + "/stock");
+        request->setContentTypeCode(drogon::CT_APPLICATION_JSON);
+        request->setBody(R"({"delta":1})");
+    } else {
+        request->setMethod(drogon::Get);
+        request->setPath(path);
+    }
+    return request;
+}
+
+// 一个流水线槽位：收到应答后立即发出下一个请求，直到截止时间
+void issue(Run& run, Connection& connection)
+{
+    if (Clock::now() >= run.deadline) {
+        if (run.activeSlots.fetch_sub(1) == 1) {
+            run.finished.set_value();
+        }
+        return;
+    }
+
+    const auto start = Clock::now();
+    connection.client->sendRequest(makeRequest(run, connection),
+        [&run, &connection, start](drogon::ReqResult result, const drogon::HttpResponsePtr& response) {
+            if (result != drogon::ReqResult::Ok || !response) {
+                connection.failures++;
+            } else {
+                const auto elapsed = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+                connection.latenciesUs.push_back(elapsed);
+                if (response->statusCode() >= 200 && response->statusCode() < 300) {
+                    connection.ok++;
+                } else {
+                    connection.errors++;
+                }
+            }
+            issue(run, connection);
+        },
+        10.0);
+}
+
+// 压测前准备一批产品，返回它们的 id
+bool seedProducts(const std::string& url, trantor::EventLoop* loop, std::vector<int>& ids)
+{
+    auto client = drogon::HttpClient::newHttpClient(url, loop);
+    for (int i = 0; i < kSeedProducts; ++i) {
+        auto request = drogon::HttpRequest::newHttpRequest();
+        request->setMethod(drogon::Post);
+        request->setPath("/api/products");
+        request->setContentTypeCode(drogon::CT_APPLICATION_JSON);
+        request->setBody(R"({"name":"bench_product_)" + std::to_string(i) + R"(","price":9.99,"stock":1000})");
+
+        const auto [result, response] = client->sendRequest(request, 10.0);
+        if (result != drogon::ReqResult::Ok || !response || response->statusCode() != drogon::k201Created) {
+            std::fprintf(stderr, "准备数据失败: 结果=%d 状态码=%d\n", static_cast<int>(result),
+                response ? static_cast<int>(response->statusCode()) : 0);
+            return false;
+        }
+        const auto json = response->getJsonObject();
+        if (json && json->isMember("last_insert_id")) {
+            ids.push_back((*json)["last_insert_id"].asInt());
+        }
+    }
+    return !ids.empty();
+}
+
+using BenchSupport::percentile;
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    const std::string url = argc > 1 ? argv[1] : "http://127.0.0.1:9464";
+    const int connections = argc > 2 ? std::max(1, std::atoi(argv[2])) : 16;
+    const int depth = argc > 3 ? std::max(1, std::atoi(argv[3])) : 8;
+    const int seconds = argc > 4 ? std::max(1, std::atoi(argv[4])) : 10;
+
+    trantor::EventLoopThreadPool loops(static_cast<size_t>(std::min(connections, 4)), "bench");
+    loops.start();
+
+    Run run;
+    run.writePercent = argc > 5 ? std::clamp(std::atoi(argv[5]), 0, 100) : 10;
+    if (!seedProducts(url, loops.getNextLoop(), run.productIds)) {
+        return 1;
+    }
+
+    std::vector<std::unique_ptr<Connection>> pool;
+    for (int i = 0; i < connections; ++i) {
+        auto connection = std::make_unique<Connection>();
+        connection->client = drogon::HttpClient::newHttpClient(url, loops.getNextLoop());
+        connection->client->setPipeliningDepth(static_cast<size_t>(depth));
+        connection->rng.seed(static_cast<unsigned>(i + 1));
+        pool.push_back(std::move(connection));
+    }
+
+    std::printf("url=%s connections=%d depth=%d seconds=%d write=%d%%\n",
+        url.c_str(), connections, depth, seconds, run.writePercent);
+
+    const auto start = Clock::now();
+    run.deadline = start + std::chrono::seconds(seconds);
+    run.activeSlots = connections * depth;
+    auto finished = run.finished.get_future();
+    for (auto& connection : pool) {
+        Connection* target = connection.get();
+        connection->client->getLoop()->queueInLoop([&run, target, depth]() {
+            for (int slot = 0; slot < depth; ++slot) {
+                issue(run, *target);
+            }
+        });
+    }
+    finished.wait();
+    const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::vector<double> latencies;
+    uint64_t ok = 0, errors = 0, failures = 0;
+    for (const auto& connection : pool) {
+        latencies.insert(latencies.end(), connection->latenciesUs.begin(), connection->latenciesUs.end());
+        ok += connection->ok;
+        errors += connection->errors;
+        failures += connection->failures;
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    std::printf("requests=%zu ok=%llu non2xx=%llu failed=%llu elapsed=%.2fs\n", latencies.size(),
+        static_cast<unsigned long long>(ok), static_cast<unsigned long long>(errors),
+        static_cast<unsigned long long>(failures), elapsed);
+    std::printf("throughput=%.0f req/s\n", latencies.size() / elapsed);
+    std::printf("latency(us) p50=%.0f p90=%.0f p99=%.0f max=%.0f\n", percentile(latencies, 0.50),
+        percentile(latencies, 0.90), percentile(latencies, 0.99), latencies.empty() ? 0.0 : latencies.back());
+
+    pool.clear();
+    return 0;
+}
@@ -0,0 +1,54 @@
+#!/usr/bin/env bash
+# 运行 qt_app_bench 并把结果保存为 bench-results/<提交>.json，便于跨提交对比
+# 用法: bench/run_qt_app_bench.sh <构建目录> [基线 JSON] [其他 benchmark 参数...]
+# 给出基线时按基准名打印前后耗时与变化比例（real_time，越小越好）
+set -euo pipefail
+
+BUILD_DIR=${1:?用法: $0 <构建目录> [基线 JSON] [benchmark 参数...]}
+shift
+BASELINE=""
+if [[ $# -gt 0 && "$1" == *.json ]]; then
+    BASELINE=$1
+    shift
+fi
+
+REPO_DIR=$(cd "$(dirname "$0")/.." && pwd)
+COMMIT=$(git -C "$REPO_DIR" rev-parse --short HEAD 2>/dev/null || echo unknown)
+if ! git -C "$REPO_DIR" diff --quiet 2>/dev/null; then
+    COMMIT="${COMMIT}-dirty"
+fi
+OUT_DIR="$REPO_DIR/bench-results"
+OUT_FILE="$OUT_DIR/qt_app_bench-$COMMIT.json"
+mkdir -p "$OUT_DIR"
+
+# 端到端基准要从构建目录读取 statemachine/
+cd "$BUILD_DIR"
+./qt_app_bench \
+    --benchmark_out="$OUT_FILE" \
+    --benchmark_out_format=json \
+    --benchmark_repetitions=3 \
+    --benchmark_report_aggregates_only=true \
+    "$@"
+echo "结果已保存: $OUT_FILE"
+
+if [[ -n "$BASELINE" ]]; then
+    python3 - "$BASELINE" "$OUT_FILE" <<'EOF'
+import json
+import sys
+
+def load(path):
+    with open(path) as f:
+        data = json.load(f)
+    return {b["name"]: b for b in data["benchmarks"] if b.get("aggregate_name", "median") == "median"}
+
+before, after = load(sys.argv[1]), load(sys.argv[2])
+print(f"{'benchmark':<70} {'before':>12} {'after':>12} {'change':>8}")
+for name, b in after.items():
+    if name not in before:
+        continue
+    old, new = before[name]["real_time"], b["real_time"]
+    unit = b.get("time_unit", "ns")
+    change = (new - old) / old * 100 if old else 0.0
+    print(f"{name:<70} {old:>10.1f}{unit:>2} {new:>10.1f}{unit:>2} {change:>+7.1f}%")
+EOF
+fi
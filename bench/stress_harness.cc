@@ -0,0 +1,445 @@
+// stress_harness.cc
+// 多生产者压测：若干线程按开环速率（固定发出时刻，落后也不跳过）向 SQLite3Handler 提交读/写/库存操作，
+// 统计吞吐、从计划发出时刻算起的延迟分位数（避免协同遗漏）、队列深度时间序列、
+// 操作 ID 碰撞以及状态机 idle/running 的切换次数；--sweep 依次跑多个速率，用于找饱和拐点
+// 用法: qt_app_stress [--producers 4] [--rate 1000] [--duration 10] [--mix 70:20:10]
+//                     [--sweep 500,1000,2000] [--report stress.json]
+// 需从构建目录运行（读取 statemachine/ 下的 SCXML 文件），数据库建在临时目录中
+#include "bench_support.h"
+#include "dboperatethread.h"
+#include "sqlite3handler.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QEventLoop>
+#include <QFile>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QTemporaryDir>
+#include <QTimer>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+enum OperationKind {
+    Read, // getProductById
+    Write, // updateProduct
+    Stock, // increaseProductStock / decreaseProductStock
+    KindCount,
+};
+
+const char* const kKindNames[KindCount] = { "read", "write", "stock" };
+
+struct Options {
+    int producers = 4;
+    QList<double> rates { 1000 }; // 每秒发出的操作总数
+    double durationSeconds = 10;
+    std::array<int, KindCount> mix { 70, 20, 10 };
+    int products = 10000;
+    int sampleMs = 100;
+    int drainTimeoutMs = 30000;
+    QString reportFile;
+};
+
+struct Sample {
+    qint64 elapsedMs;
+    int queueDepth;
+    int inFlight;
+    quint64 issued;
+    quint64 completed;
+    quint64 stateChanges;
+};
+
+// 登记与完成回调都在数据库线程，采样在主线程，共用一把锁
+// 完成可能先于登记到达（处理器在调用返回前就发出了完成信号），先放进 early 等登记时配对
+class Collector {
+public:
+    void registerOperation(const QString& operationId, OperationKind kind, Clock::time_point intended)
+    {
+        QMutexLocker locker(&m_mutex);
+        auto early = m_early.find(operationId);
+        if (early != m_early.end()) {
+            const Completion completion = early.value().takeFirst();
+            if (early.value().isEmpty()) {
+                m_early.erase(early);
+            }
+            record(kind, intended, completion);
+            return;
+        }
+        QList<Pending>& pending = m_pending[operationId];
+        if (!pending.isEmpty()) {
+            // 同一 ID 已有未完成的操作：ID 生成器碰撞
+            ++m_collisions;
+        }
+        pending.append({ kind, intended });
+        ++m_outstanding;
+    }
+
+    void complete(const QString& operationId, bool success)
+    {
+        const Completion completion { Clock::now(), success };
+        QMutexLocker locker(&m_mutex);
+        auto pending = m_pending.find(operationId);
+        if (pending == m_pending.end()) {
+            m_early[operationId].append(completion);
+            return;
+        }
+        const Pending entry = pending.value().takeFirst();
+        if (pending.value().isEmpty()) {
+            m_pending.erase(pending);
+        }
+        --m_outstanding;
+        record(entry.kind, entry.intended, completion);
+    }
+
+    quint64 completed() const
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_completedTotal;
+    }
+
+    qint64 outstanding() const
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_outstanding;
+    }
+
+    // 运行结束后调用（生产者已停止）
+    QJsonObject summarize(Clock::time_point start)
+    {
+        QMutexLocker locker(&m_mutex);
+        QJsonObject latency;
+        std::vector<int64_t> all;
+        for (int kind = 0; kind < KindCount; ++kind) {
+            all.insert(all.end(), m_latencies[kind].begin(), m_latencies[kind].end());
+            QJsonObject entry = BenchSupport::percentiles(m_latencies[kind]);
+            entry["failed"] = static_cast<qint64>(m_failed[kind]);
+            latency[kKindNames[kind]] = entry;
+        }
+        latency["all"] = BenchSupport::percentiles(all);
+
+        quint64 unmatched = 0;
+        for (const auto& completions : m_early) {
+            unmatched += completions.size();
+        }
+        const double activeSeconds = m_lastCompletion > start
+            ? std::chrono::duration<double>(m_lastCompletion - start).count()
+            : 0.0;
+
+        QJsonObject result;
+        result["completed"] = static_cast<qint64>(m_completedTotal);
+        result["failed"] = static_cast<qint64>(std::accumulate(m_failed.begin(), m_failed.end(), quint64(0)));
+        result["lost"] = m_outstanding; // 排空超时后仍未完成
+        result["unmatched_completions"] = static_cast<qint64>(unmatched);
+        result["id_collisions"] = static_cast<qint64>(m_collisions);
+        result["achieved_ops_per_sec"] = activeSeconds > 0 ? m_completedTotal / activeSeconds : 0.0;
+        result["latency_ms"] = latency;
+        return result;
+    }
+
+private:
+    struct Pending {
+        OperationKind kind;
+        Clock::time_point intended;
+    };
+
+    struct Completion {
+        Clock::time_point at;
+        bool success;
+    };
+
+    void record(OperationKind kind, Clock::time_point intended, const Completion& completion)
+    {
+        m_latencies[kind].push_back(std::chrono::duration_cast<std::chrono::microseconds>(completion.at - intended).count());
+        if (!completion.success) {
+            ++m_failed[kind];
+        }
+        ++m_completedTotal;
+        m_lastCompletion = std::max(m_lastCompletion, completion.at);
+    }
+
+    mutable QMutex m_mutex;
+    QHash<QString, QList<Pending>> m_pending;
+    QHash<QString, QList<Completion>> m_early;
+    std::array<std::vector<int64_t>, KindCount> m_latencies;
+    std::array<quint64, KindCount> m_failed {};
+    quint64 m_completedTotal = 0;
+    quint64 m_collisions = 0;
+    qint64 m_outstanding = 0;
+    Clock::time_point m_lastCompletion;
+};
+
+QString submit(SQLite3Handler* handler, OperationKind kind, int productId, int sequence)
+{
+    switch (kind) {
+    case Read:
+        return handler->getProductById(productId);
+    case Write:
+        return handler->updateProduct(productId, { { "price", 1.0 + sequence % 1000 } });
+    case Stock:
+    default:
+        // 增减交替，库存总量保持稳定
+        return sequence % 2 ? handler->increaseProductStock(productId, 1) : handler->decreaseProductStock(productId, 1);
+    }
+}
+
+// 一个生产者：按固定间隔计划发出时刻，落后时立即补发（不跳过），延迟从计划时刻算起
+void runProducer(const Options& options, double rate, int index, SQLite3Handler* handler, Collector& collector,
+    std::atomic<quint64>& issued, Clock::time_point start, Clock::time_point end)
+{
+    std::mt19937 rng(static_cast<unsigned>(index * 7919 + 17));
+    std::discrete_distribution<int> pickKind(options.mix.begin(), options.mix.end());
+    std::uniform_int_distribution<int> pickProduct(1, options.products);
+
+    const auto interval = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(options.producers / rate));
+    // 各生产者错开起点，合起来是均匀的发出节奏
+    Clock::time_point next = start + interval * index / options.producers;
+    for (int sequence = 0; next < end; ++sequence, next += interval) {
+        std::this_thread::sleep_until(next);
+        const auto kind = static_cast<OperationKind>(pickKind(rng));
+        const int productId = pickProduct(rng);
+        const Clock::time_point intended = next;
+
+        // 处理器不是线程安全的，投递到数据库线程调用（OperationDispatcher 的用法）
+        QMetaObject::invokeMethod(handler, [handler, &collector, kind, productId, sequence, intended]() {
+            collector.registerOperation(submit(handler, kind, productId, sequence), kind, intended);
+        }, Qt::QueuedConnection);
+        issued.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+QJsonObject runOnce(const Options& options, double rate, SQLite3Handler* handler)
+{
+    Collector collector;
+    std::atomic<quint64> issued { 0 };
+    std::atomic<quint64> stateChanges { 0 };
+    std::atomic<quint64> runningEntries { 0 };
+
+    const auto completedConnection = QObject::connect(handler, &SQLite3Handler::operationCompleted, handler,
+        [&collector](const QString& operationId, bool success, const QVariant&) { collector.complete(operationId, success); },
+        Qt::DirectConnection);
+    const auto stateConnection = QObject::connect(handler, &SQLite3Handler::stateChanged, handler,
+        [&stateChanges, &runningEntries](const QString& state) {
+            stateChanges.fetch_add(1, std::memory_order_relaxed);
+            if (state == "running") {
+                runningEntries.fetch_add(1, std::memory_order_relaxed);
+            }
+        },
+        Qt::DirectConnection);
+
+    const Clock::time_point start = Clock::now() + std::chrono::milliseconds(50);
+    const Clock::time_point end = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.durationSeconds));
+
+    std::atomic<int> running { options.producers };
+    std::vector<std::thread> producers;
+    for (int i = 0; i < options.producers; ++i) {
+        producers.emplace_back([&, i]() {
+            runProducer(options, rate, i, handler, collector, issued, start, end);
+            running.fetch_sub(1);
+        });
+    }
+
+    // 主线程采样队列深度，生产者结束后等待在途操作排空
+    QList<Sample> series;
+    int peakDepth = 0;
+    QEventLoop loop;
+    QTimer sampler;
+    Clock::time_point drainDeadline;
+    QObject::connect(&sampler, &QTimer::timeout, &loop, [&]() {
+        const auto now = Clock::now();
+        Sample sample {
+            std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count(),
+            handler->queueSize(),
+            handler->inFlightOperations(),
+            issued.load(std::memory_order_relaxed),
+            collector.completed(),
+            stateChanges.load(std::memory_order_relaxed),
+        };
+        peakDepth = std::max(peakDepth, sample.queueDepth);
+        series.append(sample);
+
+        if (running.load() > 0) {
+            return;
+        }
+        if (drainDeadline == Clock::time_point()) {
+            drainDeadline = now + std::chrono::milliseconds(options.drainTimeoutMs);
+        }
+        if (collector.outstanding() == 0 && sample.completed >= sample.issued) {
+            loop.quit();
+        } else if (now >= drainDeadline) {
+            std::fprintf(stderr, "排空超时，仍有 %lld 个操作未完成\n", static_cast<long long>(collector.outstanding()));
+            loop.quit();
+        }
+    });
+    sampler.start(options.sampleMs);
+    loop.exec();
+    sampler.stop();
+    for (std::thread& producer : producers) {
+        producer.join();
+    }
+    QObject::disconnect(completedConnection);
+    QObject::disconnect(stateConnection);
+
+    QJsonObject result = collector.summarize(start);
+    result["offered_ops_per_sec"] = rate;
+    result["issued"] = static_cast<qint64>(issued.load());
+    result["duration_s"] = options.durationSeconds;
+    result["peak_queue_depth"] = peakDepth;
+    result["state_changes"] = static_cast<qint64>(stateChanges.load());
+    result["running_entries"] = static_cast<qint64>(runningEntries.load());
+
+    QJsonArray samples;
+    for (const Sample& sample : series) {
+        samples.append(QJsonObject {
+            { "t_ms", sample.elapsedMs },
+            { "queue_depth", sample.queueDepth },
+            { "in_flight", sample.inFlight },
+            { "issued", static_cast<qint64>(sample.issued) },
+            { "completed", static_cast<qint64>(sample.completed) },
+            { "state_changes", static_cast<qint64>(sample.stateChanges) },
+        });
+    }
+    result["series"] = samples;
+    return result;
+}
+
+bool parseOptions(const QCoreApplication& app, Options& options)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("SQLite3Handler 多生产者压测");
+    parser.addHelpOption();
+    parser.addOptions({
+        { "producers", "生产者线程数", "n", "4" },
+        { "rate", "每秒发出的操作总数（开环）", "ops", "1000" },
+        { "sweep", "依次运行的多个速率，逗号分隔，覆盖 --rate", "ops,..." },
+        { "duration", "每个速率的运行时长（秒）", "seconds", "10" },
+        { "mix", "读:写:库存 的比例", "r:w:s", "70:20:10" },
+        { "products", "预置的商品行数", "n", "10000" },
+        { "sample-ms", "队列深度采样间隔（毫秒）", "ms", "100" },
+        { "report", "JSON 报告输出文件", "file" },
+    });
+    parser.process(app);
+
+    bool ok = true;
+    options.producers = parser.value("producers").toInt(&ok);
+    if (!ok || options.producers <= 0) {
+        std::fprintf(stderr, "--producers 必须为正整数\n");
+        return false;
+    }
+    const QStringList rates = parser.isSet("sweep") ? parser.value("sweep").split(',', Qt::SkipEmptyParts)
+                                                    : QStringList { parser.value("rate") };
+    options.rates.clear();
+    for (const QString& value : rates) {
+        const double rate = value.trimmed().toDouble(&ok);
+        if (!ok || rate <= 0) {
+            std::fprintf(stderr, "速率必须为正数: %s\n", qPrintable(value));
+            return false;
+        }
+        options.rates.append(rate);
+    }
+    options.durationSeconds = parser.value("duration").toDouble(&ok);
+    if (!ok || options.durationSeconds <= 0) {
+        std::fprintf(stderr, "--duration 必须为正数\n");
+        return false;
+    }
+    const QStringList mix = parser.value("mix").split(':');
+    if (mix.size() != KindCount) {
+        std::fprintf(stderr, "--mix 格式为 读:写:库存\n");
+        return false;
+    }
+    int total = 0;
+    for (int kind = 0; kind < KindCount; ++kind) {
+        options.mix[kind] = std::max(0, mix[kind].toInt());
+        total += options.mix[kind];
+    }
+    if (total == 0) {
+        std::fprintf(stderr, "--mix 的比例之和不能为 0\n");
+        return false;
+    }
+    options.products = std::max(1, parser.value("products").toInt());
+    options.sampleMs = std::max(10, parser.value("sample-ms").toInt());
+    options.reportFile = parser.value("report");
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    Options options;
+    if (!parseOptions(app, options)) {
+        return 2;
+    }
+    qInstallMessageHandler(BenchSupport::quietMessageHandler);
+
+    QTemporaryDir tempDir;
+    if (!tempDir.isValid()) {
+        return 1;
+    }
+    const QString dbFile = tempDir.filePath("stress.db");
+
+    // 空库由状态机连接时建表，再预置商品；库存足够大，减库存不会因为不足而失败
+    DBOperateThread dbThread(dbFile);
+    SQLite3Handler* handler = BenchSupport::startDatabase(dbThread);
+    if (!handler) {
+        std::fprintf(stderr, "数据库线程未能建立连接（是否在构建目录中运行？）\n");
+        return 1;
+    }
+    if (!BenchSupport::seedProducts(dbFile, options.products, 1000000)) {
+        dbThread.shutdown();
+        return 1;
+    }
+
+    std::printf("生产者 %d，读:写:库存 = %d:%d:%d，每档 %.1f 秒\n", options.producers, options.mix[Read],
+        options.mix[Write], options.mix[Stock], options.durationSeconds);
+    std::printf("%10s %10s %10s %10s %10s %10s %8s %8s %8s %8s\n", "offered", "achieved", "p50_ms", "p99_ms", "p999_ms",
+        "max_ms", "peak_q", "failed", "lost", "collide");
+
+    QJsonArray runs;
+    for (double rate : options.rates) {
+        const QJsonObject run = runOnce(options, rate, handler);
+        const QJsonObject all = run["latency_ms"].toObject()["all"].toObject();
+        std::printf("%10.0f %10.0f %10.2f %10.2f %10.2f %10.2f %8d %8lld %8lld %8lld\n", rate,
+            run["achieved_ops_per_sec"].toDouble(), all["p50"].toDouble(), all["p99"].toDouble(), all["p999"].toDouble(),
+            all["max"].toDouble(), run["peak_queue_depth"].toInt(), static_cast<long long>(run["failed"].toInteger()),
+            static_cast<long long>(run["lost"].toInteger()), static_cast<long long>(run["id_collisions"].toInteger()));
+        std::fflush(stdout);
+        runs.append(run);
+    }
+
+    if (!options.reportFile.isEmpty()) {
+        QJsonObject report {
+            { "producers", options.producers },
+            { "mix", QJsonObject { { "read", options.mix[Read] }, { "write", options.mix[Write] }, { "stock", options.mix[Stock] } } },
+            { "runs", runs },
+            // 处理器自身的分阶段延迟（所有速率累计），用于区分排队与执行
+            { "handler_latency", QJsonObject::fromVariantMap(handler->latencySnapshot()) },
+        };
+        QFile file(options.reportFile);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            std::fprintf(stderr, "无法写入报告 %s: %s\n", qPrintable(options.reportFile), qPrintable(file.errorString()));
+            return 1;
+        }
+        file.write(QJsonDocument(report).toJson());
+        std::printf("报告已写入 %s\n", qPrintable(options.reportFile));
+    }
+
+    dbThread.shutdown();
+    return 0;
+}
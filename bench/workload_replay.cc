@@ -0,0 +1,445 @@
+// workload_replay.cc
+// 工作负载回放：读取 QT_APP_CAPTURE 录制的二进制日志，在数据库快照的临时副本上重新发出请求，
+// 按原节奏（--speed 1）、N 倍速（--speed N）或尽快（--afap，限制在途数量）回放，
+// 统计总体与按语句的延迟分布；--baseline 给出另一次（例如另一个构建）的报告时逐条语句对比
+// 用法: qt_app_replay <录制文件> [--db 快照] [--speed N | --afap [--window 64]] [--limit N]
+//                     [--report out.json] [--baseline old.json]
+// 需从构建目录运行（读取 statemachine/ 下的 SCXML 文件）；快照默认为 <录制文件>.db
+#include "bench_support.h"
+#include "dboperatethread.h"
+#include "sqlite3handler.h"
+#include "version.h"
+#include "workloadcapture.h"
+#include <sqlite3.h>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QTemporaryDir>
+#include <QTimer>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const char kIdPrefix[] = "replay_";
+
+struct Options {
+    QString captureFile;
+    QString dbFile;
+    double speed = 1.0;
+    bool afap = false;
+    int window = 64; // --afap 时的最大在途请求数
+    qint64 limit = 0;
+    int drainTimeoutMs = 60000;
+    QString reportFile;
+    QString baselineFile;
+};
+
+// 回放请求的完成记录；完成回调在数据库线程，其余在发出线程或主线程
+class Tracker {
+public:
+    explicit Tracker(std::size_t count)
+        : m_intended(count)
+        , m_completed(count)
+        , m_success(count, false)
+    {
+    }
+
+    void issued(std::size_t index, Clock::time_point intended)
+    {
+        std::lock_guard<std::mutex> locker(m_mutex);
+        m_intended[index] = intended;
+        ++m_issued;
+    }
+
+    void complete(const QString& operationId, bool success)
+    {
+        const Clock::time_point now = Clock::now();
+        if (!operationId.startsWith(kIdPrefix)) {
+            return;
+        }
+        bool ok = false;
+        const qulonglong index = operationId.mid(sizeof(kIdPrefix) - 1).toULongLong(&ok);
+        {
+            std::lock_guard<std::mutex> locker(m_mutex);
+            if (!ok || index >= m_completed.size() || m_completed[index] != Clock::time_point()) {
+                return;
+            }
+            m_completed[index] = now;
+            m_success[index] = success;
+            ++m_done;
+        }
+        m_changed.notify_all();
+    }
+
+    // --afap：在途数量达到 window 时阻塞
+    void waitForWindow(std::size_t window)
+    {
+        std::unique_lock<std::mutex> locker(m_mutex);
+        m_changed.wait(locker, [&]() { return m_issued - m_done < window; });
+    }
+
+    std::size_t issuedCount() const
+    {
+        std::lock_guard<std::mutex> locker(m_mutex);
+        return m_issued;
+    }
+
+    std::size_t doneCount() const
+    {
+        std::lock_guard<std::mutex> locker(m_mutex);
+        return m_done;
+    }
+
+    // 以下在回放结束后调用；未完成的请求返回 -1
+    int64_t latencyUs(std::size_t index) const
+    {
+        if (m_completed[index] == Clock::time_point()) {
+            return -1;
+        }
+        return std::chrono::duration_cast<std::chrono::microseconds>(m_completed[index] - m_intended[index]).count();
+    }
+    bool succeeded(std::size_t index) const { return m_success[index]; }
+    Clock::time_point lastCompletion() const
+    {
+        return m_completed.empty() ? Clock::time_point() : *std::max_element(m_completed.begin(), m_completed.end());
+    }
+
+private:
+    mutable std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::vector<Clock::time_point> m_intended;
+    std::vector<Clock::time_point> m_completed;
+    std::vector<bool> m_success;
+    std::size_t m_issued = 0;
+    std::size_t m_done = 0;
+};
+
+// 在线备份到临时目录，源库可能仍在被应用使用（WAL 模式）
+bool copyDatabase(const QString& source, const QString& target, QString& error)
+{
+    sqlite3* from = nullptr;
+    sqlite3* to = nullptr;
+    bool ok = sqlite3_open_v2(source.toUtf8().constData(), &from, SQLITE_OPEN_READONLY, nullptr) == SQLITE_OK
+        && sqlite3_open(target.toUtf8().constData(), &to) == SQLITE_OK;
+    if (ok) {
+        sqlite3_backup* backup = sqlite3_backup_init(to, "main", from, "main");
+        ok = backup && sqlite3_backup_step(backup, -1) == SQLITE_DONE;
+        sqlite3_backup_finish(backup);
+    }
+    if (!ok) {
+        error = QString("复制数据库 %1 失败: %2").arg(source, QString::fromUtf8(sqlite3_errmsg(to ? to : from)));
+    }
+    sqlite3_close(to);
+    sqlite3_close(from);
+    return ok;
+}
+
+void issueRequests(const Options& options, const CapturedWorkload& workload, std::size_t count,
+    SQLite3Handler* handler, Tracker& tracker, Clock::time_point start)
+{
+    for (std::size_t i = 0; i < count; ++i) {
+        const CapturedRequest& captured = workload.requests[i];
+        Clock::time_point intended;
+        if (options.afap) {
+            tracker.waitForWindow(static_cast<std::size_t>(options.window));
+            intended = Clock::now();
+        } else {
+            // 按录制时的到达间隔缩放；落后时立即补发，延迟仍从计划时刻算起
+            intended = start + std::chrono::microseconds(static_cast<int64_t>(captured.arrivalUs / options.speed));
+            std::this_thread::sleep_until(intended);
+        }
+
+        OperationRequest request = captured.request;
+        request.id = kIdPrefix + std::to_string(i);
+        request.timestamp = std::chrono::system_clock::now();
+        request.enqueued_at = Clock::now();
+        tracker.issued(i, intended);
+        QMetaObject::invokeMethod(handler, [handler, request]() { handler->replayRequest(request); }, Qt::QueuedConnection);
+    }
+}
+
+QJsonObject buildReport(const Options& options, const CapturedWorkload& workload, std::size_t count,
+    const Tracker& tracker, Clock::time_point start, SQLite3Handler* handler)
+{
+    std::vector<int64_t> all;
+    std::vector<std::vector<int64_t>> byStatement(workload.statements.size() + 1);
+    std::vector<qint64> failedByStatement(workload.statements.size() + 1, 0);
+    std::vector<QString> typeByStatement(workload.statements.size() + 1);
+    qint64 failed = 0;
+    qint64 lost = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        const uint32_t statement = workload.requests[i].statementId;
+        typeByStatement[statement] = QString::fromStdString(workload.requests[i].request.type);
+        const int64_t latency = tracker.latencyUs(i);
+        if (latency < 0) {
+            ++lost;
+            continue;
+        }
+        all.push_back(latency);
+        byStatement[statement].push_back(latency);
+        if (!tracker.succeeded(i)) {
+            ++failed;
+            ++failedByStatement[statement];
+        }
+    }
+
+    QJsonArray statements;
+    for (std::size_t id = 0; id < byStatement.size(); ++id) {
+        if (byStatement[id].empty() && failedByStatement[id] == 0) {
+            continue;
+        }
+        QJsonObject entry = BenchSupport::percentiles(byStatement[id]);
+        entry["sql"] = id ? QString::fromStdString(workload.statements[id - 1]) : QString("(无语句)");
+        entry["type"] = typeByStatement[id];
+        entry["failed"] = failedByStatement[id];
+        statements.append(entry);
+    }
+
+    const Clock::time_point last = tracker.lastCompletion();
+    const double wallSeconds = last > start ? std::chrono::duration<double>(last - start).count() : 0.0;
+    const double capturedSeconds = count ? workload.requests[count - 1].arrivalUs / 1e6 : 0.0;
+
+    QJsonObject report;
+    report["capture"] = QFileInfo(options.captureFile).fileName();
+    report["version"] = VersionInfo::fullVersion();
+    report["git"] = VersionInfo::gitInfo();
+    report["mode"] = options.afap ? QString("afap") : QString("paced");
+    report["speed"] = options.speed;
+    report["window"] = options.afap ? options.window : 0;
+    report["requests"] = static_cast<qint64>(count);
+    report["completed"] = static_cast<qint64>(all.size());
+    report["failed"] = failed;
+    report["lost"] = lost;
+    report["captured_span_s"] = capturedSeconds;
+    report["wall_s"] = wallSeconds;
+    report["achieved_ops_per_sec"] = wallSeconds > 0 ? all.size() / wallSeconds : 0.0;
+    report["latency_ms"] = BenchSupport::percentiles(all);
+    report["statements"] = statements;
+    // 处理器的分阶段延迟，用于区分排队与执行
+    report["handler_latency"] = QJsonObject::fromVariantMap(handler->latencySnapshot());
+    return report;
+}
+
+QString shorten(QString sql, int width)
+{
+    sql = sql.simplified();
+    return sql.size() > width ? sql.left(width - 3) + "..." : sql;
+}
+
+void printComparison(const QJsonObject& before, const QJsonObject& after)
+{
+    if (before["mode"] != after["mode"] || before["speed"] != after["speed"]) {
+        std::printf("注意：基线的回放方式（%s ×%.2f）与本次不同\n", qPrintable(before["mode"].toString()),
+            before["speed"].toDouble());
+    }
+    std::printf("\n基线 %s → 本次 %s\n", qPrintable(before["version"].toString()), qPrintable(after["version"].toString()));
+    std::printf("%-60s %8s %10s %10s %8s %10s %10s %8s\n", "statement", "count", "p50_old", "p50_new", "change",
+        "p99_old", "p99_new", "change");
+
+    auto row = [](const QString& label, const QJsonObject& old, const QJsonObject& now) {
+        auto change = [](double a, double b) { return a > 0 ? (b - a) / a * 100 : 0.0; };
+        const double p50Old = old["p50"].toDouble(), p50New = now["p50"].toDouble();
+        const double p99Old = old["p99"].toDouble(), p99New = now["p99"].toDouble();
+        std::printf("%-60s %8lld %10.3f %10.3f %+7.1f%% %10.3f %10.3f %+7.1f%%\n", qPrintable(shorten(label, 60)),
+            static_cast<long long>(now["count"].toInteger()), p50Old, p50New, change(p50Old, p50New), p99Old, p99New,
+            change(p99Old, p99New));
+    };
+
+    QHash<QString, QJsonObject> baseline;
+    for (const QJsonValue& value : before["statements"].toArray()) {
+        baseline.insert(value["sql"].toString(), value.toObject());
+    }
+    for (const QJsonValue& value : after["statements"].toArray()) {
+        const QJsonObject statement = value.toObject();
+        auto old = baseline.constFind(statement["sql"].toString());
+        if (old != baseline.constEnd()) {
+            row(statement["sql"].toString(), old.value(), statement);
+        }
+    }
+    row("(全部)", before["latency_ms"].toObject(), after["latency_ms"].toObject());
+    std::printf("吞吐 %.0f → %.0f ops/s，失败 %lld → %lld\n", before["achieved_ops_per_sec"].toDouble(),
+        after["achieved_ops_per_sec"].toDouble(), static_cast<long long>(before["failed"].toInteger()),
+        static_cast<long long>(after["failed"].toInteger()));
+}
+
+bool parseOptions(const QCoreApplication& app, Options& options)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("工作负载回放与构建间延迟对比");
+    parser.addHelpOption();
+    parser.addPositionalArgument("capture", "QT_APP_CAPTURE 录制的文件");
+    parser.addOptions({
+        { "db", "回放起点的数据库快照（默认 <录制文件>.db），回放在其临时副本上进行", "file" },
+        { "speed", "相对录制节奏的倍速", "n", "1" },
+        { "afap", "不按录制节奏，尽快发出（在途数量受 --window 限制）" },
+        { "window", "--afap 时的最大在途请求数", "n", "64" },
+        { "limit", "只回放前 N 条请求", "n" },
+        { "report", "JSON 报告输出文件", "file" },
+        { "baseline", "与之对比的另一份报告", "file" },
+    });
+    parser.process(app);
+
+    const QStringList positional = parser.positionalArguments();
+    if (positional.size() != 1) {
+        parser.showHelp(2);
+    }
+    options.captureFile = positional.first();
+    options.dbFile = parser.isSet("db") ? parser.value("db") : options.captureFile + ".db";
+
+    bool ok = true;
+    options.speed = parser.value("speed").toDouble(&ok);
+    if (!ok || options.speed <= 0) {
+        std::fprintf(stderr, "--speed 必须为正数\n");
+        return false;
+    }
+    options.afap = parser.isSet("afap");
+    options.window = std::max(1, parser.value("window").toInt());
+    options.limit = parser.isSet("limit") ? std::max<qint64>(0, parser.value("limit").toLongLong()) : 0;
+    options.reportFile = parser.value("report");
+    options.baselineFile = parser.value("baseline");
+    return true;
+}
+
+bool loadBaseline(const QString& path, QJsonObject& baseline)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        std::fprintf(stderr, "无法读取基线 %s: %s\n", qPrintable(path), qPrintable(file.errorString()));
+        return false;
+    }
+    baseline = QJsonDocument::fromJson(file.readAll()).object();
+    if (!baseline.contains("statements")) {
+        std::fprintf(stderr, "%s 不是回放报告\n", qPrintable(path));
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    Options options;
+    if (!parseOptions(app, options)) {
+        return 2;
+    }
+    // 基线在回放前读取，避免跑完才发现文件有误
+    QJsonObject baseline;
+    if (!options.baselineFile.isEmpty() && !loadBaseline(options.baselineFile, baseline)) {
+        return 2;
+    }
+    qInstallMessageHandler(BenchSupport::quietMessageHandler);
+
+    CapturedWorkload workload;
+    QString error;
+    if (!WorkloadLog::read(options.captureFile, workload, error)) {
+        std::fprintf(stderr, "%s\n", qPrintable(error));
+        return 1;
+    }
+    if (workload.truncated) {
+        std::fprintf(stderr, "录制文件末尾有不完整的记录，已忽略\n");
+    }
+    std::size_t count = workload.requests.size();
+    if (options.limit > 0) {
+        count = std::min(count, static_cast<std::size_t>(options.limit));
+    }
+    if (count == 0) {
+        std::fprintf(stderr, "录制文件中没有请求\n");
+        return 1;
+    }
+
+    QTemporaryDir tempDir;
+    const QString replayDb = tempDir.filePath("replay.db");
+    if (!tempDir.isValid() || !copyDatabase(options.dbFile, replayDb, error)) {
+        std::fprintf(stderr, "%s\n", qPrintable(error));
+        return 1;
+    }
+
+    DBOperateThread dbThread(replayDb);
+    SQLite3Handler* handler = BenchSupport::startDatabase(dbThread);
+    if (!handler) {
+        std::fprintf(stderr, "数据库线程未能建立连接（是否在构建目录中运行？）\n");
+        return 1;
+    }
+
+    Tracker tracker(count);
+    QObject::connect(handler, &SQLite3Handler::operationCompleted, handler,
+        [&tracker](const QString& operationId, bool success, const QVariant&) { tracker.complete(operationId, success); },
+        Qt::DirectConnection);
+
+    const QString pacing = options.afap ? QString("尽快发出，在途上限 %1").arg(options.window)
+                                        : QString("%1 倍速").arg(options.speed);
+    std::printf("回放 %zu 条请求（%zu 条语句，录制跨度 %.1f 秒），%s\n", count, workload.statements.size(),
+        workload.requests[count - 1].arrivalUs / 1e6, qPrintable(pacing));
+
+    const Clock::time_point start = Clock::now() + std::chrono::milliseconds(50);
+    std::thread issuer(issueRequests, std::cref(options), std::cref(workload), count, handler, std::ref(tracker), start);
+
+    // 主线程等待全部完成；发完后最多再等 drainTimeoutMs
+    QEventLoop loop;
+    QTimer poll;
+    Clock::time_point drainDeadline;
+    QObject::connect(&poll, &QTimer::timeout, &loop, [&]() {
+        if (tracker.doneCount() >= count) {
+            loop.quit();
+            return;
+        }
+        if (tracker.issuedCount() < count) {
+            return;
+        }
+        if (drainDeadline == Clock::time_point()) {
+            drainDeadline = Clock::now() + std::chrono::milliseconds(options.drainTimeoutMs);
+        } else if (Clock::now() >= drainDeadline) {
+            std::fprintf(stderr, "排空超时，%zu 条请求未完成\n", count - tracker.doneCount());
+            loop.quit();
+        }
+    });
+    poll.start(100);
+    loop.exec();
+    issuer.join();
+
+    const QJsonObject report = buildReport(options, workload, count, tracker, start, handler);
+    const QJsonObject overall = report["latency_ms"].toObject();
+    std::printf("完成 %lld，失败 %lld，未完成 %lld，耗时 %.2f 秒，%.0f ops/s\n",
+        static_cast<long long>(report["completed"].toInteger()), static_cast<long long>(report["failed"].toInteger()),
+        static_cast<long long>(report["lost"].toInteger()), report["wall_s"].toDouble(),
+        report["achieved_ops_per_sec"].toDouble());
+    std::printf("延迟 ms: p50 %.3f  p90 %.3f  p99 %.3f  p99.9 %.3f  max %.3f\n", overall["p50"].toDouble(),
+        overall["p90"].toDouble(), overall["p99"].toDouble(), overall["p999"].toDouble(), overall["max"].toDouble());
+
+    if (!baseline.isEmpty()) {
+        printComparison(baseline, report);
+    }
+
+    if (!options.reportFile.isEmpty()) {
+        QFile file(options.reportFile);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            std::fprintf(stderr, "无法写入报告 %s: %s\n", qPrintable(options.reportFile), qPrintable(file.errorString()));
+            return 1;
+        }
+        file.write(QJsonDocument(report).toJson());
+        std::printf("报告已写入 %s\n", qPrintable(options.reportFile));
+    }
+
+    dbThread.shutdown();
+    return 0;
+}
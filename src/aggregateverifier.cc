@@ -0,0 +1,150 @@
+// aggregateverifier.cc
+#include "aggregateverifier.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <algorithm>
+#include <cmath>
+#include <sqlite3.h>
+
+namespace {
+// 价值类聚合是浮点数逐次累加的结果，按相对误差比较
+constexpr double kRelativeTolerance = 1e-9;
+}
+
+AggregateVerifier::AggregateVerifier(const QString& dbFile, const QMap<QString, QString>& recomputeQueries,
+    int intervalMs, QObject* parent)
+    : QObject(parent)
+    , m_dbFile(dbFile)
+    , m_queries(recomputeQueries)
+    , m_intervalMs(intervalMs)
+{
+}
+
+AggregateVerifier::~AggregateVerifier()
+{
+    closeConnection();
+}
+
+QVariantMap AggregateVerifier::metrics() const
+{
+    QVariantMap result;
+    result["verify_runs"] = static_cast<quint64>(m_runs.load());
+    result["verify_drifts"] = static_cast<quint64>(m_drifts.load());
+    result["verify_failures"] = static_cast<quint64>(m_failures.load());
+    result["last_verify_duration_ms"] = static_cast<qint64>(m_lastDurationMs.load());
+    return result;
+}
+
+void AggregateVerifier::start()
+{
+    if (m_timer || m_intervalMs <= 0) {
+        return;
+    }
+
+    m_timer = new QTimer(this);
+    connect(m_timer, &QTimer::timeout, this, &AggregateVerifier::verifyNow);
+    m_timer->start(m_intervalMs);
+    qDebug() << "物化聚合校验已启动，周期:" << m_intervalMs << "ms";
+}
+
+void AggregateVerifier::stop()
+{
+    if (m_timer) {
+        m_timer->stop();
+        m_timer->deleteLater();
+        m_timer = nullptr;
+    }
+    closeConnection();
+}
+
+void AggregateVerifier::verifyNow()
+{
+    if (!openConnection()) {
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QStringList drifted;
+    const bool ok = verify(drifted);
+    m_lastDurationMs = timer.elapsed();
+    m_runs.fetch_add(1, std::memory_order_relaxed);
+
+    if (!ok) {
+        m_failures.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (!drifted.isEmpty()) {
+        m_drifts.fetch_add(drifted.size(), std::memory_order_relaxed);
+        emit driftDetected(drifted);
+    }
+}
+
+bool AggregateVerifier::openConnection()
+{
+    if (m_db) {
+        return true;
+    }
+
+    const QByteArray path = m_dbFile.toUtf8();
+    const int rc = sqlite3_open_v2(path.constData(), &m_db, SQLITE_OPEN_READONLY, nullptr);
+    if (rc != SQLITE_OK) {
+        const QString error = QString("聚合校验连接打开失败: %1").arg(m_db ? sqlite3_errmsg(m_db) : sqlite3_errstr(rc));
+        qWarning() << error;
+        closeConnection();
+        emit errorOccurred(error);
+        return false;
+    }
+    sqlite3_busy_timeout(m_db, 1000);
+    return true;
+}
+
+void AggregateVerifier::closeConnection()
+{
+    if (m_db) {
+        sqlite3_close_v2(m_db);
+        m_db = nullptr;
+    }
+}
+
+bool AggregateVerifier::verify(QStringList& drifted)
+{
+    // WAL 模式下读事务看到的是开始时的快照，存储值与重算值来自同一时刻，不受并发写入影响
+    if (sqlite3_exec(m_db, "BEGIN", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        return false;
+    }
+
+    bool ok = true;
+    for (auto it = m_queries.cbegin(); it != m_queries.cend() && ok; ++it) {
+        const QByteArray sql = QString("SELECT (SELECT value FROM materialized_aggregates WHERE name = ?1), (%1)")
+                                   .arg(it.value())
+                                   .toUtf8();
+        const QByteArray name = it.key().toUtf8();
+
+        sqlite3_stmt* st = nullptr;
+        if (sqlite3_prepare_v2(m_db, sql.constData(), -1, &st, nullptr) != SQLITE_OK) {
+            qWarning() << "聚合校验语句准备失败:" << it.key() << sqlite3_errmsg(m_db);
+            ok = false;
+            break;
+        }
+        sqlite3_bind_text(st, 1, name.constData(), name.size(), SQLITE_STATIC);
+
+        if (sqlite3_step(st) == SQLITE_ROW) {
+            const bool missing = sqlite3_column_type(st, 0) == SQLITE_NULL;
+            const double stored = sqlite3_column_double(st, 0);
+            const double expected = sqlite3_column_double(st, 1);
+            if (missing || std::abs(stored - expected) > kRelativeTolerance * std::max(1.0, std::abs(expected))) {
+                qWarning() << "物化聚合偏差:" << it.key() << "存储值" << stored << "重算值" << expected;
+                drifted.append(it.key());
+            }
+        } else {
+            qWarning() << "聚合校验执行失败:" << it.key() << sqlite3_errmsg(m_db);
+            ok = false;
+        }
+        sqlite3_finalize(st);
+    }
+
+    sqlite3_exec(m_db, "COMMIT", nullptr, nullptr, nullptr);
+    return ok;
+}
@@ -0,0 +1,55 @@
+// aggregateverifier.h
+#ifndef AGGREGATEVERIFIER_H
+#define AGGREGATEVERIFIER_H
+
+#include <QMap>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+#include <QVariantMap>
+#include <atomic>
+
+struct sqlite3;
+
+// 物化聚合后台校验器，运行在独立的低优先级线程中，使用自己的只读连接
+// 在同一个读事务（同一快照）中比较存储值与全量重算值，不一致的聚合通过 driftDetected 交给写连接修复
+class AggregateVerifier : public QObject {
+    Q_OBJECT
+
+public:
+    AggregateVerifier(const QString& dbFile, const QMap<QString, QString>& recomputeQueries, int intervalMs,
+        QObject* parent = nullptr);
+    ~AggregateVerifier();
+
+    // 线程安全的指标读取
+    QVariantMap metrics() const;
+
+public slots:
+    void start();
+    void stop();
+    void verifyNow();
+
+signals:
+    void driftDetected(const QStringList& names);
+    void errorOccurred(const QString& error);
+
+private:
+    bool openConnection();
+    void closeConnection();
+    // 返回 false 表示本轮执行失败；drifted 为不一致的聚合名
+    bool verify(QStringList& drifted);
+
+    QString m_dbFile;
+    QMap<QString, QString> m_queries;
+    int m_intervalMs;
+    sqlite3* m_db = nullptr;
+    QTimer* m_timer = nullptr;
+
+    std::atomic<quint64> m_runs { 0 };
+    std::atomic<quint64> m_drifts { 0 };
+    std::atomic<quint64> m_failures { 0 };
+    std::atomic<qint64> m_lastDurationMs { 0 };
+};
+
+#endif // AGGREGATEVERIFIER_H
@@ -0,0 +1,126 @@
+// changetracker.cc
+#include "changetracker.h"
+#include "sqlite3statemachine.h"
+#include <QDebug>
+#include <sqlite3.h>
+
+// SQLite 钩子回调，转发到对应的 ChangeTracker
+struct ChangeTrackerHooks {
+    static void onUpdate(void* context, int operation, const char* /*database*/, const char* table, sqlite3_int64 rowid)
+    {
+        static_cast<ChangeTracker*>(context)->recordChange(operation, table, rowid);
+    }
+
+    static int onCommit(void* context)
+    {
+        static_cast<ChangeTracker*>(context)->commitPending();
+        return 0; // 0 表示允许提交
+    }
+
+    static void onRollback(void* context)
+    {
+        static_cast<ChangeTracker*>(context)->discardPending();
+    }
+};
+
+ChangeTracker::ChangeTracker(SQLite3StateMachine* stateMachine, QObject* parent)
+    : QObject(parent)
+    , m_stateMachine(stateMachine)
+{
+}
+
+ChangeTracker::~ChangeTracker()
+{
+    uninstall();
+}
+
+void ChangeTracker::watch(const QString& table)
+{
+    m_watched.insert(table.toUtf8());
+}
+
+bool ChangeTracker::install()
+{
+    if (m_db) {
+        return true;
+    }
+
+    m_db = m_stateMachine->nativeHandle();
+    if (!m_db) {
+        return false;
+    }
+
+    sqlite3_update_hook(m_db, &ChangeTrackerHooks::onUpdate, this);
+    sqlite3_commit_hook(m_db, &ChangeTrackerHooks::onCommit, this);
+    sqlite3_rollback_hook(m_db, &ChangeTrackerHooks::onRollback, this);
+    qDebug() << "变更跟踪已启用，关注表:" << m_watched.values();
+    return true;
+}
+
+void ChangeTracker::uninstall()
+{
+    if (!m_db) {
+        return;
+    }
+
+    // 连接断开时句柄已经失效，只有仍然是同一个连接时才注销
+    if (m_stateMachine->nativeHandle() == m_db) {
+        sqlite3_update_hook(m_db, nullptr, nullptr);
+        sqlite3_commit_hook(m_db, nullptr, nullptr);
+        sqlite3_rollback_hook(m_db, nullptr, nullptr);
+    }
+    m_db = nullptr;
+}
+
+void ChangeTracker::recordChange(int sqliteOperation, const char* table, qint64 rowid)
+{
+    const QByteArray tableName(table);
+    if (!m_watched.contains(tableName)) {
+        return;
+    }
+
+    m_pending[QString::fromUtf8(tableName)][rowid] = (sqliteOperation == SQLITE_DELETE) ? Operation::Delete : Operation::Upsert;
+}
+
+void ChangeTracker::commitPending()
+{
+    if (m_pending.isEmpty()) {
+        return;
+    }
+
+    for (auto table = m_pending.cbegin(); table != m_pending.cend(); ++table) {
+        QHash<qint64, Operation>& committed = m_committed[table.key()];
+        for (auto row = table.value().cbegin(); row != table.value().cend(); ++row) {
+            committed[row.key()] = row.value();
+        }
+    }
+    m_pending.clear();
+
+    // 提交钩子里不能访问数据库，分发放到下一轮事件循环
+    if (!m_dispatchScheduled) {
+        m_dispatchScheduled = true;
+        QMetaObject::invokeMethod(this, &ChangeTracker::dispatch, Qt::QueuedConnection);
+    }
+}
+
+void ChangeTracker::discardPending()
+{
+    m_pending.clear();
+}
+
+void ChangeTracker::dispatch()
+{
+    m_dispatchScheduled = false;
+
+    const QHash<QString, QHash<qint64, Operation>> committed = std::move(m_committed);
+    m_committed.clear();
+
+    for (auto table = committed.cbegin(); table != committed.cend(); ++table) {
+        QList<RowChange> changes;
+        changes.reserve(table.value().size());
+        for (auto row = table.value().cbegin(); row != table.value().cend(); ++row) {
+            changes.append({ row.value(), row.key() });
+        }
+        emit tableChanged(table.key(), changes);
+    }
+}
@@ -0,0 +1,65 @@
+// changetracker.h
+#ifndef CHANGETRACKER_H
+#define CHANGETRACKER_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QSet>
+#include <QString>
+
+class SQLite3StateMachine;
+struct sqlite3;
+
+// 行级变更通知
+// 在写连接上注册 update/commit/rollback 钩子，只记录被关注的表；
+// 钩子里不能访问数据库，已提交的变更在下一轮事件循环中（两次操作之间）统一分发，
+// 接收方可以在槽函数里回查最新的行
+class ChangeTracker : public QObject {
+    Q_OBJECT
+
+public:
+    enum class Operation {
+        Upsert, // 插入或更新，以当前行为准
+        Delete,
+    };
+
+    struct RowChange {
+        Operation operation;
+        qint64 rowid;
+    };
+
+    explicit ChangeTracker(SQLite3StateMachine* stateMachine, QObject* parent = nullptr);
+    ~ChangeTracker();
+
+    // 以下在数据库线程调用
+    void watch(const QString& table);
+    bool install();
+    void uninstall();
+
+signals:
+    // 同一事务内对同一行的多次修改合并为最后一次
+    void tableChanged(const QString& table, const QList<ChangeTracker::RowChange>& changes);
+
+private slots:
+    void dispatch();
+
+private:
+    friend struct ChangeTrackerHooks;
+
+    void recordChange(int sqliteOperation, const char* table, qint64 rowid);
+    void commitPending();
+    void discardPending();
+
+    SQLite3StateMachine* m_stateMachine;
+    sqlite3* m_db = nullptr;
+    QSet<QByteArray> m_watched;
+
+    // 事务内尚未提交的变更 / 已提交待分发的变更
+    QHash<QString, QHash<qint64, Operation>> m_pending;
+    QHash<QString, QHash<qint64, Operation>> m_committed;
+    bool m_dispatchScheduled = false;
+};
+
+#endif // CHANGETRACKER_H
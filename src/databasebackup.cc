@@ -0,0 +1,145 @@
+// databasebackup.cc
+#include "databasebackup.h"
+#include <QDebug>
+#include <QFile>
+#include <QVariantMap>
+#include <sqlite3.h>
+
+DatabaseBackup::DatabaseBackup(const QString& operationId, sqlite3* source, const QString& destFile,
+    const BackupOptions& options, QObject* parent)
+    : QObject(parent)
+    , m_operationId(operationId)
+    , m_source(source)
+    , m_destFile(destFile)
+    , m_tempFile(destFile + ".part")
+    , m_options(options)
+{
+    m_timer.setSingleShot(true);
+    connect(&m_timer, &QTimer::timeout, this, &DatabaseBackup::step);
+}
+
+DatabaseBackup::~DatabaseBackup()
+{
+    release();
+}
+
+void DatabaseBackup::setBusyProbe(std::function<bool()> probe)
+{
+    m_busyProbe = std::move(probe);
+}
+
+bool DatabaseBackup::start()
+{
+    if (!m_source) {
+        finish(false, "数据库连接已断开");
+        return false;
+    }
+
+    // 先写到临时文件，完成后再改名，目标路径上永远只会出现完整的快照
+    QFile::remove(m_tempFile);
+
+    const QByteArray path = m_tempFile.toUtf8();
+    if (sqlite3_open_v2(path.constData(), &m_dest, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr) != SQLITE_OK) {
+        finish(false, QString("无法创建备份文件: %1").arg(m_dest ? sqlite3_errmsg(m_dest) : "out of memory"));
+        return false;
+    }
+
+    m_backup = sqlite3_backup_init(m_dest, "main", m_source, "main");
+    if (!m_backup) {
+        finish(false, QString("备份初始化失败: %1").arg(sqlite3_errmsg(m_dest)));
+        return false;
+    }
+
+    qDebug() << "开始在线备份:" << m_destFile << "每步页数:" << m_options.pagesPerStep;
+    m_elapsed.start();
+    m_timer.start(0);
+    return true;
+}
+
+void DatabaseBackup::cancel()
+{
+    if (!m_done) {
+        finish(false, "备份已取消");
+    }
+}
+
+void DatabaseBackup::step()
+{
+    if (m_done) {
+        return;
+    }
+
+    // 队列里有待处理的操作时先让路，但连续推迟有上限
+    if (m_busyProbe && m_busyProbe() && m_deferredSteps < m_options.maxDeferredSteps) {
+        ++m_deferredSteps;
+        m_timer.start(m_options.stepIntervalMs);
+        return;
+    }
+    m_deferredSteps = 0;
+
+    const int rc = sqlite3_backup_step(m_backup, m_options.pagesPerStep);
+    ++m_steps;
+
+    const int remaining = sqlite3_backup_remaining(m_backup);
+    const int total = sqlite3_backup_pagecount(m_backup);
+    emit progress(m_operationId, remaining, total);
+
+    if (rc == SQLITE_DONE) {
+        finish(true);
+        return;
+    }
+
+    if (rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED) {
+        m_timer.start(m_options.stepIntervalMs);
+        return;
+    }
+
+    finish(false, QString("备份失败: %1").arg(sqlite3_errstr(rc)));
+}
+
+void DatabaseBackup::finish(bool success, const QString& error)
+{
+    m_done = true;
+    m_timer.stop();
+
+    const int totalPages = m_backup ? sqlite3_backup_pagecount(m_backup) : 0;
+    release();
+
+    QVariant result;
+    if (success) {
+        QFile::remove(m_destFile);
+        if (!QFile::rename(m_tempFile, m_destFile)) {
+            success = false;
+            result = QString("备份文件改名失败: %1").arg(m_destFile);
+        } else {
+            QVariantMap summary;
+            summary["file"] = m_destFile;
+            summary["pages"] = totalPages;
+            summary["steps"] = m_steps;
+            summary["elapsed_ms"] = m_elapsed.isValid() ? m_elapsed.elapsed() : 0;
+            result = summary;
+            qDebug() << "在线备份完成:" << m_destFile << "页数:" << totalPages << "耗时:" << summary["elapsed_ms"].toLongLong() << "ms";
+        }
+    } else {
+        result = error;
+    }
+
+    if (!success) {
+        QFile::remove(m_tempFile);
+        qWarning() << "在线备份失败:" << result.toString();
+    }
+
+    emit finished(m_operationId, success, result);
+}
+
+void DatabaseBackup::release()
+{
+    if (m_backup) {
+        sqlite3_backup_finish(m_backup);
+        m_backup = nullptr;
+    }
+    if (m_dest) {
+        sqlite3_close_v2(m_dest);
+        m_dest = nullptr;
+    }
+}
@@ -0,0 +1,68 @@
+// databasebackup.h
+#ifndef DATABASEBACKUP_H
+#define DATABASEBACKUP_H
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <QVariant>
+#include <functional>
+
+struct sqlite3;
+struct sqlite3_backup;
+
+// 在线备份的节流参数
+struct BackupOptions {
+    int pagesPerStep = 64; // 每一步复制的页数
+    int stepIntervalMs = 10; // 两步之间让出给队列的时间
+    int maxDeferredSteps = 50; // 队列繁忙时最多连续推迟的步数，保证备份总能前进
+};
+
+// 基于 SQLite 在线备份 API 的分步快照
+// 运行在数据库线程中，源连接就是写连接本身，这样备份期间的写入会同步到目标，不会导致备份重启；
+// 每一步只复制少量页，由定时器驱动，与队列处理交替执行
+class DatabaseBackup : public QObject {
+    Q_OBJECT
+
+public:
+    DatabaseBackup(const QString& operationId, sqlite3* source, const QString& destFile,
+        const BackupOptions& options, QObject* parent = nullptr);
+    ~DatabaseBackup();
+
+    // 返回 true 表示当前有待处理的操作，本步应当让路
+    void setBusyProbe(std::function<bool()> probe);
+
+    bool start();
+    void cancel();
+
+    QString operationId() const { return m_operationId; }
+
+signals:
+    void progress(const QString& operationId, int remainingPages, int totalPages);
+    void finished(const QString& operationId, bool success, const QVariant& result);
+
+private slots:
+    void step();
+
+private:
+    void finish(bool success, const QString& error = QString());
+    void release();
+
+    QString m_operationId;
+    sqlite3* m_source = nullptr;
+    sqlite3* m_dest = nullptr;
+    sqlite3_backup* m_backup = nullptr;
+    QString m_destFile;
+    QString m_tempFile;
+    BackupOptions m_options;
+    std::function<bool()> m_busyProbe;
+
+    QTimer m_timer;
+    QElapsedTimer m_elapsed;
+    int m_deferredSteps = 0;
+    int m_steps = 0;
+    bool m_done = false;
+};
+
+#endif // DATABASEBACKUP_H
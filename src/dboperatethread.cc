@@ -9,6 +9,9 @@ DBOperateThread::DBOperateThread(const QString& dbFile, QObject* parent)
     , m_dbFile(dbFile)
     , m_initialized(false)
 {
+    // 线程名会出现在 trace 中
+    m_workerThread->setObjectName("db-worker");
+
     // 创建工作线程对象
     m_handler = new SQLite3Handler(m_dbFile);
 
@@ -106,6 +109,7 @@ void DBOperateThread::setupConnections()
 
     // 连接处理器信号（跨线程）
     if (m_handler) {
+        m_handler->setDeliveryLatencyTracking(true);
         connect(m_handler, &SQLite3Handler::operationCompleted, this, &DBOperateThread::onOperationCompleted, Qt::QueuedConnection);
         connect(m_handler, &SQLite3Handler::connected, this, &DBOperateThread::onConnected, Qt::QueuedConnection);
         connect(m_handler, &SQLite3Handler::disconnected, this, &DBOperateThread::onDisconnected, Qt::QueuedConnection);
@@ -124,6 +128,11 @@ void DBOperateThread::onOperationCompleted(const QString& operationId, bool succ
         qWarning() << "忽略空 operationId 的操作完成信号";
         return;
     }
+    if (m_handler) {
+        m_handler->recordDelivery(operationId);
+    }
+    // 区间包含主线程上各消费方的处理
+    TraceRecorder::Span span(m_handler ? m_handler->traceRecorder() : nullptr, "deliver.forward", operationId);
     emit operationCompleted(operationId, success, result);
 }
 
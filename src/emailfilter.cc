@@ -0,0 +1,280 @@
+// emailfilter.cc
+#include "emailfilter.h"
+#include "sqlite3statemachine.h"
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <algorithm>
+
+namespace {
+
+quint64 mix(quint64 x)
+{
+    // splitmix64 终结函数
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+} // namespace
+
+EmailFilter::EmailFilter(SQLite3StateMachine* stateMachine, QObject* parent)
+    : QObject(parent)
+    , m_stateMachine(stateMachine)
+{
+}
+
+quint64 EmailFilter::hashEmail(const QString& email)
+{
+    // FNV-1a，再混合一次让高低位都均匀
+    const QByteArray bytes = email.toUtf8();
+    quint64 hash = 0xcbf29ce484222325ULL;
+    for (char c : bytes) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001b3ULL;
+    }
+    return mix(hash);
+}
+
+bool EmailFilter::load()
+{
+    QHash<qint64, quint64> rows;
+    try {
+        rows = readEmails(std::string(), std::string());
+    } catch (const std::exception& e) {
+        qWarning() << "邮箱过滤器加载失败:" << e.what();
+        return false;
+    }
+
+    QWriteLocker locker(&m_lock);
+    m_rows = std::move(rows);
+    resize(std::max<qint64>(kMinCapacity, m_rows.size() * 2));
+    m_ready.store(true, std::memory_order_release);
+
+    qDebug() << "邮箱过滤器已加载，用户数:" << m_rows.size() << "计数器:" << m_counterCount;
+    return true;
+}
+
+bool EmailFilter::beginInsert(const QString& operationId, quint64 hash)
+{
+    m_checks.fetch_add(1, std::memory_order_relaxed);
+
+    QWriteLocker locker(&m_lock);
+    const bool maybe = m_inFlight.contains(hash) || contains(hash);
+    m_inFlight[hash]++;
+    m_inFlightOperations.insert(operationId, hash);
+    if (!maybe) {
+        m_negatives.fetch_add(1, std::memory_order_relaxed);
+    }
+    return maybe;
+}
+
+void EmailFilter::endInsert(const QString& operationId, qint64 insertedId)
+{
+    QWriteLocker locker(&m_lock);
+    const auto operation = m_inFlightOperations.constFind(operationId);
+    if (operation == m_inFlightOperations.constEnd()) {
+        return;
+    }
+    const quint64 hash = operation.value();
+    m_inFlightOperations.erase(operation);
+
+    auto it = m_inFlight.find(hash);
+    if (it != m_inFlight.end() && --it.value() <= 0) {
+        m_inFlight.erase(it);
+    }
+    if (insertedId > 0) {
+        setRow(insertedId, hash);
+    }
+}
+
+void EmailFilter::recordOutcome(bool duplicate)
+{
+    (duplicate ? m_duplicates : m_falsePositives).fetch_add(1, std::memory_order_relaxed);
+}
+
+QVariantMap EmailFilter::metrics() const
+{
+    QVariantMap result;
+    {
+        QReadLocker locker(&m_lock);
+        result["users"] = static_cast<qint64>(m_rows.size());
+        result["counters"] = static_cast<qint64>(m_counterCount);
+        result["memory_bytes"] = static_cast<qint64>(m_counters.size());
+        result["in_flight"] = static_cast<qint64>(m_inFlight.size());
+    }
+    result["ready"] = isReady();
+    result["checks"] = static_cast<quint64>(m_checks.load());
+    result["definite_new"] = static_cast<quint64>(m_negatives.load());
+    result["false_positives"] = static_cast<quint64>(m_falsePositives.load());
+    result["duplicates"] = static_cast<quint64>(m_duplicates.load());
+    result["saturated_counters"] = static_cast<quint64>(m_saturated.load());
+    result["resizes"] = static_cast<quint64>(m_resizes.load());
+    return result;
+}
+
+void EmailFilter::onTableChanged(const QString& table, const QList<ChangeTracker::RowChange>& changes)
+{
+    if (table != "users" || !isReady()) {
+        return;
+    }
+
+    QList<qint64> deleted;
+    QJsonArray upserted;
+    for (const ChangeTracker::RowChange& change : changes) {
+        if (change.operation == ChangeTracker::Operation::Delete) {
+            deleted.append(change.rowid);
+        } else {
+            upserted.append(change.rowid);
+        }
+    }
+
+    // 插入和改邮箱都需要回查当前邮箱
+    QHash<qint64, quint64> rows;
+    if (!upserted.isEmpty()) {
+        try {
+            rows = readEmails("WHERE id IN (SELECT value FROM json_each(:ids))",
+                QJsonDocument(upserted).toJson(QJsonDocument::Compact).toStdString());
+        } catch (const std::exception& e) {
+            qWarning() << "邮箱过滤器更新失败，重新加载:" << e.what();
+            load();
+            return;
+        }
+    }
+
+    QWriteLocker locker(&m_lock);
+    for (qint64 id : deleted) {
+        removeRow(id);
+    }
+    for (auto it = rows.cbegin(); it != rows.cend(); ++it) {
+        setRow(it.key(), it.value());
+    }
+    if (m_rows.size() > m_capacity) {
+        resize(m_rows.size() * 2);
+    }
+}
+
+QHash<qint64, quint64> EmailFilter::readEmails(const std::string& whereClause, const std::string& idsJson) const
+{
+    QHash<qint64, quint64> rows;
+    soci::session* session = m_stateMachine->getSession();
+    if (!session) {
+        return rows;
+    }
+
+    long long id = 0;
+    std::string email;
+    soci::indicator emailIndicator = soci::i_ok;
+
+    const std::string sql = "SELECT id, email FROM users " + whereClause;
+    soci::statement st = (session->prepare << sql);
+    st.exchange(soci::into(id));
+    st.exchange(soci::into(email, emailIndicator));
+    if (!idsJson.empty()) {
+        st.exchange(soci::use(idsJson, "ids"));
+    }
+    st.define_and_bind();
+    st.execute(false);
+
+    // 逐行取出，只保留哈希，不在内存中保存邮箱字符串
+    while (st.fetch()) {
+        if (emailIndicator == soci::i_ok) {
+            rows.insert(id, hashEmail(QString::fromStdString(email)));
+        }
+    }
+    return rows;
+}
+
+void EmailFilter::resize(qint64 capacity)
+{
+    m_capacity = capacity;
+    m_counterCount = static_cast<std::size_t>(capacity) * kCountersPerElement;
+    m_counters.assign((m_counterCount + 1) / 2, 0);
+    for (quint64 hash : std::as_const(m_rows)) {
+        add(hash);
+    }
+    m_resizes.fetch_add(1, std::memory_order_relaxed);
+}
+
+void EmailFilter::add(quint64 hash)
+{
+    for (int i = 0; i < kHashCount; ++i) {
+        const std::size_t index = counterIndex(hash, i);
+        const int value = counterAt(index);
+        if (value < 15) {
+            setCounterAt(index, value + 1);
+        } else {
+            m_saturated.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+void EmailFilter::remove(quint64 hash)
+{
+    for (int i = 0; i < kHashCount; ++i) {
+        const std::size_t index = counterIndex(hash, i);
+        const int value = counterAt(index);
+        // 饱和的计数器已经丢失真实计数，不能再递减
+        if (value > 0 && value < 15) {
+            setCounterAt(index, value - 1);
+        }
+    }
+}
+
+void EmailFilter::setRow(qint64 id, quint64 hash)
+{
+    auto it = m_rows.find(id);
+    if (it != m_rows.end()) {
+        if (it.value() == hash) {
+            return;
+        }
+        remove(it.value());
+        it.value() = hash;
+    } else {
+        m_rows.insert(id, hash);
+    }
+    add(hash);
+}
+
+void EmailFilter::removeRow(qint64 id)
+{
+    auto it = m_rows.find(id);
+    if (it == m_rows.end()) {
+        return;
+    }
+    remove(it.value());
+    m_rows.erase(it);
+}
+
+bool EmailFilter::contains(quint64 hash) const
+{
+    for (int i = 0; i < kHashCount; ++i) {
+        if (counterAt(counterIndex(hash, i)) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::size_t EmailFilter::counterIndex(quint64 hash, int i) const
+{
+    // 双重哈希：h1 + i * h2
+    const quint64 h2 = mix(hash) | 1;
+    return static_cast<std::size_t>((hash + static_cast<quint64>(i) * h2) % m_counterCount);
+}
+
+int EmailFilter::counterAt(std::size_t index) const
+{
+    const uint8_t byte = m_counters[index / 2];
+    return index % 2 ? byte >> 4 : byte & 0x0f;
+}
+
+void EmailFilter::setCounterAt(std::size_t index, int value)
+{
+    uint8_t& byte = m_counters[index / 2];
+    byte = index % 2 ? static_cast<uint8_t>((byte & 0x0f) | (value << 4))
+                     : static_cast<uint8_t>((byte & 0xf0) | value);
+}
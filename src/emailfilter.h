@@ -0,0 +1,87 @@
+// emailfilter.h
+#ifndef EMAILFILTER_H
+#define EMAILFILTER_H
+
+#include "changetracker.h"
+#include <QHash>
+#include <QObject>
+#include <QReadWriteLock>
+#include <QString>
+#include <QVariantMap>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class SQLite3StateMachine;
+
+// users.email 上的计数布隆过滤器（4 位计数器，支持删除）
+// 判定为"一定不存在"的邮箱直接插入；"可能存在"的由调用方走带 NOT EXISTS 的插入确认，
+// 过滤器本身不会拒绝任何写入。启动时流式扫描建立，之后由 ChangeTracker 的变更增量维护；
+// 按 id 记录每行的邮箱哈希，删除和改邮箱时据此递减计数
+class EmailFilter : public QObject {
+    Q_OBJECT
+
+public:
+    explicit EmailFilter(SQLite3StateMachine* stateMachine, QObject* parent = nullptr);
+
+    // 与 UNIQUE 约束一致，按原始字节比较（区分大小写）
+    static quint64 hashEmail(const QString& email);
+
+    // 数据库线程：全量扫描建立
+    bool load();
+    bool isReady() const { return m_ready.load(std::memory_order_acquire); }
+
+    // 任意线程：登记一个排队中的插入，返回该邮箱是否可能已存在（已存在或有同邮箱的插入尚未完成）
+    bool beginInsert(const QString& operationId, quint64 hash);
+    // 插入完成：insertedId > 0 表示成功写入，立即计入过滤器，不等变更分发；
+    // 按操作 ID 找回登记时的哈希，未登记过的操作忽略
+    void endInsert(const QString& operationId, qint64 insertedId);
+    // 可能存在但确认后并不存在（假阳性）/ 确认重复
+    void recordOutcome(bool duplicate);
+
+    QVariantMap metrics() const;
+
+public slots:
+    void onTableChanged(const QString& table, const QList<ChangeTracker::RowChange>& changes);
+
+private:
+    static constexpr int kHashCount = 7;
+    static constexpr int kCountersPerElement = 10; // 约 1% 假阳性率
+    static constexpr qint64 kMinCapacity = 1024;
+
+    // 读取 whereClause 命中的 (id, email)，idsJson 绑定到 :ids
+    QHash<qint64, quint64> readEmails(const std::string& whereClause, const std::string& idsJson) const;
+
+    // 调用方持有写锁
+    void resize(qint64 capacity);
+    void add(quint64 hash);
+    void remove(quint64 hash);
+    void setRow(qint64 id, quint64 hash);
+    void removeRow(qint64 id);
+    bool contains(quint64 hash) const;
+
+    std::size_t counterIndex(quint64 hash, int i) const;
+    int counterAt(std::size_t index) const;
+    void setCounterAt(std::size_t index, int value);
+
+    SQLite3StateMachine* m_stateMachine;
+
+    mutable QReadWriteLock m_lock;
+    std::vector<uint8_t> m_counters; // 每字节两个 4 位计数器，饱和（15）后不再增减
+    std::size_t m_counterCount = 0;
+    qint64 m_capacity = 0;
+    QHash<qint64, quint64> m_rows; // id -> 邮箱哈希
+    QHash<quint64, int> m_inFlight; // 排队中的插入
+    QHash<QString, quint64> m_inFlightOperations; // 操作 ID -> 邮箱哈希
+
+    std::atomic<bool> m_ready { false };
+    std::atomic<quint64> m_checks { 0 };
+    std::atomic<quint64> m_negatives { 0 };
+    std::atomic<quint64> m_falsePositives { 0 };
+    std::atomic<quint64> m_duplicates { 0 };
+    std::atomic<quint64> m_saturated { 0 };
+    std::atomic<quint64> m_resizes { 0 };
+};
+
+#endif // EMAILFILTER_H
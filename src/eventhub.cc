@@ -0,0 +1,430 @@
+// eventhub.cc
+#include "eventhub.h"
+#include "sqlite3handler.h"
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QSet>
+#include <algorithm>
+#include <deque>
+#include <drogon/HttpAppFramework.h>
+#include <drogon/WebSocketController.h>
+
+namespace {
+
+constexpr int kDefaultWindow = 32;
+constexpr int kMaxWindow = 1024;
+constexpr int kDefaultBuffer = 256;
+constexpr int kMaxBuffer = 4096;
+// 单条批次消息的事件数上限，大事务的变更拆成多条消息
+constexpr int kMaxEventsPerMessage = 500;
+
+QByteArray toJson(const QJsonObject& object)
+{
+    return QJsonDocument(object).toJson(QJsonDocument::Compact);
+}
+
+void sendJson(const drogon::WebSocketConnectionPtr& connection, const QJsonObject& object)
+{
+    const QByteArray text = toJson(object);
+    connection->send(text.constData(), static_cast<uint64_t>(text.size()));
+}
+
+QSet<QString> toStringSet(const QJsonValue& value)
+{
+    QSet<QString> result;
+    for (const QJsonValue& item : value.toArray()) {
+        result.insert(item.toString());
+    }
+    return result;
+}
+
+} // namespace
+
+// 一个待分发的事件；序列化结果缓存在事件上，同一事件只编码一次
+struct EventHub::Event {
+    bool operation; // true 为操作完成，false 为表变更
+    QString key; // 操作类型或表名
+    bool success = true;
+    QJsonObject object;
+    QVariant result;
+    QByteArray plain;
+    QByteArray withResult;
+
+    const QByteArray& text(bool includeResult)
+    {
+        if (!includeResult || !operation) {
+            if (plain.isEmpty()) {
+                plain = toJson(object);
+            }
+            return plain;
+        }
+        if (withResult.isEmpty()) {
+            QJsonObject full = object;
+            full["result"] = QJsonValue::fromVariant(result);
+            withResult = toJson(full);
+        }
+        return withResult;
+    }
+};
+
+// 连接状态由数据库线程（分发）和 IO 线程（订阅、确认、关闭）共同访问，以 mutex 保护
+struct EventHub::Subscriber {
+    quint64 id = 0;
+    QMutex mutex;
+    drogon::WebSocketConnectionPtr connection;
+    bool subscribed = false;
+    bool closed = false;
+
+    // 过滤条件，空集合表示不限
+    bool operations = true;
+    bool failuresOnly = false;
+    bool results = false;
+    QSet<QString> operationTypes;
+    bool changes = true;
+    QSet<QString> tables;
+
+    int window = kDefaultWindow;
+    int buffer = kDefaultBuffer;
+    bool closeOnOverflow = false;
+
+    // 等待发送的批次：事件数组的文本（不含方括号）与事件数
+    std::deque<std::pair<QByteArray, int>> queue;
+    quint64 sentSeq = 0;
+    quint64 ackedSeq = 0;
+    quint64 droppedSinceLast = 0;
+
+    bool matches(const Event& event) const
+    {
+        if (event.operation) {
+            return operations && (!failuresOnly || !event.success)
+                && (operationTypes.isEmpty() || operationTypes.contains(event.key));
+        }
+        return changes && (tables.isEmpty() || tables.contains(event.key));
+    }
+};
+
+// drogon 的 WebSocket 控制器，只把连接事件转给 EventHub
+class EventSocketController : public drogon::WebSocketController<EventSocketController, false> {
+public:
+    explicit EventSocketController(EventHub* hub)
+        : m_hub(hub)
+    {
+    }
+
+    WS_PATH_LIST_BEGIN
+    WS_PATH_ADD("/ws/events");
+    WS_PATH_LIST_END
+
+    void handleNewConnection(const drogon::HttpRequestPtr&, const drogon::WebSocketConnectionPtr& connection) override
+    {
+        connection->setContext(m_hub->attach(connection));
+    }
+
+    void handleNewMessage(const drogon::WebSocketConnectionPtr& connection, std::string&& message,
+        const drogon::WebSocketMessageType& type) override
+    {
+        if (type != drogon::WebSocketMessageType::Text) {
+            return;
+        }
+        if (auto subscriber = connection->getContext<EventHub::Subscriber>()) {
+            m_hub->handleMessage(subscriber, QByteArray::fromStdString(message));
+        }
+    }
+
+    void handleConnectionClosed(const drogon::WebSocketConnectionPtr& connection) override
+    {
+        if (auto subscriber = connection->getContext<EventHub::Subscriber>()) {
+            m_hub->detach(subscriber);
+        }
+        connection->clearContext();
+    }
+
+private:
+    EventHub* m_hub;
+};
+
+EventHub::EventHub(SQLite3Handler* handler, QObject* parent)
+    : QObject(parent)
+    , m_handler(handler)
+{
+    connect(m_handler, &SQLite3Handler::operationCompleted, this, &EventHub::onOperationCompleted);
+    connect(m_handler, &SQLite3Handler::tableChanged, this, &EventHub::onTableChanged);
+}
+
+EventHub::~EventHub()
+{
+    disconnectAll();
+}
+
+void EventHub::registerRoutes(HttpServer& server)
+{
+    server.addSetup([this]() {
+        drogon::app().registerController(std::make_shared<EventSocketController>(this));
+    });
+    server.addRoute("/api/events/stats", drogon::Get,
+        [this](const drogon::HttpRequestPtr&, HttpServer::Callback&& callback) {
+            auto response = drogon::HttpResponse::newHttpResponse();
+            response->setContentTypeCode(drogon::CT_APPLICATION_JSON);
+            response->setBody(toJson(QJsonObject::fromVariantMap(metrics())).toStdString());
+            callback(response);
+        });
+}
+
+void EventHub::disconnectAll()
+{
+    QList<SubscriberPtr> subscribers;
+    {
+        QMutexLocker locker(&m_subscribersMutex);
+        subscribers = m_subscribers.values();
+    }
+    for (const SubscriberPtr& subscriber : subscribers) {
+        QMutexLocker locker(&subscriber->mutex);
+        if (!subscriber->closed && subscriber->connection) {
+            subscriber->closed = true;
+            subscriber->queue.clear();
+            subscriber->connection->shutdown(drogon::CloseCode::kEndpointGone, "服务关闭");
+        }
+    }
+}
+
+QVariantMap EventHub::metrics() const
+{
+    QVariantMap result;
+    {
+        QMutexLocker locker(&m_subscribersMutex);
+        result["connections"] = m_subscribers.size();
+    }
+    result["subscribers"] = m_activeSubscriptions.load();
+    result["events_published"] = static_cast<quint64>(m_eventsPublished.load());
+    result["messages_sent"] = static_cast<quint64>(m_messagesSent.load());
+    result["events_dropped"] = static_cast<quint64>(m_eventsDropped.load());
+    result["slow_disconnects"] = static_cast<quint64>(m_slowDisconnects.load());
+    return result;
+}
+
+void EventHub::onOperationCompleted(const QString& operationId, bool success, const QVariant& result)
+{
+    if (m_activeSubscriptions.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+
+    // 与完成信号同步执行，此时操作类型映射尚未清理
+    const QString operationType = m_handler->getOperationType(operationId);
+    Event event { true, operationType, success, {}, {}, {}, {} };
+    event.object = QJsonObject {
+        { "kind", "op" },
+        { "id", operationId },
+        { "op_type", operationType },
+        { "success", success },
+    };
+    if (success) {
+        event.result = result;
+    } else {
+        const QVariantMap map = result.toMap();
+        event.object["error"] = map.isEmpty() ? result.toString() : map.value("error").toString();
+        if (map.contains("error_code")) {
+            event.object["error_code"] = map.value("error_code").toString();
+        }
+    }
+    m_pending.push_back(std::move(event));
+    schedule();
+}
+
+void EventHub::onTableChanged(const QString& table, const QList<ChangeTracker::RowChange>& changes)
+{
+    if (m_activeSubscriptions.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+
+    for (int offset = 0; offset < changes.size(); offset += kMaxEventsPerMessage) {
+        QJsonArray rows;
+        const int end = std::min<int>(changes.size(), offset + kMaxEventsPerMessage);
+        for (int i = offset; i < end; ++i) {
+            const ChangeTracker::RowChange& change = changes.at(i);
+            rows.append(QJsonObject {
+                { "op", change.operation == ChangeTracker::Operation::Delete ? "delete" : "upsert" },
+                { "rowid", change.rowid },
+            });
+        }
+        Event event { false, table, true, {}, {}, {}, {} };
+        event.object = QJsonObject {
+            { "kind", "change" },
+            { "table", table },
+            { "rows", rows },
+        };
+        m_pending.push_back(std::move(event));
+    }
+    schedule();
+}
+
+void EventHub::schedule()
+{
+    // 本轮事件循环内的其余事件搭同一次分发
+    if (!m_flushScheduled) {
+        m_flushScheduled = true;
+        QMetaObject::invokeMethod(this, &EventHub::flush, Qt::QueuedConnection);
+    }
+}
+
+void EventHub::flush()
+{
+    m_flushScheduled = false;
+    std::vector<Event> events;
+    events.swap(m_pending);
+    if (events.empty()) {
+        return;
+    }
+    m_eventsPublished.fetch_add(events.size(), std::memory_order_relaxed);
+
+    QList<SubscriberPtr> subscribers;
+    {
+        QMutexLocker locker(&m_subscribersMutex);
+        subscribers = m_subscribers.values();
+    }
+
+    for (const SubscriberPtr& subscriber : subscribers) {
+        QMutexLocker locker(&subscriber->mutex);
+        if (!subscriber->subscribed || subscriber->closed) {
+            continue;
+        }
+
+        QByteArray chunk;
+        int count = 0;
+        for (Event& event : events) {
+            if (!subscriber->matches(event)) {
+                continue;
+            }
+            if (count > 0) {
+                chunk.append(',');
+            }
+            chunk.append(event.text(subscriber->results));
+            if (++count == kMaxEventsPerMessage) {
+                enqueue(*subscriber, chunk, count);
+                chunk.clear();
+                count = 0;
+            }
+        }
+        if (count > 0) {
+            enqueue(*subscriber, chunk, count);
+        }
+        pump(*subscriber);
+    }
+}
+
+void EventHub::enqueue(Subscriber& subscriber, const QByteArray& events, int count)
+{
+    if (subscriber.closed) {
+        return;
+    }
+    if (static_cast<int>(subscriber.queue.size()) >= subscriber.buffer) {
+        if (subscriber.closeOnOverflow) {
+            subscriber.closed = true;
+            subscriber.queue.clear();
+            subscriber.connection->shutdown(drogon::CloseCode::kViolation, "消费过慢，缓冲区已满");
+            m_slowDisconnects.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        const int dropped = subscriber.queue.front().second;
+        subscriber.queue.pop_front();
+        subscriber.droppedSinceLast += static_cast<quint64>(dropped);
+        m_eventsDropped.fetch_add(static_cast<quint64>(dropped), std::memory_order_relaxed);
+    }
+    subscriber.queue.emplace_back(events, count);
+}
+
+void EventHub::pump(Subscriber& subscriber)
+{
+    // send() 只是把数据交给连接所在的 IO 线程，不会阻塞
+    while (!subscriber.closed && !subscriber.queue.empty()
+        && subscriber.sentSeq - subscriber.ackedSeq < static_cast<quint64>(subscriber.window)) {
+        const QByteArray& events = subscriber.queue.front().first;
+        QByteArray message;
+        message.reserve(events.size() + 64);
+        message.append("{\"type\":\"batch\",\"seq\":").append(QByteArray::number(++subscriber.sentSeq));
+        message.append(",\"dropped\":").append(QByteArray::number(subscriber.droppedSinceLast));
+        message.append(",\"events\":[").append(events).append("]}");
+        subscriber.connection->send(message.constData(), static_cast<uint64_t>(message.size()));
+        subscriber.queue.pop_front();
+        subscriber.droppedSinceLast = 0;
+        m_messagesSent.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+EventHub::SubscriberPtr EventHub::attach(const drogon::WebSocketConnectionPtr& connection)
+{
+    auto subscriber = std::make_shared<Subscriber>();
+    subscriber->connection = connection;
+    QMutexLocker locker(&m_subscribersMutex);
+    subscriber->id = m_nextSubscriberId++;
+    m_subscribers.insert(subscriber->id, subscriber);
+    return subscriber;
+}
+
+void EventHub::detach(const SubscriberPtr& subscriber)
+{
+    {
+        QMutexLocker locker(&m_subscribersMutex);
+        m_subscribers.remove(subscriber->id);
+    }
+    QMutexLocker locker(&subscriber->mutex);
+    subscriber->closed = true;
+    subscriber->queue.clear();
+    if (subscriber->subscribed) {
+        subscriber->subscribed = false;
+        m_activeSubscriptions.fetch_sub(1, std::memory_order_relaxed);
+    }
+    // 连接的上下文持有订阅者，这里断开反向引用
+    subscriber->connection.reset();
+}
+
+void EventHub::handleMessage(const SubscriberPtr& subscriber, const QByteArray& message)
+{
+    QMutexLocker locker(&subscriber->mutex);
+    if (subscriber->closed) {
+        return;
+    }
+
+    const QJsonObject request = QJsonDocument::fromJson(message).object();
+    if (request.contains("ack")) {
+        const quint64 seq = static_cast<quint64>(request.value("ack").toDouble());
+        subscriber->ackedSeq = std::max(subscriber->ackedSeq, std::min(seq, subscriber->sentSeq));
+        pump(*subscriber);
+        return;
+    }
+
+    if (!request.value("subscribe").isObject()) {
+        sendJson(subscriber->connection, QJsonObject { { "type", "error" }, { "error", "需要 subscribe 或 ack" } });
+        return;
+    }
+
+    const QJsonObject options = request.value("subscribe").toObject();
+    const QString overflow = options.value("overflow").toString("drop_oldest");
+    if (overflow != "drop_oldest" && overflow != "close") {
+        sendJson(subscriber->connection, QJsonObject { { "type", "error" }, { "error", "overflow 只能是 drop_oldest 或 close" } });
+        return;
+    }
+
+    subscriber->operations = options.value("ops").toBool(true);
+    subscriber->operationTypes = toStringSet(options.value("op_types"));
+    subscriber->failuresOnly = options.value("failures_only").toBool(false);
+    subscriber->results = options.value("results").toBool(false);
+    subscriber->changes = options.value("changes").toBool(true);
+    subscriber->tables = toStringSet(options.value("tables"));
+    subscriber->window = std::clamp(options.value("window").toInt(kDefaultWindow), 1, kMaxWindow);
+    subscriber->buffer = std::clamp(options.value("buffer").toInt(kDefaultBuffer), 1, kMaxBuffer);
+    subscriber->closeOnOverflow = overflow == "close";
+    if (!subscriber->subscribed) {
+        subscriber->subscribed = true;
+        m_activeSubscriptions.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    sendJson(subscriber->connection, QJsonObject {
+        { "type", "subscribed" },
+        { "window", subscriber->window },
+        { "buffer", subscriber->buffer },
+    });
+    pump(*subscriber);
+}
@@ -0,0 +1,91 @@
+// eventhub.h
+#ifndef EVENTHUB_H
+#define EVENTHUB_H
+
+#include "changetracker.h"
+#include "httpserver.h"
+#include <drogon/WebSocketConnection.h>
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QVariant>
+#include <QVariantMap>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+class SQLite3Handler;
+
+// 操作完成与表变更的 WebSocket 推送（/ws/events），与处理器同在数据库线程
+// 一轮事件循环内产生的事件合并为一次分发，按订阅者的过滤条件筛选后打包成批次消息；
+// 每个连接有独立的有界缓冲和确认窗口：未确认的批次达到窗口后新批次进入缓冲，
+// 缓冲满时丢弃最旧的批次（或按订阅要求断开），数据库线程从不等待慢消费者
+//
+// 协议（文本帧，JSON）：
+//   客户端 {"subscribe": {"ops": true, "op_types": [...], "failures_only": false, "results": false,
+//                         "changes": true, "tables": [...], "window": 32, "buffer": 256,
+//                         "overflow": "drop_oldest" | "close"}}
+//   客户端 {"ack": <seq>}  确认到 seq 为止的批次
+//   服务端 {"type": "subscribed", "window": n, "buffer": n}
+//   服务端 {"type": "batch", "seq": n, "dropped": n, "events": [...]}  dropped 为上一批之后丢弃的事件数
+//   服务端 {"type": "error", "error": "..."}
+class EventHub : public QObject {
+    Q_OBJECT
+
+public:
+    // 创建后需移动到 handler 所在线程；表变更需处理器启用 setChangeEventsEnabled
+    explicit EventHub(SQLite3Handler* handler, QObject* parent = nullptr);
+    ~EventHub();
+
+    // 需在 server.start() 之前调用；本对象必须比 server 活得久
+    void registerRoutes(HttpServer& server);
+
+    // 任意线程：关闭所有连接，停止 HTTP 服务前调用
+    void disconnectAll();
+
+    // 任意线程：{connections, subscribers, events_published, messages_sent, events_dropped, slow_disconnects}
+    QVariantMap metrics() const;
+
+private slots:
+    void onOperationCompleted(const QString& operationId, bool success, const QVariant& result);
+    void onTableChanged(const QString& table, const QList<ChangeTracker::RowChange>& changes);
+    void flush();
+
+private:
+    friend class EventSocketController;
+    struct Event;
+    struct Subscriber;
+    using SubscriberPtr = std::shared_ptr<Subscriber>;
+
+    // 以下由 drogon 的 IO 线程调用
+    SubscriberPtr attach(const drogon::WebSocketConnectionPtr& connection);
+    void detach(const SubscriberPtr& subscriber);
+    void handleMessage(const SubscriberPtr& subscriber, const QByteArray& message);
+
+    void schedule();
+    // 持订阅者的锁调用：在窗口内发出缓冲的批次
+    void pump(Subscriber& subscriber);
+    // 持订阅者的锁调用：放入缓冲，缓冲满时按订阅的溢出策略处理
+    void enqueue(Subscriber& subscriber, const QByteArray& events, int count);
+
+    SQLite3Handler* m_handler;
+
+    std::vector<Event> m_pending; // 只在数据库线程访问
+    bool m_flushScheduled = false;
+
+    mutable QMutex m_subscribersMutex;
+    QHash<quint64, SubscriberPtr> m_subscribers;
+    quint64 m_nextSubscriberId = 1;
+    // 已订阅的连接数，为 0 时不收集事件
+    std::atomic<int> m_activeSubscriptions { 0 };
+
+    std::atomic<quint64> m_eventsPublished { 0 };
+    std::atomic<quint64> m_messagesSent { 0 };
+    std::atomic<quint64> m_eventsDropped { 0 };
+    std::atomic<quint64> m_slowDisconnects { 0 };
+};
+
+#endif // EVENTHUB_H
@@ -0,0 +1,742 @@
+// grpcserver.cc
+#include "grpcserver.h"
+#include "operationdispatcher.h"
+#include "operationrequest.h"
+#include "sqlite3handler.h"
+#include <QDebug>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <limits>
+#include <mutex>
+
+#include <grpcpp/grpcpp.h>
+#include "inventory.grpc.pb.h"
+
+namespace pb = qtapp::inventory;
+
+struct GrpcServer::State {
+    OperationDispatcher* dispatcher = nullptr;
+    pb::Inventory::AsyncService service;
+    std::unique_ptr<grpc::ServerCompletionQueue> cq;
+
+    std::atomic<int> activeCalls { 0 };
+    std::atomic<quint64> unaryCalls { 0 };
+    std::atomic<quint64> listStreams { 0 };
+    std::atomic<quint64> bulkStreams { 0 };
+    std::atomic<quint64> rowsStreamed { 0 };
+    std::atomic<quint64> rowsIngested { 0 };
+};
+
+namespace {
+
+using State = GrpcServer::State;
+
+// 每个方法预先挂起的待接收调用数，突发的新调用不必等前一个被接收后才能登记
+constexpr int kPendingCallsPerMethod = 8;
+constexpr int kDefaultPageSize = 500;
+constexpr int kMaxPageSize = 1000;
+// 与 bulkUpsertProducts 每条语句的行数一致，每批恰好对应一条多行 VALUES 语句
+constexpr int kBulkBatchRows = 200;
+// 单个批量写入流同时在途的批次上限，超出后暂停读取，对客户端形成背压
+constexpr int kMaxBatchesInFlight = 2;
+
+grpc::Status busyStatus()
+{
+    return grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED, "服务繁忙");
+}
+
+grpc::Status failureStatus(const QVariant& result)
+{
+    const QVariantMap map = result.toMap();
+    if (map.value("error_code").toString() == OperationError::kDuplicateEmail) {
+        return grpc::Status(grpc::StatusCode::ALREADY_EXISTS, "邮箱已存在: " + map.value("email").toString().toStdString());
+    }
+    const QString message = map.isEmpty() ? result.toString() : map.value("error").toString();
+    return grpc::Status(grpc::StatusCode::INTERNAL, message.toStdString());
+}
+
+void toUser(const QVariantMap& row, pb::User* user)
+{
+    user->set_id(row.value("id").toLongLong());
+    user->set_name(row.value("name").toString().toStdString());
+    user->set_email(row.value("email").toString().toStdString());
+    user->set_age(row.value("age").toInt());
+    user->set_created_at(row.value("created_at").toString().toStdString());
+}
+
+void toProduct(const QVariantMap& row, pb::Product* product)
+{
+    product->set_id(row.value("id").toLongLong());
+    product->set_name(row.value("name").toString().toStdString());
+    product->set_price(row.value("price").toDouble());
+    product->set_stock(row.value("stock").toInt());
+    product->set_created_at(row.value("created_at").toString().toStdString());
+}
+
+// 写操作的结果：未影响任何行时返回 NOT_FOUND
+grpc::Status toMutationReply(const QVariant& result, pb::MutationReply& reply, bool requireAffected)
+{
+    const QVariantMap map = result.toMap();
+    reply.set_affected_rows(map.value("affected_rows").toLongLong());
+    reply.set_last_insert_id(map.value("last_insert_id").toLongLong());
+    if (requireAffected && reply.affected_rows() == 0) {
+        return grpc::Status(grpc::StatusCode::NOT_FOUND, "记录不存在");
+    }
+    return grpc::Status::OK;
+}
+
+enum Event {
+    RequestEvent,
+    ReadEvent,
+    WriteEvent,
+    FinishEvent,
+    EventCount,
+};
+
+class Call;
+
+// 完成队列的标签：指向所属调用和事件种类
+struct Tag {
+    Call* call;
+    Event event;
+};
+
+// 调用的基类：从登记到收到 Finish 标签期间持有自身；
+// 数据库完成回调另外持有 shared_ptr，两者都释放后才销毁
+class Call : public std::enable_shared_from_this<Call> {
+public:
+    explicit Call(State* state)
+        : m_state(state)
+    {
+        for (int i = 0; i < EventCount; ++i) {
+            m_tags[i] = { this, static_cast<Event>(i) };
+        }
+        m_state->activeCalls.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    virtual ~Call()
+    {
+        m_state->activeCalls.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    virtual void proceed(Event event, bool ok) = 0;
+
+protected:
+    void* tag(Event event) { return &m_tags[event]; }
+    void retain() { m_self = shared_from_this(); }
+    // 可能销毁自身，调用后不能再访问成员
+    void release() { m_self.reset(); }
+
+    State* m_state;
+    grpc::ServerContext m_context;
+    std::mutex m_mutex; // 轮询线程与数据库线程都会推进状态
+
+private:
+    Tag m_tags[EventCount];
+    std::shared_ptr<Call> m_self;
+};
+
+template <typename Reply>
+using Respond = std::function<void(const grpc::Status&, const Reply&)>;
+
+template <typename Reply>
+using Convert = std::function<grpc::Status(const QVariant& result, Reply& reply)>;
+
+// 提交一个数据库操作，成功时由 convert 填充应答
+template <typename Reply>
+void execute(State* state, OperationDispatcher::Starter starter, Convert<Reply> convert, Respond<Reply> respond)
+{
+    const bool accepted = state->dispatcher->submit(std::move(starter),
+        [convert, respond](bool success, const QVariant& result) {
+            Reply reply;
+            const grpc::Status status = success ? convert(result, reply) : failureStatus(result);
+            respond(status, reply);
+        });
+    if (!accepted) {
+        respond(busyStatus(), Reply());
+    }
+}
+
+template <typename Request, typename Reply>
+class UnaryCall : public Call {
+public:
+    using RequestMethod = void (pb::Inventory::AsyncService::*)(grpc::ServerContext*, Request*,
+        grpc::ServerAsyncResponseWriter<Reply>*, grpc::CompletionQueue*, grpc::ServerCompletionQueue*, void*);
+    // 处理请求，之后在任意线程调用一次 respond 结束调用
+    using Process = std::function<void(State*, const Request&, Respond<Reply>)>;
+
+    UnaryCall(State* state, RequestMethod method, Process process)
+        : Call(state)
+        , m_method(method)
+        , m_process(std::move(process))
+        , m_responder(&m_context)
+    {
+    }
+
+    static void spawn(State* state, RequestMethod method, Process process)
+    {
+        auto call = std::make_shared<UnaryCall>(state, method, std::move(process));
+        call->retain();
+        (state->service.*method)(&call->m_context, &call->m_request, &call->m_responder,
+            state->cq.get(), state->cq.get(), call->tag(RequestEvent));
+    }
+
+    void proceed(Event event, bool ok) override
+    {
+        if (event == RequestEvent && ok) {
+            spawn(m_state, m_method, m_process);
+            m_state->unaryCalls.fetch_add(1, std::memory_order_relaxed);
+
+            std::shared_ptr<Call> self = shared_from_this();
+            m_process(m_state, m_request, [this, self](const grpc::Status& status, const Reply& reply) {
+                if (status.ok()) {
+                    m_responder.Finish(reply, status, tag(FinishEvent));
+                } else {
+                    m_responder.FinishWithError(status, tag(FinishEvent));
+                }
+            });
+            return;
+        }
+        // 应答已发出，或服务关闭时登记被取消
+        release();
+    }
+
+private:
+    RequestMethod m_method;
+    Process m_process;
+    Request m_request;
+    grpc::ServerAsyncResponseWriter<Reply> m_responder;
+};
+
+// ListProducts：按键集分页读取，边读边写；缓冲降到半页以下时预取下一页，
+// 写入与数据库读取重叠。同一时刻最多一个写入、一个读取在途
+class ListProductsCall : public Call {
+public:
+    explicit ListProductsCall(State* state)
+        : Call(state)
+        , m_writer(&m_context)
+    {
+    }
+
+    static void spawn(State* state)
+    {
+        auto call = std::make_shared<ListProductsCall>(state);
+        call->retain();
+        state->service.RequestListProducts(&call->m_context, &call->m_request, &call->m_writer,
+            state->cq.get(), state->cq.get(), call->tag(RequestEvent));
+    }
+
+    void proceed(Event event, bool ok) override
+    {
+        if (event == FinishEvent || (event == RequestEvent && !ok)) {
+            release();
+            return;
+        }
+
+        std::lock_guard<std::mutex> locker(m_mutex);
+        if (event == RequestEvent) {
+            spawn(m_state);
+            m_state->listStreams.fetch_add(1, std::memory_order_relaxed);
+            const int requested = m_request.page_size();
+            m_pageSize = requested > 0 ? std::min(requested, kMaxPageSize) : kDefaultPageSize;
+            if (m_request.has_min_price() != m_request.has_max_price()) {
+                m_status = grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "min_price 和 max_price 需同时提供");
+                m_hasMore = false;
+            }
+        } else if (event == WriteEvent) {
+            m_writing = false;
+            if (!ok) {
+                // 客户端已断开
+                m_status = grpc::Status(grpc::StatusCode::CANCELLED, "客户端已断开");
+                m_hasMore = false;
+                m_buffer.clear();
+            }
+        }
+        pump();
+    }
+
+private:
+    // 持锁调用
+    void pump()
+    {
+        if (m_finishing || m_writing) {
+            return;
+        }
+        if (m_hasMore && !m_fetching && static_cast<int>(m_buffer.size()) <= m_pageSize / 2) {
+            fetch();
+        }
+        if (!m_buffer.empty()) {
+            m_writing = true;
+            m_writer.Write(m_buffer.front(), tag(WriteEvent));
+            m_buffer.pop_front();
+            m_state->rowsStreamed.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        if (m_fetching) {
+            return; // 等待下一页
+        }
+        m_finishing = true;
+        m_writer.Finish(m_status, tag(FinishEvent));
+    }
+
+    // 持锁调用
+    void fetch()
+    {
+        const QString cursor = m_cursor;
+        const int limit = m_pageSize;
+        const bool byPrice = m_request.has_min_price();
+        const double minPrice = m_request.min_price();
+        const double maxPrice = m_request.max_price();
+
+        m_fetching = true;
+        auto self = std::static_pointer_cast<ListProductsCall>(shared_from_this());
+        const bool accepted = m_state->dispatcher->submit(
+            [=](SQLite3Handler* handler) {
+                return byPrice ? handler->findProductsByPriceRangePage(minPrice, maxPrice, cursor, limit)
+                               : handler->getProductsPage(cursor, limit);
+            },
+            [self](bool success, const QVariant& result) { self->onPage(success, result); });
+        if (!accepted) {
+            m_fetching = false;
+            m_hasMore = false;
+            m_status = busyStatus();
+        }
+    }
+
+    // 数据库线程
+    void onPage(bool success, const QVariant& result)
+    {
+        std::lock_guard<std::mutex> locker(m_mutex);
+        m_fetching = false;
+        if (!m_status.ok()) {
+            // 已失败或客户端已断开，丢弃这一页
+        } else if (!success) {
+            m_status = failureStatus(result);
+            m_hasMore = false;
+        } else {
+            const QVariantMap page = result.toMap();
+            for (const QVariant& row : page.value("rows").toList()) {
+                m_buffer.emplace_back();
+                toProduct(row.toMap(), &m_buffer.back());
+            }
+            m_hasMore = page.value("has_more").toBool();
+            m_cursor = page.value("next_cursor").toString();
+        }
+        pump();
+    }
+
+    pb::ListProductsRequest m_request;
+    grpc::ServerAsyncWriter<pb::Product> m_writer;
+    std::deque<pb::Product> m_buffer;
+    QString m_cursor;
+    int m_pageSize = kDefaultPageSize;
+    bool m_hasMore = true;
+    bool m_fetching = false;
+    bool m_writing = false;
+    bool m_finishing = false;
+    grpc::Status m_status;
+};
+
+// BulkInsertProducts：读满一批即提交一条多行插入，批次按到达顺序入队；
+// 在途批次达到上限时暂停读取，直到有批次完成
+class BulkInsertCall : public Call {
+public:
+    explicit BulkInsertCall(State* state)
+        : Call(state)
+        , m_reader(&m_context)
+    {
+    }
+
+    static void spawn(State* state)
+    {
+        auto call = std::make_shared<BulkInsertCall>(state);
+        call->retain();
+        state->service.RequestBulkInsertProducts(&call->m_context, &call->m_reader,
+            state->cq.get(), state->cq.get(), call->tag(RequestEvent));
+    }
+
+    void proceed(Event event, bool ok) override
+    {
+        if (event == FinishEvent || (event == RequestEvent && !ok)) {
+            release();
+            return;
+        }
+
+        std::lock_guard<std::mutex> locker(m_mutex);
+        if (event == RequestEvent) {
+            spawn(m_state);
+            m_state->bulkStreams.fetch_add(1, std::memory_order_relaxed);
+            read();
+            return;
+        }
+
+        // ReadEvent：ok 为 false 表示客户端已写完
+        m_reading = false;
+        if (!ok) {
+            m_readDone = true;
+            if (!m_batch.isEmpty() && m_status.ok()) {
+                flush();
+            }
+        } else {
+            m_summary.set_received(m_summary.received() + 1);
+            if (m_item.name().empty()) {
+                m_summary.set_rejected(m_summary.rejected() + 1);
+            } else {
+                m_batch.append(QVariantMap {
+                    { "name", QString::fromStdString(m_item.name()) },
+                    { "price", m_item.price() },
+                    { "stock", m_item.stock() },
+                });
+            }
+            if (m_batch.size() >= kBulkBatchRows) {
+                flush();
+            }
+            continueReading();
+        }
+        maybeFinish();
+    }
+
+private:
+    // 以下均持锁调用
+    void read()
+    {
+        m_reading = true;
+        m_reader.Read(&m_item, tag(ReadEvent));
+    }
+
+    void continueReading()
+    {
+        if (m_readDone || m_reading || !m_status.ok()) {
+            return;
+        }
+        if (m_batchesInFlight < kMaxBatchesInFlight) {
+            read();
+        }
+    }
+
+    void flush()
+    {
+        const QVariantList rows = std::move(m_batch);
+        m_batch.clear();
+        ++m_batchesInFlight;
+        m_summary.set_batches(m_summary.batches() + 1);
+
+        auto self = std::static_pointer_cast<BulkInsertCall>(shared_from_this());
+        const bool accepted = m_state->dispatcher->submit(
+            [rows](SQLite3Handler* handler) { return handler->bulkUpsertProducts(rows).value(0); },
+            [self](bool success, const QVariant& result) { self->onBatchDone(success, result); });
+        if (!accepted) {
+            --m_batchesInFlight;
+            m_status = busyStatus();
+        }
+    }
+
+    void maybeFinish()
+    {
+        if (m_finishing || m_batchesInFlight > 0 || m_reading) {
+            return;
+        }
+        if (!m_readDone && m_status.ok()) {
+            return;
+        }
+        // 出错时不必等客户端写完，直接结束调用
+        m_finishing = true;
+        if (m_status.ok()) {
+            m_reader.Finish(m_summary, grpc::Status::OK, tag(FinishEvent));
+        } else {
+            m_reader.FinishWithError(m_status, tag(FinishEvent));
+        }
+    }
+
+    // 数据库线程
+    void onBatchDone(bool success, const QVariant& result)
+    {
+        std::lock_guard<std::mutex> locker(m_mutex);
+        --m_batchesInFlight;
+        if (success) {
+            const qint64 inserted = result.toList().size();
+            m_summary.set_inserted(m_summary.inserted() + inserted);
+            m_state->rowsIngested.fetch_add(static_cast<quint64>(inserted), std::memory_order_relaxed);
+        } else if (m_status.ok()) {
+            m_status = failureStatus(result);
+        }
+        continueReading();
+        maybeFinish();
+    }
+
+    grpc::ServerAsyncReader<pb::BulkInsertSummary, pb::AddProductRequest> m_reader;
+    pb::AddProductRequest m_item;
+    QVariantList m_batch;
+    pb::BulkInsertSummary m_summary;
+    int m_batchesInFlight = 0;
+    bool m_reading = false;
+    bool m_readDone = false;
+    bool m_finishing = false;
+    grpc::Status m_status;
+};
+
+// ---- 一元调用的处理 ----
+
+// proto 中的 id 为 int64，超出 int 范围的按无效处理（返回 0），避免截断后命中别的行
+int checkedId(int64_t id)
+{
+    return id > 0 && id <= std::numeric_limits<int>::max() ? static_cast<int>(id) : 0;
+}
+
+grpc::Status invalidId()
+{
+    return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "无效的 ID");
+}
+
+void getUser(State* state, const pb::GetByIdRequest& request, Respond<pb::User> respond)
+{
+    const int id = checkedId(request.id());
+    if (id <= 0) {
+        respond(invalidId(), pb::User());
+        return;
+    }
+    execute<pb::User>(
+        state, [id](SQLite3Handler* handler) { return handler->getUserById(id); },
+        [](const QVariant& result, pb::User& reply) {
+            const QVariantList rows = result.toList();
+            if (rows.isEmpty()) {
+                return grpc::Status(grpc::StatusCode::NOT_FOUND, "用户不存在");
+            }
+            toUser(rows.first().toMap(), &reply);
+            return grpc::Status::OK;
+        },
+        std::move(respond));
+}
+
+void addUser(State* state, const pb::AddUserRequest& request, Respond<pb::MutationReply> respond)
+{
+    if (request.name().empty() || request.email().empty()) {
+        respond(grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "需要 name 和 email"), pb::MutationReply());
+        return;
+    }
+    const QString name = QString::fromStdString(request.name());
+    const QString email = QString::fromStdString(request.email());
+    const int age = request.age();
+    execute<pb::MutationReply>(
+        state, [=](SQLite3Handler* handler) { return handler->addUser(name, email, age); },
+        [](const QVariant& result, pb::MutationReply& reply) { return toMutationReply(result, reply, false); },
+        std::move(respond));
+}
+
+void updateUser(State* state, const pb::UpdateUserRequest& request, Respond<pb::MutationReply> respond)
+{
+    const int id = checkedId(request.id());
+    QVariantMap updates;
+    if (request.has_name()) {
+        updates["name"] = QString::fromStdString(request.name());
+    }
+    if (request.has_email()) {
+        updates["email"] = QString::fromStdString(request.email());
+    }
+    if (request.has_age()) {
+        updates["age"] = request.age();
+    }
+    if (id <= 0 || updates.isEmpty()) {
+        respond(grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "需要有效的 ID 和至少一个字段"), pb::MutationReply());
+        return;
+    }
+    execute<pb::MutationReply>(
+        state, [id, updates](SQLite3Handler* handler) { return handler->updateUser(id, updates); },
+        [](const QVariant& result, pb::MutationReply& reply) { return toMutationReply(result, reply, true); },
+        std::move(respond));
+}
+
+void deleteUser(State* state, const pb::DeleteRequest& request, Respond<pb::MutationReply> respond)
+{
+    const int id = checkedId(request.id());
+    if (id <= 0) {
+        respond(invalidId(), pb::MutationReply());
+        return;
+    }
+    execute<pb::MutationReply>(
+        state, [id](SQLite3Handler* handler) { return handler->deleteUser(id); },
+        [](const QVariant& result, pb::MutationReply& reply) { return toMutationReply(result, reply, true); },
+        std::move(respond));
+}
+
+void getProduct(State* state, const pb::GetByIdRequest& request, Respond<pb::Product> respond)
+{
+    const int id = checkedId(request.id());
+    if (id <= 0) {
+        respond(invalidId(), pb::Product());
+        return;
+    }
+    execute<pb::Product>(
+        state, [id](SQLite3Handler* handler) { return handler->getProductById(id); },
+        [](const QVariant& result, pb::Product& reply) {
+            const QVariantList rows = result.toList();
+            if (rows.isEmpty()) {
+                return grpc::Status(grpc::StatusCode::NOT_FOUND, "产品不存在");
+            }
+            toProduct(rows.first().toMap(), &reply);
+            return grpc::Status::OK;
+        },
+        std::move(respond));
+}
+
+void addProduct(State* state, const pb::AddProductRequest& request, Respond<pb::MutationReply> respond)
+{
+    if (request.name().empty()) {
+        respond(grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "需要 name"), pb::MutationReply());
+        return;
+    }
+    const QString name = QString::fromStdString(request.name());
+    const double price = request.price();
+    const int stock = request.stock();
+    execute<pb::MutationReply>(
+        state, [=](SQLite3Handler* handler) { return handler->addProduct(name, price, stock); },
+        [](const QVariant& result, pb::MutationReply& reply) { return toMutationReply(result, reply, false); },
+        std::move(respond));
+}
+
+void updateProduct(State* state, const pb::UpdateProductRequest& request, Respond<pb::MutationReply> respond)
+{
+    const int id = checkedId(request.id());
+    QVariantMap updates;
+    if (request.has_name()) {
+        updates["name"] = QString::fromStdString(request.name());
+    }
+    if (request.has_price()) {
+        updates["price"] = request.price();
+    }
+    if (request.has_stock()) {
+        updates["stock"] = request.stock();
+    }
+    if (id <= 0 || updates.isEmpty()) {
+        respond(grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "需要有效的 ID 和至少一个字段"), pb::MutationReply());
+        return;
+    }
+    execute<pb::MutationReply>(
+        state, [id, updates](SQLite3Handler* handler) { return handler->updateProduct(id, updates); },
+        [](const QVariant& result, pb::MutationReply& reply) { return toMutationReply(result, reply, true); },
+        std::move(respond));
+}
+
+void deleteProduct(State* state, const pb::DeleteRequest& request, Respond<pb::MutationReply> respond)
+{
+    const int id = checkedId(request.id());
+    if (id <= 0) {
+        respond(invalidId(), pb::MutationReply());
+        return;
+    }
+    execute<pb::MutationReply>(
+        state, [id](SQLite3Handler* handler) { return handler->deleteProduct(id); },
+        [](const QVariant& result, pb::MutationReply& reply) { return toMutationReply(result, reply, true); },
+        std::move(respond));
+}
+
+template <typename Request, typename Reply>
+void spawnUnary(State* state, typename UnaryCall<Request, Reply>::RequestMethod method,
+    void (*process)(State*, const Request&, Respond<Reply>))
+{
+    for (int i = 0; i < kPendingCallsPerMethod; ++i) {
+        UnaryCall<Request, Reply>::spawn(state, method, process);
+    }
+}
+
+} // namespace
+
+GrpcServer::GrpcServer(OperationDispatcher* dispatcher, int pollThreads)
+    : m_state(std::make_unique<State>())
+    , m_pollThreadCount(std::max(1, pollThreads))
+{
+    m_state->dispatcher = dispatcher;
+}
+
+GrpcServer::~GrpcServer()
+{
+    stop();
+}
+
+bool GrpcServer::start(const QString& address)
+{
+    if (m_server) {
+        return true;
+    }
+
+    int selectedPort = 0;
+    grpc::ServerBuilder builder;
+    builder.AddListeningPort(address.toStdString(), grpc::InsecureServerCredentials(), &selectedPort);
+    builder.RegisterService(&m_state->service);
+    m_state->cq = builder.AddCompletionQueue();
+    m_server = builder.BuildAndStart();
+    if (!m_server || selectedPort == 0) {
+        qWarning() << "gRPC 服务启动失败:" << address;
+        m_server.reset();
+        m_state->cq.reset();
+        return false;
+    }
+
+    using Service = pb::Inventory::AsyncService;
+    State* state = m_state.get();
+    spawnUnary<pb::GetByIdRequest, pb::User>(state, &Service::RequestGetUser, &getUser);
+    spawnUnary<pb::AddUserRequest, pb::MutationReply>(state, &Service::RequestAddUser, &addUser);
+    spawnUnary<pb::UpdateUserRequest, pb::MutationReply>(state, &Service::RequestUpdateUser, &updateUser);
+    spawnUnary<pb::DeleteRequest, pb::MutationReply>(state, &Service::RequestDeleteUser, &deleteUser);
+    spawnUnary<pb::GetByIdRequest, pb::Product>(state, &Service::RequestGetProduct, &getProduct);
+    spawnUnary<pb::AddProductRequest, pb::MutationReply>(state, &Service::RequestAddProduct, &addProduct);
+    spawnUnary<pb::UpdateProductRequest, pb::MutationReply>(state, &Service::RequestUpdateProduct, &updateProduct);
+    spawnUnary<pb::DeleteRequest, pb::MutationReply>(state, &Service::RequestDeleteProduct, &deleteProduct);
+    for (int i = 0; i < kPendingCallsPerMethod; ++i) {
+        ListProductsCall::spawn(state);
+        BulkInsertCall::spawn(state);
+    }
+
+    for (int i = 0; i < m_pollThreadCount; ++i) {
+        m_pollThreads.emplace_back([state]() {
+            void* tag = nullptr;
+            bool ok = false;
+            while (state->cq->Next(&tag, &ok)) {
+                const Tag* target = static_cast<const Tag*>(tag);
+                target->call->proceed(target->event, ok);
+            }
+        });
+    }
+
+    qDebug() << "gRPC 服务已启动，监听" << address << "轮询线程:" << m_pollThreadCount;
+    return true;
+}
+
+void GrpcServer::stop()
+{
+    if (!m_server) {
+        return;
+    }
+
+    // 取消所有调用；等待数据库操作的调用仍会在完成时发出应答，其标签随后回到队列
+    m_server->Shutdown(std::chrono::system_clock::now() + std::chrono::seconds(1));
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (m_state->activeCalls.load() > 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    if (m_state->activeCalls.load() > 0) {
+        qWarning() << "gRPC 服务关闭时仍有" << m_state->activeCalls.load() << "个调用未结束";
+    }
+
+    m_state->cq->Shutdown();
+    for (std::thread& thread : m_pollThreads) {
+        thread.join();
+    }
+    m_pollThreads.clear();
+    m_server.reset();
+    qDebug() << "gRPC 服务已停止";
+}
+
+QVariantMap GrpcServer::metrics() const
+{
+    QVariantMap result;
+    result["active_calls"] = m_state->activeCalls.load();
+    result["unary_calls"] = static_cast<quint64>(m_state->unaryCalls.load());
+    result["list_streams"] = static_cast<quint64>(m_state->listStreams.load());
+    result["bulk_streams"] = static_cast<quint64>(m_state->bulkStreams.load());
+    result["rows_streamed"] = static_cast<quint64>(m_state->rowsStreamed.load());
+    result["rows_ingested"] = static_cast<quint64>(m_state->rowsIngested.load());
+    return result;
+}
@@ -0,0 +1,45 @@
+// grpcserver.h
+#ifndef GRPCSERVER_H
+#define GRPCSERVER_H
+
+#include <QString>
+#include <QVariantMap>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace grpc {
+class Server;
+}
+
+class OperationDispatcher;
+
+// proto/inventory.proto 中 Inventory 服务的异步实现
+// 基于完成队列：每个调用是一个小状态机，由轮询线程驱动，等待数据库时不占用线程，
+// 一个轮询线程即可承载大量并发调用和流。数据库操作经 OperationDispatcher 投递，
+// 完成时在数据库线程中直接发起应答
+class GrpcServer {
+public:
+    explicit GrpcServer(OperationDispatcher* dispatcher, int pollThreads = 1);
+    ~GrpcServer();
+
+    GrpcServer(const GrpcServer&) = delete;
+    GrpcServer& operator=(const GrpcServer&) = delete;
+
+    // address 形如 "127.0.0.1:50051"
+    bool start(const QString& address);
+    void stop();
+
+    // 任意线程：{active_calls, unary_calls, list_streams, bulk_streams, rows_streamed, rows_ingested}
+    QVariantMap metrics() const;
+
+    struct State;
+
+private:
+    std::unique_ptr<State> m_state;
+    std::unique_ptr<grpc::Server> m_server;
+    std::vector<std::thread> m_pollThreads;
+    int m_pollThreadCount;
+};
+
+#endif // GRPCSERVER_H
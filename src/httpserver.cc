@@ -0,0 +1,115 @@
+// httpserver.cc
+#include "httpserver.h"
+#include <QDebug>
+#include <algorithm>
+#include <drogon/drogon.h>
+
+namespace {
+// drogon::app().run() 在进程内只能调用一次
+std::atomic<bool> g_appStarted { false };
+} // namespace
+
+HttpServer::HttpServer(quint16 port, const QString& address, const HttpServerOptions& options)
+    : m_port(port)
+    , m_address(address)
+    , m_options(options)
+{
+}
+
+HttpServer::~HttpServer()
+{
+    stop();
+}
+
+void HttpServer::addRoute(const std::string& path, drogon::HttpMethod method, Handler handler)
+{
+    if (m_running) {
+        qWarning() << "HTTP 服务已启动，忽略路由:" << QString::fromStdString(path);
+        return;
+    }
+    m_routes.push_back({ path, method, std::move(handler), nullptr });
+}
+
+void HttpServer::addRoute(const std::string& path, drogon::HttpMethod method, ParamHandler handler)
+{
+    if (m_running) {
+        qWarning() << "HTTP 服务已启动，忽略路由:" << QString::fromStdString(path);
+        return;
+    }
+    m_routes.push_back({ path, method, nullptr, std::move(handler) });
+}
+
+void HttpServer::addSetup(Setup setup)
+{
+    if (m_running) {
+        qWarning() << "HTTP 服务已启动，忽略注册步骤";
+        return;
+    }
+    m_setups.push_back(std::move(setup));
+}
+
+bool HttpServer::start()
+{
+    if (m_running) {
+        return true;
+    }
+    if (g_appStarted.exchange(true)) {
+        qWarning() << "drogon 事件循环已在运行，不能再启动第二个 HTTP 服务";
+        return false;
+    }
+
+    auto& app = drogon::app();
+    for (const Route& route : m_routes) {
+        if (route.paramHandler) {
+            const ParamHandler handler = route.paramHandler;
+            app.registerHandler(route.path,
+                [handler](const drogon::HttpRequestPtr& request, Callback&& callback, const std::string& param) {
+                    handler(request, std::move(callback), param);
+                },
+                { route.method });
+        } else {
+            const Handler handler = route.handler;
+            app.registerHandler(route.path,
+                [handler](const drogon::HttpRequestPtr& request, Callback&& callback) {
+                    handler(request, std::move(callback));
+                },
+                { route.method });
+        }
+    }
+
+    for (const Setup& setup : m_setups) {
+        setup();
+    }
+
+    app.addListener(m_address.toStdString(), m_port)
+        .setThreadNum(std::max(1, m_options.ioThreads))
+        .setKeepaliveRequestsNumber(m_options.keepAliveRequests)
+        .setPipeliningRequestsNumber(m_options.pipeliningRequests)
+        .setIdleConnectionTimeout(m_options.idleTimeoutSec)
+        .setClientMaxBodySize(m_options.maxBodyBytes)
+        .disableSigtermHandling()
+        .setLogLevel(trantor::Logger::kWarn);
+
+    m_running = true;
+    m_thread = std::thread([]() {
+        // run() 把主事件循环迁移到当前线程，阻塞直到 quit()
+        drogon::app().run();
+    });
+
+    qDebug() << "HTTP 服务已启动，监听" << m_address << ":" << m_port;
+    return true;
+}
+
+void HttpServer::stop()
+{
+    if (!m_running.exchange(false)) {
+        return;
+    }
+
+    // 排进事件循环再退出：即使 run() 还没开始循环，也不会丢掉这次退出请求
+    drogon::app().getLoop()->queueInLoop([]() { drogon::app().quit(); });
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    qDebug() << "HTTP 服务已停止";
+}
@@ -0,0 +1,72 @@
+// httpserver.h
+#ifndef HTTPSERVER_H
+#define HTTPSERVER_H
+
+#include <drogon/HttpRequest.h>
+#include <drogon/HttpResponse.h>
+#include <drogon/HttpTypes.h>
+#include <QString>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 连接与线程参数，需在 start() 之前设置
+struct HttpServerOptions {
+    int ioThreads = 1; // drogon IO 线程数
+    std::size_t keepAliveRequests = 0; // 单个长连接上的请求数上限，0 表示不限
+    std::size_t pipeliningRequests = 64; // 单个连接上允许同时未应答的流水线请求数
+    std::size_t idleTimeoutSec = 60; // 空闲连接超时
+    std::size_t maxBodyBytes = 1024 * 1024; // 请求体上限
+};
+
+// 内嵌的 drogon HTTP 服务，事件循环跑在自己的线程里，不占用 Qt 主线程和数据库线程
+// drogon::app() 是进程级单例，run() 只能调用一次，所以整个进程只应有一个 HttpServer；
+// 各功能模块在 start() 之前通过 addRoute 挂接自己的路由
+class HttpServer {
+public:
+    using Callback = std::function<void(const drogon::HttpResponsePtr&)>;
+    using Handler = std::function<void(const drogon::HttpRequestPtr&, Callback&&)>;
+    // 带一个路径参数的路由，例如 /api/users/{id}
+    using ParamHandler = std::function<void(const drogon::HttpRequestPtr&, Callback&&, const std::string&)>;
+    // 直接操作 drogon::app() 的注册步骤，例如 WebSocket 控制器
+    using Setup = std::function<void()>;
+
+    explicit HttpServer(quint16 port, const QString& address = "127.0.0.1",
+        const HttpServerOptions& options = HttpServerOptions());
+    ~HttpServer();
+
+    HttpServer(const HttpServer&) = delete;
+    HttpServer& operator=(const HttpServer&) = delete;
+
+    // 需在 start() 之前调用；处理函数在 drogon 的 IO 线程中执行
+    void addRoute(const std::string& path, drogon::HttpMethod method, Handler handler);
+    void addRoute(const std::string& path, drogon::HttpMethod method, ParamHandler handler);
+    // 需在 start() 之前调用；在路由注册之后、开始监听之前执行
+    void addSetup(Setup setup);
+
+    bool start();
+    void stop();
+    bool isRunning() const { return m_running.load(); }
+    quint16 port() const { return m_port; }
+
+private:
+    struct Route {
+        std::string path;
+        drogon::HttpMethod method;
+        Handler handler;
+        ParamHandler paramHandler;
+    };
+
+    quint16 m_port;
+    QString m_address;
+    HttpServerOptions m_options;
+    std::vector<Route> m_routes;
+    std::vector<Setup> m_setups;
+    std::thread m_thread;
+    std::atomic<bool> m_running { false };
+};
+
+#endif // HTTPSERVER_H
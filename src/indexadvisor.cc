@@ -0,0 +1,742 @@
+// indexadvisor.cc
+#include "indexadvisor.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRegularExpression>
+#include <QTextStream>
+#include <QUrl>
+#include <algorithm>
+#include <cmath>
+#include <sqlite3.h>
+
+namespace {
+
+// 没有等值条件的范围扫描按表的四分之一估算
+constexpr double kRangeSelectivity = 0.25;
+
+QString stripLiterals(const QString& sql)
+{
+    static const QRegularExpression literal("'(?:[^']|'')*'");
+    QString stripped = sql;
+    return stripped.replace(literal, "''");
+}
+
+QString abbreviate(const QString& sql, int length = 120)
+{
+    const QString simplified = sql.simplified();
+    return simplified.size() > length ? simplified.left(length - 3) + "..." : simplified;
+}
+
+QRegularExpression columnPattern(const QString& column, const QString& suffix)
+{
+    return QRegularExpression("(?<![\\w$])\"?" + QRegularExpression::escape(column) + "\"?(?![\\w$])" + suffix,
+        QRegularExpression::CaseInsensitiveOption);
+}
+
+} // namespace
+
+IndexAdvisor::IndexAdvisor(const QString& dbFile)
+    : m_dbFile(dbFile)
+{
+}
+
+IndexAdvisor::~IndexAdvisor()
+{
+    if (m_db) {
+        sqlite3_close_v2(m_db);
+    }
+}
+
+bool IndexAdvisor::loadWorkload(const QString& path, QList<WorkloadQuery>& workload, QString& error)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = QString("无法读取工作负载文件 %1: %2").arg(path, file.errorString());
+        return false;
+    }
+    const QByteArray content = file.readAll();
+
+    // GET /debug/queries 的输出：已经按模板聚合
+    QJsonParseError parseError;
+    const QJsonDocument document = QJsonDocument::fromJson(content, &parseError);
+    if (parseError.error == QJsonParseError::NoError && document.isObject()) {
+        for (const QJsonValue& value : document.object().value("shapes").toArray()) {
+            const QJsonObject shape = value.toObject();
+            WorkloadQuery query;
+            query.sql = shape.value("sql").toString();
+            query.calls = static_cast<quint64>(shape.value("calls").toDouble());
+            query.totalUs = static_cast<qint64>(shape.value("total_us").toDouble());
+            query.fullscanSteps = static_cast<quint64>(shape.value("fullscan_steps").toDouble());
+            query.sorts = static_cast<quint64>(shape.value("sorts").toDouble());
+            if (!query.sql.isEmpty() && query.sql != "other" && query.calls > 0) {
+                workload.append(query);
+            }
+        }
+        return true;
+    }
+
+    // 慢查询日志：每行一次执行
+    QHash<QString, int> positions;
+    int lineNumber = 0;
+    for (const QByteArray& line : content.split('\n')) {
+        ++lineNumber;
+        if (line.trimmed().isEmpty()) {
+            continue;
+        }
+        const QJsonDocument entry = QJsonDocument::fromJson(line, &parseError);
+        if (parseError.error != QJsonParseError::NoError || !entry.isObject()) {
+            error = QString("%1 第 %2 行不是有效的 JSON: %3").arg(path).arg(lineNumber).arg(parseError.errorString());
+            return false;
+        }
+        const QJsonObject record = entry.object();
+        const QString sql = record.value("sql").toString();
+        if (sql.isEmpty()) {
+            continue;
+        }
+        auto position = positions.find(sql);
+        if (position == positions.end()) {
+            WorkloadQuery query;
+            query.sql = sql;
+            query.sampleSql = record.value("expanded_sql").toString();
+            workload.append(query);
+            position = positions.insert(sql, workload.size() - 1);
+        }
+        WorkloadQuery& query = workload[position.value()];
+        query.calls++;
+        query.totalUs += static_cast<qint64>(record.value("duration_us").toDouble());
+        query.fullscanSteps += static_cast<quint64>(record.value("fullscan_steps").toDouble());
+        query.sorts += static_cast<quint64>(record.value("sorts").toDouble());
+    }
+    return true;
+}
+
+bool IndexAdvisor::open(QString& error)
+{
+    if (!QFileInfo::exists(m_dbFile)) {
+        error = QString("数据库文件不存在: %1").arg(m_dbFile);
+        return false;
+    }
+    if (sqlite3_open_v2(":memory:", &m_db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_URI, nullptr) != SQLITE_OK) {
+        error = QString("无法创建内存数据库: %1").arg(sqlite3_errmsg(m_db));
+        return false;
+    }
+
+    // 源库以只读方式附加为 src，统计信息直接从真实数据计算
+    const QByteArray uri = (QUrl::fromLocalFile(QFileInfo(m_dbFile).absoluteFilePath()).toString(QUrl::FullyEncoded)
+        + "?mode=ro").toUtf8();
+    sqlite3_stmt* stmt = nullptr;
+    sqlite3_prepare_v2(m_db, "ATTACH DATABASE ?1 AS src", -1, &stmt, nullptr);
+    sqlite3_bind_text(stmt, 1, uri.constData(), uri.size(), SQLITE_TRANSIENT);
+    const int rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        error = QString("无法附加数据库 %1: %2").arg(m_dbFile, sqlite3_errmsg(m_db));
+        return false;
+    }
+
+    return loadSchema(error) && loadStatistics(error);
+}
+
+bool IndexAdvisor::exec(const QString& sql, QString* error)
+{
+    char* message = nullptr;
+    if (sqlite3_exec(m_db, sql.toUtf8().constData(), nullptr, nullptr, &message) != SQLITE_OK) {
+        if (error) {
+            *error = QString::fromUtf8(message ? message : sqlite3_errmsg(m_db));
+        }
+        sqlite3_free(message);
+        return false;
+    }
+    return true;
+}
+
+// 按创建顺序复制表、索引和视图；FTS 的影子表随虚拟表一起创建，重复创建的报错忽略
+bool IndexAdvisor::loadSchema(QString& error)
+{
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(m_db,
+            "SELECT type, name, sql FROM src.sqlite_schema"
+            " WHERE sql IS NOT NULL AND type IN ('table', 'index', 'view') AND name NOT LIKE 'sqlite\\_%' ESCAPE '\\'"
+            " ORDER BY rowid",
+            -1, &stmt, nullptr)
+        != SQLITE_OK) {
+        error = QString("无法读取表结构: %1").arg(sqlite3_errmsg(m_db));
+        return false;
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const QString type = QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)));
+        const QString name = QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)));
+        const QString sql = QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2)));
+        QString message;
+        if (!exec(sql, &message) && !message.contains("already exists")) {
+            m_warnings << QString("无法复制 %1 %2: %3").arg(type, name, message);
+        }
+    }
+    sqlite3_finalize(stmt);
+
+    sqlite3_prepare_v2(m_db,
+        "SELECT name FROM main.sqlite_schema WHERE type = 'table' AND name NOT LIKE 'sqlite\\_%' ESCAPE '\\'",
+        -1, &stmt, nullptr);
+    QStringList tables;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        tables << QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)));
+    }
+    sqlite3_finalize(stmt);
+
+    for (const QString& name : tables) {
+        Table table;
+        sqlite3_prepare_v2(m_db, QString("PRAGMA main.table_info(%1)").arg(quote(name)).toUtf8().constData(), -1, &stmt, nullptr);
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            const QString column = QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)));
+            const QString type = QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2)));
+            // INTEGER PRIMARY KEY 是 rowid 的别名，不需要索引
+            if (sqlite3_column_int(stmt, 5) == 1 && type.compare("INTEGER", Qt::CaseInsensitive) == 0) {
+                continue;
+            }
+            table.columns << column;
+        }
+        sqlite3_finalize(stmt);
+
+        sqlite3_prepare_v2(m_db, QString("SELECT COUNT(*) FROM src.%1").arg(quote(name)).toUtf8().constData(), -1, &stmt, nullptr);
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            table.rows = sqlite3_column_int64(stmt, 0);
+        }
+        sqlite3_finalize(stmt);
+        m_tables.insert(name, table);
+    }
+    return true;
+}
+
+// 内存库里的表是空的，统计信息按源库的数据写入 sqlite_stat1，规划器据此估算选择性
+bool IndexAdvisor::loadStatistics(QString& error)
+{
+    if (!exec("ANALYZE main", &error) || !exec("DELETE FROM main.sqlite_stat1", &error)) {
+        error = QString("无法初始化统计信息: %1").arg(error);
+        return false;
+    }
+
+    for (auto it = m_tables.cbegin(); it != m_tables.cend(); ++it) {
+        sqlite3_stmt* stmt = nullptr;
+        sqlite3_prepare_v2(m_db, "INSERT INTO main.sqlite_stat1 (tbl, idx, stat) VALUES (?1, NULL, ?2)", -1, &stmt, nullptr);
+        const QByteArray table = it.key().toUtf8();
+        const QByteArray stat = QByteArray::number(it.value().rows);
+        sqlite3_bind_text(stmt, 1, table.constData(), table.size(), SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 2, stat.constData(), stat.size(), SQLITE_TRANSIENT);
+        sqlite3_step(stmt);
+        sqlite3_finalize(stmt);
+
+        QStringList indexes;
+        sqlite3_prepare_v2(m_db, QString("PRAGMA main.index_list(%1)").arg(quote(it.key())).toUtf8().constData(), -1, &stmt, nullptr);
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            indexes << QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)));
+        }
+        sqlite3_finalize(stmt);
+
+        for (const QString& index : indexes) {
+            const QList<Column> columns = indexColumns(index);
+            if (!columns.isEmpty()) {
+                writeIndexStatistics(it.key(), index, columns);
+            }
+        }
+    }
+    return exec("ANALYZE sqlite_schema", &error);
+}
+
+void IndexAdvisor::writeIndexStatistics(const QString& table, const QString& index, const QList<Column>& columns)
+{
+    QStringList stat { QString::number(m_tables.value(table).rows) };
+    for (int i = 1; i <= columns.size(); ++i) {
+        stat << QString::number(static_cast<qint64>(std::ceil(rowsPerKey(table, columns.mid(0, i)))));
+    }
+
+    sqlite3_stmt* stmt = nullptr;
+    sqlite3_prepare_v2(m_db, "INSERT INTO main.sqlite_stat1 (tbl, idx, stat) VALUES (?1, ?2, ?3)", -1, &stmt, nullptr);
+    const QByteArray tableName = table.toUtf8();
+    const QByteArray indexName = index.toUtf8();
+    const QByteArray value = stat.join(' ').toUtf8();
+    sqlite3_bind_text(stmt, 1, tableName.constData(), tableName.size(), SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 2, indexName.constData(), indexName.size(), SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 3, value.constData(), value.size(), SQLITE_TRANSIENT);
+    sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+}
+
+// 索引的键列；含表达式的索引返回空
+QList<IndexAdvisor::Column> IndexAdvisor::indexColumns(const QString& index)
+{
+    QList<Column> columns;
+    sqlite3_stmt* stmt = nullptr;
+    sqlite3_prepare_v2(m_db, QString("PRAGMA main.index_xinfo(%1)").arg(quote(index)).toUtf8().constData(), -1, &stmt, nullptr);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        if (sqlite3_column_int(stmt, 5) == 0) {
+            continue;
+        }
+        if (sqlite3_column_int(stmt, 1) == -2) {
+            columns.clear();
+            break;
+        }
+        Column column;
+        column.name = QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2)));
+        const QString collation = QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4)));
+        if (collation.compare("BINARY", Qt::CaseInsensitive) != 0) {
+            column.collation = collation;
+        }
+        columns << column;
+    }
+    sqlite3_finalize(stmt);
+    return columns;
+}
+
+// 每个键值平均对应的行数，在源库上用 COUNT(DISTINCT) 计算
+double IndexAdvisor::rowsPerKey(const QString& table, const QList<Column>& columns)
+{
+    QStringList expressions;
+    for (const Column& column : columns) {
+        expressions << columnSql(column);
+    }
+    const QString key = table + '|' + expressions.join(',');
+    auto cached = m_rowsPerKey.constFind(key);
+    if (cached != m_rowsPerKey.cend()) {
+        return cached.value();
+    }
+
+    const qint64 rows = m_tables.value(table).rows;
+    double result = 1.0;
+    if (rows > 0) {
+        sqlite3_stmt* stmt = nullptr;
+        const QString sql = QString("SELECT COUNT(*) FROM (SELECT DISTINCT %1 FROM src.%2)").arg(expressions.join(", "), quote(table));
+        sqlite3_prepare_v2(m_db, sql.toUtf8().constData(), -1, &stmt, nullptr);
+        if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_int64(stmt, 0) > 0) {
+            result = std::max(1.0, static_cast<double>(rows) / sqlite3_column_int64(stmt, 0));
+        }
+        sqlite3_finalize(stmt);
+    }
+    m_rowsPerKey.insert(key, result);
+    return result;
+}
+
+// 计划中每张表的估算读取行数之和；嵌套循环的乘法不计入，对连接查询偏保守
+IndexAdvisor::PlanCost IndexAdvisor::explain(const QString& sql)
+{
+    PlanCost cost;
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(m_db, ("EXPLAIN QUERY PLAN " + sql).toUtf8().constData(), -1, &stmt, nullptr) != SQLITE_OK) {
+        cost.error = QString::fromUtf8(sqlite3_errmsg(m_db));
+        sqlite3_finalize(stmt);
+        return cost;
+    }
+
+    // FROM/JOIN 后的别名，计划里可能显示别名而不是表名
+    QHash<QString, QString> aliases;
+    static const QRegularExpression fromClause("\\b(?:FROM|JOIN)\\s+\"?(\\w+)\"?(?:\\s+(?:AS\\s+)?(\\w+))?",
+        QRegularExpression::CaseInsensitiveOption);
+    for (auto match = fromClause.globalMatch(sql); match.hasNext();) {
+        const auto m = match.next();
+        if (!m.captured(2).isEmpty()) {
+            aliases.insert(m.captured(2), m.captured(1));
+        }
+    }
+
+    static const QRegularExpression indexName("USING (?:COVERING )?INDEX (\\S+)");
+    QString lastTable;
+    double lastRows = 0;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const QString detail = QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3)));
+        if (detail.startsWith("USE TEMP B-TREE")) {
+            cost.tempSort = true;
+            cost.rows += lastRows;
+            if (!lastTable.isEmpty()) {
+                cost.scannedTables.insert(lastTable);
+            }
+            continue;
+        }
+        if (!detail.startsWith("SCAN ") && !detail.startsWith("SEARCH ")) {
+            continue;
+        }
+
+        QString table = detail.section(' ', 1, 1);
+        if (!m_tables.contains(table)) {
+            table = aliases.value(table, table);
+        }
+        if (!m_tables.contains(table)) {
+            continue;
+        }
+        cost.tables.insert(table);
+        lastTable = table;
+
+        if (detail.contains("VIRTUAL TABLE")) {
+            lastRows = 1;
+            cost.rows += lastRows;
+            continue;
+        }
+        const auto index = indexName.match(detail);
+        if (index.hasMatch()) {
+            cost.indexes.insert(index.captured(1));
+        }
+        if (detail.startsWith("SCAN ")) {
+            cost.scannedTables.insert(table);
+        }
+        lastRows = estimateRows(table, detail);
+        cost.rows += lastRows;
+    }
+    sqlite3_finalize(stmt);
+    cost.ok = true;
+    return cost;
+}
+
+double IndexAdvisor::estimateRows(const QString& table, const QString& detail)
+{
+    const double rows = std::max<qint64>(1, m_tables.value(table).rows);
+    if (detail.startsWith("SCAN ")) {
+        return rows;
+    }
+
+    // 约束写在最后一对括号里，如 (name=? AND price>?)
+    const int open = detail.lastIndexOf('(');
+    const QStringList terms = open >= 0 ? detail.mid(open + 1).chopped(1).split(" AND ") : QStringList();
+    int equalities = 0;
+    bool range = false;
+    for (const QString& term : terms) {
+        if (term.contains('>') || term.contains('<')) {
+            range = true;
+        } else if (term.contains('=')) {
+            ++equalities;
+        }
+    }
+
+    double estimate = rows;
+    static const QRegularExpression indexName("USING (?:COVERING )?INDEX (\\S+)");
+    const auto index = indexName.match(detail);
+    if (!index.hasMatch()) {
+        // INTEGER PRIMARY KEY / rowid
+        estimate = equalities > 0 ? 1.0 : rows;
+    } else if (equalities > 0) {
+        const QList<Column> columns = indexColumns(index.captured(1));
+        estimate = rowsPerKey(table, columns.mid(0, std::min<int>(equalities, columns.size())));
+    }
+    if (range) {
+        estimate *= kRangeSelectivity;
+    }
+    return std::max(1.0, estimate);
+}
+
+IndexAdvisor::ColumnUsage IndexAdvisor::columnUsage(const QString& sql, const QString& table) const
+{
+    ColumnUsage usage;
+    const QString stripped = stripLiterals(sql);
+
+    static const QRegularExpression where("\\bWHERE\\b", QRegularExpression::CaseInsensitiveOption);
+    static const QRegularExpression whereEnd("\\b(?:ORDER\\s+BY|GROUP\\s+BY|LIMIT|RETURNING)\\b", QRegularExpression::CaseInsensitiveOption);
+    static const QRegularExpression orderBy("\\bORDER\\s+BY\\b", QRegularExpression::CaseInsensitiveOption);
+    static const QRegularExpression orderEnd("\\b(?:LIMIT|RETURNING)\\b", QRegularExpression::CaseInsensitiveOption);
+
+    QString whereText;
+    const auto whereMatch = where.match(stripped);
+    if (whereMatch.hasMatch()) {
+        const int start = whereMatch.capturedEnd();
+        const auto end = whereEnd.match(stripped, start);
+        whereText = stripped.mid(start, end.hasMatch() ? end.capturedStart() - start : -1);
+    }
+    QString orderText;
+    for (auto match = orderBy.globalMatch(stripped); match.hasNext();) {
+        const int start = match.next().capturedEnd();
+        const auto end = orderEnd.match(stripped, start);
+        orderText = stripped.mid(start, end.hasMatch() ? end.capturedStart() - start : -1);
+    }
+
+    for (const QString& column : m_tables.value(table).columns) {
+        if (columnPattern(column, "\\s*(?:==?(?!=)|IN\\b|IS\\b)").match(whereText).hasMatch()) {
+            usage.equality << column;
+        } else if (columnPattern(column, "\\s*(?:<=?|>=?|BETWEEN\\b)").match(whereText).hasMatch()) {
+            usage.range << column;
+        } else if (columnPattern(column, "\\s+(?:LIKE|GLOB)\\b").match(whereText).hasMatch()) {
+            usage.like << column;
+        }
+        if (columnPattern(column, QString()).match(orderText).hasMatch()) {
+            usage.orderBy << column;
+        }
+    }
+    return usage;
+}
+
+// 对全表扫描或需要临时排序的表生成候选：等值列（选择性高的在前）接一个范围列或排序列、
+// 各单列，以及 LIKE 列上的 NOCASE 索引（默认 LIKE 不区分大小写，只有 NOCASE 索引可用）
+QList<IndexAdvisor::Candidate> IndexAdvisor::candidatesFor(const QString& sql, const PlanCost& plan)
+{
+    QList<Candidate> candidates;
+    auto add = [&](const QString& table, const QList<Column>& columns) {
+        if (columns.isEmpty()) {
+            return;
+        }
+        Candidate candidate { table, columns, "idx_" + table };
+        for (const Column& column : columns) {
+            candidate.name += '_' + column.name;
+        }
+        if (!columns.first().collation.isEmpty()) {
+            candidate.name += '_' + columns.first().collation.toLower();
+        }
+        candidates.append(candidate);
+    };
+    auto binary = [](const QStringList& names) {
+        QList<Column> columns;
+        for (const QString& name : names) {
+            columns.append({ name, QString() });
+        }
+        return columns;
+    };
+
+    for (const QString& table : plan.scannedTables) {
+        const ColumnUsage usage = columnUsage(sql, table);
+        QStringList equality = usage.equality;
+        std::sort(equality.begin(), equality.end(), [&](const QString& a, const QString& b) {
+            return rowsPerKey(table, binary({ a })) < rowsPerKey(table, binary({ b }));
+        });
+
+        if (!equality.isEmpty()) {
+            if (!usage.range.isEmpty()) {
+                add(table, binary(equality + QStringList { usage.range.first() }));
+            } else if (!usage.orderBy.isEmpty()) {
+                QStringList columns = equality;
+                for (const QString& column : usage.orderBy) {
+                    if (!columns.contains(column)) {
+                        columns << column;
+                    }
+                }
+                add(table, binary(columns));
+            }
+            if (equality.size() > 1) {
+                add(table, binary(equality));
+            }
+        }
+        for (const QString& column : equality + usage.range) {
+            add(table, binary({ column }));
+        }
+        if (equality.isEmpty() && usage.range.isEmpty() && !usage.orderBy.isEmpty()) {
+            add(table, binary(usage.orderBy));
+        }
+        for (const QString& column : usage.like) {
+            add(table, { { column, "NOCASE" } });
+        }
+    }
+    return candidates;
+}
+
+// LIKE 的参数未绑定时规划器不会考虑索引，what-if 时代入一个前缀模式
+QString IndexAdvisor::whatIfSql(const WorkloadQuery& query) const
+{
+    static const QRegularExpression likeParameter("\\b(LIKE|GLOB)\\s+(?::\\w+|@\\w+|\\$\\w+|\\?\\d*)",
+        QRegularExpression::CaseInsensitiveOption);
+    QString sql = query.sql;
+    return sql.replace(likeParameter, "\\1 'a%'");
+}
+
+// 每次写入多下降一棵 B 树，按 log2(行数) 计
+double IndexAdvisor::writePenalty(const QList<WorkloadQuery>& workload, const QString& table) const
+{
+    const QRegularExpression write(
+        QString("^\\s*(?:(?:INSERT|REPLACE)(?:\\s+OR\\s+\\w+)?\\s+INTO|UPDATE(?:\\s+OR\\s+\\w+)?|DELETE\\s+FROM)\\s+\"?%1\"?(?![\\w$])")
+            .arg(QRegularExpression::escape(table)),
+        QRegularExpression::CaseInsensitiveOption);
+    quint64 writes = 0;
+    for (const WorkloadQuery& query : workload) {
+        if (write.match(query.sql).hasMatch()) {
+            writes += query.calls;
+        }
+    }
+    return writes * std::log2(static_cast<double>(m_tables.value(table).rows) + 2.0);
+}
+
+QList<IndexRecommendation> IndexAdvisor::analyze(const QList<WorkloadQuery>& workload, int limit)
+{
+    struct Evaluated {
+        WorkloadQuery query;
+        QString sql;
+        PlanCost before;
+    };
+
+    // 已有索引的列签名，候选是其前缀时不再考虑
+    QStringList existing;
+    for (auto it = m_tables.cbegin(); it != m_tables.cend(); ++it) {
+        sqlite3_stmt* stmt = nullptr;
+        sqlite3_prepare_v2(m_db, QString("PRAGMA main.index_list(%1)").arg(quote(it.key())).toUtf8().constData(), -1, &stmt, nullptr);
+        QStringList indexes;
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            indexes << QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)));
+        }
+        sqlite3_finalize(stmt);
+        for (const QString& index : indexes) {
+            QStringList columns;
+            for (const Column& column : indexColumns(index)) {
+                columns << columnSql(column);
+            }
+            existing << it.key() + '|' + columns.join(',') + ',';
+        }
+    }
+
+    QList<Evaluated> evaluated;
+    QList<Candidate> candidates;
+    QSet<QString> seen;
+    for (const WorkloadQuery& query : workload) {
+        Evaluated entry { query, whatIfSql(query), PlanCost() };
+        entry.before = explain(entry.sql);
+        if (!entry.before.ok) {
+            m_warnings << QString("跳过无法解释的语句（%1）: %2").arg(entry.before.error, abbreviate(query.sql));
+            continue;
+        }
+        evaluated.append(entry);
+
+        for (const Candidate& candidate : candidatesFor(entry.sql, entry.before)) {
+            QStringList columns;
+            for (const Column& column : candidate.columns) {
+                columns << columnSql(column);
+            }
+            const QString signature = candidate.table + '|' + columns.join(',') + ',';
+            const bool covered = std::any_of(existing.cbegin(), existing.cend(),
+                [&](const QString& index) { return index.startsWith(signature); });
+            if (!covered && !seen.contains(signature)) {
+                seen.insert(signature);
+                candidates.append(candidate);
+            }
+        }
+    }
+
+    static const QRegularExpression leadingWildcard("\\b(?:LIKE|GLOB)\\s+'[%*_?]", QRegularExpression::CaseInsensitiveOption);
+    QList<IndexRecommendation> scored;
+    for (const Candidate& candidate : candidates) {
+        QStringList columns;
+        for (const Column& column : candidate.columns) {
+            columns << columnSql(column);
+        }
+        const QString ddl = QString("CREATE INDEX %1 ON %2(%3)").arg(quote(candidate.name), quote(candidate.table), columns.join(", "));
+        QString message;
+        if (!exec(ddl, &message)) {
+            m_warnings << QString("无法创建候选索引 %1: %2").arg(candidate.name, message);
+            continue;
+        }
+        writeIndexStatistics(candidate.table, candidate.name, candidate.columns);
+        exec("ANALYZE sqlite_schema");
+
+        IndexRecommendation recommendation;
+        recommendation.table = candidate.table;
+        recommendation.columns = columns;
+        recommendation.ddl = ddl + ";";
+        const bool likeIndex = !candidate.columns.first().collation.isEmpty();
+        bool substringOnly = false;
+        bool unknownPattern = false;
+        for (const Evaluated& entry : evaluated) {
+            if (!entry.before.tables.contains(candidate.table)) {
+                continue;
+            }
+            const PlanCost after = explain(entry.sql);
+            if (!after.ok || !after.indexes.contains(candidate.name)) {
+                continue;
+            }
+            const double saved = entry.before.rows - after.rows;
+            if (saved <= 0) {
+                continue;
+            }
+            if (likeIndex) {
+                if (leadingWildcard.match(entry.query.sampleSql).hasMatch()) {
+                    substringOnly = true;
+                    continue;
+                }
+                unknownPattern = unknownPattern || entry.query.sampleSql.isEmpty();
+            }
+            recommendation.rowsSaved += saved * entry.query.calls;
+            QString line = QString("%1 次: %2").arg(entry.query.calls).arg(abbreviate(entry.query.sql));
+            if (entry.query.fullscanSteps > 0) {
+                line += QString("（观测全表扫描 %1 步/次）").arg(entry.query.fullscanSteps / std::max<quint64>(1, entry.query.calls));
+            }
+            if (entry.before.tempSort && !after.tempSort) {
+                line += "（省去临时排序）";
+            }
+            recommendation.queries << line;
+        }
+        if (substringOnly) {
+            recommendation.notes << "部分语句的 LIKE 模式以通配符开头（子串匹配），任何 B 树索引都无法使用，应改走全文索引";
+        }
+        if (unknownPattern) {
+            recommendation.notes << "只有前缀匹配（'abc%'）且 case_sensitive_like 关闭时 LIKE 才能使用该索引，收益按前缀匹配估算";
+        }
+
+        exec(QString("DROP INDEX %1").arg(quote(candidate.name)));
+        exec(QString("DELETE FROM main.sqlite_stat1 WHERE idx = '%1'").arg(QString(candidate.name).replace('\'', "''")));
+        exec("ANALYZE sqlite_schema");
+
+        recommendation.writePenalty = writePenalty(workload, candidate.table);
+        recommendation.benefit = recommendation.rowsSaved - recommendation.writePenalty;
+        if (recommendation.writePenalty > 0) {
+            recommendation.notes << QString("写入该表的语句每次多维护一个索引，估算代价 %1 行").arg(recommendation.writePenalty, 0, 'f', 0);
+        }
+        if (!recommendation.queries.isEmpty() && recommendation.benefit > 0) {
+            scored.append(recommendation);
+        } else if (substringOnly) {
+            m_warnings << QString("%1(%2) 上的 LIKE 是子串匹配，索引无帮助").arg(candidate.table, columns.join(", "));
+        }
+    }
+
+    std::sort(scored.begin(), scored.end(),
+        [](const IndexRecommendation& a, const IndexRecommendation& b) { return a.benefit > b.benefit; });
+
+    // 贪心挑选：已选索引的列以候选的列开头时，候选能做到的它基本都能做到
+    QList<IndexRecommendation> selected;
+    for (const IndexRecommendation& recommendation : scored) {
+        if (selected.size() >= limit) {
+            break;
+        }
+        const bool redundant = std::any_of(selected.cbegin(), selected.cend(), [&](const IndexRecommendation& chosen) {
+            return chosen.table == recommendation.table
+                && chosen.columns.mid(0, recommendation.columns.size()) == recommendation.columns;
+        });
+        if (!redundant) {
+            selected.append(recommendation);
+        }
+    }
+    return selected;
+}
+
+QString IndexAdvisor::formatReport(const QList<IndexRecommendation>& recommendations, const QStringList& warnings)
+{
+    QString report;
+    QTextStream out(&report);
+    if (recommendations.isEmpty()) {
+        out << "未发现能带来收益的索引\n";
+    } else {
+        out << "索引建议（按净收益降序，单位为估算读取行数）:\n";
+    }
+    int rank = 0;
+    for (const IndexRecommendation& recommendation : recommendations) {
+        out << "\n" << ++rank << ". " << recommendation.ddl << "\n";
+        out << "   减少读取 " << QString::number(recommendation.rowsSaved, 'f', 0)
+            << "，写入维护 " << QString::number(recommendation.writePenalty, 'f', 0)
+            << "，净收益 " << QString::number(recommendation.benefit, 'f', 0) << "\n";
+        out << "   受益语句:\n";
+        for (const QString& query : recommendation.queries) {
+            out << "     - " << query << "\n";
+        }
+        for (const QString& note : recommendation.notes) {
+            out << "   注意: " << note << "\n";
+        }
+    }
+    if (!warnings.isEmpty()) {
+        out << "\n分析过程中的提示:\n";
+        for (const QString& warning : warnings) {
+            out << "  - " << warning << "\n";
+        }
+    }
+    out.flush();
+    return report;
+}
+
+QString IndexAdvisor::quote(const QString& identifier)
+{
+    return '"' + QString(identifier).replace('"', "\"\"") + '"';
+}
+
+QString IndexAdvisor::columnSql(const Column& column)
+{
+    return column.collation.isEmpty() ? quote(column.name) : quote(column.name) + " COLLATE " + column.collation;
+}
@@ -0,0 +1,122 @@
+// indexadvisor.h
+#ifndef INDEXADVISOR_H
+#define INDEXADVISOR_H
+
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+struct sqlite3;
+
+// 一条工作负载语句（按模板聚合）
+struct WorkloadQuery {
+    QString sql; // 语句模板（参数为占位符）
+    QString sampleSql; // 代入参数后的一条样例，慢查询日志里才有，用于判断 LIKE 的模式
+    quint64 calls = 0;
+    qint64 totalUs = 0;
+    quint64 fullscanSteps = 0; // 观测到的全表扫描步数（所有调用之和）
+    quint64 sorts = 0;
+};
+
+// 一条索引建议
+struct IndexRecommendation {
+    QString table;
+    QStringList columns; // 可带 COLLATE 子句
+    QString ddl;
+    double rowsSaved = 0; // 按调用次数加权的估算读取行数减少量
+    double writePenalty = 0; // 写入该表的语句维护索引的估算代价
+    double benefit = 0; // rowsSaved - writePenalty
+    QStringList queries; // 计划因该索引改变的语句
+    QStringList notes;
+};
+
+// 离线索引顾问：读取记录下来的工作负载（GET /debug/queries 的输出或慢查询日志），
+// 把数据库的表结构复制到内存库中，对每个候选索引做 what-if 分析：
+// 在内存库里建索引、按源库的真实数据写入 sqlite_stat1，比较 EXPLAIN QUERY PLAN 的前后差异，
+// 用计划中每张表的估算读取行数乘以调用次数作为收益，减去写入语句维护索引的代价
+// 源库只以只读方式附加，不会被修改
+class IndexAdvisor {
+public:
+    explicit IndexAdvisor(const QString& dbFile);
+    ~IndexAdvisor();
+
+    IndexAdvisor(const IndexAdvisor&) = delete;
+    IndexAdvisor& operator=(const IndexAdvisor&) = delete;
+
+    // 两种格式：包含 shapes 数组的 JSON 对象，或每行一条记录的慢查询日志（同一模板的多行合并）
+    static bool loadWorkload(const QString& path, QList<WorkloadQuery>& workload, QString& error);
+
+    // 复制表结构并收集统计信息
+    bool open(QString& error);
+
+    // 按收益降序，最多 limit 条；已被更长的同前缀建议覆盖的候选不再单独列出
+    QList<IndexRecommendation> analyze(const QList<WorkloadQuery>& workload, int limit = 10);
+
+    // 分析过程中跳过的语句、无法复制的对象等
+    const QStringList& warnings() const { return m_warnings; }
+
+    static QString formatReport(const QList<IndexRecommendation>& recommendations, const QStringList& warnings);
+
+private:
+    struct Column {
+        QString name;
+        QString collation; // 为空表示 BINARY
+    };
+
+    struct Table {
+        qint64 rows = 0;
+        QStringList columns;
+    };
+
+    // 一个计划的估算代价
+    struct PlanCost {
+        bool ok = false;
+        QString error;
+        double rows = 0;
+        bool tempSort = false;
+        QSet<QString> tables;
+        QSet<QString> scannedTables; // 全表扫描或需要临时排序的表
+        QSet<QString> indexes;
+    };
+
+    // 语句中对某张表各列的使用方式
+    struct ColumnUsage {
+        QStringList equality;
+        QStringList range;
+        QStringList like;
+        QStringList orderBy;
+    };
+
+    struct Candidate {
+        QString table;
+        QList<Column> columns;
+        QString name;
+    };
+
+    bool exec(const QString& sql, QString* error = nullptr);
+    bool loadSchema(QString& error);
+    bool loadStatistics(QString& error);
+    void writeIndexStatistics(const QString& table, const QString& index, const QList<Column>& columns);
+    QList<Column> indexColumns(const QString& index);
+    double rowsPerKey(const QString& table, const QList<Column>& columns);
+
+    PlanCost explain(const QString& sql);
+    double estimateRows(const QString& table, const QString& detail);
+    ColumnUsage columnUsage(const QString& sql, const QString& table) const;
+    QList<Candidate> candidatesFor(const QString& sql, const PlanCost& plan);
+    QString whatIfSql(const WorkloadQuery& query) const;
+    double writePenalty(const QList<WorkloadQuery>& workload, const QString& table) const;
+
+    static QString quote(const QString& identifier);
+    static QString columnSql(const Column& column);
+
+    QString m_dbFile;
+    sqlite3* m_db = nullptr;
+    QHash<QString, Table> m_tables;
+    QHash<QString, double> m_rowsPerKey; // 键：表名 + 列（含排序规则）
+    QStringList m_warnings;
+};
+
+#endif // INDEXADVISOR_H
@@ -0,0 +1,289 @@
+// latencyrecorder.cc
+#include "latencyrecorder.h"
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+namespace {
+
+std::atomic<uint64_t> g_nextInstanceId { 1 };
+
+// 每个线程在每个记录器上的分片；以实例 ID 为键，记录器销毁后旧条目不会被误用
+thread_local std::unordered_map<uint64_t, void*> t_shards;
+
+const QString kOtherType = QStringLiteral("other");
+
+} // namespace
+
+LatencyRecorder::Shard::~Shard()
+{
+    for (auto& histogram : histograms) {
+        delete histogram.load(std::memory_order_relaxed);
+    }
+}
+
+LatencyRecorder::LatencyRecorder()
+    : m_instanceId(g_nextInstanceId.fetch_add(1, std::memory_order_relaxed))
+{
+    m_types.insert(kOtherType, 0);
+    m_typeNames[0].store(&kOtherType, std::memory_order_relaxed);
+    m_typeCount.store(1, std::memory_order_release);
+}
+
+LatencyRecorder::~LatencyRecorder() = default;
+
+void LatencyRecorder::record(const QString& operationType, Stage stage, qint64 nanos)
+{
+    if (stage < 0 || stage >= StageCount) {
+        return;
+    }
+
+    Shard* shard = localShard();
+    if (!shard) {
+        return;
+    }
+    const int slot = typeId(shard, operationType) * StageCount + stage;
+
+    Histogram* histogram = shard->histograms[slot].load(std::memory_order_relaxed);
+    if (!histogram) {
+        histogram = new Histogram;
+        shard->histograms[slot].store(histogram, std::memory_order_release);
+    }
+
+    const uint64_t value = nanos > 0 ? static_cast<uint64_t>(nanos) : 0;
+    auto& bucket = histogram->counts[bucketIndex(value)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    histogram->sumNanos.store(histogram->sumNanos.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    if (value > histogram->maxNanos.load(std::memory_order_relaxed)) {
+        histogram->maxNanos.store(value, std::memory_order_relaxed);
+    }
+}
+
+void LatencyRecorder::setDeliveryTracking(bool enabled)
+{
+    m_deliveryTracking = enabled;
+    if (!enabled) {
+        QMutexLocker locker(&m_dispatchMutex);
+        m_dispatched.clear();
+    }
+}
+
+void LatencyRecorder::markDispatched(const QString& operationId, const QString& operationType)
+{
+    if (!m_deliveryTracking.load(std::memory_order_relaxed)) {
+        return;
+    }
+    QMutexLocker locker(&m_dispatchMutex);
+    m_dispatched.insert(operationId, { operationType, std::chrono::steady_clock::now() });
+}
+
+void LatencyRecorder::markDelivered(const QString& operationId)
+{
+    Dispatch dispatch;
+    {
+        QMutexLocker locker(&m_dispatchMutex);
+        auto it = m_dispatched.find(operationId);
+        if (it == m_dispatched.end()) {
+            return;
+        }
+        dispatch = it.value();
+        m_dispatched.erase(it);
+    }
+
+    const auto elapsed = std::chrono::steady_clock::now() - dispatch.dispatchedAt;
+    record(dispatch.operationType, Deliver, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+}
+
+double LatencyRecorder::HistogramSnapshot::percentileMicros(double quantile) const
+{
+    if (total == 0) {
+        return 0.0;
+    }
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(quantile * total)));
+    uint64_t seen = 0;
+    for (int i = 0; i < static_cast<int>(counts.size()); ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return std::min(bucketValue(i), static_cast<double>(maxNanos)) / 1000.0;
+        }
+    }
+    return maxNanos / 1000.0;
+}
+
+uint64_t LatencyRecorder::HistogramSnapshot::countAtOrBelow(uint64_t nanos) const
+{
+    uint64_t result = 0;
+    for (int i = 0; i < static_cast<int>(counts.size()); ++i) {
+        if (bucketUpperBound(i) > nanos) {
+            break;
+        }
+        result += counts[i];
+    }
+    return result;
+}
+
+QList<LatencyRecorder::HistogramSnapshot> LatencyRecorder::histograms() const
+{
+    // 槽位只增不减、发布后不再改变，按 acquire 读到的计数遍历即可，无需加锁
+    const int typeCount = m_typeCount.load(std::memory_order_acquire);
+    const int shardCount = m_shardCount.load(std::memory_order_acquire);
+
+    std::vector<HistogramSnapshot> merged(static_cast<std::size_t>(typeCount) * StageCount);
+    for (int shardIndex = 0; shardIndex < shardCount; ++shardIndex) {
+        const Shard* shard = m_shards[shardIndex].load(std::memory_order_acquire);
+        for (std::size_t slot = 0; slot < merged.size(); ++slot) {
+            const Histogram* histogram = shard->histograms[slot].load(std::memory_order_acquire);
+            if (!histogram) {
+                continue;
+            }
+            HistogramSnapshot& target = merged[slot];
+            if (target.counts.empty()) {
+                target.counts.assign(kBucketCount, 0);
+            }
+            for (int i = 0; i < kBucketCount; ++i) {
+                const uint64_t count = histogram->counts[i].load(std::memory_order_relaxed);
+                target.counts[i] += count;
+                target.total += count;
+            }
+            target.sumNanos += histogram->sumNanos.load(std::memory_order_relaxed);
+            target.maxNanos = std::max(target.maxNanos, histogram->maxNanos.load(std::memory_order_relaxed));
+        }
+    }
+
+    QList<HistogramSnapshot> result;
+    for (std::size_t slot = 0; slot < merged.size(); ++slot) {
+        HistogramSnapshot& histogram = merged[slot];
+        if (histogram.total == 0) {
+            continue;
+        }
+        histogram.operationType = *m_typeNames[slot / StageCount].load(std::memory_order_acquire);
+        histogram.stage = static_cast<Stage>(slot % StageCount);
+        result.append(std::move(histogram));
+    }
+    return result;
+}
+
+QVariantMap LatencyRecorder::snapshot() const
+{
+    QVariantMap result;
+    for (const HistogramSnapshot& histogram : histograms()) {
+        QVariantMap summary;
+        summary["count"] = static_cast<quint64>(histogram.total);
+        summary["mean_us"] = histogram.sumNanos / 1000.0 / histogram.total;
+        summary["p50_us"] = histogram.percentileMicros(0.50);
+        summary["p90_us"] = histogram.percentileMicros(0.90);
+        summary["p99_us"] = histogram.percentileMicros(0.99);
+        summary["p999_us"] = histogram.percentileMicros(0.999);
+        summary["max_us"] = histogram.maxNanos / 1000.0;
+
+        QVariantMap stages = result.value(histogram.operationType).toMap();
+        stages.insert(stageName(histogram.stage), summary);
+        result.insert(histogram.operationType, stages);
+    }
+    return result;
+}
+
+const char* LatencyRecorder::stageName(Stage stage)
+{
+    switch (stage) {
+    case QueueWait:
+        return "queue_wait";
+    case Execute:
+        return "execute";
+    case Serialize:
+        return "serialize";
+    case Deliver:
+        return "deliver";
+    default:
+        return "unknown";
+    }
+}
+
+// 小于 32ns 的值每个纳秒一个桶；之后每个 2 的幂区间等分为 32 个桶
+int LatencyRecorder::bucketIndex(uint64_t nanos)
+{
+    if (nanos < kSubBucketCount) {
+        return static_cast<int>(nanos);
+    }
+
+    int exponent = 63 - __builtin_clzll(nanos);
+    if (exponent > kMaxExponent) {
+        exponent = kMaxExponent;
+        nanos = (uint64_t(1) << (kMaxExponent + 1)) - 1;
+    }
+    const int shift = exponent - kSubBucketBits;
+    return (shift + 1) * kSubBucketCount + static_cast<int>((nanos >> shift) - kSubBucketCount);
+}
+
+// 桶内最大值
+uint64_t LatencyRecorder::bucketUpperBound(int index)
+{
+    if (index < kSubBucketCount) {
+        return static_cast<uint64_t>(index);
+    }
+    const int shift = index / kSubBucketCount - 1;
+    const uint64_t lower = static_cast<uint64_t>(index % kSubBucketCount + kSubBucketCount) << shift;
+    return lower + (uint64_t(1) << shift) - 1;
+}
+
+// 桶的中点
+double LatencyRecorder::bucketValue(int index)
+{
+    if (index < kSubBucketCount) {
+        return index;
+    }
+    const int shift = index / kSubBucketCount - 1;
+    const uint64_t lower = static_cast<uint64_t>(index % kSubBucketCount + kSubBucketCount) << shift;
+    return static_cast<double>(lower) + static_cast<double>(uint64_t(1) << shift) / 2.0;
+}
+
+LatencyRecorder::Shard* LatencyRecorder::localShard()
+{
+    auto it = t_shards.find(m_instanceId);
+    if (it != t_shards.end()) {
+        return static_cast<Shard*>(it->second);
+    }
+
+    Shard* shard = nullptr;
+    {
+        QMutexLocker locker(&m_registryMutex);
+        const int index = m_shardCount.load(std::memory_order_relaxed);
+        if (index < kMaxShards) {
+            m_ownedShards.push_back(std::make_unique<Shard>());
+            shard = m_ownedShards.back().get();
+            m_shards[index].store(shard, std::memory_order_release);
+            m_shardCount.store(index + 1, std::memory_order_release);
+        } else {
+            m_droppedThreads.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    // 超限的线程也缓存空分片，之后直接跳过
+    t_shards[m_instanceId] = shard;
+    return shard;
+}
+
+int LatencyRecorder::typeId(Shard* shard, const QString& operationType)
+{
+    auto cached = shard->typeCache.constFind(operationType);
+    if (cached != shard->typeCache.constEnd()) {
+        return cached.value();
+    }
+
+    int id = 0;
+    {
+        QMutexLocker locker(&m_registryMutex);
+        auto it = m_types.constFind(operationType);
+        const int count = m_typeCount.load(std::memory_order_relaxed);
+        if (it != m_types.constEnd()) {
+            id = it.value();
+        } else if (count < kMaxTypes) {
+            id = count;
+            m_ownedTypeNames.push_back(std::make_unique<QString>(operationType));
+            m_types.insert(operationType, id);
+            m_typeNames[id].store(m_ownedTypeNames.back().get(), std::memory_order_release);
+            m_typeCount.store(count + 1, std::memory_order_release);
+        }
+    }
+    shard->typeCache.insert(operationType, id);
+    return id;
+}
@@ -0,0 +1,119 @@
+// latencyrecorder.h
+#ifndef LATENCYRECORDER_H
+#define LATENCYRECORDER_H
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QVariantMap>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// 按操作类型、分阶段的延迟直方图（HDR 风格的对数-线性分桶，相对误差不超过 2%）
+// 每个线程写自己的分片，记录路径无锁；读取时合并所有分片，读取路径同样不加锁
+class LatencyRecorder {
+public:
+    enum Stage {
+        QueueWait, // 入队到出队
+        Execute, // SQL 执行（含取行）
+        Serialize, // 结果 JSON 序列化与处理器侧解析整理
+        Deliver, // 处理器发出完成信号到 DBOperateThread 收到
+        StageCount,
+    };
+
+    // 合并所有分片后的单个直方图
+    struct HistogramSnapshot {
+        QString operationType;
+        Stage stage = QueueWait;
+        uint64_t total = 0;
+        uint64_t sumNanos = 0;
+        uint64_t maxNanos = 0;
+        std::vector<uint64_t> counts;
+
+        double percentileMicros(double quantile) const;
+        // 不超过 nanos 的样本数（按桶上界判断），用于导出固定边界的累积直方图
+        uint64_t countAtOrBelow(uint64_t nanos) const;
+    };
+
+    LatencyRecorder();
+    ~LatencyRecorder();
+
+    LatencyRecorder(const LatencyRecorder&) = delete;
+    LatencyRecorder& operator=(const LatencyRecorder&) = delete;
+
+    // 任意线程
+    void record(const QString& operationType, Stage stage, qint64 nanos);
+
+    // 跨线程投递的计时：发出前登记，接收方收到后结算（未开启时不登记）
+    void setDeliveryTracking(bool enabled);
+    void markDispatched(const QString& operationId, const QString& operationType);
+    void markDelivered(const QString& operationId);
+
+    // 任意线程，不加锁：有样本的直方图
+    QList<HistogramSnapshot> histograms() const;
+    // {操作类型: {阶段: {count, mean_us, p50_us, p90_us, p99_us, p999_us, max_us}}}
+    QVariantMap snapshot() const;
+    // 超出分片上限、未被记录的线程数
+    quint64 droppedThreads() const { return m_droppedThreads.load(std::memory_order_relaxed); }
+
+    static const char* stageName(Stage stage);
+
+private:
+    static constexpr int kSubBucketBits = 5;
+    static constexpr int kSubBucketCount = 1 << kSubBucketBits;
+    static constexpr int kMaxExponent = 36; // 约 68 秒，更大的值计入最后一个桶
+    static constexpr int kBucketCount = (kMaxExponent - kSubBucketBits + 2) * kSubBucketCount;
+    static constexpr int kMaxTypes = 128; // 超出的操作类型统一计入 "other"
+    static constexpr int kMaxShards = 64; // 超出的线程不再记录
+
+    // 只有所属线程写入，用 relaxed 的 load/store 代替 fetch_add
+    struct Histogram {
+        std::array<std::atomic<uint64_t>, kBucketCount> counts {};
+        std::atomic<uint64_t> sumNanos { 0 };
+        std::atomic<uint64_t> maxNanos { 0 };
+    };
+
+    struct Shard {
+        std::array<std::atomic<Histogram*>, kMaxTypes * StageCount> histograms {};
+        QHash<QString, int> typeCache; // 只由所属线程访问
+        ~Shard();
+    };
+
+    struct Dispatch {
+        QString operationType;
+        std::chrono::steady_clock::time_point dispatchedAt;
+    };
+
+    static int bucketIndex(uint64_t nanos);
+    static uint64_t bucketUpperBound(int index);
+    static double bucketValue(int index);
+
+    Shard* localShard();
+    int typeId(Shard* shard, const QString& operationType);
+
+    const uint64_t m_instanceId;
+
+    // 分片注册与类型登记只在线程首次记录或首次遇到新类型时加锁（仅写者之间互斥）；
+    // 读者先以 acquire 读计数，再读对应的原子槽位，不碰这把锁
+    QMutex m_registryMutex;
+    std::vector<std::unique_ptr<Shard>> m_ownedShards;
+    std::vector<std::unique_ptr<QString>> m_ownedTypeNames;
+    QHash<QString, int> m_types;
+
+    std::array<std::atomic<Shard*>, kMaxShards> m_shards {};
+    std::atomic<int> m_shardCount { 0 };
+    std::array<std::atomic<const QString*>, kMaxTypes> m_typeNames {};
+    std::atomic<int> m_typeCount { 0 };
+    std::atomic<quint64> m_droppedThreads { 0 };
+
+    std::atomic<bool> m_deliveryTracking { false };
+    QMutex m_dispatchMutex;
+    QHash<QString, Dispatch> m_dispatched;
+};
+
+#endif // LATENCYRECORDER_H
@@ -1,11 +1,15 @@
 // src/main.cpp
 #include "main.h"
+#include "indexadvisor.h"
 #include "version.h" // 增加版本信息
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 
 #include <QCoreApplication>
 #include <QDebug>
 #include <QDir>
+#include <QFile>
 #include <QScxmlStateMachine>
 #include <QTextStream>
 #include <QTimer>
@@ -30,6 +34,21 @@ DatabaseTest::DatabaseTest(const QString& dbFile, QObject* parent)
 
 DatabaseTest::~DatabaseTest()
 {
+    // 请求会读取处理器，先停网络服务；分发器和推送随数据库线程结束一并销毁
+    m_grpcServer.reset();
+    if (m_eventHub) {
+        m_eventHub->disconnectAll();
+    }
+    m_httpServer.reset();
+    m_restApi.reset();
+    if (m_eventHub) {
+        m_eventHub->deleteLater();
+        m_eventHub = nullptr;
+    }
+    if (m_dispatcher) {
+        m_dispatcher->deleteLater();
+        m_dispatcher = nullptr;
+    }
     if (m_dbThread) {
         m_dbThread->shutdown();
     }
@@ -41,6 +60,22 @@ void DatabaseTest::startTest()
     qDebug() << "数据库文件:" << (m_dbThread->handler() ? "已设置" : "未设置");
     qDebug() << "初始化数据库操作线程...";
 
+    // 邮箱预检：重复邮箱直接返回 DUPLICATE_EMAIL，不触发唯一约束异常
+    m_dbThread->handler()->setEmailFilterEnabled(true);
+
+    SQLite3Handler* handler = m_dbThread->handler();
+    configureTracing();
+    configureQueryProfiler();
+    configureWorkloadCapture();
+    m_dispatcher = new OperationDispatcher(handler);
+    m_dispatcher->moveToThread(handler->thread());
+    // WebSocket 推送：操作完成与 users/products 的行级变更
+    handler->setChangeEventsEnabled(true);
+    m_eventHub = new EventHub(handler);
+    m_eventHub->moveToThread(handler->thread());
+    startHttpServer();
+    startGrpcServer();
+
     if (m_dbThread->initialize()) {
         m_dbThread->start();
     } else {
@@ -49,6 +84,141 @@ void DatabaseTest::startTest()
     }
 }
 
+// REST 接口与 Prometheus 指标：端口取自 QT_APP_HTTP_PORT（默认 9464，0 表示不启动），
+// IO 线程数取自 QT_APP_HTTP_THREADS（默认 2）。
+// 写接口与 /debug 路由都没有鉴权，默认只监听 127.0.0.1；需要对外时显式设置 QT_APP_HTTP_HOST（例如 0.0.0.0）
+void DatabaseTest::startHttpServer()
+{
+    bool ok = false;
+    int port = qEnvironmentVariableIntValue("QT_APP_HTTP_PORT", &ok);
+    if (!ok) {
+        port = 9464;
+    }
+    if (port <= 0 || port > 65535) {
+        qDebug() << "HTTP 服务未启用";
+        return;
+    }
+
+    HttpServerOptions options;
+    options.ioThreads = qEnvironmentVariableIntValue("QT_APP_HTTP_THREADS", &ok);
+    if (!ok || options.ioThreads <= 0) {
+        options.ioThreads = 2;
+    }
+
+    QString host = qEnvironmentVariable("QT_APP_HTTP_HOST");
+    if (host.isEmpty()) {
+        host = "127.0.0.1";
+    }
+
+    m_restApi = std::make_unique<RestApi>(m_dispatcher);
+    m_httpServer = std::make_unique<HttpServer>(static_cast<quint16>(port), host, options);
+    MetricsExporter(m_dbThread->handler()).registerRoute(*m_httpServer);
+    MetricsExporter(m_dbThread->handler()).registerQueryRoute(*m_httpServer);
+    MetricsExporter::registerTraceRoutes(*m_httpServer, m_dbThread->handler()->traceRecorder());
+    m_restApi->registerRoutes(*m_httpServer);
+    m_eventHub->registerRoutes(*m_httpServer);
+    if (m_httpServer->start()) {
+        qDebug() << "HTTP 监听地址:" << host << "端口:" << port;
+        qDebug() << "REST 接口: http://localhost:" << port << "/api/users, /api/products";
+        qDebug() << "事件推送: ws://localhost:" << port << "/ws/events";
+        qDebug() << "Prometheus 指标: http://localhost:" << port << "/metrics";
+        qDebug() << "链路追踪: http://localhost:" << port << "/debug/trace";
+        qDebug() << "语句剖析: http://localhost:" << port << "/debug/queries";
+    } else {
+        m_httpServer.reset();
+    }
+}
+
+// 链路追踪：QT_APP_TRACE=1 时启动即开启记录（也可经 POST /debug/trace?enabled=1 随时开启）；
+// QT_APP_TRACE_SLOW_MS 设置慢操作阈值，超过时把该操作的时间线写到 traces/ 目录
+void DatabaseTest::configureTracing()
+{
+    TraceRecorder* trace = m_dbThread->handler()->traceRecorder();
+    trace->setEnabled(qEnvironmentVariableIntValue("QT_APP_TRACE") == 1);
+
+    bool ok = false;
+    const int slowMs = qEnvironmentVariableIntValue("QT_APP_TRACE_SLOW_MS", &ok);
+    if (ok && slowMs > 0) {
+        const QString directory = QDir::current().filePath("traces");
+        trace->setSlowOperationTrigger(static_cast<qint64>(slowMs) * 1000, directory);
+        qDebug() << "慢操作 trace 阈值:" << slowMs << "ms，输出目录:" << directory;
+    }
+}
+
+// 语句剖析与慢查询日志：QT_APP_SLOW_QUERY_MS 为慢查询阈值（默认 100，0 表示不启用），
+// 日志写在数据库文件旁的 <数据库文件>-slowquery.log
+void DatabaseTest::configureQueryProfiler()
+{
+    bool ok = false;
+    int slowMs = qEnvironmentVariableIntValue("QT_APP_SLOW_QUERY_MS", &ok);
+    if (!ok) {
+        slowMs = 100;
+    }
+    QueryProfilerPolicy policy;
+    policy.enabled = slowMs > 0;
+    policy.slowThresholdUs = static_cast<qint64>(slowMs) * 1000;
+    m_dbThread->handler()->setQueryProfilerPolicy(policy);
+}
+
+// 工作负载录制：QT_APP_CAPTURE 为录制文件路径（不设置则不录制），QT_APP_CAPTURE_MAX_MB 为大小上限（默认 256）。
+// 连接数据库前把数据库文件复制为 <录制文件>.db，作为回放（qt_app_replay）的起始快照
+void DatabaseTest::configureWorkloadCapture()
+{
+    const QString captureFile = qEnvironmentVariable("QT_APP_CAPTURE");
+    if (captureFile.isEmpty()) {
+        return;
+    }
+    bool ok = false;
+    int maxMb = qEnvironmentVariableIntValue("QT_APP_CAPTURE_MAX_MB", &ok);
+    if (!ok || maxMb <= 0) {
+        maxMb = 256;
+    }
+
+    SQLite3Handler* handler = m_dbThread->handler();
+    const QString dbFile = handler->databaseFile();
+    const QString snapshot = captureFile + ".db";
+    if (QFile::exists(dbFile)) {
+        QFile::remove(snapshot);
+        QFile::remove(snapshot + "-wal");
+        if (!QFile::copy(dbFile, snapshot)
+            || (QFile::exists(dbFile + "-wal") && !QFile::copy(dbFile + "-wal", snapshot + "-wal"))) {
+            qWarning() << "复制数据库快照失败:" << snapshot;
+        }
+    }
+
+    QString error;
+    if (!handler->workloadCapture()->start(captureFile, static_cast<qint64>(maxMb) * 1024 * 1024, error)) {
+        qWarning() << error;
+        return;
+    }
+    qDebug() << "工作负载录制:" << captureFile << "数据库快照:" << snapshot;
+}
+
+// gRPC 服务：端口取自 QT_APP_GRPC_PORT（默认 50051，0 表示不启动）。
+// 使用明文凭据且写接口无鉴权，默认只监听 127.0.0.1；需要对外时显式设置 QT_APP_GRPC_HOST（例如 0.0.0.0）
+void DatabaseTest::startGrpcServer()
+{
+    bool ok = false;
+    int port = qEnvironmentVariableIntValue("QT_APP_GRPC_PORT", &ok);
+    if (!ok) {
+        port = 50051;
+    }
+    if (port <= 0 || port > 65535) {
+        qDebug() << "gRPC 服务未启用";
+        return;
+    }
+
+    QString host = qEnvironmentVariable("QT_APP_GRPC_HOST");
+    if (host.isEmpty()) {
+        host = "127.0.0.1";
+    }
+
+    m_grpcServer = std::make_unique<GrpcServer>(m_dispatcher);
+    if (!m_grpcServer->start(QString("%1:%2").arg(host).arg(port))) {
+        m_grpcServer.reset();
+    }
+}
+
 void DatabaseTest::onConnected()
 {
     static bool firstConnection = true;
@@ -82,6 +252,11 @@ void DatabaseTest::cleanupTestData()
 
 void DatabaseTest::onOperationCompleted(const QString& operationId, bool success, const QVariant& result)
 {
+    // 测试结束后的完成信号来自 REST 请求，不再计数和打印
+    if (m_testsFinished) {
+        return;
+    }
+    TraceRecorder::Span span(m_dbThread->handler()->traceRecorder(), "consumer", operationId);
     m_completedOperations++;
 
     QString opType = "unknown";
@@ -99,7 +274,10 @@ void DatabaseTest::onOperationCompleted(const QString& operationId, bool success
         QString errorStr = result.toString();
         qDebug() << "✗ 操作失败:" << operationId << "类型:" << opType;
 
-        if (errorStr.contains("UNIQUE constraint failed")) {
+        const QString errorCode = result.toMap().value("error_code").toString();
+        if (errorCode == OperationError::kDuplicateEmail) {
+            qDebug() << "  错误原因: 邮箱已存在 -" << result.toMap().value("email").toString();
+        } else if (errorStr.contains("UNIQUE constraint failed")) {
             qDebug() << "  错误原因: 数据重复（唯一约束冲突）";
         } else if (errorStr.contains("NOT NULL constraint failed")) {
             qDebug() << "  错误原因: 缺少必需数据（非空约束冲突）";
@@ -123,6 +301,24 @@ void DatabaseTest::onOperationCompleted(const QString& operationId, bool success
             qDebug() << "总成功操作:" << m_completedOperations << "/" << m_totalOperations;
             qDebug() << "数据库状态:" << m_dbThread->currentState();
             qDebug() << "队列大小:" << m_dbThread->queueSize();
+
+            // 各操作类型的分阶段延迟
+            const QVariantMap latency = m_dbThread->handler()->latencySnapshot();
+            for (auto it = latency.cbegin(); it != latency.cend(); ++it) {
+                const QVariantMap stages = it.value().toMap();
+                for (auto stage = stages.cbegin(); stage != stages.cend(); ++stage) {
+                    const QVariantMap summary = stage.value().toMap();
+                    qDebug() << "  延迟" << it.key() << stage.key() << "次数:" << summary["count"].toULongLong()
+                             << "p50:" << summary["p50_us"].toDouble() << "us"
+                             << "p99:" << summary["p99_us"].toDouble() << "us"
+                             << "p999:" << summary["p999_us"].toDouble() << "us";
+                }
+            }
+            m_testsFinished = true;
+            if (m_serveMode) {
+                qDebug() << "继续提供 HTTP 服务，Ctrl+C 退出";
+                return;
+            }
             qDebug() << "3秒后退出程序...";
             QTimer::singleShot(3000, QCoreApplication::instance(), &QCoreApplication::quit);
         }
@@ -147,7 +343,10 @@ void DatabaseTest::performBasicTests()
         "zhangsan_" + timestamp + "@example.com", 25);
     QString user2 = m_dbThread->handler()->addUser("李四",
         "lisi_" + timestamp + "@example.com", 30);
-    m_totalOperations += 2;
+    // 重复邮箱，预期失败并返回 DUPLICATE_EMAIL
+    QString duplicateUser = m_dbThread->handler()->addUser("张三(重复)",
+        "zhangsan_" + timestamp + "@example.com", 26);
+    m_totalOperations += 3;
 
     // 2. 添加产品（使用唯一名称）
     qDebug() << "2. 添加测试产品...";
@@ -329,8 +528,53 @@ void DatabaseTest::displayResults(const QString& operationId, const QVariant& re
              << "result:" << result;
 }
 
+// 离线索引顾问：advise-indexes <工作负载文件> [--db <数据库文件>] [--top N]
+// 工作负载可以是 GET /debug/queries?limit=512 的输出，也可以是慢查询日志
+static int adviseIndexes(int argc, char* argv[])
+{
+    QString workloadFile;
+    QString dbFile = "test_database.db";
+    int top = 10;
+    for (int i = 2; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--db" && i + 1 < argc) {
+            dbFile = QString::fromLocal8Bit(argv[++i]);
+        } else if (arg == "--top" && i + 1 < argc) {
+            top = std::max(1, std::atoi(argv[++i]));
+        } else if (workloadFile.isEmpty() && arg.rfind("--", 0) != 0) {
+            workloadFile = QString::fromLocal8Bit(argv[i]);
+        } else {
+            workloadFile.clear();
+            break;
+        }
+    }
+    if (workloadFile.isEmpty()) {
+        std::cerr << "Usage: " << argv[0] << " advise-indexes <workload> [--db FILE] [--top N]" << std::endl;
+        return 2;
+    }
+
+    QList<WorkloadQuery> workload;
+    QString error;
+    if (!IndexAdvisor::loadWorkload(workloadFile, workload, error)) {
+        std::cerr << error.toStdString() << std::endl;
+        return 1;
+    }
+    IndexAdvisor advisor(dbFile);
+    if (!advisor.open(error)) {
+        std::cerr << error.toStdString() << std::endl;
+        return 1;
+    }
+    const QList<IndexRecommendation> recommendations = advisor.analyze(workload, top);
+    std::cout << IndexAdvisor::formatReport(recommendations, advisor.warnings()).toStdString();
+    return 0;
+}
+
 int main(int argc, char* argv[])
 {
+    if (argc >= 2 && std::string(argv[1]) == "advise-indexes") {
+        return adviseIndexes(argc, argv);
+    }
+
     // 增加版本信息
     if (argc == 2) {
         std::string arg = argv[1];
@@ -357,6 +601,9 @@ int main(int argc, char* argv[])
             std::cout << "  --version-short         Print version number only" << std::endl;
             std::cout << "  --git-info              Print Git information only" << std::endl;
             std::cout << "  --build-time            Print build timestamp only" << std::endl;
+            std::cout << "  --serve                 Keep serving HTTP after the self-test" << std::endl;
+            std::cout << "  advise-indexes <workload> [--db FILE] [--top N]" << std::endl;
+            std::cout << "                          Suggest indexes for a recorded workload" << std::endl;
             std::cout << "  -h, --help              Print this help message" << std::endl;
             return 0;
         }
@@ -384,6 +631,7 @@ int main(int argc, char* argv[])
     QString dbFile = "test_database.db";
 
     DatabaseTest test(dbFile);
+    test.setServeMode(QCoreApplication::arguments().contains("--serve"));
 
     QTimer::singleShot(0, &test, &DatabaseTest::startTest);
 
@@ -3,9 +3,16 @@
 #define MAIN_H
 
 #include "dboperatethread.h"
+#include "eventhub.h"
+#include "httpserver.h"
+#include "grpcserver.h"
+#include "metricsexporter.h"
+#include "operationdispatcher.h"
+#include "restapi.h"
 #include <QCoreApplication>
 #include <QObject>
 #include <QVariant>
+#include <memory>
 
 class DatabaseTest : public QObject {
     Q_OBJECT
@@ -15,6 +22,8 @@ public:
     ~DatabaseTest();
 
     void startTest();
+    // 测试完成后不退出，继续提供 HTTP 接口
+    void setServeMode(bool serve) { m_serveMode = serve; }
 
 private slots:
     void onConnected();
@@ -26,11 +35,23 @@ private:
     void performBasicTests();
     void performAdvancedTests();
     void displayResults(const QString& operationId, const QVariant& result);
+    void configureTracing();
+    void configureQueryProfiler();
+    void configureWorkloadCapture();
+    void startHttpServer();
+    void startGrpcServer();
 
     DBOperateThread* m_dbThread;
+    OperationDispatcher* m_dispatcher = nullptr; // 位于数据库线程
+    EventHub* m_eventHub = nullptr; // 位于数据库线程
+    std::unique_ptr<RestApi> m_restApi;
+    std::unique_ptr<HttpServer> m_httpServer;
+    std::unique_ptr<GrpcServer> m_grpcServer;
     int m_totalOperations;
     int m_completedOperations;
     bool m_basicTestsDone;
+    bool m_testsFinished = false;
+    bool m_serveMode = false;
 };
 
 #endif // MAIN_H
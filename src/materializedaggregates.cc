@@ -0,0 +1,373 @@
+// materializedaggregates.cc
+#include "materializedaggregates.h"
+#include "sqlite3statemachine.h"
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QRegularExpression>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+const char* kTriggerPrefix = "mat_agg_";
+
+QString literal(double value)
+{
+    return QString::number(value, 'g', 17);
+}
+
+} // namespace
+
+MaterializedAggregates::MaterializedAggregates(SQLite3StateMachine* stateMachine, QObject* parent)
+    : QObject(parent)
+    , m_stateMachine(stateMachine)
+{
+}
+
+QList<AggregateDefinition> MaterializedAggregates::defaultDefinitions(const QList<double>& priceBuckets)
+{
+    QList<AggregateDefinition> definitions {
+        { "users.count", "users", "1", {} },
+        { "products.count", "products", "1", {} },
+        { "products.stock_total", "products", "COALESCE({row}.stock, 0)", { "stock" } },
+    };
+
+    for (int i = 0; i < priceBuckets.size(); ++i) {
+        const double low = priceBuckets[i];
+        const double high = i + 1 < priceBuckets.size() ? priceBuckets[i + 1] : kUnbounded;
+
+        QString condition = QString("{row}.price >= %1").arg(literal(low));
+        if (std::isfinite(high)) {
+            condition += QString(" AND {row}.price < %1").arg(literal(high));
+        }
+        definitions.append({ priceBucketName(low, high), "products",
+            QString("CASE WHEN %1 THEN {row}.price * COALESCE({row}.stock, 0) ELSE 0 END").arg(condition),
+            { "price", "stock" } });
+    }
+    return definitions;
+}
+
+QString MaterializedAggregates::priceBucketName(double minPrice, double maxPrice)
+{
+    return QString("products.stock_value.price_%1_%2")
+        .arg(literal(minPrice), std::isfinite(maxPrice) ? literal(maxPrice) : QString("inf"));
+}
+
+bool MaterializedAggregates::registerAggregate(const AggregateDefinition& definition)
+{
+    // 名称会直接拼进触发器，只允许安全字符
+    static const QRegularExpression namePattern("^[A-Za-z0-9_.\\-]+$");
+    static const QRegularExpression tablePattern("^[A-Za-z_][A-Za-z0-9_]*$");
+    if (!namePattern.match(definition.name).hasMatch() || !tablePattern.match(definition.table).hasMatch()
+        || definition.rowExpression.isEmpty()) {
+        qWarning() << "物化聚合定义无效:" << definition.name;
+        return false;
+    }
+
+    for (const AggregateDefinition& existing : m_definitions) {
+        if (existing.name == definition.name) {
+            qWarning() << "物化聚合重复注册:" << definition.name;
+            return false;
+        }
+    }
+
+    m_definitions.append(definition);
+    m_tables.insert(definition.table);
+    return true;
+}
+
+bool MaterializedAggregates::install()
+{
+    soci::session* session = m_stateMachine->getSession();
+    if (!session) {
+        return false;
+    }
+
+    const QMap<QString, QString> triggers = buildTriggers();
+
+    try {
+        *session << R"(CREATE TABLE IF NOT EXISTS materialized_aggregates (
+            name TEXT PRIMARY KEY,
+            value NUMERIC NOT NULL DEFAULT 0
+        ))";
+
+        // 触发器和聚合行都与当前定义一致时，已有的值由触发器逐事务维护，不需要重算
+        QMap<QString, QString> installed;
+        {
+            std::string name;
+            std::string sql;
+            soci::statement st = (session->prepare << "SELECT name, sql FROM sqlite_master"
+                                                      " WHERE type = 'trigger' AND name GLOB 'mat_agg_*'");
+            st.exchange(soci::into(name));
+            st.exchange(soci::into(sql));
+            st.define_and_bind();
+            st.execute(false);
+            while (st.fetch()) {
+                installed.insert(QString::fromStdString(name), QString::fromStdString(sql));
+            }
+        }
+
+        QSet<QString> stored;
+        {
+            std::string name;
+            soci::statement st = (session->prepare << "SELECT name FROM materialized_aggregates");
+            st.exchange(soci::into(name));
+            st.define_and_bind();
+            st.execute(false);
+            while (st.fetch()) {
+                stored.insert(QString::fromStdString(name));
+            }
+        }
+
+        QSet<QString> registered;
+        for (const AggregateDefinition& definition : m_definitions) {
+            registered.insert(definition.name);
+        }
+
+        if (installed != triggers || stored != registered) {
+            QJsonArray names;
+            for (const QString& name : registered) {
+                names.append(name);
+            }
+
+            soci::transaction tr(*session);
+            for (auto it = installed.cbegin(); it != installed.cend(); ++it) {
+                *session << "DROP TRIGGER IF EXISTS " + it.key().toStdString();
+            }
+            for (const QString& sql : triggers) {
+                *session << sql.toStdString();
+            }
+
+            const std::string namesJson = QJsonDocument(names).toJson(QJsonDocument::Compact).toStdString();
+            *session << "DELETE FROM materialized_aggregates WHERE name NOT IN (SELECT value FROM json_each(:names))",
+                soci::use(namesJson, "names");
+
+            for (const AggregateDefinition& definition : m_definitions) {
+                const std::string name = definition.name.toStdString();
+                *session << "INSERT INTO materialized_aggregates (name, value) VALUES (:name, ("
+                        + recomputeQuery(definition).toStdString()
+                        + ")) ON CONFLICT(name) DO UPDATE SET value = excluded.value",
+                    soci::use(name, "name");
+            }
+            tr.commit();
+
+            m_rebuilds.fetch_add(1, std::memory_order_relaxed);
+            qDebug() << "物化聚合已重建，触发器数:" << triggers.size() << "聚合数:" << m_definitions.size();
+        }
+    } catch (const std::exception& e) {
+        qWarning() << "物化聚合安装失败:" << e.what();
+        return false;
+    }
+
+    return refresh();
+}
+
+bool MaterializedAggregates::refresh()
+{
+    soci::session* session = m_stateMachine->getSession();
+    if (!session) {
+        return false;
+    }
+
+    QHash<QString, double> values;
+    try {
+        std::string name;
+        double value = 0.0;
+        soci::statement st = (session->prepare << "SELECT name, value FROM materialized_aggregates");
+        st.exchange(soci::into(name));
+        st.exchange(soci::into(value));
+        st.define_and_bind();
+        st.execute(false);
+        while (st.fetch()) {
+            values.insert(QString::fromStdString(name), value);
+        }
+    } catch (const std::exception& e) {
+        qWarning() << "物化聚合读取失败:" << e.what();
+        return false;
+    }
+
+    {
+        QWriteLocker locker(&m_lock);
+        m_values = std::move(values);
+    }
+    m_ready.store(true, std::memory_order_release);
+    m_refreshes.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void MaterializedAggregates::removeTriggers(SQLite3StateMachine* stateMachine)
+{
+    soci::session* session = stateMachine->getSession();
+    if (!session) {
+        return;
+    }
+
+    try {
+        std::vector<std::string> names;
+        {
+            std::string name;
+            soci::statement st = (session->prepare << "SELECT name FROM sqlite_master"
+                                                      " WHERE type = 'trigger' AND name GLOB 'mat_agg_*'");
+            st.exchange(soci::into(name));
+            st.define_and_bind();
+            st.execute(false);
+            while (st.fetch()) {
+                names.push_back(name);
+            }
+        }
+        for (const std::string& name : names) {
+            *session << "DROP TRIGGER IF EXISTS " + name;
+        }
+        if (!names.empty()) {
+            qDebug() << "已移除物化聚合触发器:" << names.size();
+        }
+    } catch (const std::exception& e) {
+        qWarning() << "移除物化聚合触发器失败:" << e.what();
+    }
+}
+
+bool MaterializedAggregates::value(const QString& name, double& value) const
+{
+    m_reads.fetch_add(1, std::memory_order_relaxed);
+    QReadLocker locker(&m_lock);
+    auto it = m_values.constFind(name);
+    if (it == m_values.constEnd()) {
+        return false;
+    }
+    value = *it;
+    return true;
+}
+
+QVariantMap MaterializedAggregates::values() const
+{
+    m_reads.fetch_add(1, std::memory_order_relaxed);
+    QVariantMap result;
+    QReadLocker locker(&m_lock);
+    for (auto it = m_values.cbegin(); it != m_values.cend(); ++it) {
+        result.insert(it.key(), it.value());
+    }
+    return result;
+}
+
+QVariantMap MaterializedAggregates::metrics() const
+{
+    QVariantMap result;
+    {
+        QReadLocker locker(&m_lock);
+        result["aggregates"] = static_cast<qint64>(m_values.size());
+    }
+    result["ready"] = isReady();
+    result["reads"] = static_cast<quint64>(m_reads.load());
+    result["refreshes"] = static_cast<quint64>(m_refreshes.load());
+    result["rebuilds"] = static_cast<quint64>(m_rebuilds.load());
+    result["repairs"] = static_cast<quint64>(m_repairs.load());
+    return result;
+}
+
+QMap<QString, QString> MaterializedAggregates::recomputeQueries() const
+{
+    QMap<QString, QString> queries;
+    for (const AggregateDefinition& definition : m_definitions) {
+        queries.insert(definition.name, recomputeQuery(definition));
+    }
+    return queries;
+}
+
+void MaterializedAggregates::onTableChanged(const QString& table, const QList<ChangeTracker::RowChange>& /*changes*/)
+{
+    // 聚合值已随写入事务提交，这里只把快照同步到内存
+    if (m_tables.contains(table)) {
+        refresh();
+    }
+}
+
+void MaterializedAggregates::repair(const QStringList& names)
+{
+    soci::session* session = m_stateMachine->getSession();
+    if (!session) {
+        return;
+    }
+
+    int repaired = 0;
+    try {
+        soci::transaction tr(*session);
+        for (const AggregateDefinition& definition : m_definitions) {
+            if (!names.contains(definition.name)) {
+                continue;
+            }
+            const std::string name = definition.name.toStdString();
+            *session << "INSERT INTO materialized_aggregates (name, value) VALUES (:name, ("
+                    + recomputeQuery(definition).toStdString()
+                    + ")) ON CONFLICT(name) DO UPDATE SET value = excluded.value",
+                soci::use(name, "name");
+            ++repaired;
+        }
+        tr.commit();
+    } catch (const std::exception& e) {
+        qWarning() << "物化聚合修复失败:" << e.what();
+        return;
+    }
+
+    m_repairs.fetch_add(repaired, std::memory_order_relaxed);
+    qWarning() << "物化聚合与全量重算不一致，已修复:" << names;
+    refresh();
+}
+
+QString MaterializedAggregates::recomputeQuery(const AggregateDefinition& definition) const
+{
+    QString expression = definition.rowExpression;
+    expression.replace("{row}", definition.table);
+    return QString("SELECT COALESCE(SUM(%1), 0) FROM %2").arg(expression, definition.table);
+}
+
+QMap<QString, QString> MaterializedAggregates::buildTriggers() const
+{
+    // 每张表每种操作一个触发器；贡献为 0 的聚合不写，避免无关分桶产生多余的写入
+    auto apply = [](const AggregateDefinition& definition, const QString& delta) {
+        return QString("UPDATE materialized_aggregates SET value = value + (%1) WHERE name = '%2' AND (%1) <> 0;\n")
+            .arg(delta, definition.name);
+    };
+    auto rowValue = [](const AggregateDefinition& definition, const char* row) {
+        QString expression = definition.rowExpression;
+        return expression.replace("{row}", row);
+    };
+
+    QMap<QString, QString> triggers;
+    for (const QString& table : m_tables) {
+        QString onInsert;
+        QString onDelete;
+        QString onUpdate;
+        QStringList updateColumns;
+
+        for (const AggregateDefinition& definition : m_definitions) {
+            if (definition.table != table) {
+                continue;
+            }
+            onInsert += apply(definition, rowValue(definition, "NEW"));
+            onDelete += apply(definition, QString("-(%1)").arg(rowValue(definition, "OLD")));
+            if (!definition.columns.isEmpty()) {
+                onUpdate += apply(definition, QString("(%1) - (%2)").arg(rowValue(definition, "NEW"), rowValue(definition, "OLD")));
+                for (const QString& column : definition.columns) {
+                    if (!updateColumns.contains(column)) {
+                        updateColumns.append(column);
+                    }
+                }
+            }
+        }
+
+        // 注意：INSERT OR REPLACE 删除冲突行时默认不触发 DELETE 触发器（recursive_triggers 关闭），
+        // 这类写入造成的偏差由后台校验发现并修复
+        const QString prefix = kTriggerPrefix + table;
+        triggers.insert(prefix + "_ai",
+            QString("CREATE TRIGGER %1_ai AFTER INSERT ON %2 BEGIN\n%3END").arg(prefix, table, onInsert));
+        triggers.insert(prefix + "_ad",
+            QString("CREATE TRIGGER %1_ad AFTER DELETE ON %2 BEGIN\n%3END").arg(prefix, table, onDelete));
+        if (!onUpdate.isEmpty()) {
+            triggers.insert(prefix + "_au",
+                QString("CREATE TRIGGER %1_au AFTER UPDATE OF %2 ON %3 BEGIN\n%4END")
+                    .arg(prefix, updateColumns.join(", "), table, onUpdate));
+        }
+    }
+    return triggers;
+}
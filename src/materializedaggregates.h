@@ -0,0 +1,92 @@
+// materializedaggregates.h
+#ifndef MATERIALIZEDAGGREGATES_H
+#define MATERIALIZEDAGGREGATES_H
+
+#include "changetracker.h"
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QObject>
+#include <QReadWriteLock>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QVariantMap>
+#include <atomic>
+#include <limits>
+
+class SQLite3StateMachine;
+
+// 物化聚合策略
+struct MaterializedAggregatePolicy {
+    bool enabled = false;
+    QList<double> priceBuckets { 0, 10, 50, 100, 500, 1000 }; // 库存价值分桶的下边界（升序），最后一桶不设上限
+    int verifyIntervalMs = 10 * 60 * 1000; // 后台全量重算校验周期，<= 0 表示不校验
+};
+
+// 聚合定义：整张表上 SUM(rowExpression)
+// rowExpression 中用 {row} 指代行，触发器里替换为 NEW/OLD，全量重算时替换为表名，
+// 两条路径共用同一个表达式，不会出现定义不一致
+struct AggregateDefinition {
+    QString name; // 只能包含字母、数字、'_'、'.'、'-'
+    QString table;
+    QString rowExpression;
+    QStringList columns; // 影响该聚合的列，UPDATE 只改动其他列时不触发；为空表示只随插入/删除变化
+};
+
+// 增量维护的物化聚合
+// 每个聚合是 materialized_aggregates 中的一行，由 users/products 上的触发器在写入所在事务内增减，
+// 与数据同时提交或回滚；内存快照在提交后（ChangeTracker 分发时）刷新，读取为 O(1)。
+// 库存热点计数开启时，尚未回写的库存增量不计入。
+class MaterializedAggregates : public QObject {
+    Q_OBJECT
+
+public:
+    static constexpr double kUnbounded = std::numeric_limits<double>::infinity();
+
+    explicit MaterializedAggregates(SQLite3StateMachine* stateMachine, QObject* parent = nullptr);
+
+    // 内置聚合：用户数、产品数、库存总量、按价格分桶的库存价值
+    static QList<AggregateDefinition> defaultDefinitions(const QList<double>& priceBuckets);
+    static QString priceBucketName(double minPrice, double maxPrice);
+
+    // 以下在数据库线程调用
+    bool registerAggregate(const AggregateDefinition& definition);
+    // 创建表与触发器；定义有变化时在同一事务中重建触发器并全量重算
+    bool install();
+    bool refresh();
+    // 删除所有物化聚合触发器（关闭功能后避免残留触发器继续写入）
+    static void removeTriggers(SQLite3StateMachine* stateMachine);
+
+    // 任意线程
+    bool isReady() const { return m_ready.load(std::memory_order_acquire); }
+    bool value(const QString& name, double& value) const;
+    QVariantMap values() const;
+    QVariantMap metrics() const;
+    // 聚合名 -> 全量重算语句（供校验器在独立连接上执行）
+    QMap<QString, QString> recomputeQueries() const;
+
+public slots:
+    void onTableChanged(const QString& table, const QList<ChangeTracker::RowChange>& changes);
+    // 在写连接上重新计算并覆盖指定聚合
+    void repair(const QStringList& names);
+
+private:
+    QString recomputeQuery(const AggregateDefinition& definition) const;
+    QMap<QString, QString> buildTriggers() const;
+
+    SQLite3StateMachine* m_stateMachine;
+    QList<AggregateDefinition> m_definitions;
+    QSet<QString> m_tables;
+
+    mutable QReadWriteLock m_lock;
+    QHash<QString, double> m_values;
+
+    std::atomic<bool> m_ready { false };
+    mutable std::atomic<quint64> m_reads { 0 };
+    std::atomic<quint64> m_refreshes { 0 };
+    std::atomic<quint64> m_rebuilds { 0 };
+    std::atomic<quint64> m_repairs { 0 };
+};
+
+#endif // MATERIALIZEDAGGREGATES_H
@@ -0,0 +1,196 @@
+// metricsexporter.cc
+#include "metricsexporter.h"
+#include "httpserver.h"
+#include "latencyrecorder.h"
+#include "sqlite3handler.h"
+#include "tracerecorder.h"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+
+namespace {
+
+// 直方图的 le 边界（秒）；按内部分桶的上界累计，跨越边界的那个桶不计入，偏差在分桶精度以内
+const double kLatencyBoundsSeconds[] = {
+    0.00005, 0.0001, 0.00025, 0.0005,
+    0.001, 0.0025, 0.005, 0.01, 0.025, 0.05,
+    0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0
+};
+
+QByteArray number(double value)
+{
+    return QByteArray::number(value, 'g', 12);
+}
+
+QByteArray escapeLabel(const QString& value)
+{
+    QByteArray escaped;
+    for (char c : value.toUtf8()) {
+        if (c == '\\' || c == '"') {
+            escaped.append('\\').append(c);
+        } else if (c == '\n') {
+            escaped.append("\\n");
+        } else {
+            escaped.append(c);
+        }
+    }
+    return escaped;
+}
+
+void header(QByteArray& out, const char* name, const char* type, const char* help)
+{
+    out.append("# HELP ").append(name).append(' ').append(help).append('\n');
+    out.append("# TYPE ").append(name).append(' ').append(type).append('\n');
+}
+
+void sample(QByteArray& out, const char* name, const QByteArray& labels, const QByteArray& value)
+{
+    out.append(name);
+    if (!labels.isEmpty()) {
+        out.append('{').append(labels).append('}');
+    }
+    out.append(' ').append(value).append('\n');
+}
+
+} // namespace
+
+MetricsExporter::MetricsExporter(const SQLite3Handler* handler)
+    : m_handler(handler)
+{
+}
+
+const char* MetricsExporter::contentType()
+{
+    return "text/plain; version=0.0.4; charset=utf-8";
+}
+
+void MetricsExporter::registerRoute(HttpServer& server, const std::string& path) const
+{
+    const MetricsExporter exporter = *this;
+    server.addRoute(path, drogon::Get,
+        [exporter](const drogon::HttpRequestPtr&, HttpServer::Callback&& callback) {
+            const QByteArray body = exporter.render();
+            auto response = drogon::HttpResponse::newHttpResponse();
+            response->setContentTypeString(contentType());
+            response->setBody(body.toStdString());
+            callback(response);
+        });
+}
+
+void MetricsExporter::registerTraceRoutes(HttpServer& server, TraceRecorder* recorder)
+{
+    server.addRoute("/debug/trace", drogon::Get,
+        [recorder](const drogon::HttpRequestPtr& request, HttpServer::Callback&& callback) {
+            const QString operationId = QString::fromStdString(request->getParameter("op"));
+            auto response = drogon::HttpResponse::newHttpResponse();
+            response->setContentTypeCode(drogon::CT_APPLICATION_JSON);
+            response->setBody(recorder->exportChromeTrace(operationId).toStdString());
+            callback(response);
+        });
+    server.addRoute("/debug/trace", drogon::Post,
+        [recorder](const drogon::HttpRequestPtr& request, HttpServer::Callback&& callback) {
+            const std::string enabled = request->getParameter("enabled");
+            if (!enabled.empty()) {
+                recorder->setEnabled(enabled == "1" || enabled == "true");
+            }
+            auto response = drogon::HttpResponse::newHttpResponse();
+            response->setContentTypeCode(drogon::CT_APPLICATION_JSON);
+            response->setBody(QJsonDocument(QJsonObject::fromVariantMap(recorder->metrics()))
+                                  .toJson(QJsonDocument::Compact)
+                                  .toStdString());
+            callback(response);
+        });
+}
+
+void MetricsExporter::registerQueryRoute(HttpServer& server) const
+{
+    const SQLite3Handler* handler = m_handler;
+    server.addRoute("/debug/queries", drogon::Get,
+        [handler](const drogon::HttpRequestPtr& request, HttpServer::Callback&& callback) {
+            bool ok = false;
+            int limit = QString::fromStdString(request->getParameter("limit")).toInt(&ok);
+            if (!ok || limit <= 0) {
+                limit = 20;
+            }
+            QJsonObject body {
+                { "metrics", QJsonObject::fromVariantMap(handler->queryProfilerMetrics()) },
+                { "shapes", QJsonArray::fromVariantList(handler->queryShapes(limit)) },
+            };
+            auto response = drogon::HttpResponse::newHttpResponse();
+            response->setContentTypeCode(drogon::CT_APPLICATION_JSON);
+            response->setBody(QJsonDocument(body).toJson(QJsonDocument::Compact).toStdString());
+            callback(response);
+        });
+}
+
+QByteArray MetricsExporter::render() const
+{
+    QByteArray out;
+
+    header(out, "qt_app_queue_depth", "gauge", "Operations waiting in the queue.");
+    sample(out, "qt_app_queue_depth", {}, QByteArray::number(m_handler->queueSize()));
+
+    header(out, "qt_app_in_flight_operations", "gauge", "Operations queued or executing that have not completed yet.");
+    sample(out, "qt_app_in_flight_operations", {}, QByteArray::number(m_handler->inFlightOperations()));
+
+    header(out, "qt_app_state", "gauge", "Current state of the database state machine (sampled every second).");
+    const QString state = m_handler->sampledState();
+    for (const QString& known : SQLite3Handler::knownStates()) {
+        sample(out, "qt_app_state", "state=\"" + escapeLabel(known) + "\"", known == state ? "1" : "0");
+    }
+
+    // 每个完成的操作恰好记录一次执行阶段，用它的样本数作为吞吐计数
+    const QList<LatencyRecorder::HistogramSnapshot> histograms = m_handler->latencyRecorder().histograms();
+    QMap<QString, quint64> completed;
+    for (const auto& histogram : histograms) {
+        if (histogram.stage == LatencyRecorder::Execute) {
+            completed[histogram.operationType] += histogram.total;
+        }
+    }
+    header(out, "qt_app_operations_total", "counter", "Completed operations by type.");
+    for (auto it = completed.cbegin(); it != completed.cend(); ++it) {
+        sample(out, "qt_app_operations_total", "type=\"" + escapeLabel(it.key()) + "\"", QByteArray::number(it.value()));
+    }
+
+    header(out, "qt_app_operation_latency_seconds", "histogram", "Operation latency by type and stage.");
+    for (const auto& histogram : histograms) {
+        const QByteArray labels = "type=\"" + escapeLabel(histogram.operationType) + "\",stage=\""
+            + LatencyRecorder::stageName(histogram.stage) + "\"";
+        for (double bound : kLatencyBoundsSeconds) {
+            const auto count = histogram.countAtOrBelow(static_cast<uint64_t>(bound * 1e9));
+            sample(out, "qt_app_operation_latency_seconds_bucket", labels + ",le=\"" + number(bound) + "\"",
+                QByteArray::number(static_cast<quint64>(count)));
+        }
+        sample(out, "qt_app_operation_latency_seconds_bucket", labels + ",le=\"+Inf\"",
+            QByteArray::number(static_cast<quint64>(histogram.total)));
+        sample(out, "qt_app_operation_latency_seconds_sum", labels, number(histogram.sumNanos / 1e9));
+        sample(out, "qt_app_operation_latency_seconds_count", labels,
+            QByteArray::number(static_cast<quint64>(histogram.total)));
+    }
+
+    qint64 hits = 0;
+    qint64 misses = 0;
+    m_handler->sampledPageCache(hits, misses);
+    header(out, "qt_app_sqlite_page_cache_hits_total", "counter", "Page cache hits on the write connection since it was opened.");
+    sample(out, "qt_app_sqlite_page_cache_hits_total", {}, QByteArray::number(hits));
+    header(out, "qt_app_sqlite_page_cache_misses_total", "counter", "Page cache misses on the write connection since it was opened.");
+    sample(out, "qt_app_sqlite_page_cache_misses_total", {}, QByteArray::number(misses));
+    header(out, "qt_app_sqlite_page_cache_hit_ratio", "gauge", "Page cache hit ratio on the write connection.");
+    sample(out, "qt_app_sqlite_page_cache_hit_ratio", {}, number(hits + misses > 0 ? double(hits) / (hits + misses) : 0.0));
+
+    header(out, "qt_app_sqlite_wal_size_bytes", "gauge", "Size of the WAL file.");
+    sample(out, "qt_app_sqlite_wal_size_bytes", {}, QByteArray::number(m_handler->sampledWalSizeBytes()));
+
+    const QVariantMap profiler = m_handler->queryProfilerMetrics();
+    if (!profiler.isEmpty()) {
+        header(out, "qt_app_sqlite_statements_total", "counter", "Statements executed on the write connection.");
+        sample(out, "qt_app_sqlite_statements_total", {}, QByteArray::number(profiler.value("statements").toULongLong()));
+        header(out, "qt_app_sqlite_slow_statements_total", "counter", "Statements slower than the slow-query threshold.");
+        sample(out, "qt_app_sqlite_slow_statements_total", {}, QByteArray::number(profiler.value("slow").toULongLong()));
+        header(out, "qt_app_sqlite_slow_log_dropped_total", "counter", "Slow statements not logged because the log writer was backlogged.");
+        sample(out, "qt_app_sqlite_slow_log_dropped_total", {}, QByteArray::number(profiler.value("dropped").toULongLong()));
+    }
+
+    return out;
+}
@@ -0,0 +1,39 @@
+// metricsexporter.h
+#ifndef METRICSEXPORTER_H
+#define METRICSEXPORTER_H
+
+#include <QByteArray>
+#include <QString>
+#include <string>
+
+class HttpServer;
+class SQLite3Handler;
+class TraceRecorder;
+
+// Prometheus 文本格式（0.0.4）的指标导出
+// 抓取在 drogon 的 IO 线程中执行，只读取处理器提供的原子量和无锁直方图快照，
+// 不会进入数据库线程的事件循环，也不会获取它持有的任何锁
+class MetricsExporter {
+public:
+    explicit MetricsExporter(const SQLite3Handler* handler);
+
+    static const char* contentType();
+
+    // 在 server 上挂接 GET path，需在 server.start() 之前调用
+    void registerRoute(HttpServer& server, const std::string& path = "/metrics") const;
+
+    // 链路追踪的按需导出与开关：
+    //   GET  /debug/trace[?op=<操作ID>]  Chrome trace JSON（指定操作时只含该操作的时间窗）
+    //   POST /debug/trace?enabled=1|0   开启或关闭记录，返回记录器状态
+    static void registerTraceRoutes(HttpServer& server, TraceRecorder* recorder);
+
+    // 语句剖析：GET /debug/queries[?limit=N]  {metrics, shapes}，shapes 按总耗时降序
+    void registerQueryRoute(HttpServer& server) const;
+
+    QByteArray render() const;
+
+private:
+    const SQLite3Handler* m_handler;
+};
+
+#endif // METRICSEXPORTER_H
@@ -0,0 +1,99 @@
+// operationdispatcher.cc
+#include "operationdispatcher.h"
+#include "sqlite3handler.h"
+#include <QDebug>
+
+OperationDispatcher::OperationDispatcher(SQLite3Handler* handler, int maxOutstanding, QObject* parent)
+    : QObject(parent)
+    , m_handler(handler)
+    , m_maxOutstanding(maxOutstanding)
+{
+    connect(m_handler, &SQLite3Handler::operationCompleted, this, &OperationDispatcher::onOperationCompleted);
+}
+
+bool OperationDispatcher::submit(Starter starter, Completion completion)
+{
+    if (m_outstanding.fetch_add(1, std::memory_order_relaxed) >= m_maxOutstanding) {
+        m_outstanding.fetch_sub(1, std::memory_order_relaxed);
+        m_rejected.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    m_submitted.fetch_add(1, std::memory_order_relaxed);
+
+    bool first = false;
+    {
+        QMutexLocker locker(&m_pendingMutex);
+        first = m_pending.empty();
+        m_pending.push_back({ std::move(starter), std::move(completion) });
+    }
+    // 列表由空变为非空时才投递，之后到达的操作搭同一次投递
+    if (first) {
+        QMetaObject::invokeMethod(this, &OperationDispatcher::drainPending, Qt::QueuedConnection);
+    }
+    return true;
+}
+
+QVariantMap OperationDispatcher::metrics() const
+{
+    QVariantMap result;
+    result["submitted"] = static_cast<quint64>(m_submitted.load());
+    result["batches"] = static_cast<quint64>(m_batches.load());
+    result["max_batch"] = static_cast<quint64>(m_maxBatch.load());
+    result["rejected"] = static_cast<quint64>(m_rejected.load());
+    result["in_flight"] = m_outstanding.load();
+    return result;
+}
+
+void OperationDispatcher::drainPending()
+{
+    std::vector<Pending> batch;
+    {
+        QMutexLocker locker(&m_pendingMutex);
+        batch.swap(m_pending);
+    }
+    if (batch.empty()) {
+        return;
+    }
+
+    TraceRecorder::Span span(m_handler->traceRecorder(), "dispatcher.drain");
+    m_batches.fetch_add(1, std::memory_order_relaxed);
+    quint64 maxBatch = m_maxBatch.load(std::memory_order_relaxed);
+    while (batch.size() > maxBatch && !m_maxBatch.compare_exchange_weak(maxBatch, batch.size())) {
+    }
+
+    for (Pending& pending : batch) {
+        startOperation(std::move(pending));
+    }
+}
+
+void OperationDispatcher::startOperation(Pending pending)
+{
+    // 完成信号经事件循环发出，先登记回调不会错过
+    const QString operationId = pending.starter(m_handler);
+    if (operationId.isEmpty()) {
+        m_outstanding.fetch_sub(1, std::memory_order_relaxed);
+        pending.completion(false, QString("操作提交失败"));
+        return;
+    }
+    if (m_completions.contains(operationId)) {
+        // 同一 ID 已在等待完成：覆盖会让先提交的调用方永远等不到结果
+        qWarning() << "操作 ID 重复，拒绝登记:" << operationId;
+        m_outstanding.fetch_sub(1, std::memory_order_relaxed);
+        pending.completion(false, QString("操作 ID 重复"));
+        return;
+    }
+    m_completions.insert(operationId, std::move(pending.completion));
+}
+
+void OperationDispatcher::onOperationCompleted(const QString& operationId, bool success, const QVariant& result)
+{
+    auto it = m_completions.find(operationId);
+    if (it == m_completions.end()) {
+        return; // 不是经本对象提交的操作
+    }
+    const Completion completion = std::move(it.value());
+    m_completions.erase(it);
+    m_outstanding.fetch_sub(1, std::memory_order_relaxed);
+    TraceRecorder::Span span(m_handler->traceRecorder(), "dispatcher.complete", operationId);
+    completion(success, result);
+}
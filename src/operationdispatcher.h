@@ -0,0 +1,64 @@
+// operationdispatcher.h
+#ifndef OPERATIONDISPATCHER_H
+#define OPERATIONDISPATCHER_H
+
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QVariant>
+#include <QVariantMap>
+#include <atomic>
+#include <functional>
+#include <vector>
+
+class SQLite3Handler;
+
+// 网络前端（REST、gRPC）向处理器提交操作的入口，与处理器同在数据库线程
+// 任意线程提交的操作先进入待提交列表，同一轮事件循环内到达的操作只跨线程投递一次，
+// 在数据库线程中连续入队；完成时直接在数据库线程中回调，不经过主线程
+class OperationDispatcher : public QObject {
+    Q_OBJECT
+
+public:
+    // 在数据库线程中调用处理器提交操作，返回操作 ID（空表示提交失败）
+    using Starter = std::function<QString(SQLite3Handler*)>;
+    using Completion = std::function<void(bool success, const QVariant& result)>;
+
+    // 创建后需移动到 handler 所在线程
+    explicit OperationDispatcher(SQLite3Handler* handler, int maxOutstanding = 10000, QObject* parent = nullptr);
+
+    // 任意线程：提交一个操作，完成后在数据库线程中调用 completion
+    // 未完成的操作达到上限时直接拒绝，返回 false（completion 不会被调用）
+    bool submit(Starter starter, Completion completion);
+
+    // 任意线程：{submitted, batches, max_batch, rejected, in_flight}
+    QVariantMap metrics() const;
+
+private slots:
+    void drainPending();
+    void onOperationCompleted(const QString& operationId, bool success, const QVariant& result);
+
+private:
+    struct Pending {
+        Starter starter;
+        Completion completion;
+    };
+
+    void startOperation(Pending pending);
+
+    SQLite3Handler* m_handler;
+    const int m_maxOutstanding;
+
+    QMutex m_pendingMutex;
+    std::vector<Pending> m_pending;
+    QHash<QString, Completion> m_completions; // 只在数据库线程访问
+
+    std::atomic<int> m_outstanding { 0 };
+    std::atomic<quint64> m_submitted { 0 };
+    std::atomic<quint64> m_batches { 0 };
+    std::atomic<quint64> m_maxBatch { 0 };
+    std::atomic<quint64> m_rejected { 0 };
+};
+
+#endif // OPERATIONDISPATCHER_H
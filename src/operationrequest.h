@@ -2,11 +2,30 @@
 #ifndef OPERATIONREQUEST_H
 #define OPERATIONREQUEST_H
 
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <map>
 #include <string>
 #include <vector>
 
+// 写合并描述：row 与 key 都相同的排队写入可以在出队时合并
+struct CoalesceSpec {
+    std::string row; // 被写入的行，例如 "products:42"
+    std::string key; // 同一行上的写入种类，例如 "set:stock"
+    std::string deltaParam; // 非空表示增量写入，合并时对该参数求和；为空表示覆盖写入，最后一个胜出
+
+    bool isEnabled() const { return !row.empty() && !key.empty(); }
+};
+
+// 操作各阶段耗时（纳秒），状态机在发出完成信号时生成，处理器取走后计入延迟直方图
+struct OperationTiming {
+    int64_t queue_wait_ns = 0; // 入队到出队
+    int64_t execute_ns = 0; // 出队到 SQL 执行完（含取行）
+    int64_t serialize_ns = 0; // 结果 JSON 序列化
+    std::chrono::steady_clock::time_point completed_at;
+};
+
 // 使用标准C++类型定义操作请求，不依赖任何数据库库
 struct OperationRequest {
     std::string id;
@@ -19,10 +38,20 @@ struct OperationRequest {
     std::map<std::string, std::vector<int>> int_array_params;
 
     std::chrono::system_clock::time_point timestamp;
+    // 延迟统计用单调时钟：构造后立即入队，构造时刻即入队时刻
+    std::chrono::steady_clock::time_point enqueued_at;
+    std::chrono::steady_clock::time_point dequeued_at;
+
+    // 写合并：合并进本操作的其他操作 ID，完成时一并通知
+    CoalesceSpec coalesce;
+    std::vector<std::string> merged_ids;
+    // 合并前的各个原始请求（第一个是 head 本身），合并后的语句失败时按顺序逐条重做
+    std::vector<OperationRequest> coalesced_members;
 
     OperationRequest(const std::string& opType)
         : type(opType)
         , timestamp(std::chrono::system_clock::now())
+        , enqueued_at(std::chrono::steady_clock::now())
     {
         id = generateUUID();
     }
@@ -32,6 +61,7 @@ struct OperationRequest {
         : type(opType)
         , string_params(params)
         , timestamp(std::chrono::system_clock::now())
+        , enqueued_at(std::chrono::steady_clock::now())
     {
         id = generateUUID();
     }
@@ -107,17 +137,29 @@ struct OperationRequest {
     // 检查操作类型
     bool isQueryType() const { return type == "query"; }
     bool isTransactionType() const { return type == "transaction"; }
+    bool isScalarType() const { return type == "scalar"; }
+    // 写入语句带 RETURNING，执行后按查询取回结果行
+    bool returnsRows() const { return getBoolParam(kReturnsRows); }
 
-private:
-    std::string generateUUID()
+    static constexpr const char* kReturnsRows = "returns_rows";
+
+    // 毫秒时间戳便于排查，进程内序号保证唯一（同一毫秒内任意多个请求也不会重复）；
+    // 处理器需要在入队前登记操作时也用它预先生成 ID
+    static std::string generateUUID()
     {
+        static std::atomic<uint64_t> sequence { 0 };
         auto now = std::chrono::system_clock::now();
         auto duration = now.time_since_epoch();
         auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
-        return "op_" + std::to_string(millis) + "_" + std::to_string(rand() % 10000);
+        return "op_" + std::to_string(millis) + "_" + std::to_string(sequence.fetch_add(1, std::memory_order_relaxed));
     }
 };
 
+// 操作失败时结果中的错误码（result["error_code"]）
+namespace OperationError {
+constexpr const char* kDuplicateEmail = "DUPLICATE_EMAIL"; // 邮箱已存在
+}
+
 // 操作结果结构体
 struct OperationResult {
     std::string operation_id;
@@ -0,0 +1,195 @@
+// productcolumnstore.cc
+#include "productcolumnstore.h"
+#include "simdkernels.h"
+#include "sqlite3statemachine.h"
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <algorithm>
+
+ProductColumnStore::ProductColumnStore(SQLite3StateMachine* stateMachine, QObject* parent)
+    : QObject(parent)
+    , m_stateMachine(stateMachine)
+{
+}
+
+bool ProductColumnStore::load()
+{
+    Columns columns;
+    try {
+        columns = readColumns(std::string(), std::string());
+    } catch (const std::exception& e) {
+        qWarning() << "列式镜像加载失败:" << e.what();
+        return false;
+    }
+
+    QWriteLocker locker(&m_lock);
+    m_columns = std::move(columns);
+    m_slots.clear();
+    m_slots.reserve(static_cast<qsizetype>(m_columns.ids.size()));
+    for (std::size_t i = 0; i < m_columns.ids.size(); ++i) {
+        m_slots.insert(m_columns.ids[i], i);
+    }
+    m_ready.store(true, std::memory_order_release);
+
+    qDebug() << "列式镜像已加载，产品数:" << m_columns.ids.size() << "内核:" << simd::activeKernel();
+    return true;
+}
+
+double ProductColumnStore::totalInventoryValue() const
+{
+    m_queries.fetch_add(1, std::memory_order_relaxed);
+    QReadLocker locker(&m_lock);
+    return simd::sumProduct(m_columns.prices.data(), m_columns.stocks.data(), m_columns.ids.size());
+}
+
+qint64 ProductColumnStore::countLowStock(int threshold) const
+{
+    m_queries.fetch_add(1, std::memory_order_relaxed);
+    QReadLocker locker(&m_lock);
+    return static_cast<qint64>(simd::countLess(m_columns.stocks.data(), m_columns.ids.size(), threshold));
+}
+
+qint64 ProductColumnStore::countInPriceRange(double minPrice, double maxPrice) const
+{
+    m_queries.fetch_add(1, std::memory_order_relaxed);
+    QReadLocker locker(&m_lock);
+    return static_cast<qint64>(simd::countInRange(m_columns.prices.data(), m_columns.ids.size(), minPrice, maxPrice));
+}
+
+QVector<quint64> ProductColumnStore::priceHistogram(double minPrice, double maxPrice, int bins) const
+{
+    m_queries.fetch_add(1, std::memory_order_relaxed);
+
+    QVector<quint64> counts(std::max(0, bins), 0);
+    if (counts.isEmpty()) {
+        return counts;
+    }
+
+    static_assert(sizeof(quint64) == sizeof(uint64_t), "quint64 must match uint64_t");
+    QReadLocker locker(&m_lock);
+    simd::histogram(m_columns.prices.data(), m_columns.ids.size(), minPrice, maxPrice, bins,
+        reinterpret_cast<uint64_t*>(counts.data()));
+    return counts;
+}
+
+QVariantMap ProductColumnStore::metrics() const
+{
+    QVariantMap result;
+    {
+        QReadLocker locker(&m_lock);
+        result["products"] = static_cast<qint64>(m_columns.ids.size());
+    }
+    result["ready"] = isReady();
+    result["kernel"] = QString::fromLatin1(simd::activeKernel());
+    result["queries"] = static_cast<quint64>(m_queries.load());
+    result["rows_applied"] = static_cast<quint64>(m_rowsApplied.load());
+    return result;
+}
+
+void ProductColumnStore::onTableChanged(const QString& table, const QList<ChangeTracker::RowChange>& changes)
+{
+    if (table != "products" || !isReady()) {
+        return;
+    }
+
+    QList<int32_t> deleted;
+    QJsonArray upserted;
+    for (const ChangeTracker::RowChange& change : changes) {
+        if (change.operation == ChangeTracker::Operation::Delete) {
+            deleted.append(static_cast<int32_t>(change.rowid));
+        } else {
+            upserted.append(change.rowid);
+        }
+    }
+
+    Columns rows;
+    if (!upserted.isEmpty()) {
+        try {
+            rows = readColumns("WHERE id IN (SELECT value FROM json_each(:ids))",
+                QJsonDocument(upserted).toJson(QJsonDocument::Compact).toStdString());
+        } catch (const std::exception& e) {
+            qWarning() << "列式镜像更新失败，重新加载:" << e.what();
+            load();
+            return;
+        }
+    }
+
+    QWriteLocker locker(&m_lock);
+    for (int32_t id : deleted) {
+        remove(id);
+    }
+    for (std::size_t i = 0; i < rows.ids.size(); ++i) {
+        upsert(rows.ids[i], rows.prices[i], rows.stocks[i]);
+    }
+    m_rowsApplied.fetch_add(changes.size(), std::memory_order_relaxed);
+}
+
+ProductColumnStore::Columns ProductColumnStore::readColumns(const std::string& whereClause, const std::string& idsJson) const
+{
+    Columns columns;
+    soci::session* session = m_stateMachine->getSession();
+    if (!session) {
+        return columns;
+    }
+
+    int id = 0;
+    double price = 0.0;
+    int stock = 0;
+    soci::indicator stockIndicator = soci::i_ok;
+
+    const std::string sql = "SELECT id, price, stock FROM products " + whereClause;
+    soci::statement st = (session->prepare << sql);
+    st.exchange(soci::into(id));
+    st.exchange(soci::into(price));
+    st.exchange(soci::into(stock, stockIndicator));
+    if (!idsJson.empty()) {
+        st.exchange(soci::use(idsJson, "ids"));
+    }
+    st.define_and_bind();
+    st.execute(false);
+
+    while (st.fetch()) {
+        columns.ids.push_back(id);
+        columns.prices.push_back(price);
+        columns.stocks.push_back(stockIndicator == soci::i_ok ? stock : 0);
+    }
+    return columns;
+}
+
+void ProductColumnStore::upsert(int32_t id, double price, int32_t stock)
+{
+    auto slot = m_slots.constFind(id);
+    if (slot != m_slots.constEnd()) {
+        m_columns.prices[*slot] = price;
+        m_columns.stocks[*slot] = stock;
+        return;
+    }
+
+    m_slots.insert(id, m_columns.ids.size());
+    m_columns.ids.push_back(id);
+    m_columns.prices.push_back(price);
+    m_columns.stocks.push_back(stock);
+}
+
+void ProductColumnStore::remove(int32_t id)
+{
+    auto slot = m_slots.find(id);
+    if (slot == m_slots.end()) {
+        return;
+    }
+
+    // 用最后一个元素填补空位，保持各列连续
+    const std::size_t index = *slot;
+    const std::size_t last = m_columns.ids.size() - 1;
+    m_slots.erase(slot);
+    if (index != last) {
+        m_columns.ids[index] = m_columns.ids[last];
+        m_columns.prices[index] = m_columns.prices[last];
+        m_columns.stocks[index] = m_columns.stocks[last];
+        m_slots[m_columns.ids[index]] = index;
+    }
+    m_columns.ids.pop_back();
+    m_columns.prices.pop_back();
+    m_columns.stocks.pop_back();
+}
@@ -0,0 +1,65 @@
+// productcolumnstore.h
+#ifndef PRODUCTCOLUMNSTORE_H
+#define PRODUCTCOLUMNSTORE_H
+
+#include "changetracker.h"
+#include <QHash>
+#include <QObject>
+#include <QReadWriteLock>
+#include <QVariantMap>
+#include <QVector>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class SQLite3StateMachine;
+
+// products 的列式内存镜像（id / price / stock 各一列连续数组）
+// 分析型聚合直接在镜像上用 SIMD 内核计算，不占用数据库写线程；
+// 由数据库线程根据 ChangeTracker 的变更增量维护，删除时用末尾元素填补空位
+class ProductColumnStore : public QObject {
+    Q_OBJECT
+
+public:
+    explicit ProductColumnStore(SQLite3StateMachine* stateMachine, QObject* parent = nullptr);
+
+    // 数据库线程：全量加载
+    bool load();
+    bool isReady() const { return m_ready.load(std::memory_order_acquire); }
+
+    // 任意线程
+    double totalInventoryValue() const; // SUM(price * stock)
+    qint64 countLowStock(int threshold) const; // COUNT(stock < threshold)
+    qint64 countInPriceRange(double minPrice, double maxPrice) const;
+    QVector<quint64> priceHistogram(double minPrice, double maxPrice, int bins) const;
+    QVariantMap metrics() const;
+
+public slots:
+    void onTableChanged(const QString& table, const QList<ChangeTracker::RowChange>& changes);
+
+private:
+    struct Columns {
+        std::vector<int32_t> ids;
+        std::vector<double> prices;
+        std::vector<int32_t> stocks;
+    };
+
+    Columns readColumns(const std::string& whereClause, const std::string& idsJson) const;
+
+    // 调用方持有写锁
+    void upsert(int32_t id, double price, int32_t stock);
+    void remove(int32_t id);
+
+    SQLite3StateMachine* m_stateMachine;
+
+    mutable QReadWriteLock m_lock;
+    Columns m_columns;
+    QHash<int32_t, std::size_t> m_slots;
+
+    std::atomic<bool> m_ready { false };
+    mutable std::atomic<quint64> m_queries { 0 };
+    std::atomic<quint64> m_rowsApplied { 0 };
+};
+
+#endif // PRODUCTCOLUMNSTORE_H
@@ -0,0 +1,202 @@
+// productpriceindex.cc
+#include "productpriceindex.h"
+#include "sqlite3statemachine.h"
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <algorithm>
+#include <limits>
+
+namespace {
+// 一批变更超过该行数时整体重排，比逐条插入删除更快
+constexpr int kRebuildThreshold = 64;
+}
+
+ProductPriceIndex::ProductPriceIndex(SQLite3StateMachine* stateMachine, QObject* parent)
+    : QObject(parent)
+    , m_stateMachine(stateMachine)
+{
+}
+
+bool ProductPriceIndex::load()
+{
+    QList<QVariantMap> rows;
+    try {
+        rows = readRows(std::string(), std::string());
+    } catch (const std::exception& e) {
+        qWarning() << "价格索引加载失败:" << e.what();
+        return false;
+    }
+
+    QWriteLocker locker(&m_lock);
+    m_rows.clear();
+    m_rows.reserve(rows.size());
+    for (const QVariantMap& row : rows) {
+        m_rows.insert(row.value("id").toInt(), row);
+    }
+    rebuildEntries();
+    m_ready.store(true, std::memory_order_release);
+
+    qDebug() << "价格索引已加载，产品数:" << m_entries.size();
+    return true;
+}
+
+QVariantList ProductPriceIndex::findRange(double minPrice, double maxPrice, int limit) const
+{
+    m_queries.fetch_add(1, std::memory_order_relaxed);
+
+    QVariantList result;
+    QReadLocker locker(&m_lock);
+
+    auto it = std::lower_bound(m_entries.begin(), m_entries.end(), Entry { minPrice, std::numeric_limits<int>::min() });
+    for (; it != m_entries.end() && it->price <= maxPrice; ++it) {
+        if (limit >= 0 && result.size() >= limit) {
+            break;
+        }
+        result.append(m_rows.value(it->id));
+    }
+    return result;
+}
+
+QVariantMap ProductPriceIndex::metrics() const
+{
+    QVariantMap result;
+    {
+        QReadLocker locker(&m_lock);
+        result["products"] = static_cast<qint64>(m_entries.size());
+    }
+    result["ready"] = isReady();
+    result["queries"] = static_cast<quint64>(m_queries.load());
+    result["rows_applied"] = static_cast<quint64>(m_rowsApplied.load());
+    result["rebuilds"] = static_cast<quint64>(m_rebuilds.load());
+    return result;
+}
+
+void ProductPriceIndex::onTableChanged(const QString& table, const QList<ChangeTracker::RowChange>& changes)
+{
+    if (table != "products" || !isReady()) {
+        return;
+    }
+
+    QList<int> deleted;
+    QJsonArray upserted;
+    for (const ChangeTracker::RowChange& change : changes) {
+        if (change.operation == ChangeTracker::Operation::Delete) {
+            deleted.append(static_cast<int>(change.rowid));
+        } else {
+            upserted.append(change.rowid);
+        }
+    }
+
+    // 回查变更后的行（在锁外完成，不阻塞查询）
+    QList<QVariantMap> rows;
+    if (!upserted.isEmpty()) {
+        try {
+            rows = readRows("WHERE id IN (SELECT value FROM json_each(:ids))",
+                QJsonDocument(upserted).toJson(QJsonDocument::Compact).toStdString());
+        } catch (const std::exception& e) {
+            qWarning() << "价格索引更新失败，重新加载:" << e.what();
+            load();
+            return;
+        }
+    }
+
+    QWriteLocker locker(&m_lock);
+    const bool rebuild = changes.size() > kRebuildThreshold;
+
+    for (int id : deleted) {
+        if (rebuild) {
+            m_rows.remove(id);
+        } else {
+            removeRow(id);
+        }
+    }
+    for (const QVariantMap& row : rows) {
+        if (rebuild) {
+            m_rows.insert(row.value("id").toInt(), row);
+        } else {
+            removeRow(row.value("id").toInt());
+            insertRow(row);
+        }
+    }
+    if (rebuild) {
+        rebuildEntries();
+    }
+
+    m_rowsApplied.fetch_add(changes.size(), std::memory_order_relaxed);
+}
+
+QList<QVariantMap> ProductPriceIndex::readRows(const std::string& whereClause, const std::string& idsJson) const
+{
+    QList<QVariantMap> rows;
+    soci::session* session = m_stateMachine->getSession();
+    if (!session) {
+        return rows;
+    }
+
+    int id = 0;
+    std::string name;
+    double price = 0.0;
+    int stock = 0;
+    std::string createdAt;
+    soci::indicator stockIndicator = soci::i_ok;
+    soci::indicator createdIndicator = soci::i_ok;
+
+    const std::string sql = "SELECT id, name, price, stock, created_at FROM products " + whereClause;
+    soci::statement st = (session->prepare << sql);
+    st.exchange(soci::into(id));
+    st.exchange(soci::into(name));
+    st.exchange(soci::into(price));
+    st.exchange(soci::into(stock, stockIndicator));
+    st.exchange(soci::into(createdAt, createdIndicator));
+    if (!idsJson.empty()) {
+        st.exchange(soci::use(idsJson, "ids"));
+    }
+    st.define_and_bind();
+    st.execute(false);
+
+    // 字段名和类型与查询结果的 JSON 保持一致
+    while (st.fetch()) {
+        QVariantMap row;
+        row["id"] = static_cast<qint64>(id);
+        row["name"] = QString::fromStdString(name);
+        row["price"] = price;
+        row["stock"] = stockIndicator == soci::i_ok ? QVariant(static_cast<qint64>(stock)) : QVariant();
+        row["created_at"] = createdIndicator == soci::i_ok ? QVariant(QString::fromStdString(createdAt)) : QVariant();
+        rows.append(row);
+    }
+    return rows;
+}
+
+void ProductPriceIndex::insertRow(const QVariantMap& row)
+{
+    const Entry entry { row.value("price").toDouble(), row.value("id").toInt() };
+    m_entries.insert(std::lower_bound(m_entries.begin(), m_entries.end(), entry), entry);
+    m_rows.insert(entry.id, row);
+}
+
+void ProductPriceIndex::removeRow(int id)
+{
+    auto row = m_rows.find(id);
+    if (row == m_rows.end()) {
+        return;
+    }
+
+    const Entry entry { row->value("price").toDouble(), id };
+    auto it = std::lower_bound(m_entries.begin(), m_entries.end(), entry);
+    if (it != m_entries.end() && it->id == id) {
+        m_entries.erase(it);
+    }
+    m_rows.erase(row);
+}
+
+void ProductPriceIndex::rebuildEntries()
+{
+    m_entries.clear();
+    m_entries.reserve(m_rows.size());
+    for (auto it = m_rows.cbegin(); it != m_rows.cend(); ++it) {
+        m_entries.push_back({ it.value().value("price").toDouble(), it.key() });
+    }
+    std::sort(m_entries.begin(), m_entries.end());
+    m_rebuilds.fetch_add(1, std::memory_order_relaxed);
+}
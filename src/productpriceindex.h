@@ -0,0 +1,68 @@
+// productpriceindex.h
+#ifndef PRODUCTPRICEINDEX_H
+#define PRODUCTPRICEINDEX_H
+
+#include "changetracker.h"
+#include <QHash>
+#include <QObject>
+#include <QReadWriteLock>
+#include <QVariantList>
+#include <QVariantMap>
+#include <atomic>
+#include <string>
+#include <vector>
+
+class SQLite3StateMachine;
+
+// products 的内存价格索引
+// 按 (price, id) 排序的连续数组做二分区间查找，行数据从行缓存取；
+// 由数据库线程根据 ChangeTracker 的变更增量维护，查询可以在任意线程直接执行，不进入队列
+class ProductPriceIndex : public QObject {
+    Q_OBJECT
+
+public:
+    explicit ProductPriceIndex(SQLite3StateMachine* stateMachine, QObject* parent = nullptr);
+
+    // 数据库线程：全量加载
+    bool load();
+
+    // 任意线程：结果与 findProductsByPriceRange 相同（按 price, id 排序），limit < 0 表示不限
+    QVariantList findRange(double minPrice, double maxPrice, int limit = -1) const;
+    bool isReady() const { return m_ready.load(std::memory_order_acquire); }
+    QVariantMap metrics() const;
+
+public slots:
+    void onTableChanged(const QString& table, const QList<ChangeTracker::RowChange>& changes);
+
+private:
+    struct Entry {
+        double price;
+        int id;
+
+        bool operator<(const Entry& other) const
+        {
+            return price < other.price || (price == other.price && id < other.id);
+        }
+    };
+
+    // 读取 whereClause 命中的行，idsJson 绑定到 :ids
+    QList<QVariantMap> readRows(const std::string& whereClause, const std::string& idsJson) const;
+
+    // 调用方持有写锁
+    void insertRow(const QVariantMap& row);
+    void removeRow(int id);
+    void rebuildEntries();
+
+    SQLite3StateMachine* m_stateMachine;
+
+    mutable QReadWriteLock m_lock;
+    std::vector<Entry> m_entries;
+    QHash<int, QVariantMap> m_rows;
+
+    std::atomic<bool> m_ready { false };
+    mutable std::atomic<quint64> m_queries { 0 };
+    std::atomic<quint64> m_rowsApplied { 0 };
+    std::atomic<quint64> m_rebuilds { 0 };
+};
+
+#endif // PRODUCTPRICEINDEX_H
@@ -0,0 +1,324 @@
+// queryprofiler.cc
+#include "queryprofiler.h"
+#include "sqlite3statemachine.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <algorithm>
+#include <sqlite3.h>
+
+namespace {
+const QByteArray kOtherShape = QByteArrayLiteral("other");
+}
+
+// SQLite 回调，转发到对应的 QueryProfiler
+struct QueryProfilerHooks {
+    static int onTrace(unsigned type, void* context, void* statement, void* elapsed)
+    {
+        if (type == SQLITE_TRACE_PROFILE) {
+            static_cast<QueryProfiler*>(context)->onProfile(statement, *static_cast<sqlite3_int64*>(elapsed));
+        }
+        return 0;
+    }
+};
+
+QueryProfiler::QueryProfiler(SQLite3StateMachine* stateMachine, const QString& dbFile,
+    const QueryProfilerPolicy& policy, QObject* parent)
+    : QObject(parent)
+    , m_stateMachine(stateMachine)
+    , m_policy(policy)
+{
+    if (m_policy.logFile.isEmpty()) {
+        m_policy.logFile = dbFile + "-slowquery.log";
+    }
+
+    m_logThread = new QThread(this);
+    m_log = new SlowQueryLog(dbFile, m_policy);
+    m_log->moveToThread(m_logThread);
+    connect(m_logThread, &QThread::finished, m_log, &QObject::deleteLater);
+    m_logThread->start(QThread::LowestPriority);
+}
+
+QueryProfiler::~QueryProfiler()
+{
+    uninstall();
+    // 先写完已投递的记录再停止
+    QMetaObject::invokeMethod(m_log, "stop", Qt::BlockingQueuedConnection);
+    m_logThread->quit();
+    m_logThread->wait();
+}
+
+bool QueryProfiler::install()
+{
+    sqlite3* db = m_stateMachine->nativeHandle();
+    if (db == m_db) {
+        return m_db != nullptr;
+    }
+
+    // 重连后旧句柄已经失效，直接换成新句柄
+    m_db = db;
+    if (!m_db) {
+        return false;
+    }
+    sqlite3_trace_v2(m_db, SQLITE_TRACE_PROFILE, &QueryProfilerHooks::onTrace, this);
+    qDebug() << "语句剖析已启用，慢查询阈值:" << m_policy.slowThresholdUs << "us，日志:" << m_policy.logFile;
+    return true;
+}
+
+void QueryProfiler::uninstall()
+{
+    if (!m_db) {
+        return;
+    }
+    if (m_stateMachine->nativeHandle() == m_db) {
+        sqlite3_trace_v2(m_db, 0, nullptr, nullptr);
+    }
+    m_db = nullptr;
+}
+
+// 语句执行结束（取完行或被重置）时由 SQLite 调用，位于数据库线程
+void QueryProfiler::onProfile(void* statement, qint64 nanos)
+{
+    auto* stmt = static_cast<sqlite3_stmt*>(statement);
+    m_statements.fetch_add(1, std::memory_order_relaxed);
+
+    // 读取后清零，下次执行从零开始计
+    const int fullscanSteps = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1);
+    const int sorts = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_SORT, 1);
+    const int autoindexes = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_AUTOINDEX, 1);
+    const int vmSteps = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_VM_STEP, 1);
+    const bool slow = nanos >= m_policy.slowThresholdUs * 1000;
+
+    const char* sql = sqlite3_sql(stmt);
+    {
+        QMutexLocker locker(&m_shapesMutex);
+        // fromRawData 不复制，只有首次出现的模板才分配
+        const QByteArray key = QByteArray::fromRawData(sql ? sql : "", sql ? static_cast<int>(qstrlen(sql)) : 0);
+        auto it = m_shapes.find(key);
+        if (it == m_shapes.end()) {
+            // 给 "other" 留一个位置，模板总数不超过 kMaxShapes
+            if (m_shapes.size() < kMaxShapes - 1) {
+                it = m_shapes.insert(QByteArray(key.constData(), key.size()), Shape());
+            } else {
+                it = m_shapes.find(kOtherShape);
+                if (it == m_shapes.end()) {
+                    it = m_shapes.insert(kOtherShape, Shape());
+                }
+            }
+        }
+        Shape& shape = it.value();
+        shape.calls++;
+        shape.totalNanos += nanos;
+        shape.maxNanos = std::max(shape.maxNanos, nanos);
+        shape.fullscanSteps += static_cast<quint64>(fullscanSteps);
+        shape.sorts += static_cast<quint64>(sorts);
+        shape.autoindexes += static_cast<quint64>(autoindexes);
+        shape.vmSteps += static_cast<quint64>(vmSteps);
+        if (slow) {
+            shape.slowCalls++;
+        }
+    }
+
+    if (!slow) {
+        return;
+    }
+    m_slow.fetch_add(1, std::memory_order_relaxed);
+
+    SlowQueryRecord record;
+    record.timestamp = QDateTime::currentDateTime().toString(Qt::ISODateWithMs);
+    record.durationUs = nanos / 1000;
+    record.sql = QString::fromUtf8(sql);
+    if (char* expanded = sqlite3_expanded_sql(stmt)) {
+        record.expandedSql = QString::fromUtf8(expanded);
+        sqlite3_free(expanded);
+    }
+    const int parameterCount = sqlite3_bind_parameter_count(stmt);
+    for (int i = 1; i <= parameterCount; ++i) {
+        const char* name = sqlite3_bind_parameter_name(stmt, i);
+        record.parameters.append(name ? QString::fromUtf8(name) : QString("?%1").arg(i));
+    }
+    record.fullscanSteps = fullscanSteps;
+    record.sorts = sorts;
+    record.autoindexes = autoindexes;
+    record.vmSteps = vmSteps;
+
+    if (!m_log->post(record)) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+QVariantMap QueryProfiler::metrics() const
+{
+    QVariantMap result;
+    result["statements"] = static_cast<quint64>(m_statements.load());
+    result["slow"] = static_cast<quint64>(m_slow.load());
+    result["logged"] = static_cast<quint64>(m_log->logged());
+    result["dropped"] = static_cast<quint64>(m_dropped.load());
+    result["pending"] = m_log->pending();
+    {
+        QMutexLocker locker(&m_shapesMutex);
+        result["shapes"] = m_shapes.size();
+    }
+    return result;
+}
+
+QVariantList QueryProfiler::topShapes(int limit) const
+{
+    QList<QPair<QByteArray, Shape>> shapes;
+    {
+        QMutexLocker locker(&m_shapesMutex);
+        shapes.reserve(m_shapes.size());
+        for (auto it = m_shapes.cbegin(); it != m_shapes.cend(); ++it) {
+            shapes.append({ it.key(), it.value() });
+        }
+    }
+    std::sort(shapes.begin(), shapes.end(),
+        [](const auto& a, const auto& b) { return a.second.totalNanos > b.second.totalNanos; });
+
+    QVariantList result;
+    for (int i = 0; i < shapes.size() && i < limit; ++i) {
+        const Shape& shape = shapes.at(i).second;
+        QVariantMap entry;
+        entry["sql"] = QString::fromUtf8(shapes.at(i).first);
+        entry["calls"] = shape.calls;
+        entry["total_us"] = shape.totalNanos / 1000;
+        entry["mean_us"] = shape.calls > 0 ? shape.totalNanos / 1000.0 / shape.calls : 0.0;
+        entry["max_us"] = shape.maxNanos / 1000;
+        entry["slow"] = shape.slowCalls;
+        entry["fullscan_steps"] = shape.fullscanSteps;
+        entry["sorts"] = shape.sorts;
+        entry["autoindexes"] = shape.autoindexes;
+        entry["vm_steps"] = shape.vmSteps;
+        result.append(entry);
+    }
+    return result;
+}
+
+SlowQueryLog::SlowQueryLog(const QString& dbFile, const QueryProfilerPolicy& policy)
+    : m_dbFile(dbFile)
+    , m_policy(policy)
+{
+}
+
+SlowQueryLog::~SlowQueryLog()
+{
+    stop();
+}
+
+bool SlowQueryLog::post(const SlowQueryRecord& record)
+{
+    if (m_pending.fetch_add(1, std::memory_order_relaxed) >= m_policy.maxPendingRecords) {
+        m_pending.fetch_sub(1, std::memory_order_relaxed);
+        return false;
+    }
+    QMetaObject::invokeMethod(this, [this, record]() {
+        write(record);
+        m_pending.fetch_sub(1, std::memory_order_relaxed);
+    }, Qt::QueuedConnection);
+    return true;
+}
+
+void SlowQueryLog::stop()
+{
+    if (m_readDb) {
+        sqlite3_close_v2(m_readDb);
+        m_readDb = nullptr;
+    }
+    if (m_file.isOpen()) {
+        m_file.close();
+    }
+}
+
+void SlowQueryLog::write(const SlowQueryRecord& record)
+{
+    if (!m_file.isOpen() && !openLog()) {
+        return;
+    }
+
+    QJsonObject entry {
+        { "time", record.timestamp },
+        { "duration_us", record.durationUs },
+        { "sql", record.sql },
+        { "expanded_sql", record.expandedSql },
+        { "parameters", QJsonArray::fromStringList(record.parameters) },
+        { "fullscan_steps", record.fullscanSteps },
+        { "sorts", record.sorts },
+        { "autoindexes", record.autoindexes },
+        { "vm_steps", record.vmSteps },
+    };
+    if (m_policy.explain) {
+        entry["plan"] = QJsonArray::fromVariantList(explain(record.sql));
+    }
+
+    m_file.write(QJsonDocument(entry).toJson(QJsonDocument::Compact));
+    m_file.write("\n");
+    m_file.flush();
+    m_logged.fetch_add(1, std::memory_order_relaxed);
+
+    if (m_file.size() >= m_policy.maxLogBytes) {
+        rotate();
+    }
+}
+
+// 在只读连接上解释语句模板；占位符未绑定时按 NULL 处理，不影响计划的形状
+QVariantList SlowQueryLog::explain(const QString& sql)
+{
+    QVariantList plan;
+    if (!m_readDb) {
+        const QByteArray path = m_dbFile.toUtf8();
+        if (sqlite3_open_v2(path.constData(), &m_readDb, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+            plan.append(QString("只读连接打开失败: %1").arg(m_readDb ? sqlite3_errmsg(m_readDb) : "unknown"));
+            sqlite3_close_v2(m_readDb);
+            m_readDb = nullptr;
+            return plan;
+        }
+        sqlite3_busy_timeout(m_readDb, 100);
+    }
+
+    const QByteArray query = "EXPLAIN QUERY PLAN " + sql.toUtf8();
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(m_readDb, query.constData(), -1, &stmt, nullptr) != SQLITE_OK) {
+        plan.append(QString("无法解释: %1").arg(sqlite3_errmsg(m_readDb)));
+        sqlite3_finalize(stmt);
+        return plan;
+    }
+
+    // 列为 id, parent, notused, detail；按 parent 链缩进成树
+    QHash<int, int> depth;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const int id = sqlite3_column_int(stmt, 0);
+        const int parent = sqlite3_column_int(stmt, 1);
+        const int level = parent == 0 ? 0 : depth.value(parent, 0) + 1;
+        depth.insert(id, level);
+        const char* detail = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+        plan.append(QString(level * 2, ' ') + QString::fromUtf8(detail ? detail : ""));
+    }
+    sqlite3_finalize(stmt);
+    return plan;
+}
+
+bool SlowQueryLog::openLog()
+{
+    m_file.setFileName(m_policy.logFile);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qWarning() << "慢查询日志打开失败:" << m_policy.logFile << m_file.errorString();
+        return false;
+    }
+    return true;
+}
+
+// app.log -> app.log.1 -> app.log.2 ...，超出 maxLogFiles 的最旧文件被删除
+void SlowQueryLog::rotate()
+{
+    m_file.close();
+    const QString base = m_policy.logFile;
+    const int keep = std::max(1, m_policy.maxLogFiles);
+    QFile::remove(QString("%1.%2").arg(base).arg(keep));
+    for (int i = keep - 1; i >= 1; --i) {
+        QFile::rename(QString("%1.%2").arg(base).arg(i), QString("%1.%2").arg(base).arg(i + 1));
+    }
+    QFile::rename(base, base + ".1");
+    openLog();
+}
@@ -0,0 +1,133 @@
+// queryprofiler.h
+#ifndef QUERYPROFILER_H
+#define QUERYPROFILER_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QThread>
+#include <QVariantList>
+#include <QVariantMap>
+#include <atomic>
+
+class SQLite3StateMachine;
+struct sqlite3;
+
+// 语句级性能剖析与慢查询日志策略
+struct QueryProfilerPolicy {
+    bool enabled = false;
+    qint64 slowThresholdUs = 100 * 1000; // 单条语句超过该耗时记入慢查询日志
+    QString logFile; // 为空时使用 <数据库文件>-slowquery.log
+    qint64 maxLogBytes = 8 * 1024 * 1024; // 单个日志文件上限，超出后轮转
+    int maxLogFiles = 3; // 保留的历史文件数（.1 最新）
+    bool explain = true; // 是否附带 EXPLAIN QUERY PLAN
+    int maxPendingRecords = 1024; // 写日志线程积压的上限，超出的慢查询只计数不记录
+};
+
+// 一条慢查询记录
+struct SlowQueryRecord {
+    QString timestamp;
+    qint64 durationUs = 0;
+    QString sql; // 语句模板（参数为占位符）
+    QString expandedSql; // 代入参数值后的语句
+    QStringList parameters; // 参数名（匿名参数为 ?N）
+    int fullscanSteps = 0;
+    int sorts = 0;
+    int autoindexes = 0;
+    int vmSteps = 0;
+};
+
+class SlowQueryLog;
+
+// 基于 sqlite3_trace_v2(SQLITE_TRACE_PROFILE) 的语句级剖析，挂在写连接上，回调在数据库线程中执行
+// 每条语句结束时读取并清零 sqlite3_stmt_status 计数（全表扫描步数、排序、自动索引、VM 步数），
+// 按语句模板聚合；超过阈值的语句交给独立线程写入轮转的慢查询日志，
+// EXPLAIN QUERY PLAN 也在那个线程里用只读连接执行，不占用写连接
+class QueryProfiler : public QObject {
+    Q_OBJECT
+
+public:
+    QueryProfiler(SQLite3StateMachine* stateMachine, const QString& dbFile, const QueryProfilerPolicy& policy,
+        QObject* parent = nullptr);
+    ~QueryProfiler();
+
+    // 数据库线程：连接建立（或重连）后调用，句柄变化时重新注册
+    bool install();
+    void uninstall();
+
+    // 任意线程
+    QVariantMap metrics() const; // {statements, slow, logged, dropped, pending, shapes}
+    // 按总耗时降序的语句模板：[{sql, calls, total_us, mean_us, max_us, slow, fullscan_steps, sorts, autoindexes, vm_steps}]
+    QVariantList topShapes(int limit = 20) const;
+
+private:
+    friend struct QueryProfilerHooks;
+
+    struct Shape {
+        quint64 calls = 0;
+        quint64 slowCalls = 0;
+        qint64 totalNanos = 0;
+        qint64 maxNanos = 0;
+        quint64 fullscanSteps = 0;
+        quint64 sorts = 0;
+        quint64 autoindexes = 0;
+        quint64 vmSteps = 0;
+    };
+
+    static constexpr int kMaxShapes = 512; // 含 "other"：超出的模板统一计入其中
+
+    void onProfile(void* statement, qint64 nanos);
+
+    SQLite3StateMachine* m_stateMachine;
+    QueryProfilerPolicy m_policy;
+    sqlite3* m_db = nullptr;
+
+    mutable QMutex m_shapesMutex;
+    QHash<QByteArray, Shape> m_shapes;
+
+    QThread* m_logThread = nullptr;
+    SlowQueryLog* m_log = nullptr;
+
+    std::atomic<quint64> m_statements { 0 };
+    std::atomic<quint64> m_slow { 0 };
+    std::atomic<quint64> m_dropped { 0 };
+};
+
+// 慢查询日志的写入端，运行在自己的线程中：每条记录一行 JSON，文件超过上限时轮转
+class SlowQueryLog : public QObject {
+    Q_OBJECT
+
+public:
+    SlowQueryLog(const QString& dbFile, const QueryProfilerPolicy& policy);
+    ~SlowQueryLog();
+
+    // 任意线程：积压未写的记录数、已写入的记录数
+    int pending() const { return m_pending.load(std::memory_order_relaxed); }
+    quint64 logged() const { return m_logged.load(std::memory_order_relaxed); }
+
+    // 投递一条记录；积压达到上限时返回 false
+    bool post(const SlowQueryRecord& record);
+
+public slots:
+    void stop();
+
+private:
+    void write(const SlowQueryRecord& record);
+    QVariantList explain(const QString& sql);
+    bool openLog();
+    void rotate();
+
+    QString m_dbFile;
+    QueryProfilerPolicy m_policy;
+    sqlite3* m_readDb = nullptr;
+    QFile m_file;
+
+    std::atomic<int> m_pending { 0 };
+    std::atomic<quint64> m_logged { 0 };
+};
+
+#endif // QUERYPROFILER_H
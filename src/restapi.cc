@@ -0,0 +1,453 @@
+// restapi.cc
+#include "restapi.h"
+#include "operationrequest.h"
+#include "sqlite3handler.h"
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <algorithm>
+#include <drogon/HttpResponse.h>
+
+namespace {
+
+drogon::HttpResponsePtr jsonResponse(int status, const QVariant& body)
+{
+    const QJsonValue value = QJsonValue::fromVariant(body);
+    QJsonDocument doc;
+    if (value.isObject()) {
+        doc.setObject(value.toObject());
+    } else if (value.isArray()) {
+        doc.setArray(value.toArray());
+    } else {
+        // 标量结果（计数、布尔等）包一层
+        doc.setObject(QJsonObject { { "result", value } });
+    }
+
+    auto response = drogon::HttpResponse::newHttpResponse();
+    response->setStatusCode(static_cast<drogon::HttpStatusCode>(status));
+    response->setContentTypeCode(drogon::CT_APPLICATION_JSON);
+    response->setBody(doc.toJson(QJsonDocument::Compact).toStdString());
+    return response;
+}
+
+drogon::HttpResponsePtr errorResponse(int status, const QString& message)
+{
+    return jsonResponse(status, QVariantMap { { "error", message } });
+}
+
+// 失败的操作：重复邮箱等带错误码的结果按 409 返回，其余按 500
+drogon::HttpResponsePtr failureResponse(const QVariant& result)
+{
+    const QVariantMap map = result.toMap();
+    if (map.value("error_code").toString() == OperationError::kDuplicateEmail) {
+        return jsonResponse(409, map);
+    }
+    return errorResponse(500, map.isEmpty() ? result.toString() : map.value("error").toString());
+}
+
+bool parseId(const std::string& text, int& id)
+{
+    bool ok = false;
+    id = QString::fromStdString(text).toInt(&ok);
+    return ok && id > 0;
+}
+
+// 更新请求的键名必须都是可更新列，返回第一个不合法的键
+QString unknownColumn(const QVariantMap& updates, const QString& table)
+{
+    const QStringList& allowed = SQLite3Handler::updatableColumns(table);
+    for (auto it = updates.begin(); it != updates.end(); ++it) {
+        if (!allowed.contains(it.key())) {
+            return it.key();
+        }
+    }
+    return QString();
+}
+
+bool parseBody(const drogon::HttpRequestPtr& request, QVariantMap& body)
+{
+    const std::string_view raw = request->body();
+    const QJsonDocument doc = QJsonDocument::fromJson(QByteArray(raw.data(), static_cast<qsizetype>(raw.size())));
+    if (!doc.isObject()) {
+        return false;
+    }
+    body = doc.object().toVariantMap();
+    return true;
+}
+
+QString queryParam(const drogon::HttpRequestPtr& request, const char* name)
+{
+    return QString::fromStdString(request->getParameter(name));
+}
+
+int limitParam(const drogon::HttpRequestPtr& request, int defaultLimit)
+{
+    bool ok = false;
+    const int limit = queryParam(request, "limit").toInt(&ok);
+    return ok && limit > 0 ? std::min(limit, 1000) : defaultLimit;
+}
+
+} // namespace
+
+// 流式列表的游标与输出状态，只在数据库线程访问
+struct RestApi::Stream {
+    QString table;
+    QString cursor;
+    std::shared_ptr<drogon::ResponseStream> output;
+    bool first = true;
+};
+
+RestApi::RestApi(OperationDispatcher* dispatcher)
+    : m_dispatcher(dispatcher)
+{
+}
+
+void RestApi::registerRoutes(HttpServer& server)
+{
+    registerUserRoutes(server);
+    registerProductRoutes(server);
+
+    server.addRoute("/api/stats", drogon::Get,
+        [this](const drogon::HttpRequestPtr&, HttpServer::Callback&& callback) {
+            QVariantMap stats = m_dispatcher->metrics();
+            stats["streams"] = static_cast<quint64>(m_streams.load());
+            callback(jsonResponse(200, stats));
+        });
+}
+
+void RestApi::registerUserRoutes(HttpServer& server)
+{
+    server.addRoute("/api/users", drogon::Get,
+        [this](const drogon::HttpRequestPtr&, HttpServer::Callback&& callback) {
+            replyStream(std::move(callback), "users");
+        });
+
+    server.addRoute("/api/users", drogon::Post,
+        [this](const drogon::HttpRequestPtr& request, HttpServer::Callback&& callback) {
+            QVariantMap body;
+            if (!parseBody(request, body) || body.value("name").toString().isEmpty()
+                || body.value("email").toString().isEmpty()) {
+                callback(errorResponse(400, "需要 name 和 email"));
+                return;
+            }
+            reply(std::move(callback), [body](SQLite3Handler* handler) {
+                return handler->addUser(body["name"].toString(), body["email"].toString(), body.value("age", 0).toInt());
+            }, 201);
+        });
+
+    server.addRoute("/api/users/page", drogon::Get,
+        [this](const drogon::HttpRequestPtr& request, HttpServer::Callback&& callback) {
+            const QString cursor = queryParam(request, "cursor");
+            const int limit = limitParam(request, 100);
+            reply(std::move(callback), [cursor, limit](SQLite3Handler* handler) {
+                return handler->getUsersPage(cursor, limit);
+            });
+        });
+
+    server.addRoute("/api/users/search", drogon::Get,
+        [this](const drogon::HttpRequestPtr& request, HttpServer::Callback&& callback) {
+            const QString name = queryParam(request, "name");
+            const QString email = queryParam(request, "email");
+            const int limit = limitParam(request, 100);
+            if (name.isEmpty() == email.isEmpty()) {
+                callback(errorResponse(400, "name 和 email 需且只需提供一个"));
+                return;
+            }
+            reply(std::move(callback), [name, email, limit](SQLite3Handler* handler) {
+                return name.isEmpty() ? handler->findUsersByEmail(email, limit) : handler->findUsersByName(name, limit);
+            });
+        });
+
+    server.addRoute("/api/users/count", drogon::Get,
+        [this](const drogon::HttpRequestPtr&, HttpServer::Callback&& callback) {
+            reply(std::move(callback), [](SQLite3Handler* handler) { return handler->countUsers(); });
+        });
+
+    server.addRoute("/api/users/{id}", drogon::Get,
+        [this](const drogon::HttpRequestPtr&, HttpServer::Callback&& callback, const std::string& idText) {
+            int id = 0;
+            if (!parseId(idText, id)) {
+                callback(errorResponse(404, "无效的用户 ID"));
+                return;
+            }
+            replyRow(std::move(callback), [id](SQLite3Handler* handler) { return handler->getUserById(id); });
+        });
+
+    server.addRoute("/api/users/{id}", drogon::Put,
+        [this](const drogon::HttpRequestPtr& request, HttpServer::Callback&& callback, const std::string& idText) {
+            int id = 0;
+            QVariantMap updates;
+            if (!parseId(idText, id)) {
+                callback(errorResponse(404, "无效的用户 ID"));
+                return;
+            }
+            if (!parseBody(request, updates) || updates.isEmpty()) {
+                callback(errorResponse(400, "请求体需为非空 JSON 对象"));
+                return;
+            }
+            if (const QString column = unknownColumn(updates, "users"); !column.isEmpty()) {
+                callback(errorResponse(400, QString("不可更新的字段: %1").arg(column)));
+                return;
+            }
+            replyAffected(std::move(callback), [id, updates](SQLite3Handler* handler) {
+                return handler->updateUser(id, updates);
+            });
+        });
+
+    server.addRoute("/api/users/{id}", drogon::Delete,
+        [this](const drogon::HttpRequestPtr&, HttpServer::Callback&& callback, const std::string& idText) {
+            int id = 0;
+            if (!parseId(idText, id)) {
+                callback(errorResponse(404, "无效的用户 ID"));
+                return;
+            }
+            replyAffected(std::move(callback), [id](SQLite3Handler* handler) { return handler->deleteUser(id); });
+        });
+}
+
+void RestApi::registerProductRoutes(HttpServer& server)
+{
+    server.addRoute("/api/products", drogon::Get,
+        [this](const drogon::HttpRequestPtr&, HttpServer::Callback&& callback) {
+            replyStream(std::move(callback), "products");
+        });
+
+    server.addRoute("/api/products", drogon::Post,
+        [this](const drogon::HttpRequestPtr& request, HttpServer::Callback&& callback) {
+            QVariantMap body;
+            if (!parseBody(request, body) || body.value("name").toString().isEmpty() || !body.contains("price")) {
+                callback(errorResponse(400, "需要 name 和 price"));
+                return;
+            }
+            reply(std::move(callback), [body](SQLite3Handler* handler) {
+                return handler->addProduct(body["name"].toString(), body["price"].toDouble(), body.value("stock", 0).toInt());
+            }, 201);
+        });
+
+    // 带 min_price/max_price 时按价格区间分页，否则按 id 分页
+    server.addRoute("/api/products/page", drogon::Get,
+        [this](const drogon::HttpRequestPtr& request, HttpServer::Callback&& callback) {
+            const QString cursor = queryParam(request, "cursor");
+            const int limit = limitParam(request, 100);
+            const QString minText = queryParam(request, "min_price");
+            const QString maxText = queryParam(request, "max_price");
+            if (minText.isEmpty() && maxText.isEmpty()) {
+                reply(std::move(callback), [cursor, limit](SQLite3Handler* handler) {
+                    return handler->getProductsPage(cursor, limit);
+                });
+                return;
+            }
+            bool minOk = false;
+            bool maxOk = false;
+            const double minPrice = minText.toDouble(&minOk);
+            const double maxPrice = maxText.toDouble(&maxOk);
+            if (!minOk || !maxOk) {
+                callback(errorResponse(400, "min_price 和 max_price 需同时提供"));
+                return;
+            }
+            reply(std::move(callback), [minPrice, maxPrice, cursor, limit](SQLite3Handler* handler) {
+                return handler->findProductsByPriceRangePage(minPrice, maxPrice, cursor, limit);
+            });
+        });
+
+    server.addRoute("/api/products/search", drogon::Get,
+        [this](const drogon::HttpRequestPtr& request, HttpServer::Callback&& callback) {
+            const QString name = queryParam(request, "name");
+            const int limit = limitParam(request, 100);
+            if (name.isEmpty()) {
+                callback(errorResponse(400, "需要 name"));
+                return;
+            }
+            reply(std::move(callback), [name, limit](SQLite3Handler* handler) {
+                return handler->findProductsByName(name, limit);
+            });
+        });
+
+    server.addRoute("/api/products/count", drogon::Get,
+        [this](const drogon::HttpRequestPtr&, HttpServer::Callback&& callback) {
+            reply(std::move(callback), [](SQLite3Handler* handler) { return handler->countProducts(); });
+        });
+
+    server.addRoute("/api/products/{id}", drogon::Get,
+        [this](const drogon::HttpRequestPtr&, HttpServer::Callback&& callback, const std::string& idText) {
+            int id = 0;
+            if (!parseId(idText, id)) {
+                callback(errorResponse(404, "无效的产品 ID"));
+                return;
+            }
+            replyRow(std::move(callback), [id](SQLite3Handler* handler) { return handler->getProductById(id); });
+        });
+
+    server.addRoute("/api/products/{id}", drogon::Put,
+        [this](const drogon::HttpRequestPtr& request, HttpServer::Callback&& callback, const std::string& idText) {
+            int id = 0;
+            QVariantMap updates;
+            if (!parseId(idText, id)) {
+                callback(errorResponse(404, "无效的产品 ID"));
+                return;
+            }
+            if (!parseBody(request, updates) || updates.isEmpty()) {
+                callback(errorResponse(400, "请求体需为非空 JSON 对象"));
+                return;
+            }
+            if (const QString column = unknownColumn(updates, "products"); !column.isEmpty()) {
+                callback(errorResponse(400, QString("不可更新的字段: %1").arg(column)));
+                return;
+            }
+            replyAffected(std::move(callback), [id, updates](SQLite3Handler* handler) {
+                return handler->updateProduct(id, updates);
+            });
+        });
+
+    server.addRoute("/api/products/{id}", drogon::Delete,
+        [this](const drogon::HttpRequestPtr&, HttpServer::Callback&& callback, const std::string& idText) {
+            int id = 0;
+            if (!parseId(idText, id)) {
+                callback(errorResponse(404, "无效的产品 ID"));
+                return;
+            }
+            replyAffected(std::move(callback), [id](SQLite3Handler* handler) { return handler->deleteProduct(id); });
+        });
+
+    // 库存增减：{"delta": n}，减库存不足时返回 409
+    server.addRoute("/api/products/{id}/stock", drogon::Post,
+        [this](const drogon::HttpRequestPtr& request, HttpServer::Callback&& callback, const std::string& idText) {
+            int id = 0;
+            QVariantMap body;
+            if (!parseId(idText, id)) {
+                callback(errorResponse(404, "无效的产品 ID"));
+                return;
+            }
+            const int delta = parseBody(request, body) ? body.value("delta").toInt() : 0;
+            if (delta == 0) {
+                callback(errorResponse(400, "需要非零的 delta"));
+                return;
+            }
+            replyAffected(std::move(callback), [id, delta](SQLite3Handler* handler) {
+                return delta > 0 ? handler->increaseProductStock(id, delta) : handler->decreaseProductStock(id, -delta);
+            }, 409);
+        });
+
+    // 库存直接设置：{"stock": n}
+    server.addRoute("/api/products/{id}/stock", drogon::Put,
+        [this](const drogon::HttpRequestPtr& request, HttpServer::Callback&& callback, const std::string& idText) {
+            int id = 0;
+            QVariantMap body;
+            if (!parseId(idText, id)) {
+                callback(errorResponse(404, "无效的产品 ID"));
+                return;
+            }
+            if (!parseBody(request, body) || !body.contains("stock") || body["stock"].toInt() < 0) {
+                callback(errorResponse(400, "需要非负的 stock"));
+                return;
+            }
+            const int stock = body["stock"].toInt();
+            replyAffected(std::move(callback), [id, stock](SQLite3Handler* handler) {
+                return handler->updateProductStock(id, stock);
+            });
+        });
+}
+
+void RestApi::reply(HttpServer::Callback&& callback, Starter starter, int okStatus)
+{
+    auto respond = std::make_shared<HttpServer::Callback>(std::move(callback));
+    const bool accepted = m_dispatcher->submit(std::move(starter), [respond, okStatus](bool success, const QVariant& result) {
+        (*respond)(success ? jsonResponse(okStatus, result) : failureResponse(result));
+    });
+    if (!accepted) {
+        (*respond)(errorResponse(503, "服务繁忙"));
+    }
+}
+
+void RestApi::replyRow(HttpServer::Callback&& callback, Starter starter)
+{
+    auto respond = std::make_shared<HttpServer::Callback>(std::move(callback));
+    const bool accepted = m_dispatcher->submit(std::move(starter), [respond](bool success, const QVariant& result) {
+        if (!success) {
+            (*respond)(failureResponse(result));
+            return;
+        }
+        const QVariantList rows = result.toList();
+        (*respond)(rows.isEmpty() ? errorResponse(404, "记录不存在") : jsonResponse(200, rows.first()));
+    });
+    if (!accepted) {
+        (*respond)(errorResponse(503, "服务繁忙"));
+    }
+}
+
+void RestApi::replyAffected(HttpServer::Callback&& callback, Starter starter, int conflictStatus)
+{
+    auto respond = std::make_shared<HttpServer::Callback>(std::move(callback));
+    const bool accepted = m_dispatcher->submit(std::move(starter), [respond, conflictStatus](bool success, const QVariant& result) {
+        if (!success) {
+            (*respond)(failureResponse(result));
+        } else if (result.toMap().value("affected_rows").toInt() == 0) {
+            (*respond)(errorResponse(conflictStatus, conflictStatus == 404 ? "记录不存在" : "产品不存在或库存不足"));
+        } else {
+            (*respond)(jsonResponse(200, result));
+        }
+    });
+    if (!accepted) {
+        (*respond)(errorResponse(503, "服务繁忙"));
+    }
+}
+
+// 全表列表：先发出响应头，再逐页取数写出 JSON 数组，写入失败（客户端断开）时停止
+void RestApi::replyStream(HttpServer::Callback&& callback, const QString& table)
+{
+    m_streams.fetch_add(1, std::memory_order_relaxed);
+    auto response = drogon::HttpResponse::newAsyncStreamResponse([this, table](drogon::ResponseStreamPtr output) {
+        auto stream = std::make_shared<Stream>();
+        stream->table = table;
+        stream->output = std::shared_ptr<drogon::ResponseStream>(output.release());
+        streamNextPage(stream);
+    });
+    response->setContentTypeCode(drogon::CT_APPLICATION_JSON);
+    callback(response);
+}
+
+void RestApi::streamNextPage(std::shared_ptr<Stream> stream)
+{
+    const bool accepted = m_dispatcher->submit(
+        [stream](SQLite3Handler* handler) {
+            return stream->table == "users"
+                ? handler->getUsersPage(stream->cursor, kStreamPageSize)
+                : handler->getProductsPage(stream->cursor, kStreamPageSize);
+        },
+        [this, stream](bool success, const QVariant& result) {
+            if (!success) {
+                qWarning() << "流式列表读取失败:" << stream->table << result.toString();
+                stream->output->close(); // 不补齐结尾，客户端据此判断响应不完整
+                return;
+            }
+
+            const QVariantMap page = result.toMap();
+            QByteArray chunk;
+            for (const QVariant& row : page.value("rows").toList()) {
+                chunk.append(stream->first ? '[' : ',');
+                chunk.append(QJsonDocument(QJsonObject::fromVariantMap(row.toMap())).toJson(QJsonDocument::Compact));
+                stream->first = false;
+            }
+
+            const bool hasMore = page.value("has_more").toBool();
+            if (!hasMore) {
+                chunk.append(stream->first ? "[]" : "]");
+            }
+            if (!stream->output->send(chunk.toStdString())) {
+                stream->output->close();
+                return;
+            }
+            if (!hasMore) {
+                stream->output->close();
+                return;
+            }
+            stream->cursor = page.value("next_cursor").toString();
+            streamNextPage(stream);
+        });
+
+    if (!accepted) {
+        stream->output->close();
+    }
+}
@@ -0,0 +1,43 @@
+// restapi.h
+#ifndef RESTAPI_H
+#define RESTAPI_H
+
+#include "httpserver.h"
+#include "operationdispatcher.h"
+#include <QString>
+#include <atomic>
+#include <memory>
+
+// 用户/产品的 REST 接口，挂在内嵌的 HttpServer 上
+// 操作经 OperationDispatcher 批量投递到数据库线程，完成时在数据库线程中直接应答；
+// 全表列表按键集分页流式输出，内存占用与表大小无关
+class RestApi {
+public:
+    using Starter = OperationDispatcher::Starter;
+
+    explicit RestApi(OperationDispatcher* dispatcher);
+
+    // 需在 server.start() 之前调用；本对象与 dispatcher 必须比 server 活得久
+    void registerRoutes(HttpServer& server);
+
+private:
+    struct Stream;
+
+    static constexpr int kStreamPageSize = 500;
+
+    void registerUserRoutes(HttpServer& server);
+    void registerProductRoutes(HttpServer& server);
+    // 提交并把结果写成 JSON 响应；okStatus 为成功时的状态码
+    void reply(HttpServer::Callback&& callback, Starter starter, int okStatus = 200);
+    // 按 id 的单行读取/修改：结果为空时返回 404，未影响任何行时返回 conflictStatus
+    void replyRow(HttpServer::Callback&& callback, Starter starter);
+    void replyAffected(HttpServer::Callback&& callback, Starter starter, int conflictStatus = 404);
+    void replyStream(HttpServer::Callback&& callback, const QString& table);
+    // 数据库线程
+    void streamNextPage(std::shared_ptr<Stream> stream);
+
+    OperationDispatcher* m_dispatcher;
+    std::atomic<quint64> m_streams { 0 };
+};
+
+#endif // RESTAPI_H
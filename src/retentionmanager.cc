@@ -0,0 +1,238 @@
+// retentionmanager.cc
+#include "retentionmanager.h"
+#include "sqlite3statemachine.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <algorithm>
+#include <sqlite3.h>
+
+namespace {
+constexpr int kMinBatchSize = 10;
+constexpr int kMaxBatchSize = 5000;
+}
+
+RetentionManager::RetentionManager(SQLite3StateMachine* stateMachine, QObject* parent)
+    : QObject(parent)
+    , m_stateMachine(stateMachine)
+{
+    m_timer.setSingleShot(true);
+    connect(&m_timer, &QTimer::timeout, this, &RetentionManager::step);
+    setPolicy(m_policy);
+}
+
+void RetentionManager::setPolicy(const RetentionPolicy& policy)
+{
+    m_policy = policy;
+    m_batchSize = std::clamp(policy.batchSize, kMinBatchSize, kMaxBatchSize);
+    m_vacuumPages = std::max(1, policy.incrementalVacuumPages);
+}
+
+QVariantMap RetentionManager::metrics() const
+{
+    QVariantMap result;
+    result["operation_queue_purged"] = static_cast<quint64>(m_operationQueuePurged.load());
+    result["app_state_purged"] = static_cast<quint64>(m_appStatePurged.load());
+    result["batches"] = static_cast<quint64>(m_batches.load());
+    result["pages_vacuumed"] = static_cast<quint64>(m_pagesVacuumed.load());
+    result["last_batch_ms"] = static_cast<qint64>(m_lastBatchMs.load());
+    result["max_batch_ms"] = static_cast<qint64>(m_maxBatchMs.load());
+    return result;
+}
+
+void RetentionManager::start()
+{
+    soci::session* session = m_stateMachine->getSession();
+    if (!session) {
+        return;
+    }
+
+    // auto_vacuum 只能在建表前设置，旧库需要一次完整 VACUUM 才能切换
+    try {
+        int autoVacuum = 0;
+        *session << "PRAGMA auto_vacuum", soci::into(autoVacuum);
+        m_incrementalVacuum = (autoVacuum == 2);
+        if (!m_incrementalVacuum) {
+            qWarning() << "数据库未启用 auto_vacuum=INCREMENTAL，清理后的空间不会归还给文件系统";
+        }
+    } catch (const std::exception& e) {
+        qWarning() << "读取 auto_vacuum 失败:" << e.what();
+    }
+
+    scheduleNextStep(false);
+    qDebug() << "保留策略已启动，周期:" << m_policy.intervalMs << "ms";
+}
+
+void RetentionManager::stop()
+{
+    m_timer.stop();
+}
+
+void RetentionManager::step()
+{
+    if (!m_policy.enabled || !isIdle()) {
+        scheduleNextStep(false);
+        return;
+    }
+
+    const Target targets[] = {
+        { "operation_queue", "created_at", m_policy.operationQueueMaxAgeDays, m_policy.operationQueueMaxRows },
+        { "app_state", "timestamp", m_policy.appStateMaxAgeDays, m_policy.appStateMaxRows },
+    };
+    constexpr int targetCount = sizeof(targets) / sizeof(targets[0]);
+
+    try {
+        // 轮流清理各表，每次只跑一批，然后让出事件循环给队列
+        for (int i = 0; i < targetCount; ++i) {
+            const int index = (m_nextTarget + i) % targetCount;
+            const int purged = purgeBatch(targets[index]);
+            if (purged > 0) {
+                m_nextTarget = (index + 1) % targetCount;
+                m_vacuumPending = true;
+                emit rowsPurged(targets[index].table, purged);
+                scheduleNextStep(true);
+                return;
+            }
+        }
+
+        if (m_vacuumPending && m_incrementalVacuum) {
+            if (incrementalVacuum() > 0) {
+                scheduleNextStep(true);
+                return;
+            }
+            m_vacuumPending = false;
+        }
+    } catch (const std::exception& e) {
+        qWarning() << "保留策略执行失败:" << e.what();
+    }
+
+    scheduleNextStep(false);
+}
+
+bool RetentionManager::isIdle() const
+{
+    return m_stateMachine->isConnected()
+        && m_stateMachine->queueSize() == 0
+        && !m_stateMachine->isProcessing();
+}
+
+int RetentionManager::purgeBatch(const Target& target)
+{
+    soci::session* session = m_stateMachine->getSession();
+    if (!session || (target.maxAgeDays <= 0 && target.maxRows <= 0)) {
+        return 0;
+    }
+
+    const std::string table = target.table;
+    const std::string ageCondition = target.maxAgeDays > 0
+        ? "t < datetime('now', '-" + std::to_string(target.maxAgeDays) + " days')"
+        : "0";
+    const std::string countCondition = target.maxRows > 0
+        ? "id <= (SELECT MAX(id) FROM " + table + ") - " + std::to_string(target.maxRows)
+        : "0";
+
+    // 读阶段：只看主键最小的 m_batchSize 行，求出本批可删除的主键上界；
+    // id 与时间同向增长，满足条件的行集中在表头，不需要全表扫描
+    const std::string boundSql = "SELECT MAX(id) FROM (SELECT id, " + std::string(target.timeColumn)
+        + " AS t FROM " + table + " ORDER BY id LIMIT " + std::to_string(m_batchSize) + ")"
+        + " WHERE " + ageCondition + " OR " + countCondition;
+
+    long long bound = 0;
+    soci::indicator boundIndicator = soci::i_null;
+    *session << boundSql, soci::into(bound, boundIndicator);
+    if (boundIndicator != soci::i_ok) {
+        return 0; // 没有需要清理的行
+    }
+
+    // 写阶段：按主键范围删除，最多 m_batchSize 行
+    QElapsedTimer timer;
+    timer.start();
+
+    int affected = 0;
+    {
+        soci::transaction tr(*session);
+
+        if (m_policy.archive) {
+            *session << "CREATE TABLE IF NOT EXISTS " + table + "_archive AS SELECT * FROM " + table + " WHERE 0";
+            *session << "INSERT INTO " + table + "_archive SELECT * FROM " + table + " WHERE id <= :bound",
+                soci::use(bound);
+        }
+
+        soci::statement st = (session->prepare << "DELETE FROM " + table + " WHERE id <= :bound", soci::use(bound));
+        st.execute(true);
+        affected = static_cast<int>(st.get_affected_rows());
+
+        tr.commit();
+    }
+
+    const qint64 elapsedMs = timer.elapsed();
+    m_batches.fetch_add(1, std::memory_order_relaxed);
+    m_lastBatchMs = elapsedMs;
+    if (elapsedMs > m_maxBatchMs.load()) {
+        m_maxBatchMs = elapsedMs;
+    }
+
+    if (table == "operation_queue") {
+        m_operationQueuePurged.fetch_add(affected, std::memory_order_relaxed);
+    } else {
+        m_appStatePurged.fetch_add(affected, std::memory_order_relaxed);
+    }
+
+    adaptBatchSize(elapsedMs, affected);
+    return affected;
+}
+
+int RetentionManager::incrementalVacuum()
+{
+    soci::session* session = m_stateMachine->getSession();
+    sqlite3* db = m_stateMachine->nativeHandle();
+    if (!session || !db) {
+        return 0;
+    }
+
+    int freeBefore = 0;
+    *session << "PRAGMA freelist_count", soci::into(freeBefore);
+    if (freeBefore <= 0) {
+        return 0;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // PRAGMA incremental_vacuum 每释放一页返回一行，用 sqlite3_exec 才会执行到结束
+    const std::string sql = "PRAGMA incremental_vacuum(" + std::to_string(m_vacuumPages) + ")";
+    char* errorMessage = nullptr;
+    if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &errorMessage) != SQLITE_OK) {
+        qWarning() << "incremental_vacuum 失败:" << (errorMessage ? errorMessage : "");
+        sqlite3_free(errorMessage);
+        return 0;
+    }
+
+    int freeAfter = 0;
+    *session << "PRAGMA freelist_count", soci::into(freeAfter);
+
+    const int freed = std::max(0, freeBefore - freeAfter);
+    m_pagesVacuumed.fetch_add(freed, std::memory_order_relaxed);
+
+    // 和删除批次一样按耗时调整每步页数
+    const qint64 elapsedMs = timer.elapsed();
+    if (elapsedMs > m_policy.maxLockMs) {
+        m_vacuumPages = std::max(1, m_vacuumPages / 2);
+    } else if (elapsedMs * 2 < m_policy.maxLockMs && freed >= m_vacuumPages) {
+        m_vacuumPages = std::min(m_vacuumPages * 2, 4096);
+    }
+    return freed;
+}
+
+void RetentionManager::adaptBatchSize(qint64 elapsedMs, int affected)
+{
+    if (elapsedMs > m_policy.maxLockMs) {
+        m_batchSize = std::max(kMinBatchSize, m_batchSize / 2);
+    } else if (elapsedMs * 2 < m_policy.maxLockMs && affected >= m_batchSize) {
+        m_batchSize = std::min(kMaxBatchSize, m_batchSize * 2);
+    }
+}
+
+void RetentionManager::scheduleNextStep(bool immediate)
+{
+    m_timer.start(immediate ? 0 : m_policy.intervalMs);
+}
@@ -0,0 +1,84 @@
+// retentionmanager.h
+#ifndef RETENTIONMANAGER_H
+#define RETENTIONMANAGER_H
+
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <QVariantMap>
+#include <atomic>
+
+class SQLite3StateMachine;
+
+// 保留策略，时间/数量为 0 表示不按该条件清理
+struct RetentionPolicy {
+    bool enabled = true;
+    int operationQueueMaxAgeDays = 7;
+    int operationQueueMaxRows = 100000;
+    int appStateMaxAgeDays = 30;
+    int appStateMaxRows = 10000;
+    bool archive = false; // 删除前复制到 <table>_archive
+    int batchSize = 200; // 初始批大小，按耗时自适应
+    int maxLockMs = 5; // 单批持有写锁的预算
+    int intervalMs = 2000; // 空闲检查周期
+    int incrementalVacuumPages = 64; // 每步归还的空闲页数
+};
+
+// operation_queue / app_state 的保留与压缩
+// 运行在数据库线程，只在队列空闲时工作；每批只删除按主键定位的一小段行，
+// 批与批之间让出事件循环，写锁持有时间控制在 maxLockMs 左右
+class RetentionManager : public QObject {
+    Q_OBJECT
+
+public:
+    explicit RetentionManager(SQLite3StateMachine* stateMachine, QObject* parent = nullptr);
+
+    void setPolicy(const RetentionPolicy& policy);
+    RetentionPolicy policy() const { return m_policy; }
+
+    // 线程安全的指标读取
+    QVariantMap metrics() const;
+
+public slots:
+    void start();
+    void stop();
+
+signals:
+    void rowsPurged(const QString& table, int rows);
+
+private slots:
+    void step();
+
+private:
+    struct Target {
+        const char* table;
+        const char* timeColumn;
+        int maxAgeDays;
+        int maxRows;
+    };
+
+    bool isIdle() const;
+    int purgeBatch(const Target& target);
+    int incrementalVacuum();
+    void adaptBatchSize(qint64 elapsedMs, int affected);
+    void scheduleNextStep(bool immediate);
+
+    SQLite3StateMachine* m_stateMachine;
+    RetentionPolicy m_policy;
+    QTimer m_timer;
+
+    int m_batchSize = 0;
+    int m_vacuumPages = 0;
+    int m_nextTarget = 0;
+    bool m_incrementalVacuum = false;
+    bool m_vacuumPending = false;
+
+    std::atomic<quint64> m_operationQueuePurged { 0 };
+    std::atomic<quint64> m_appStatePurged { 0 };
+    std::atomic<quint64> m_batches { 0 };
+    std::atomic<quint64> m_pagesVacuumed { 0 };
+    std::atomic<qint64> m_lastBatchMs { 0 };
+    std::atomic<qint64> m_maxBatchMs { 0 };
+};
+
+#endif // RETENTIONMANAGER_H
@@ -0,0 +1,33 @@
+// simdkernels.h
+#ifndef SIMDKERNELS_H
+#define SIMDKERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// 列式数据上的过滤/聚合内核
+// x86-64 上运行时检测 AVX2，aarch64 上使用 NEON，其他平台走标量实现；
+// 不依赖 Qt，基准程序可以单独链接
+namespace simd {
+
+// 当前使用的实现："avx2" / "neon" / "scalar"
+const char* activeKernel();
+
+// 强制使用标量实现（用于基准对比和结果校验）
+void forceScalar(bool enabled);
+
+// sum(price[i] * stock[i])
+double sumProduct(const double* price, const int32_t* stock, std::size_t n);
+
+// count(stock[i] < threshold)
+std::size_t countLess(const int32_t* stock, std::size_t n, int32_t threshold);
+
+// count(lo <= price[i] <= hi)
+std::size_t countInRange(const double* price, std::size_t n, double lo, double hi);
+
+// 等宽直方图：[lo, hi) 分成 bins 个桶，counts 需预先置零；区间外的值不计入
+void histogram(const double* price, std::size_t n, double lo, double hi, int bins, uint64_t* counts);
+
+} // namespace simd
+
+#endif // SIMDKERNELS_H
@@ -1,10 +1,46 @@
 // sqlite3handler.cc
 #include "sqlite3handler.h"
 #include <QDebug>
+#include <QFileInfo>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QSet>
 #include <QTimer>
+#include <algorithm>
+#include <sqlite3.h>
+
+namespace {
+// 名称搜索默认返回条数
+constexpr int kDefaultSearchLimit = 100;
+// 分页默认每页条数
+constexpr int kDefaultPageLimit = 100;
+
+// 允许投影的列，列名会直接拼进 SQL，必须走白名单
+const QStringList kUserColumns = { "id", "name", "email", "age", "created_at" };
+const QStringList kProductColumns = { "id", "name", "price", "stock", "created_at" };
+// 可由调用方更新的列：主键和创建时间不可改
+const QStringList kUserUpdatableColumns = { "name", "email", "age" };
+const QStringList kProductUpdatableColumns = { "name", "price", "stock" };
+
+// 批量 upsert 每条语句的行数，参数个数远低于 SQLITE_MAX_VARIABLE_NUMBER
+constexpr int kBulkUpsertRows = 200;
+
+// 单行写入的合并描述；覆盖写按列集合区分，只有列集合相同的更新才会合并
+CoalesceSpec rowWrite(const std::string& table, int id, const std::string& key, const std::string& deltaParam = std::string())
+{
+    CoalesceSpec spec;
+    spec.row = table + ":" + std::to_string(id);
+    spec.key = key;
+    spec.deltaParam = deltaParam;
+    return spec;
+}
+
+std::string setKey(const QVariantMap& updates)
+{
+    return "set:" + QStringList(updates.keys()).join(",").toStdString();
+}
+}
 
 SQLite3Handler::SQLite3Handler(const QString& dbFile, QObject* parent)
     : QObject(parent)
@@ -12,6 +48,8 @@ SQLite3Handler::SQLite3Handler(const QString& dbFile, QObject* parent)
     , m_initialized(false)
 {
     m_stateMachine = new SQLite3StateMachine(dbFile, this);
+    m_stateMachine->setTraceRecorder(&m_trace);
+    m_stateMachine->setWorkloadCapture(&m_capture);
 
     // 连接状态机信号
     connect(m_stateMachine, &SQLite3StateMachine::operationCompleted,
@@ -22,11 +60,16 @@ SQLite3Handler::SQLite3Handler(const QString& dbFile, QObject* parent)
         this, &SQLite3Handler::onConnectionLost);
     connect(m_stateMachine, &SQLite3StateMachine::errorOccurred,
         this, &SQLite3Handler::onErrorOccurred);
+    connect(m_stateMachine, &SQLite3StateMachine::stateChanged,
+        this, &SQLite3Handler::stateChanged);
 }
 
 SQLite3Handler::~SQLite3Handler()
 {
     shutdown();
+    // 状态机作为子对象晚于成员析构
+    m_stateMachine->setTraceRecorder(nullptr);
+    m_stateMachine->setWorkloadCapture(nullptr);
 }
 
 bool SQLite3Handler::initialize()
@@ -52,11 +95,23 @@ QString SQLite3Handler::addUser(const QString& name, const QString& email, int a
     data["email"] = email;
     data["age"] = age;
 
+    // 过滤器判定一定不存在时直接插入；可能存在时用 NOT EXISTS 确认，重复不会触发约束异常。
+    // 排队中的插入按操作 ID 登记在过滤器里，完成时凭 ID 释放
+    const QString operationId = QString::fromStdString(OperationRequest::generateUUID());
+    QVariantMap context;
+    bool guarded = false;
+    EmailFilter* filter = m_emailFilter.load(std::memory_order_acquire);
+    if (filter && filter->isReady()) {
+        guarded = filter->beginInsert(operationId, EmailFilter::hashEmail(email));
+    }
+    context["uniqueEmail"] = guarded;
+    context["email"] = email;
+
     std::map<std::string, std::string> params;
-    std::string query = buildInsertUserQuery(data, params);
+    std::string query = guarded ? buildGuardedInsertUserQuery(data, params) : buildInsertUserQuery(data, params);
 
-    QString operationId = m_stateMachine->executeQuery(QString::fromStdString(query), params);
-    setOperationType(operationId, "addUser");
+    beginOperation("addUser", context, operationId);
+    m_stateMachine->executeQuery(QString::fromStdString(query), params, operationId);
     return operationId;
 }
 
@@ -68,9 +123,13 @@ QString SQLite3Handler::updateUser(int userId, const QVariantMap& updates)
 
     std::map<std::string, std::string> params;
     std::string query = buildUpdateUserQuery(userId, updates, params);
+    if (query.empty()) {
+        return QString();
+    }
 
-    QString operationId = m_stateMachine->executeQuery(QString::fromStdString(query), params);
-    setOperationType(operationId, "updateUser");
+    const QString operationId = beginOperation("updateUser");
+    m_stateMachine->executeWrite(QString::fromStdString(query), params,
+        rowWrite("users", userId, setKey(updates)), operationId);
     return operationId;
 }
 
@@ -80,49 +139,157 @@ QString SQLite3Handler::deleteUser(int userId)
     std::map<std::string, std::string> params;
     params["id"] = std::to_string(userId);
 
-    QString operationId = m_stateMachine->executeQuery(QString::fromStdString(query), params);
-    setOperationType(operationId, "deleteUser");
+    const QString operationId = beginOperation("deleteUser");
+    m_stateMachine->executeQuery(QString::fromStdString(query), params, operationId);
     return operationId;
 }
 
-QString SQLite3Handler::getUserById(int userId)
+QString SQLite3Handler::getUserById(int userId, const QStringList& columns)
 {
-    std::string query = "SELECT * FROM users WHERE id = :id";
+    std::string query = "SELECT " + buildColumnList("users", columns) + " FROM users WHERE id = :id";
     std::map<std::string, std::string> params;
     params["id"] = std::to_string(userId);
 
-    QString operationId = m_stateMachine->executeQuery(QString::fromStdString(query), params);
-    setOperationType(operationId, "getUser");
+    const QString operationId = beginOperation("getUser");
+    m_stateMachine->executeQuery(QString::fromStdString(query), params, operationId);
+    return operationId;
+}
+
+QString SQLite3Handler::getAllUsers(const QStringList& columns)
+{
+    std::string query = "SELECT " + buildColumnList("users", columns) + " FROM users ORDER BY id";
+    const QString operationId = beginOperation("getAllUsers");
+    m_stateMachine->executeQuery(QString::fromStdString(query), {}, operationId);
+    return operationId;
+}
+
+QString SQLite3Handler::findUsersByName(const QString& name, int limit)
+{
+    std::map<std::string, std::string> params;
+    std::string query = buildNameSearchQuery("users", "name", name, limit, params);
+
+    const QString operationId = beginOperation("findUsersByName");
+    m_stateMachine->executeQuery(QString::fromStdString(query), params, operationId);
+    return operationId;
+}
+
+QString SQLite3Handler::findUsersByEmail(const QString& email, int limit)
+{
+    std::map<std::string, std::string> params;
+    std::string query = buildNameSearchQuery("users", "email", email, limit, params);
+
+    const QString operationId = beginOperation("findUsersByEmail");
+    m_stateMachine->executeQuery(QString::fromStdString(query), params, operationId);
+    return operationId;
+}
+
+QString SQLite3Handler::getUsersPage(const QString& cursor, int limit, const QStringList& columns)
+{
+    QVariantMap after;
+    if (!cursor.isEmpty() && !decodeCursor(cursor, after)) {
+        qWarning() << "无效的分页游标:" << cursor;
+        return QString();
+    }
+
+    limit = limit > 0 ? limit : kDefaultPageLimit;
+
+    // 多取一行用来判断是否还有下一页
+    // 游标需要 id，投影时自动带上
+    std::string query = "SELECT " + buildColumnList("users", columns, { "id" })
+        + " FROM users WHERE id > :after ORDER BY id LIMIT :limit";
+    std::map<std::string, std::string> params;
+    params["after"] = std::to_string(after.value("id", 0).toLongLong());
+    params["limit"] = std::to_string(limit + 1);
+
+    const QString operationId = beginOperation("getUsersPage", { { "page", "id" }, { "limit", limit } });
+    m_stateMachine->executeQuery(QString::fromStdString(query), params, operationId);
+    return operationId;
+}
+
+QString SQLite3Handler::getUsersByIds(const QList<int>& userIds, const QStringList& columns)
+{
+    std::map<std::string, std::string> params;
+    QVariantMap context;
+    std::string query = buildMultiGetQuery("users", userIds, columns, params, context);
+
+    const QString operationId = beginOperation("getUsersByIds", context);
+    m_stateMachine->executeQuery(QString::fromStdString(query), params, operationId);
     return operationId;
 }
 
-QString SQLite3Handler::getAllUsers()
+QString SQLite3Handler::upsertUser(const QString& name, const QString& email, int age)
 {
-    std::string query = "SELECT * FROM users ORDER BY id";
-    QString operationId = m_stateMachine->executeQuery(QString::fromStdString(query));
-    setOperationType(operationId, "getAllUsers");
+    std::string query = "INSERT INTO users (name, email, age) VALUES (:name, :email, :age)"
+                        " ON CONFLICT(email) DO UPDATE SET name = excluded.name, age = excluded.age"
+                        " RETURNING *";
+    std::map<std::string, std::string> params;
+    params["name"] = name.toStdString();
+    params["email"] = email.toStdString();
+    params["age"] = std::to_string(age);
+
+    const QString operationId = beginOperation("upsertUser", { { "returning", "row" } });
+    m_stateMachine->executeReturningQuery(QString::fromStdString(query), params, operationId);
     return operationId;
 }
 
-QString SQLite3Handler::findUsersByName(const QString& name)
+QString SQLite3Handler::compareAndSetUser(int userId, const QVariantMap& expected, const QVariantMap& updates)
 {
-    std::string query = "SELECT * FROM users WHERE name LIKE :name ORDER BY id";
     std::map<std::string, std::string> params;
-    params["name"] = "%" + name.toStdString() + "%";
+    std::string query = buildCompareAndSetQuery("users", userId, expected, updates, params);
+    if (query.empty()) {
+        return QString();
+    }
+
+    const QString operationId = beginOperation("compareAndSetUser", { { "returning", "cas" } });
+    m_stateMachine->executeReturningQuery(QString::fromStdString(query), params, operationId);
+    return operationId;
+}
+
+QStringList SQLite3Handler::bulkUpsertUsers(const QVariantList& users)
+{
+    QStringList operationIds;
+
+    for (qsizetype offset = 0; offset < users.size(); offset += kBulkUpsertRows) {
+        const QVariantList chunk = users.mid(offset, kBulkUpsertRows);
+
+        std::map<std::string, std::string> params;
+        QStringList values;
+        for (qsizetype i = 0; i < chunk.size(); ++i) {
+            const QVariantMap user = chunk[i].toMap();
+            const std::string suffix = "_" + std::to_string(i);
+            values << QString::fromStdString("(:name" + suffix + ", :email" + suffix + ", :age" + suffix + ")");
+            params["name" + suffix] = user["name"].toString().toStdString();
+            params["email" + suffix] = user["email"].toString().toStdString();
+            params["age" + suffix] = std::to_string(user["age"].toInt());
+        }
+
+        std::string query = "INSERT INTO users (name, email, age) VALUES " + values.join(", ").toStdString()
+            + " ON CONFLICT(email) DO UPDATE SET name = excluded.name, age = excluded.age RETURNING *";
+
+        const QString operationId = beginOperation("bulkUpsertUsers");
+        m_stateMachine->executeReturningQuery(QString::fromStdString(query), params, operationId);
+        operationIds << operationId;
+    }
+
+    return operationIds;
+}
 
-    QString operationId = m_stateMachine->executeQuery(QString::fromStdString(query), params);
-    setOperationType(operationId, "findUsersByName");
+QString SQLite3Handler::countUsers()
+{
+    const QString operationId = beginOperation("countUsers", { { "scalar", "count" } });
+    m_stateMachine->executeScalarQuery("SELECT COUNT(*) FROM users", {}, operationId);
     return operationId;
 }
 
-QString SQLite3Handler::findUsersByEmail(const QString& email)
+QString SQLite3Handler::existsUserByEmail(const QString& email)
 {
-    std::string query = "SELECT * FROM users WHERE email LIKE :email ORDER BY id";
+    // EXISTS 命中 idx_users_email 后立即返回，不读取整行
+    std::string query = "SELECT EXISTS(SELECT 1 FROM users WHERE email = :email)";
     std::map<std::string, std::string> params;
-    params["email"] = "%" + email.toStdString() + "%";
+    params["email"] = email.toStdString();
 
-    QString operationId = m_stateMachine->executeQuery(QString::fromStdString(query), params);
-    setOperationType(operationId, "findUsersByEmail");
+    const QString operationId = beginOperation("existsUserByEmail", { { "scalar", "exists" } });
+    m_stateMachine->executeScalarQuery(QString::fromStdString(query), params, operationId);
     return operationId;
 }
 
@@ -137,8 +304,8 @@ QString SQLite3Handler::addProduct(const QString& name, double price, int stock)
     std::map<std::string, std::string> params;
     std::string query = buildInsertProductQuery(data, params);
 
-    QString operationId = m_stateMachine->executeQuery(QString::fromStdString(query), params);
-    setOperationType(operationId, "addProduct");
+    const QString operationId = beginOperation("addProduct");
+    m_stateMachine->executeQuery(QString::fromStdString(query), params, operationId);
     return operationId;
 }
 
@@ -148,41 +315,49 @@ QString SQLite3Handler::updateProduct(int productId, const QVariantMap& updates)
         return QString();
     }
 
+    evictHotStock(productId);
+
     std::map<std::string, std::string> params;
     std::string query = buildUpdateProductQuery(productId, updates, params);
+    if (query.empty()) {
+        return QString();
+    }
 
-    QString operationId = m_stateMachine->executeQuery(QString::fromStdString(query), params);
-    setOperationType(operationId, "updateProduct");
+    const QString operationId = beginOperation("updateProduct");
+    m_stateMachine->executeWrite(QString::fromStdString(query), params,
+        rowWrite("products", productId, setKey(updates)), operationId);
     return operationId;
 }
 
 QString SQLite3Handler::deleteProduct(int productId)
 {
+    evictHotStock(productId);
+
     std::string query = "DELETE FROM products WHERE id = :id";
     std::map<std::string, std::string> params;
     params["id"] = std::to_string(productId);
 
-    QString operationId = m_stateMachine->executeQuery(QString::fromStdString(query), params);
-    setOperationType(operationId, "deleteProduct");
+    const QString operationId = beginOperation("deleteProduct");
+    m_stateMachine->executeQuery(QString::fromStdString(query), params, operationId);
     return operationId;
 }
 
-QString SQLite3Handler::getProductById(int productId)
+QString SQLite3Handler::getProductById(int productId, const QStringList& columns)
 {
-    std::string query = "SELECT * FROM products WHERE id = :id";
+    std::string query = "SELECT " + buildColumnList("products", columns) + " FROM products WHERE id = :id";
     std::map<std::string, std::string> params;
     params["id"] = std::to_string(productId);
 
-    QString operationId = m_stateMachine->executeQuery(QString::fromStdString(query), params);
-    setOperationType(operationId, "getProduct");
+    const QString operationId = beginOperation("getProduct");
+    m_stateMachine->executeQuery(QString::fromStdString(query), params, operationId);
     return operationId;
 }
 
-QString SQLite3Handler::getAllProducts()
+QString SQLite3Handler::getAllProducts(const QStringList& columns)
 {
-    std::string query = "SELECT * FROM products ORDER BY id";
-    QString operationId = m_stateMachine->executeQuery(QString::fromStdString(query));
-    setOperationType(operationId, "getAllProducts");
+    std::string query = "SELECT " + buildColumnList("products", columns) + " FROM products ORDER BY id";
+    const QString operationId = beginOperation("getAllProducts");
+    m_stateMachine->executeQuery(QString::fromStdString(query), {}, operationId);
     return operationId;
 }
 
@@ -194,64 +369,264 @@ QString SQLite3Handler::findProductsByPriceRange(double minPrice, double maxPric
     params["minPrice"] = std::to_string(minPrice);
     params["maxPrice"] = std::to_string(maxPrice);
 
-    QString operationId = m_stateMachine->executeQuery(QString::fromStdString(query), params);
-    setOperationType(operationId, "findProductsByPriceRange");
+    const QString operationId = beginOperation("findProductsByPriceRange");
+    m_stateMachine->executeQuery(QString::fromStdString(query), params, operationId);
+    return operationId;
+}
+
+bool SQLite3Handler::findProductsByPriceRangeCached(double minPrice, double maxPrice, QVariantList& rows, int limit) const
+{
+    const ProductPriceIndex* index = m_priceIndex.load(std::memory_order_acquire);
+    if (!index || !index->isReady()) {
+        return false;
+    }
+    rows = index->findRange(minPrice, maxPrice, limit);
+    return true;
+}
+
+QString SQLite3Handler::findProductsByName(const QString& name, int limit)
+{
+    std::map<std::string, std::string> params;
+    std::string query = buildNameSearchQuery("products", "name", name, limit, params);
+
+    const QString operationId = beginOperation("findProductsByName");
+    m_stateMachine->executeQuery(QString::fromStdString(query), params, operationId);
+    return operationId;
+}
+
+QString SQLite3Handler::getProductsPage(const QString& cursor, int limit, const QStringList& columns)
+{
+    QVariantMap after;
+    if (!cursor.isEmpty() && !decodeCursor(cursor, after)) {
+        qWarning() << "无效的分页游标:" << cursor;
+        return QString();
+    }
+
+    limit = limit > 0 ? limit : kDefaultPageLimit;
+
+    std::string query = "SELECT " + buildColumnList("products", columns, { "id" })
+        + " FROM products WHERE id > :after ORDER BY id LIMIT :limit";
+    std::map<std::string, std::string> params;
+    params["after"] = std::to_string(after.value("id", 0).toLongLong());
+    params["limit"] = std::to_string(limit + 1);
+
+    const QString operationId = beginOperation("getProductsPage", { { "page", "id" }, { "limit", limit } });
+    m_stateMachine->executeQuery(QString::fromStdString(query), params, operationId);
+    return operationId;
+}
+
+QString SQLite3Handler::findProductsByPriceRangePage(double minPrice, double maxPrice, const QString& cursor, int limit,
+    const QStringList& columns)
+{
+    QVariantMap after;
+    if (!cursor.isEmpty() && (!decodeCursor(cursor, after) || !after.contains("price"))) {
+        qWarning() << "无效的分页游标:" << cursor;
+        return QString();
+    }
+
+    limit = limit > 0 ? limit : kDefaultPageLimit;
+
+    std::map<std::string, std::string> params;
+    params["minPrice"] = std::to_string(minPrice);
+    params["maxPrice"] = std::to_string(maxPrice);
+    params["limit"] = std::to_string(limit + 1);
+
+    // (price, id) 行值比较可以直接在 idx_products_price（隐含 rowid）上定位
+    std::string query = "SELECT " + buildColumnList("products", columns, { "price", "id" })
+        + " FROM products WHERE price BETWEEN :minPrice AND :maxPrice";
+    if (!after.isEmpty()) {
+        query += " AND (price, id) > (:afterPrice, :afterId)";
+        params["afterPrice"] = QString::number(after.value("price").toDouble(), 'g', 17).toStdString();
+        params["afterId"] = std::to_string(after.value("id").toLongLong());
+    }
+    query += " ORDER BY price, id LIMIT :limit";
+
+    const QString operationId = beginOperation("findProductsByPriceRangePage", { { "page", "price" }, { "limit", limit } });
+    m_stateMachine->executeQuery(QString::fromStdString(query), params, operationId);
+    return operationId;
+}
+
+QString SQLite3Handler::getProductsByIds(const QList<int>& productIds, const QStringList& columns)
+{
+    std::map<std::string, std::string> params;
+    QVariantMap context;
+    std::string query = buildMultiGetQuery("products", productIds, columns, params, context);
+
+    const QString operationId = beginOperation("getProductsByIds", context);
+    m_stateMachine->executeQuery(QString::fromStdString(query), params, operationId);
+    return operationId;
+}
+
+QString SQLite3Handler::upsertProduct(int productId, const QString& name, double price, int stock)
+{
+    if (productId > 0) {
+        evictHotStock(productId);
+    }
+
+    std::map<std::string, std::string> params;
+    params["name"] = name.toStdString();
+    params["price"] = QString::number(price, 'g', 17).toStdString();
+    params["stock"] = std::to_string(stock);
+
+    // 没有 id 时写 NULL，由 AUTOINCREMENT 分配
+    std::string idValue = "NULL";
+    if (productId > 0) {
+        idValue = ":id";
+        params["id"] = std::to_string(productId);
+    }
+
+    std::string query = "INSERT INTO products (id, name, price, stock) VALUES (" + idValue + ", :name, :price, :stock)"
+        + " ON CONFLICT(id) DO UPDATE SET name = excluded.name, price = excluded.price, stock = excluded.stock"
+        + " RETURNING *";
+
+    const QString operationId = beginOperation("upsertProduct", { { "returning", "row" } });
+    m_stateMachine->executeReturningQuery(QString::fromStdString(query), params, operationId);
+    return operationId;
+}
+
+QString SQLite3Handler::compareAndSetProduct(int productId, const QVariantMap& expected, const QVariantMap& updates)
+{
+    evictHotStock(productId);
+
+    std::map<std::string, std::string> params;
+    std::string query = buildCompareAndSetQuery("products", productId, expected, updates, params);
+    if (query.empty()) {
+        return QString();
+    }
+
+    const QString operationId = beginOperation("compareAndSetProduct", { { "returning", "cas" } });
+    m_stateMachine->executeReturningQuery(QString::fromStdString(query), params, operationId);
+    return operationId;
+}
+
+QStringList SQLite3Handler::bulkUpsertProducts(const QVariantList& products)
+{
+    QStringList operationIds;
+
+    for (qsizetype offset = 0; offset < products.size(); offset += kBulkUpsertRows) {
+        const QVariantList chunk = products.mid(offset, kBulkUpsertRows);
+
+        std::map<std::string, std::string> params;
+        QStringList values;
+        for (qsizetype i = 0; i < chunk.size(); ++i) {
+            const QVariantMap product = chunk[i].toMap();
+            const std::string suffix = "_" + std::to_string(i);
+
+            std::string idValue = "NULL";
+            if (product.value("id").toInt() > 0) {
+                evictHotStock(product.value("id").toInt());
+                idValue = ":id" + suffix;
+                params["id" + suffix] = std::to_string(product.value("id").toInt());
+            }
+
+            values << QString::fromStdString("(" + idValue + ", :name" + suffix + ", :price" + suffix + ", :stock" + suffix + ")");
+            params["name" + suffix] = product["name"].toString().toStdString();
+            params["price" + suffix] = QString::number(product["price"].toDouble(), 'g', 17).toStdString();
+            params["stock" + suffix] = std::to_string(product["stock"].toInt());
+        }
+
+        std::string query = "INSERT INTO products (id, name, price, stock) VALUES " + values.join(", ").toStdString()
+            + " ON CONFLICT(id) DO UPDATE SET name = excluded.name, price = excluded.price, stock = excluded.stock"
+            + " RETURNING *";
+
+        const QString operationId = beginOperation("bulkUpsertProducts");
+        m_stateMachine->executeReturningQuery(QString::fromStdString(query), params, operationId);
+        operationIds << operationId;
+    }
+
+    return operationIds;
+}
+
+QString SQLite3Handler::countProducts()
+{
+    const QString operationId = beginOperation("countProducts", { { "scalar", "count" } });
+    m_stateMachine->executeScalarQuery("SELECT COUNT(*) FROM products", {}, operationId);
     return operationId;
 }
 
-QString SQLite3Handler::findProductsByName(const QString& name)
+QString SQLite3Handler::countProductsInPriceRange(double minPrice, double maxPrice)
 {
-    std::string query = "SELECT * FROM products WHERE name LIKE :name ORDER BY id";
+    // 只在 idx_products_price 上计数，不回表
+    std::string query = "SELECT COUNT(*) FROM products WHERE price BETWEEN :minPrice AND :maxPrice";
     std::map<std::string, std::string> params;
-    params["name"] = "%" + name.toStdString() + "%";
+    params["minPrice"] = std::to_string(minPrice);
+    params["maxPrice"] = std::to_string(maxPrice);
 
-    QString operationId = m_stateMachine->executeQuery(QString::fromStdString(query), params);
-    setOperationType(operationId, "findProductsByName");
+    const QString operationId = beginOperation("countProductsInPriceRange", { { "scalar", "count" } });
+    m_stateMachine->executeScalarQuery(QString::fromStdString(query), params, operationId);
     return operationId;
 }
 
 // 库存管理操作
 QString SQLite3Handler::updateProductStock(int productId, int newStock)
 {
+    evictHotStock(productId);
+
     std::string query = "UPDATE products SET stock = :stock WHERE id = :id";
     std::map<std::string, std::string> params;
     params["id"] = std::to_string(productId);
     params["stock"] = std::to_string(newStock);
 
-    QString operationId = m_stateMachine->executeQuery(QString::fromStdString(query), params);
-    setOperationType(operationId, "updateStock");
+    const QString operationId = beginOperation("updateStock");
+    m_stateMachine->executeWrite(QString::fromStdString(query), params,
+        rowWrite("products", productId, "set:stock"), operationId);
     return operationId;
 }
 
 QString SQLite3Handler::increaseProductStock(int productId, int quantity)
 {
+    if (m_stockCounters) {
+        return applyStockDelta(productId, quantity, "increaseStock");
+    }
+
     std::string query = "UPDATE products SET stock = stock + :quantity WHERE id = :id";
     std::map<std::string, std::string> params;
     params["id"] = std::to_string(productId);
     params["quantity"] = std::to_string(quantity);
 
-    QString operationId = m_stateMachine->executeQuery(QString::fromStdString(query), params);
-    setOperationType(operationId, "increaseStock");
+    // 无条件增量可以求和合并；扣减带库存检查，合并会改变逐条成败，不参与
+    const QString operationId = beginOperation("increaseStock");
+    m_stateMachine->executeWrite(QString::fromStdString(query), params,
+        rowWrite("products", productId, "add:stock", "quantity"), operationId);
     return operationId;
 }
 
 QString SQLite3Handler::decreaseProductStock(int productId, int quantity)
 {
+    if (m_stockCounters) {
+        return applyStockDelta(productId, -quantity, "decreaseStock");
+    }
+
     std::string query = "UPDATE products SET stock = stock - :quantity WHERE id = :id AND stock >= :quantity";
     std::map<std::string, std::string> params;
     params["id"] = std::to_string(productId);
     params["quantity"] = std::to_string(quantity);
 
-    QString operationId = m_stateMachine->executeQuery(QString::fromStdString(query), params);
-    setOperationType(operationId, "decreaseStock");
+    const QString operationId = beginOperation("decreaseStock");
+    m_stateMachine->executeQuery(QString::fromStdString(query), params, operationId);
     return operationId;
 }
 
 // 通用查询操作
 QString SQLite3Handler::executeCustomQuery(const QString& query, const QVariantMap& params)
 {
-    QString operationId = m_stateMachine->executeQuery(query, qvariantMapToStringMap(params));
-    setOperationType(operationId, "customQuery");
+    // 无法判断自定义语句是否写 products，保守地先回写全部热点库存
+    evictAllHotStock();
+
+    const QString operationId = beginOperation("customQuery");
+    m_stateMachine->executeQuery(query, qvariantMapToStringMap(params), operationId);
+    return operationId;
+}
+
+// 工作负载回放：请求按录制时的类型、语句与参数原样入队
+QString SQLite3Handler::replayRequest(const OperationRequest& request)
+{
+    evictAllHotStock();
+
+    // 请求自带 ID，同样先登记再入队
+    const QString operationId = QString::fromStdString(request.id);
+    setOperationType(operationId, "replay");
+    m_stateMachine->enqueueRequest(request);
     return operationId;
 }
 
@@ -309,6 +684,20 @@ QString SQLite3Handler::batchInsertProducts(const QVariantList& products)
     return operationId;
 }
 
+// 在线备份
+QString SQLite3Handler::backupDatabase(const QString& destFile, const BackupOptions& options)
+{
+    QString operationId = "backup_" + QString::number(QDateTime::currentMSecsSinceEpoch());
+    setOperationType(operationId, "backup");
+
+    // 备份对象和源连接都属于数据库线程，调用方可能在其他线程
+    QMetaObject::invokeMethod(this, [this, operationId, destFile, options]() {
+        startBackup(operationId, destFile, options);
+    }, Qt::QueuedConnection);
+
+    return operationId;
+}
+
 // 状态查询
 bool SQLite3Handler::isConnected() const
 {
@@ -325,149 +714,1118 @@ int SQLite3Handler::queueSize() const
     return m_stateMachine->queueSize();
 }
 
-// 事务支持
-bool SQLite3Handler::beginTransaction()
+// 与 sqlite3_init_statemachine.scxml 中的状态一致，另加状态机未就绪时的两种取值
+const QStringList& SQLite3Handler::knownStates()
 {
-    return executeCustomCommand("BEGIN TRANSACTION");
+    static const QStringList states = { "init", "idle", "running", "error", "final", "uninitialized", "unknown" };
+    return states;
 }
 
-bool SQLite3Handler::commitTransaction()
+QString SQLite3Handler::sampledState() const
 {
-    return executeCustomCommand("COMMIT");
+    const int index = m_sampledState.load(std::memory_order_relaxed);
+    return index >= 0 ? knownStates().at(index) : QString("uninitialized");
 }
 
-bool SQLite3Handler::rollbackTransaction()
+void SQLite3Handler::sampledPageCache(qint64& hits, qint64& misses) const
 {
-    return executeCustomCommand("ROLLBACK");
+    hits = m_pageCacheHits.load(std::memory_order_relaxed);
+    misses = m_pageCacheMisses.load(std::memory_order_relaxed);
 }
 
-void SQLite3Handler::start()
+qint64 SQLite3Handler::sampledWalSizeBytes() const
 {
-    if (m_initialized) {
-        m_stateMachine->startConnection();
-    }
+    return m_sampledWalSize.load(std::memory_order_relaxed);
 }
 
-void SQLite3Handler::stop()
+int SQLite3Handler::inFlightOperations() const
 {
-    if (m_stateMachine) {
-        m_stateMachine->stopConnection();
-    }
+    return m_stateMachine->inFlightOperations();
 }
 
-void SQLite3Handler::shutdown()
+void SQLite3Handler::sampleGauges()
 {
-    stop();
-    if (m_stateMachine) {
-        m_stateMachine->shutdown();
+    const int state = knownStates().indexOf(m_stateMachine->currentState());
+    m_sampledState.store(state >= 0 ? state : knownStates().indexOf("unknown"), std::memory_order_relaxed);
+
+    // 写连接自打开以来的累计值，重连后从零开始
+    if (sqlite3* db = m_stateMachine->nativeHandle()) {
+        int current = 0;
+        int highwater = 0;
+        if (sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_HIT, &current, &highwater, 0) == SQLITE_OK) {
+            m_pageCacheHits.store(current, std::memory_order_relaxed);
+        }
+        if (sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_MISS, &current, &highwater, 0) == SQLITE_OK) {
+            m_pageCacheMisses.store(current, std::memory_order_relaxed);
+        }
     }
+
+    const qint64 walSize = m_walCheckpointer
+        ? m_walCheckpointer->walSizeBytes()
+        : QFileInfo(m_dbFile + "-wal").size();
+    m_sampledWalSize.store(walSize, std::memory_order_relaxed);
 }
 
-// 私有槽函数
-void SQLite3Handler::onOperationCompleted(const QString& operationId, bool success, const QString& result)
+void SQLite3Handler::setWalCheckpointPolicy(const WalCheckpointPolicy& policy)
 {
-    QString operationType = getOperationType(operationId);
-    QVariant parsedResult = parseJsonResult(result);
-
-    // 发出通用操作完成信号
-    emit operationCompleted(operationId, success, parsedResult);
+    m_walPolicy = policy;
+}
 
-    // 发出特定操作信号
-    if (operationType == "addUser") {
-        emit userAdded(operationId, success, parsedResult);
-    } else if (operationType == "updateUser") {
-        emit userUpdated(operationId, success, parsedResult);
-    } else if (operationType == "deleteUser") {
-        emit userDeleted(operationId, success, parsedResult);
-    } else if (operationType.startsWith("getUser") || operationType.startsWith("findUser")) {
-        emit userRetrieved(operationId, success, parsedResult);
+QVariantMap SQLite3Handler::walCheckpointMetrics() const
+{
+    return m_walCheckpointer ? m_walCheckpointer->metrics() : QVariantMap();
+}
 
-    } else if (operationType == "addProduct") {
-        emit productAdded(operationId, success, parsedResult);
-    } else if (operationType == "updateProduct") {
-        emit productUpdated(operationId, success, parsedResult);
-    } else if (operationType == "deleteProduct") {
-        emit productDeleted(operationId, success, parsedResult);
-    } else if (operationType.startsWith("getProduct") || operationType.startsWith("findProduct")) {
-        emit productRetrieved(operationId, success, parsedResult);
+void SQLite3Handler::setQueryProfilerPolicy(const QueryProfilerPolicy& policy)
+{
+    m_profilerPolicy = policy;
+}
 
-    } else if (operationType.contains("Stock")) {
-        emit stockUpdated(operationId, success, parsedResult);
+QVariantMap SQLite3Handler::queryProfilerMetrics() const
+{
+    const QueryProfiler* profiler = m_queryProfiler.load(std::memory_order_acquire);
+    return profiler ? profiler->metrics() : QVariantMap();
+}
 
-    } else if (operationType == "batchUsers") {
-        emit batchUsersCompleted(operationId, success, parsedResult);
-    } else if (operationType == "batchProducts") {
-        emit batchProductsCompleted(operationId, success, parsedResult);
-    }
+QVariantList SQLite3Handler::queryShapes(int limit) const
+{
+    const QueryProfiler* profiler = m_queryProfiler.load(std::memory_order_acquire);
+    return profiler ? profiler->topShapes(limit) : QVariantList();
+}
 
-    // 清理操作类型映射
-    clearOperationType(operationId);
+void SQLite3Handler::setRetentionPolicy(const RetentionPolicy& policy)
+{
+    QMetaObject::invokeMethod(this, [this, policy]() {
+        m_retentionPolicy = policy;
+        if (m_retentionManager) {
+            m_retentionManager->setPolicy(policy);
+        }
+    }, Qt::QueuedConnection);
 }
 
-void SQLite3Handler::onConnectionEstablished()
+QVariantMap SQLite3Handler::retentionMetrics() const
 {
-    emit connected();
+    return m_retentionManager ? m_retentionManager->metrics() : QVariantMap();
 }
 
-void SQLite3Handler::onConnectionLost()
+void SQLite3Handler::setWriteCoalescing(bool enabled)
 {
-    emit disconnected();
+    m_stateMachine->setWriteCoalescing(enabled);
 }
 
-void SQLite3Handler::onErrorOccurred(const QString& error)
+QVariantMap SQLite3Handler::coalesceMetrics() const
 {
-    emit errorOccurred(error);
+    return m_stateMachine->coalesceMetrics();
 }
 
-// 私有辅助函数
-std::map<std::string, std::string> SQLite3Handler::qvariantMapToStringMap(const QVariantMap& qmap) const
+QVariantMap SQLite3Handler::latencySnapshot() const
 {
-    std::map<std::string, std::string> result;
-    for (auto it = qmap.begin(); it != qmap.end(); ++it) {
-        result[it.key().toStdString()] = it.value().toString().toStdString();
-    }
-    return result;
+    return m_latency.snapshot();
 }
 
-QVariant SQLite3Handler::parseJsonResult(const QString& jsonResult) const
+void SQLite3Handler::setDeliveryLatencyTracking(bool enabled)
 {
-    if (jsonResult.isEmpty() || jsonResult == "{}") {
-        return QVariant();
-    }
+    m_latency.setDeliveryTracking(enabled);
+}
 
-    QJsonDocument doc = QJsonDocument::fromJson(jsonResult.toUtf8());
+void SQLite3Handler::recordDelivery(const QString& operationId)
+{
+    m_latency.markDelivered(operationId);
+}
 
-    if (doc.isArray()) {
-        return doc.array().toVariantList();
-    } else if (doc.isObject()) {
-        return doc.object().toVariantMap();
+void SQLite3Handler::recordLatency(const QString& operationId, const QString& operationType,
+    std::chrono::steady_clock::time_point receivedAt)
+{
+    OperationTiming timing;
+    if (!m_stateMachine->takeOperationTiming(operationId, timing)) {
+        return;
     }
 
-    return QVariant(jsonResult);
+    const QString type = operationType.isEmpty() ? QStringLiteral("unknown") : operationType;
+    const auto handlerElapsed = std::chrono::steady_clock::now() - receivedAt;
+    const qint64 handlerNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(handlerElapsed).count();
+    m_latency.record(type, LatencyRecorder::QueueWait, timing.queue_wait_ns);
+    m_latency.record(type, LatencyRecorder::Execute, timing.execute_ns);
+    m_latency.record(type, LatencyRecorder::Serialize, timing.serialize_ns + handlerNanos);
+    m_trace.checkSlowOperation(operationId, type,
+        timing.queue_wait_ns + timing.execute_ns + timing.serialize_ns + handlerNanos);
 }
 
-std::string SQLite3Handler::buildInsertUserQuery(const QVariantMap& data, std::map<std::string, std::string>& params) const
+void SQLite3Handler::setEmailFilterEnabled(bool enabled)
 {
-    std::string query = "INSERT INTO users (name, email, age) VALUES (:name, :email, :age)";
+    m_emailFilterEnabled = enabled;
+}
 
-    // 确保参数名称与SQL语句中的占位符完全匹配
-    params["name"] = data["name"].toString().toStdString();
-    params["email"] = data["email"].toString().toStdString();
-    params["age"] = std::to_string(data["age"].toInt());
+QVariantMap SQLite3Handler::emailFilterMetrics() const
+{
+    const EmailFilter* filter = m_emailFilter.load(std::memory_order_acquire);
+    return filter ? filter->metrics() : QVariantMap();
+}
 
-    return query;
+void SQLite3Handler::setChangeEventsEnabled(bool enabled)
+{
+    m_changeEventsEnabled = enabled;
 }
 
-std::string SQLite3Handler::buildUpdateUserQuery(int userId, const QVariantMap& updates, std::map<std::string, std::string>& params) const
+void SQLite3Handler::setPriceIndexEnabled(bool enabled)
 {
-    std::string query = "UPDATE users SET ";
-    QStringList setClauses;
+    m_priceIndexEnabled = enabled;
+}
 
+QVariantMap SQLite3Handler::priceIndexMetrics() const
+{
+    const ProductPriceIndex* index = m_priceIndex.load(std::memory_order_acquire);
+    return index ? index->metrics() : QVariantMap();
+}
+
+void SQLite3Handler::setColumnStoreEnabled(bool enabled)
+{
+    m_columnStoreEnabled = enabled;
+}
+
+QVariantMap SQLite3Handler::columnStoreMetrics() const
+{
+    const ProductColumnStore* store = m_columnStore.load(std::memory_order_acquire);
+    return store ? store->metrics() : QVariantMap();
+}
+
+bool SQLite3Handler::totalInventoryValue(double& value) const
+{
+    const ProductColumnStore* store = m_columnStore.load(std::memory_order_acquire);
+    if (!store || !store->isReady()) {
+        return false;
+    }
+    value = store->totalInventoryValue();
+    return true;
+}
+
+bool SQLite3Handler::countLowStockProducts(int threshold, qint64& count) const
+{
+    const ProductColumnStore* store = m_columnStore.load(std::memory_order_acquire);
+    if (!store || !store->isReady()) {
+        return false;
+    }
+    count = store->countLowStock(threshold);
+    return true;
+}
+
+bool SQLite3Handler::countProductsInPriceRangeCached(double minPrice, double maxPrice, qint64& count) const
+{
+    const ProductColumnStore* store = m_columnStore.load(std::memory_order_acquire);
+    if (!store || !store->isReady()) {
+        return false;
+    }
+    count = store->countInPriceRange(minPrice, maxPrice);
+    return true;
+}
+
+bool SQLite3Handler::priceHistogram(double minPrice, double maxPrice, int bins, QVariantList& counts) const
+{
+    const ProductColumnStore* store = m_columnStore.load(std::memory_order_acquire);
+    if (!store || !store->isReady()) {
+        return false;
+    }
+    counts.clear();
+    for (quint64 count : store->priceHistogram(minPrice, maxPrice, bins)) {
+        counts.append(count);
+    }
+    return true;
+}
+
+void SQLite3Handler::setMaterializedAggregatePolicy(const MaterializedAggregatePolicy& policy)
+{
+    m_aggregatePolicy = policy;
+    std::sort(m_aggregatePolicy.priceBuckets.begin(), m_aggregatePolicy.priceBuckets.end());
+    m_aggregatePolicy.priceBuckets.erase(
+        std::unique(m_aggregatePolicy.priceBuckets.begin(), m_aggregatePolicy.priceBuckets.end()),
+        m_aggregatePolicy.priceBuckets.end());
+}
+
+QVariantMap SQLite3Handler::materializedAggregateMetrics() const
+{
+    if (!m_aggregates) {
+        return QVariantMap();
+    }
+    QVariantMap result = m_aggregates->metrics();
+    if (m_aggregateVerifier) {
+        result.insert(m_aggregateVerifier->metrics());
+    }
+    return result;
+}
+
+bool SQLite3Handler::materializedAggregate(const QString& name, double& value) const
+{
+    if (!m_aggregates || !m_aggregates->isReady()) {
+        return false;
+    }
+    return m_aggregates->value(name, value);
+}
+
+bool SQLite3Handler::materializedAggregates(QVariantMap& values) const
+{
+    if (!m_aggregates || !m_aggregates->isReady()) {
+        return false;
+    }
+    values = m_aggregates->values();
+    return true;
+}
+
+bool SQLite3Handler::stockValueByPriceBucket(QVariantList& buckets) const
+{
+    if (!m_aggregates || !m_aggregates->isReady()) {
+        return false;
+    }
+
+    buckets.clear();
+    const QList<double>& bounds = m_aggregatePolicy.priceBuckets;
+    for (int i = 0; i < bounds.size(); ++i) {
+        const double maxPrice = i + 1 < bounds.size() ? bounds[i + 1] : MaterializedAggregates::kUnbounded;
+        double value = 0.0;
+        m_aggregates->value(MaterializedAggregates::priceBucketName(bounds[i], maxPrice), value);
+
+        QVariantMap bucket;
+        bucket["min_price"] = bounds[i];
+        bucket["max_price"] = i + 1 < bounds.size() ? QVariant(maxPrice) : QVariant();
+        bucket["value"] = value;
+        buckets.append(bucket);
+    }
+    return true;
+}
+
+void SQLite3Handler::verifyMaterializedAggregates()
+{
+    if (m_aggregateVerifier) {
+        QMetaObject::invokeMethod(m_aggregateVerifier, "verifyNow", Qt::QueuedConnection);
+    }
+}
+
+void SQLite3Handler::setStockCounterPolicy(const StockCounterPolicy& policy)
+{
+    m_stockPolicy = policy;
+}
+
+QVariantMap SQLite3Handler::stockCounterMetrics() const
+{
+    return m_stockCounters ? m_stockCounters->metrics() : QVariantMap();
+}
+
+// 事务支持
+bool SQLite3Handler::beginTransaction()
+{
+    return executeCustomCommand("BEGIN TRANSACTION");
+}
+
+bool SQLite3Handler::commitTransaction()
+{
+    return executeCustomCommand("COMMIT");
+}
+
+bool SQLite3Handler::rollbackTransaction()
+{
+    return executeCustomCommand("ROLLBACK");
+}
+
+void SQLite3Handler::start()
+{
+    if (m_initialized) {
+        m_stateMachine->startConnection();
+    }
+}
+
+void SQLite3Handler::stop()
+{
+    // 断开前把内存中的库存增量落库
+    if (m_stockCounters) {
+        m_stockCounters->stop();
+    }
+    if (m_changeTracker) {
+        m_changeTracker->uninstall();
+    }
+    if (m_stateMachine) {
+        m_stateMachine->stopConnection();
+    }
+}
+
+void SQLite3Handler::shutdown()
+{
+    stop();
+    if (m_gaugeTimer) {
+        m_gaugeTimer->stop();
+    }
+    if (m_activeBackup) {
+        m_activeBackup->cancel();
+    }
+    if (m_retentionManager) {
+        m_retentionManager->stop();
+    }
+    stopAggregateVerifier();
+    stopWalCheckpointer();
+    if (QueryProfiler* profiler = m_queryProfiler.load(std::memory_order_relaxed)) {
+        // 连接关闭前摘掉回调；对象保留到析构，统计仍可读取
+        profiler->uninstall();
+    }
+    // 写出录制缓冲
+    m_capture.stop();
+    if (m_stateMachine) {
+        m_stateMachine->shutdown();
+    }
+}
+
+// 私有槽函数
+void SQLite3Handler::onOperationCompleted(const QString& operationId, bool success, const QString& result)
+{
+    const auto receivedAt = std::chrono::steady_clock::now();
+    TraceRecorder::Span span(&m_trace, "handler.complete", operationId);
+    QString operationType = getOperationType(operationId);
+    QVariant parsedResult = parseJsonResult(result);
+
+    const QVariantMap context = takeOperationContext(operationId);
+    if (context.contains("stockLoad")) {
+        // 热点库存的内部加载操作，不对外发出完成信号
+        recordLatency(operationId, "stockLoad", receivedAt);
+        onStockLoaded(context.value("stockLoad").toInt(), success, parsedResult);
+        clearOperationType(operationId);
+        return;
+    }
+    if (context.contains("uniqueEmail")) {
+        const bool guarded = context.value("uniqueEmail").toBool();
+        const QVariantMap resultMap = parsedResult.toMap();
+        const bool duplicate = success
+            ? guarded && resultMap.value("affected_rows").toInt() == 0
+            : parsedResult.toString().contains("UNIQUE constraint failed: users.email");
+
+        if (EmailFilter* filter = m_emailFilter.load(std::memory_order_acquire)) {
+            const bool inserted = success && !duplicate;
+            filter->endInsert(operationId, inserted ? resultMap.value("last_insert_id").toLongLong() : 0);
+            if (guarded && success) {
+                filter->recordOutcome(duplicate);
+            }
+        }
+        if (duplicate) {
+            success = false;
+            parsedResult = buildDuplicateEmailResult(context.value("email").toString());
+        }
+    } else if (operationType == "addUser") {
+        // 不应出现：上下文在入队前登记。仍要释放过滤器里的排队登记，否则该邮箱一直被当作可能存在
+        qWarning() << "addUser 完成时缺少操作上下文:" << operationId;
+        if (EmailFilter* filter = m_emailFilter.load(std::memory_order_acquire)) {
+            filter->endInsert(operationId, 0);
+        }
+    }
+
+    if (success && context.contains("page")) {
+        parsedResult = buildPageResult(context, parsedResult);
+    } else if (success && context.contains("scalar")) {
+        parsedResult = buildScalarResult(context, parsedResult);
+    } else if (success && context.contains("ids")) {
+        parsedResult = buildMultiGetResult(context, parsedResult);
+    } else if (success && context.contains("returning")) {
+        parsedResult = buildReturningResult(context, parsedResult);
+    }
+
+    recordLatency(operationId, operationType, receivedAt);
+    m_latency.markDispatched(operationId, operationType);
+
+    // 发出通用操作完成信号
+    emit operationCompleted(operationId, success, parsedResult);
+
+    // 发出特定操作信号
+    if (operationType == "addUser") {
+        emit userAdded(operationId, success, parsedResult);
+    } else if (operationType == "updateUser" || operationType == "bulkUpsertUsers"
+        || operationType == "upsertUser" || operationType == "compareAndSetUser") {
+        emit userUpdated(operationId, success, parsedResult);
+    } else if (operationType == "deleteUser") {
+        emit userDeleted(operationId, success, parsedResult);
+    } else if (operationType.startsWith("getUser") || operationType.startsWith("findUser")
+        || operationType == "countUsers" || operationType.startsWith("existsUser")) {
+        emit userRetrieved(operationId, success, parsedResult);
+
+    } else if (operationType == "addProduct") {
+        emit productAdded(operationId, success, parsedResult);
+    } else if (operationType == "updateProduct" || operationType == "bulkUpsertProducts"
+        || operationType == "upsertProduct" || operationType == "compareAndSetProduct") {
+        emit productUpdated(operationId, success, parsedResult);
+    } else if (operationType == "deleteProduct") {
+        emit productDeleted(operationId, success, parsedResult);
+    } else if (operationType.startsWith("getProduct") || operationType.startsWith("findProduct")
+        || operationType.startsWith("countProducts")) {
+        emit productRetrieved(operationId, success, parsedResult);
+
+    } else if (operationType.contains("Stock")) {
+        emit stockUpdated(operationId, success, parsedResult);
+
+    } else if (operationType == "batchUsers") {
+        emit batchUsersCompleted(operationId, success, parsedResult);
+    } else if (operationType == "batchProducts") {
+        emit batchProductsCompleted(operationId, success, parsedResult);
+    }
+
+    // 清理操作类型映射
+    clearOperationType(operationId);
+}
+
+void SQLite3Handler::onConnectionEstablished()
+{
+    startWalCheckpointer();
+
+    // 这些对象只在数据库线程创建，release 发布后其他线程的 acquire 读取才能看到构造完成的对象
+    QueryProfiler* profiler = m_queryProfiler.load(std::memory_order_relaxed);
+    if (m_profilerPolicy.enabled && !profiler) {
+        profiler = new QueryProfiler(m_stateMachine, m_dbFile, m_profilerPolicy, this);
+        m_queryProfiler.store(profiler, std::memory_order_release);
+    }
+    if (profiler) {
+        // 重连后句柄会变，每次连接建立都重新注册
+        profiler->install();
+    }
+
+    if (!m_gaugeTimer) {
+        m_gaugeTimer = new QTimer(this);
+        connect(m_gaugeTimer, &QTimer::timeout, this, &SQLite3Handler::sampleGauges);
+        connect(m_stateMachine, &SQLite3StateMachine::stateChanged, this, &SQLite3Handler::sampleGauges);
+        m_gaugeTimer->start(1000);
+    }
+    sampleGauges();
+
+    if (!m_retentionManager) {
+        m_retentionManager = new RetentionManager(m_stateMachine, this);
+        m_retentionManager->setPolicy(m_retentionPolicy);
+        m_retentionManager->start();
+    }
+
+    if (m_changeTracker) {
+        ensureChangeTracker();
+    }
+
+    if (m_changeEventsEnabled && !m_changeEventsConnected) {
+        if (ChangeTracker* tracker = ensureChangeTracker()) {
+            tracker->watch("users");
+            tracker->watch("products");
+            connect(tracker, &ChangeTracker::tableChanged, this, &SQLite3Handler::tableChanged);
+            m_changeEventsConnected = true;
+        }
+    }
+
+    if (m_emailFilterEnabled && !m_emailFilter.load(std::memory_order_relaxed)) {
+        if (ChangeTracker* tracker = ensureChangeTracker()) {
+            auto* filter = new EmailFilter(m_stateMachine, this);
+            tracker->watch("users");
+            connect(tracker, &ChangeTracker::tableChanged, filter, &EmailFilter::onTableChanged);
+            if (filter->load()) {
+                m_emailFilter.store(filter, std::memory_order_release);
+            } else {
+                delete filter;
+            }
+        }
+    }
+
+    if (m_priceIndexEnabled && !m_priceIndex.load(std::memory_order_relaxed)) {
+        if (ChangeTracker* tracker = ensureChangeTracker()) {
+            auto* index = new ProductPriceIndex(m_stateMachine, this);
+            tracker->watch("products");
+            connect(tracker, &ChangeTracker::tableChanged, index, &ProductPriceIndex::onTableChanged);
+            if (index->load()) {
+                m_priceIndex.store(index, std::memory_order_release);
+            } else {
+                delete index;
+            }
+        }
+    }
+
+    if (m_columnStoreEnabled && !m_columnStore.load(std::memory_order_relaxed)) {
+        if (ChangeTracker* tracker = ensureChangeTracker()) {
+            auto* store = new ProductColumnStore(m_stateMachine, this);
+            tracker->watch("products");
+            connect(tracker, &ChangeTracker::tableChanged, store, &ProductColumnStore::onTableChanged);
+            if (store->load()) {
+                m_columnStore.store(store, std::memory_order_release);
+            } else {
+                delete store;
+            }
+        }
+    }
+
+    startMaterializedAggregates();
+
+    if (m_stockCounters) {
+        // 断开重连：stop() 停掉了周期回写
+        m_stockCounters->resume();
+    } else if (m_stockPolicy.enabled) {
+        const QString journalFile = m_stockPolicy.journalFile.isEmpty()
+            ? m_dbFile + "-stockjournal"
+            : m_stockPolicy.journalFile;
+        auto* counters = new StockCounterCache(m_stateMachine, journalFile, this);
+        counters->setFlushInterval(m_stockPolicy.flushIntervalMs);
+        if (counters->start()) {
+            m_stockCounters = counters;
+        } else {
+            delete counters;
+            emit errorOccurred("热点库存计数启动失败，库存操作退回逐条写入");
+        }
+    }
+
+    emit connected();
+}
+
+void SQLite3Handler::onConnectionLost()
+{
+    sampleGauges();
+    emit disconnected();
+}
+
+void SQLite3Handler::onErrorOccurred(const QString& error)
+{
+    emit errorOccurred(error);
+}
+
+ChangeTracker* SQLite3Handler::ensureChangeTracker()
+{
+    if (!m_changeTracker) {
+        m_changeTracker = new ChangeTracker(m_stateMachine, this);
+    }
+    // 重新连接后句柄变化，需要重新注册
+    return m_changeTracker->install() ? m_changeTracker : nullptr;
+}
+
+// 热点库存：在内存中判定并生效，完成信号排队发出，保证调用方先拿到操作 ID
+QString SQLite3Handler::applyStockDelta(int productId, int delta, const QString& operationType)
+{
+    const QString operationId = QString("stock_%1_%2")
+                                    .arg(QDateTime::currentMSecsSinceEpoch())
+                                    .arg(m_stockSequence.fetch_add(1, std::memory_order_relaxed));
+    setOperationType(operationId, operationType);
+
+    qint64 stock = 0;
+    const StockCounterCache::ApplyResult applyResult = m_stockCounters->applyDelta(productId, delta, operationId, &stock);
+
+    switch (applyResult) {
+    case StockCounterCache::ApplyResult::Applied:
+    case StockCounterCache::ApplyResult::Insufficient: {
+        // 与 SQL 路径一致：库存不足时操作成功但 affected_rows 为 0
+        QVariantMap result;
+        result["affected_rows"] = applyResult == StockCounterCache::ApplyResult::Applied ? 1 : 0;
+        result["stock"] = stock;
+        result["cached"] = true;
+        finishStockOperation(operationId, true, result);
+        break;
+    }
+    case StockCounterCache::ApplyResult::NeedsLoad:
+        // 加载操作在数据库线程里入队并登记上下文，保证完成时一定能取到上下文；
+        // 之前已入队的写入先执行，读到的就是最新库存
+        QMetaObject::invokeMethod(this, [this, productId]() {
+            std::map<std::string, std::string> params;
+            params["id"] = std::to_string(productId);
+            const QString loadId = beginOperation("stockLoad", { { "stockLoad", productId } });
+            m_stateMachine->executeQuery("SELECT stock FROM products WHERE id = :id", params, loadId);
+        }, Qt::QueuedConnection);
+        break;
+    case StockCounterCache::ApplyResult::Pending:
+        break; // 加载完成时统一判定
+    }
+
+    return operationId;
+}
+
+void SQLite3Handler::onStockLoaded(int productId, bool success, const QVariant& rows)
+{
+    const QVariantList list = rows.toList();
+    const bool found = success && !list.isEmpty();
+    const qint64 stock = found ? list.first().toMap().value("stock").toLongLong() : 0;
+
+    const QList<StockCounterCache::Resolution> resolutions = m_stockCounters->completeLoad(productId, found, stock);
+    for (const StockCounterCache::Resolution& resolution : resolutions) {
+        if (!success) {
+            finishStockOperation(resolution.operationId, false, QString("库存加载失败: %1").arg(productId));
+            continue;
+        }
+        QVariantMap result;
+        result["affected_rows"] = resolution.applied ? 1 : 0;
+        result["stock"] = resolution.stock;
+        result["cached"] = true;
+        finishStockOperation(resolution.operationId, true, result);
+    }
+}
+
+void SQLite3Handler::finishStockOperation(const QString& operationId, bool success, const QVariant& result)
+{
+    QMetaObject::invokeMethod(this, [this, operationId, success, result]() {
+        emit operationCompleted(operationId, success, result);
+        emit stockUpdated(operationId, success, result);
+        clearOperationType(operationId);
+    }, Qt::QueuedConnection);
+}
+
+// 其他写入会直接改写 products，先把该产品的增量回写并移出缓存；
+// 回写必须在写入入队之前完成，调用方不在数据库线程时阻塞等待
+void SQLite3Handler::evictHotStock(int productId)
+{
+    if (!m_stockCounters || !m_stockCounters->contains(productId)) {
+        return;
+    }
+
+    if (QThread::currentThread() == thread()) {
+        m_stockCounters->evict(productId);
+    } else {
+        QMetaObject::invokeMethod(this, [this, productId]() {
+            m_stockCounters->evict(productId);
+        }, Qt::BlockingQueuedConnection);
+    }
+}
+
+void SQLite3Handler::evictAllHotStock()
+{
+    if (!m_stockCounters || m_stockCounters->isEmpty()) {
+        return;
+    }
+
+    if (QThread::currentThread() == thread()) {
+        m_stockCounters->evictAll();
+    } else {
+        QMetaObject::invokeMethod(this, [this]() {
+            m_stockCounters->evictAll();
+        }, Qt::BlockingQueuedConnection);
+    }
+}
+
+void SQLite3Handler::onBackupFinished(const QString& operationId, bool success, const QVariant& result)
+{
+    if (m_activeBackup && m_activeBackup->operationId() == operationId) {
+        m_activeBackup->deleteLater();
+        m_activeBackup = nullptr;
+    }
+
+    emit backupCompleted(operationId, success, result);
+    emit operationCompleted(operationId, success, result);
+    clearOperationType(operationId);
+}
+
+void SQLite3Handler::startBackup(const QString& operationId, const QString& destFile, const BackupOptions& options)
+{
+    if (m_activeBackup) {
+        onBackupFinished(operationId, false, QString("已有备份正在进行: %1").arg(m_activeBackup->operationId()));
+        return;
+    }
+
+    auto* backup = new DatabaseBackup(operationId, m_stateMachine->nativeHandle(), destFile, options, this);
+    SQLite3StateMachine* stateMachine = m_stateMachine;
+    backup->setBusyProbe([stateMachine]() {
+        return stateMachine->queueSize() > 0;
+    });
+
+    connect(backup, &DatabaseBackup::progress, this, &SQLite3Handler::backupProgress);
+    connect(backup, &DatabaseBackup::finished, this, &SQLite3Handler::onBackupFinished);
+
+    m_activeBackup = backup;
+    if (!backup->start()) {
+        // start() 失败时已经发出 finished，这里只需要确保对象被回收
+        if (m_activeBackup == backup) {
+            m_activeBackup = nullptr;
+            backup->deleteLater();
+        }
+    }
+}
+
+// WAL 检查点线程：独立连接 + 最低优先级，只在队列空闲时做 PASSIVE
+void SQLite3Handler::startWalCheckpointer()
+{
+    if (m_checkpointThread) {
+        return; // connectionEstablished 每次进入 idle/running 都会触发
+    }
+
+    m_checkpointThread = new QThread(this);
+    m_walCheckpointer = new WalCheckpointer(m_dbFile);
+    m_walCheckpointer->setPolicy(m_walPolicy);
+
+    SQLite3StateMachine* stateMachine = m_stateMachine;
+    m_walCheckpointer->setIdleProbe([stateMachine]() {
+        return stateMachine->queueSize() == 0 && !stateMachine->isProcessing();
+    });
+    m_walCheckpointer->moveToThread(m_checkpointThread);
+
+    connect(m_checkpointThread, &QThread::started, m_walCheckpointer, &WalCheckpointer::start);
+    connect(m_checkpointThread, &QThread::finished, m_walCheckpointer, &QObject::deleteLater);
+    connect(m_walCheckpointer, &WalCheckpointer::errorOccurred, this, &SQLite3Handler::onErrorOccurred);
+
+    m_checkpointThread->start(QThread::LowestPriority);
+}
+
+void SQLite3Handler::stopWalCheckpointer()
+{
+    if (!m_checkpointThread) {
+        return;
+    }
+
+    QMetaObject::invokeMethod(m_walCheckpointer, "stop", Qt::BlockingQueuedConnection);
+    m_checkpointThread->quit();
+    m_checkpointThread->wait();
+
+    m_walCheckpointer = nullptr; // 已随 finished 信号 deleteLater
+    m_checkpointThread->deleteLater();
+    m_checkpointThread = nullptr;
+}
+
+void SQLite3Handler::startMaterializedAggregates()
+{
+    if (!m_aggregatePolicy.enabled) {
+        // 之前启用过时残留的触发器仍会在每次写入时执行，关闭后移除（每次启动检查一次）
+        if (!m_aggregateTriggersChecked) {
+            MaterializedAggregates::removeTriggers(m_stateMachine);
+            m_aggregateTriggersChecked = true;
+        }
+        return;
+    }
+    if (m_aggregates) {
+        return;
+    }
+
+    ChangeTracker* tracker = ensureChangeTracker();
+    if (!tracker) {
+        return;
+    }
+
+    auto* aggregates = new MaterializedAggregates(m_stateMachine, this);
+    for (const AggregateDefinition& definition : MaterializedAggregates::defaultDefinitions(m_aggregatePolicy.priceBuckets)) {
+        aggregates->registerAggregate(definition);
+    }
+    if (!aggregates->install()) {
+        delete aggregates;
+        emit errorOccurred("物化聚合安装失败，聚合读取不可用");
+        return;
+    }
+
+    tracker->watch("users");
+    tracker->watch("products");
+    connect(tracker, &ChangeTracker::tableChanged, aggregates, &MaterializedAggregates::onTableChanged);
+    m_aggregates = aggregates;
+
+    if (m_aggregatePolicy.verifyIntervalMs <= 0) {
+        return;
+    }
+
+    // 校验在独立线程的只读连接上做全量重算，发现偏差后回到数据库线程修复
+    m_verifierThread = new QThread(this);
+    m_aggregateVerifier = new AggregateVerifier(m_dbFile, aggregates->recomputeQueries(), m_aggregatePolicy.verifyIntervalMs);
+    m_aggregateVerifier->moveToThread(m_verifierThread);
+
+    connect(m_verifierThread, &QThread::started, m_aggregateVerifier, &AggregateVerifier::start);
+    connect(m_verifierThread, &QThread::finished, m_aggregateVerifier, &QObject::deleteLater);
+    connect(m_aggregateVerifier, &AggregateVerifier::driftDetected, aggregates, &MaterializedAggregates::repair);
+    connect(m_aggregateVerifier, &AggregateVerifier::errorOccurred, this, &SQLite3Handler::onErrorOccurred);
+
+    m_verifierThread->start(QThread::LowestPriority);
+}
+
+void SQLite3Handler::stopAggregateVerifier()
+{
+    if (!m_verifierThread) {
+        return;
+    }
+
+    QMetaObject::invokeMethod(m_aggregateVerifier, "stop", Qt::BlockingQueuedConnection);
+    m_verifierThread->quit();
+    m_verifierThread->wait();
+
+    m_aggregateVerifier = nullptr; // 已随 finished 信号 deleteLater
+    m_verifierThread->deleteLater();
+    m_verifierThread = nullptr;
+}
+
+// 私有辅助函数
+std::map<std::string, std::string> SQLite3Handler::qvariantMapToStringMap(const QVariantMap& qmap) const
+{
+    std::map<std::string, std::string> result;
+    for (auto it = qmap.begin(); it != qmap.end(); ++it) {
+        result[it.key().toStdString()] = it.value().toString().toStdString();
+    }
+    return result;
+}
+
+QVariant SQLite3Handler::parseJsonResult(const QString& jsonResult)
+{
+    if (jsonResult.isEmpty() || jsonResult == "{}") {
+        return QVariant();
+    }
+
+    QJsonDocument doc = QJsonDocument::fromJson(jsonResult.toUtf8());
+
+    if (doc.isArray()) {
+        return doc.array().toVariantList();
+    } else if (doc.isObject()) {
+        return doc.object().toVariantMap();
+    }
+
+    return QVariant(jsonResult);
+}
+
+QString SQLite3Handler::encodeCursor(const QVariantMap& key)
+{
+    const QByteArray json = QJsonDocument(QJsonObject::fromVariantMap(key)).toJson(QJsonDocument::Compact);
+    return QString::fromLatin1(json.toBase64(QByteArray::Base64UrlEncoding | QByteArray::OmitTrailingEquals));
+}
+
+bool SQLite3Handler::decodeCursor(const QString& cursor, QVariantMap& key)
+{
+    const QByteArray json = QByteArray::fromBase64(cursor.toLatin1(), QByteArray::Base64UrlEncoding | QByteArray::OmitTrailingEquals);
+    const QJsonDocument doc = QJsonDocument::fromJson(json);
+    if (!doc.isObject() || !doc.object().contains("id")) {
+        return false;
+    }
+    key = doc.object().toVariantMap();
+    return true;
+}
+
+// 分页结果：截掉多取的一行，用最后一行的键生成 next_cursor
+QVariant SQLite3Handler::buildPageResult(const QVariantMap& context, const QVariant& rows) const
+{
+    const int limit = context.value("limit").toInt();
+    QVariantList list = rows.toList();
+
+    const bool hasMore = list.size() > limit;
+    if (hasMore) {
+        list = list.mid(0, limit);
+    }
+
+    QString nextCursor;
+    if (hasMore && !list.isEmpty()) {
+        const QVariantMap last = list.last().toMap();
+        QVariantMap key;
+        key["id"] = last.value("id");
+        if (context.value("page").toString() == "price") {
+            key["price"] = last.value("price");
+        }
+        nextCursor = encodeCursor(key);
+    }
+
+    QVariantMap page;
+    page["rows"] = list;
+    page["next_cursor"] = nextCursor;
+    page["has_more"] = hasMore;
+    return page;
+}
+
+// 标量结果：count 返回整数，exists 返回布尔
+QVariant SQLite3Handler::buildScalarResult(const QVariantMap& context, const QVariant& result)
+{
+    const QVariant value = result.toMap().value("value");
+    if (context.value("scalar").toString() == "exists") {
+        return value.toLongLong() != 0;
+    }
+    return value.isNull() ? QVariant(0LL) : QVariant(value.toLongLong());
+}
+
+// 批量读取结果：按 id 建索引，并列出没有找到的 id（保持请求顺序）
+QVariant SQLite3Handler::buildMultiGetResult(const QVariantMap& context, const QVariant& rows)
+{
+    QVariantMap byId;
+    for (const QVariant& row : rows.toList()) {
+        const QVariantMap rowMap = row.toMap();
+        byId.insert(rowMap.value("id").toString(), rowMap);
+    }
+
+    QVariantList missing;
+    for (const QVariant& id : context.value("ids").toList()) {
+        if (!byId.contains(id.toString())) {
+            missing << id;
+        }
+    }
+
+    QVariantMap result;
+    result["rows"] = byId;
+    result["missing"] = missing;
+    return result;
+}
+
+// RETURNING 结果：单行 upsert 直接给出该行；
+// 条件更新没有返回行说明 id 不存在或当前值已被他人修改
+QVariant SQLite3Handler::buildReturningResult(const QVariantMap& context, const QVariant& rows)
+{
+    const QVariantList list = rows.toList();
+    const QVariant row = list.isEmpty() ? QVariant() : list.first();
+
+    if (context.value("returning").toString() == "cas") {
+        QVariantMap result;
+        result["applied"] = !list.isEmpty();
+        result["row"] = row;
+        return result;
+    }
+    return row;
+}
+
+const QStringList& SQLite3Handler::updatableColumns(const QString& table)
+{
+    return table == "users" ? kUserUpdatableColumns : kProductUpdatableColumns;
+}
+
+// 列投影：只保留白名单内的列，keyColumns（分页键）总是带上；
+// 没有有效列时退回 *
+std::string SQLite3Handler::buildColumnList(const std::string& table, const QStringList& columns,
+    const QStringList& keyColumns) const
+{
+    if (columns.isEmpty()) {
+        return "*";
+    }
+
+    const QStringList& allowed = (table == "users") ? kUserColumns : kProductColumns;
+
+    QStringList selected;
+    for (const QString& key : keyColumns) {
+        if (!columns.contains(key)) {
+            selected << key;
+        }
+    }
+    for (const QString& column : columns) {
+        if (!allowed.contains(column)) {
+            qWarning() << "忽略未知列:" << QString::fromStdString(table) << column;
+            continue;
+        }
+        if (!selected.contains(column)) {
+            selected << column;
+        }
+    }
+
+    return selected.isEmpty() ? "*" : selected.join(", ").toStdString();
+}
+
+// 条件更新：WHERE 同时比较 expected 中的旧值，命中才更新，RETURNING 带回新行；
+// 列名来自调用方，只接受白名单中的列
+std::string SQLite3Handler::buildCompareAndSetQuery(const std::string& table, int id, const QVariantMap& expected,
+    const QVariantMap& updates, std::map<std::string, std::string>& params) const
+{
+    const QStringList& allowed = (table == "users") ? kUserColumns : kProductColumns;
+
+    QStringList setClauses;
     for (auto it = updates.begin(); it != updates.end(); ++it) {
+        if (!allowed.contains(it.key()) || it.key() == "id") {
+            qWarning() << "条件更新忽略列:" << it.key();
+            continue;
+        }
+        const std::string column = it.key().toStdString();
+        setClauses << QString::fromStdString(column + " = :set_" + column);
+        params["set_" + column] = it.value().toString().toStdString();
+    }
+    if (setClauses.isEmpty()) {
+        return std::string();
+    }
+
+    QStringList conditions;
+    conditions << "id = :id";
+    params["id"] = std::to_string(id);
+    for (auto it = expected.begin(); it != expected.end(); ++it) {
+        if (!allowed.contains(it.key())) {
+            qWarning() << "条件更新忽略列:" << it.key();
+            continue;
+        }
+        const std::string column = it.key().toStdString();
+        if (it.value().isNull()) {
+            conditions << QString::fromStdString(column + " IS NULL");
+        } else {
+            conditions << QString::fromStdString(column + " = :expect_" + column);
+            params["expect_" + column] = it.value().toString().toStdString();
+        }
+    }
+
+    return "UPDATE " + table + " SET " + setClauses.join(", ").toStdString()
+        + " WHERE " + conditions.join(" AND ").toStdString() + " RETURNING *";
+}
+
+// 批量读取：id 列表以 JSON 数组绑定为单个参数，由 json_each 展开后走主键查找，语句文本与 id 个数无关
+std::string SQLite3Handler::buildMultiGetQuery(const std::string& table, const QList<int>& ids, const QStringList& columns,
+    std::map<std::string, std::string>& params, QVariantMap& context) const
+{
+    QJsonArray idArray;
+    QVariantList requested;
+    QSet<int> seen;
+    seen.reserve(ids.size());
+    for (int id : ids) {
+        if (!seen.contains(id)) {
+            seen.insert(id);
+            idArray.append(id);
+            requested << id;
+        }
+    }
+
+    params["ids"] = QJsonDocument(idArray).toJson(QJsonDocument::Compact).toStdString();
+    context["ids"] = requested;
+
+    return "SELECT " + buildColumnList(table, columns, { "id" }) + " FROM " + table
+        + " WHERE id IN (SELECT value FROM json_each(:ids))";
+}
+
+// 子串搜索：词长 >= 3 时走 FTS5 trigram 索引并按 bm25 排序，
+// 更短的词 trigram 无法匹配，退回带 LIMIT 的 LIKE
+std::string SQLite3Handler::buildNameSearchQuery(const std::string& table, const std::string& column,
+    const QString& term, int limit, std::map<std::string, std::string>& params) const
+{
+    params["limit"] = std::to_string(limit > 0 ? limit : kDefaultSearchLimit);
+
+    if (m_stateMachine->hasFullTextSearch() && term.toUcs4().size() >= 3) {
+        // FTS5 短语语法：双引号包裹，内部双引号写两遍
+        QString phrase = term;
+        phrase.replace("\"", "\"\"");
+        params["match"] = column + " : \"" + phrase.toStdString() + "\"";
+
+        return "SELECT t.* FROM " + table + "_fts f JOIN " + table + " t ON t.id = f.rowid"
+            + " WHERE " + table + "_fts MATCH :match ORDER BY f.rank LIMIT :limit";
+    }
+
+    params["term"] = "%" + term.toStdString() + "%";
+    return "SELECT * FROM " + table + " WHERE " + column + " LIKE :term ORDER BY id LIMIT :limit";
+}
+
+std::string SQLite3Handler::buildInsertUserQuery(const QVariantMap& data, std::map<std::string, std::string>& params) const
+{
+    std::string query = "INSERT INTO users (name, email, age) VALUES (:name, :email, :age)";
+
+    // 确保参数名称与SQL语句中的占位符完全匹配
+    params["name"] = data["name"].toString().toStdString();
+    params["email"] = data["email"].toString().toStdString();
+    params["age"] = std::to_string(data["age"].toInt());
+
+    return query;
+}
+
+// 邮箱已存在时插入 0 行而不是违反 UNIQUE 约束
+std::string SQLite3Handler::buildGuardedInsertUserQuery(const QVariantMap& data, std::map<std::string, std::string>& params) const
+{
+    std::string query = "INSERT INTO users (name, email, age) SELECT :name, :email, :age"
+                        " WHERE NOT EXISTS (SELECT 1 FROM users WHERE email = :email)";
+
+    params["name"] = data["name"].toString().toStdString();
+    params["email"] = data["email"].toString().toStdString();
+    params["age"] = std::to_string(data["age"].toInt());
+
+    return query;
+}
+
+QVariant SQLite3Handler::buildDuplicateEmailResult(const QString& email)
+{
+    QVariantMap result;
+    result["error_code"] = QString::fromLatin1(OperationError::kDuplicateEmail);
+    result["error"] = QString("邮箱已存在: %1").arg(email);
+    result["email"] = email;
+    return result;
+}
+
+std::string SQLite3Handler::buildUpdateUserQuery(int userId, const QVariantMap& updates, std::map<std::string, std::string>& params) const
+{
+    std::string query = "UPDATE users SET ";
+    QStringList setClauses;
+
+    // 键名会拼进 SQL，只接受可更新列
+    const QStringList& allowed = updatableColumns("users");
+    for (auto it = updates.begin(); it != updates.end(); ++it) {
+        if (!allowed.contains(it.key())) {
+            qWarning() << "更新忽略列:" << it.key();
+            continue;
+        }
         std::string paramName = it.key().toStdString();
         setClauses << QString::fromStdString(paramName + " = :" + paramName);
         params[paramName] = it.value().toString().toStdString();
     }
+    if (setClauses.isEmpty()) {
+        return std::string();
+    }
 
     query += setClauses.join(", ").toStdString();
     query += " WHERE id = :id";
@@ -492,11 +1850,20 @@ std::string SQLite3Handler::buildUpdateProductQuery(int productId, const QVarian
     std::string query = "UPDATE products SET ";
     QStringList setClauses;
 
+    // 键名会拼进 SQL，只接受可更新列
+    const QStringList& allowed = updatableColumns("products");
     for (auto it = updates.begin(); it != updates.end(); ++it) {
+        if (!allowed.contains(it.key())) {
+            qWarning() << "更新忽略列:" << it.key();
+            continue;
+        }
         std::string paramName = it.key().toStdString();
         setClauses << QString::fromStdString(paramName + " = :" + paramName);
         params[paramName] = it.value().toString().toStdString();
     }
+    if (setClauses.isEmpty()) {
+        return std::string();
+    }
 
     query += setClauses.join(", ").toStdString();
     query += " WHERE id = :id";
@@ -507,16 +1874,35 @@ std::string SQLite3Handler::buildUpdateProductQuery(int productId, const QVarian
 
 QString SQLite3Handler::getOperationType(const QString& operationId) const
 {
-
+    QMutexLocker locker(&m_operationMutex);
     return m_operationTypes.value(operationId, "unknown");
 }
 
 void SQLite3Handler::setOperationType(const QString& operationId, const QString& type)
 {
+    QMutexLocker locker(&m_operationMutex);
     m_operationTypes[operationId] = type;
 }
 
 void SQLite3Handler::clearOperationType(const QString& operationId)
 {
+    QMutexLocker locker(&m_operationMutex);
     m_operationTypes.remove(operationId);
 }
+
+QString SQLite3Handler::beginOperation(const QString& type, const QVariantMap& context, const QString& operationId)
+{
+    const QString id = operationId.isEmpty() ? QString::fromStdString(OperationRequest::generateUUID()) : operationId;
+    QMutexLocker locker(&m_operationMutex);
+    m_operationTypes.insert(id, type);
+    if (!context.isEmpty()) {
+        m_operationContexts.insert(id, context);
+    }
+    return id;
+}
+
+QVariantMap SQLite3Handler::takeOperationContext(const QString& operationId)
+{
+    QMutexLocker locker(&m_operationMutex);
+    return m_operationContexts.take(operationId);
+}
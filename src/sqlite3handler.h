@@ -2,12 +2,32 @@
 #ifndef SQLITE3HANDLER_H
 #define SQLITE3HANDLER_H
 
+#include "aggregateverifier.h"
+#include "changetracker.h"
+#include "databasebackup.h"
+#include "emailfilter.h"
+#include "latencyrecorder.h"
+#include "materializedaggregates.h"
+#include "productcolumnstore.h"
+#include "productpriceindex.h"
+#include "queryprofiler.h"
+#include "retentionmanager.h"
 #include "sqlite3statemachine.h"
+#include "stockcountercache.h"
+#include "tracerecorder.h"
+#include "walcheckpointer.h"
+#include "workloadcapture.h"
+#include <QMutex>
 #include <QObject>
 #include <QString>
+#include <QStringList>
+#include <QThread>
+#include <QTimer>
 #include <QVariant>
 #include <QVariantList>
 #include <QVariantMap>
+#include <atomic>
+#include <chrono>
 #include <map>
 #include <string>
 #include <vector>
@@ -23,22 +43,60 @@ public:
     bool initialize();
 
     // 用户管理操作 - 异步（使用队列）
+    // 邮箱重复时失败，结果为 {error_code: DUPLICATE_EMAIL, error, email}
     QString addUser(const QString& name, const QString& email, int age = 0);
     QString updateUser(int userId, const QVariantMap& updates);
     QString deleteUser(int userId);
-    QString getUserById(int userId);
-    QString getAllUsers();
-    QString findUsersByName(const QString& name);
-    QString findUsersByEmail(const QString& email);
+    // columns 为空时返回整行，否则只取白名单内的列
+    QString getUserById(int userId, const QStringList& columns = QStringList());
+    QString getAllUsers(const QStringList& columns = QStringList());
+    QString findUsersByName(const QString& name, int limit = 100);
+    QString findUsersByEmail(const QString& email, int limit = 100);
+
+    // 键集分页：cursor 为上一页返回的 next_cursor，首页传空
+    // 结果为 {rows, next_cursor, has_more}，每页开销与表大小无关
+    QString getUsersPage(const QString& cursor = QString(), int limit = 100, const QStringList& columns = QStringList());
+
+    // 批量按 id 读取：一条语句绑定全部 id，结果为 {rows: {id: row}, missing: [id]}
+    QString getUsersByIds(const QList<int>& userIds, const QStringList& columns = QStringList());
+
+    // upsert：按 email 冲突更新，一条语句完成并返回最终行
+    QString upsertUser(const QString& name, const QString& email, int age = 0);
+    // 条件更新：只有当前值与 expected 一致时才应用 updates，结果为 {applied, row}
+    QString compareAndSetUser(int userId, const QVariantMap& expected, const QVariantMap& updates);
+    // 批量 upsert：多行 VALUES，每条语句最多 200 行，返回每条语句的操作 ID
+    QStringList bulkUpsertUsers(const QVariantList& users);
+
+    // 标量查询：结果直接是数值/布尔，不构造行
+    QString countUsers();
+    QString existsUserByEmail(const QString& email);
 
     // 产品管理操作 - 异步（使用队列）
     QString addProduct(const QString& name, double price, int stock = 0);
     QString updateProduct(int productId, const QVariantMap& updates);
     QString deleteProduct(int productId);
-    QString getProductById(int productId);
-    QString getAllProducts();
+    QString getProductById(int productId, const QStringList& columns = QStringList());
+    QString getAllProducts(const QStringList& columns = QStringList());
     QString findProductsByPriceRange(double minPrice, double maxPrice);
-    QString findProductsByName(const QString& name);
+    // 内存价格索引上的同步区间查询，可在任意线程调用，不进入队列；
+    // 索引未启用或尚未加载时返回 false
+    bool findProductsByPriceRangeCached(double minPrice, double maxPrice, QVariantList& rows, int limit = -1) const;
+    QString findProductsByName(const QString& name, int limit = 100);
+
+    // 产品分页：默认按 id，价格区间按 (price, id) 复合键
+    QString getProductsPage(const QString& cursor = QString(), int limit = 100, const QStringList& columns = QStringList());
+    QString findProductsByPriceRangePage(double minPrice, double maxPrice, const QString& cursor = QString(), int limit = 100,
+        const QStringList& columns = QStringList());
+
+    QString getProductsByIds(const QList<int>& productIds, const QStringList& columns = QStringList());
+
+    // productId <= 0 时按新产品插入，否则按 id 冲突更新
+    QString upsertProduct(int productId, const QString& name, double price, int stock = 0);
+    QString compareAndSetProduct(int productId, const QVariantMap& expected, const QVariantMap& updates);
+    QStringList bulkUpsertProducts(const QVariantList& products);
+
+    QString countProducts();
+    QString countProductsInPriceRange(double minPrice, double maxPrice);
 
     // 库存管理操作
     QString updateProductStock(int productId, int newStock);
@@ -47,6 +105,8 @@ public:
 
     // 通用查询操作 - 异步（使用队列）
     QString executeCustomQuery(const QString& query, const QVariantMap& params = QVariantMap());
+    // 回放录制的请求，request.id 由调用方分配且必须唯一
+    QString replayRequest(const OperationRequest& request);
 
     // 立即执行操作（绕过队列）
     bool executeCustomCommand(const QString& command, const QVariantMap& params = QVariantMap());
@@ -58,8 +118,88 @@ public:
     // 状态查询
     bool isConnected() const;
     QString currentState() const;
+    QString databaseFile() const { return m_dbFile; }
+    // updateUser/updateProduct 接受的列（不含 id 与 created_at），table 为 "users" 或 "products"
+    static const QStringList& updatableColumns(const QString& table);
     int queueSize() const;
 
+    // 按操作类型的分阶段延迟（queue_wait / execute / serialize / deliver），任意线程可调用
+    QVariantMap latencySnapshot() const;
+    // 投递阶段：DBOperateThread 收到完成信号时调用
+    void setDeliveryLatencyTracking(bool enabled);
+    void recordDelivery(const QString& operationId);
+    const LatencyRecorder& latencyRecorder() const { return m_latency; }
+    // 链路追踪（默认关闭），开关、导出与慢操作触发均可在任意线程调用
+    TraceRecorder* traceRecorder() { return &m_trace; }
+    // 工作负载录制（默认关闭），开始/停止与指标读取均可在任意线程调用
+    WorkloadCapture* workloadCapture() { return &m_capture; }
+
+    // 指标采集用的无锁读数，任意线程可调用，不会碰数据库线程持有的锁。
+    // 状态、页缓存命中与 WAL 大小由数据库线程每秒采样一次（连接建立后开始）
+    static const QStringList& knownStates();
+    QString sampledState() const;
+    void sampledPageCache(qint64& hits, qint64& misses) const;
+    qint64 sampledWalSizeBytes() const;
+    int inFlightOperations() const;
+
+    // WAL 检查点调度（策略需在连接建立前设置）
+    void setWalCheckpointPolicy(const WalCheckpointPolicy& policy);
+    QVariantMap walCheckpointMetrics() const;
+
+    // 语句级剖析与慢查询日志（策略需在连接建立前设置）
+    void setQueryProfilerPolicy(const QueryProfilerPolicy& policy);
+    QVariantMap queryProfilerMetrics() const;
+    QVariantList queryShapes(int limit = 20) const;
+
+    // operation_queue / app_state 保留策略
+    void setRetentionPolicy(const RetentionPolicy& policy);
+    QVariantMap retentionMetrics() const;
+
+    // 排队写入合并：同一行上的覆盖写后者胜出，增量写求和；每个被合并的操作仍会收到完成信号
+    void setWriteCoalescing(bool enabled);
+    QVariantMap coalesceMetrics() const;
+
+    // 邮箱布隆过滤器（需在连接建立前启用）：addUser 据此跳过重复确认，或在不抛异常的情况下拒绝重复邮箱
+    void setEmailFilterEnabled(bool enabled);
+    QVariantMap emailFilterMetrics() const;
+
+    // 行级变更事件（需在连接建立前启用）：users/products 表提交后的变更经 tableChanged 信号发出
+    void setChangeEventsEnabled(bool enabled);
+
+    // 内存价格索引（需在连接建立前启用）
+    void setPriceIndexEnabled(bool enabled);
+    QVariantMap priceIndexMetrics() const;
+
+    // 列式镜像上的分析型操作：同步执行，不进入队列，也不占用数据库线程；
+    // 镜像未启用或尚未加载时返回 false
+    void setColumnStoreEnabled(bool enabled);
+    QVariantMap columnStoreMetrics() const;
+    bool totalInventoryValue(double& value) const;
+    bool countLowStockProducts(int threshold, qint64& count) const;
+    bool countProductsInPriceRangeCached(double minPrice, double maxPrice, qint64& count) const;
+    bool priceHistogram(double minPrice, double maxPrice, int bins, QVariantList& counts) const;
+
+    // 物化聚合（策略需在连接建立前设置）：读取为 O(1)，值随写入事务一起提交，提交后刷新到内存；
+    // 聚合名见 MaterializedAggregates::defaultDefinitions，未启用或尚未加载时返回 false
+    void setMaterializedAggregatePolicy(const MaterializedAggregatePolicy& policy);
+    QVariantMap materializedAggregateMetrics() const;
+    bool materializedAggregate(const QString& name, double& value) const;
+    bool materializedAggregates(QVariantMap& values) const;
+    // 按价格分桶的库存价值：[{min_price, max_price, value}]，最后一桶 max_price 为空
+    bool stockValueByPriceBucket(QVariantList& buckets) const;
+    // 立即执行一次后台全量重算校验
+    void verifyMaterializedAggregates();
+
+    // 热点库存计数（策略需在连接建立前设置）：启用后库存增减在内存中完成并定期回写
+    void setStockCounterPolicy(const StockCounterPolicy& policy);
+    QVariantMap stockCounterMetrics() const;
+
+    // 在线备份：分步复制到 destFile，与队列处理交替进行，不阻塞写入
+    QString backupDatabase(const QString& destFile, const BackupOptions& options = BackupOptions());
+
+    // 状态机返回的 JSON 文本转为 QVariantList / QVariantMap
+    static QVariant parseJsonResult(const QString& jsonResult);
+
     // 事务支持（立即执行）
     bool beginTransaction();
     bool commitTransaction();
@@ -81,6 +221,12 @@ signals:
     // 通用操作完成信号
     void operationCompleted(const QString& operationId, bool success, const QVariant& result);
 
+    // 状态机进入稳定状态（idle/running/error 等），在数据库线程中发出
+    void stateChanged(const QString& state);
+
+    // 已提交的行级变更，在数据库线程中发出（见 setChangeEventsEnabled）
+    void tableChanged(const QString& table, const QList<ChangeTracker::RowChange>& changes);
+
     // 特定操作完成信号
     void userAdded(const QString& operationId, bool success, const QVariant& result);
     void userUpdated(const QString& operationId, bool success, const QVariant& result);
@@ -98,6 +244,10 @@ signals:
     void batchUsersCompleted(const QString& operationId, bool success, const QVariant& result);
     void batchProductsCompleted(const QString& operationId, bool success, const QVariant& result);
 
+    // 备份信号
+    void backupProgress(const QString& operationId, int remainingPages, int totalPages);
+    void backupCompleted(const QString& operationId, bool success, const QVariant& result);
+
     // 状态信号
     void connected();
     void disconnected();
@@ -108,14 +258,32 @@ private slots:
     void onConnectionEstablished();
     void onConnectionLost();
     void onErrorOccurred(const QString& error);
+    void onBackupFinished(const QString& operationId, bool success, const QVariant& result);
 
 private:
     // 类型转换辅助函数
     std::map<std::string, std::string> qvariantMapToStringMap(const QVariantMap& qmap) const;
-    QVariant parseJsonResult(const QString& jsonResult) const;
+
+    // 分页游标编解码与结果整理
+    static QString encodeCursor(const QVariantMap& key);
+    static bool decodeCursor(const QString& cursor, QVariantMap& key);
+    QVariant buildPageResult(const QVariantMap& context, const QVariant& rows) const;
+    static QVariant buildScalarResult(const QVariantMap& context, const QVariant& result);
+    static QVariant buildMultiGetResult(const QVariantMap& context, const QVariant& rows);
+    static QVariant buildReturningResult(const QVariantMap& context, const QVariant& rows);
 
     // 构建查询语句和参数
+    std::string buildColumnList(const std::string& table, const QStringList& columns,
+        const QStringList& keyColumns = QStringList()) const;
+    std::string buildCompareAndSetQuery(const std::string& table, int id, const QVariantMap& expected,
+        const QVariantMap& updates, std::map<std::string, std::string>& params) const;
+    std::string buildMultiGetQuery(const std::string& table, const QList<int>& ids, const QStringList& columns,
+        std::map<std::string, std::string>& params, QVariantMap& context) const;
+    std::string buildNameSearchQuery(const std::string& table, const std::string& column,
+        const QString& term, int limit, std::map<std::string, std::string>& params) const;
     std::string buildInsertUserQuery(const QVariantMap& data, std::map<std::string, std::string>& params) const;
+    std::string buildGuardedInsertUserQuery(const QVariantMap& data, std::map<std::string, std::string>& params) const;
+    static QVariant buildDuplicateEmailResult(const QString& email);
     std::string buildUpdateUserQuery(int userId, const QVariantMap& updates, std::map<std::string, std::string>& params) const;
     std::string buildInsertProductQuery(const QVariantMap& data, std::map<std::string, std::string>& params) const;
     std::string buildUpdateProductQuery(int productId, const QVariantMap& updates, std::map<std::string, std::string>& params) const;
@@ -125,12 +293,100 @@ private:
     void setOperationType(const QString& operationId, const QString& type);
     // void clearOperationType(const QString& operationId);
 
+    // 把状态机记录的耗时与处理器侧的解析整理时间计入直方图
+    void recordLatency(const QString& operationId, const QString& operationType,
+        std::chrono::steady_clock::time_point receivedAt);
+
+    // 生成操作 ID 并登记类型和上下文（结果需要二次整理的操作，如分页），之后才能入队：
+    // 调用方可能在任意线程，完成回调在数据库线程，先登记保证完成时一定能取到
+    // operationId 为空时生成新 ID
+    QString beginOperation(const QString& type, const QVariantMap& context = QVariantMap(),
+        const QString& operationId = QString());
+    QVariantMap takeOperationContext(const QString& operationId);
+
+    // 热点库存：内存中增减、加载完成后的判定，以及其他写入前的回写移出
+    QString applyStockDelta(int productId, int delta, const QString& operationType);
+    void onStockLoaded(int productId, bool success, const QVariant& rows);
+    void finishStockOperation(const QString& operationId, bool success, const QVariant& result);
+    void evictHotStock(int productId);
+    void evictAllHotStock();
+
+    // 变更跟踪：首次需要时在写连接上注册钩子
+    ChangeTracker* ensureChangeTracker();
+
+    // 数据库线程：刷新采样值
+    void sampleGauges();
+
+    // 后台检查点线程
+    void startWalCheckpointer();
+    void stopWalCheckpointer();
+
+    // 物化聚合：安装触发器并启动后台校验线程
+    void startMaterializedAggregates();
+    void stopAggregateVerifier();
+
+    // 在线备份（在数据库线程中执行）
+    void startBackup(const QString& operationId, const QString& destFile, const BackupOptions& options);
+
     SQLite3StateMachine* m_stateMachine;
     QString m_dbFile;
     bool m_initialized;
 
-    // 操作类型跟踪
+    // 操作类型跟踪（调用方线程登记，数据库线程取用）
+    mutable QMutex m_operationMutex;
     QMap<QString, QString> m_operationTypes;
+    QMap<QString, QVariantMap> m_operationContexts;
+
+    // 分阶段延迟直方图
+    LatencyRecorder m_latency;
+    TraceRecorder m_trace;
+    WorkloadCapture m_capture;
+
+    // 采样值（数据库线程写，任意线程读）
+    QTimer* m_gaugeTimer = nullptr;
+    std::atomic<int> m_sampledState { -1 };
+    std::atomic<qint64> m_pageCacheHits { 0 };
+    std::atomic<qint64> m_pageCacheMisses { 0 };
+    std::atomic<qint64> m_sampledWalSize { 0 };
+
+    // WAL 检查点
+    WalCheckpointPolicy m_walPolicy;
+    QThread* m_checkpointThread = nullptr;
+    WalCheckpointer* m_walCheckpointer = nullptr;
+
+    // 语句剖析（挂在写连接上）
+    QueryProfilerPolicy m_profilerPolicy;
+    std::atomic<QueryProfiler*> m_queryProfiler { nullptr }; // 数据库线程发布，/metrics 在 IO 线程读取
+
+    // 保留与压缩（数据库线程）
+    RetentionPolicy m_retentionPolicy;
+    RetentionManager* m_retentionManager = nullptr;
+
+    // 变更跟踪与内存价格索引（数据库线程维护）
+    ChangeTracker* m_changeTracker = nullptr;
+    bool m_emailFilterEnabled = false;
+    std::atomic<EmailFilter*> m_emailFilter { nullptr }; // 数据库线程发布，调用方线程读取
+    bool m_priceIndexEnabled = false;
+    bool m_changeEventsEnabled = false;
+    bool m_changeEventsConnected = false;
+    std::atomic<ProductPriceIndex*> m_priceIndex { nullptr }; // 同 m_emailFilter
+    bool m_columnStoreEnabled = false;
+    std::atomic<ProductColumnStore*> m_columnStore { nullptr }; // 同 m_emailFilter
+
+    // 物化聚合（数据库线程维护）与后台校验线程
+    MaterializedAggregatePolicy m_aggregatePolicy;
+    MaterializedAggregates* m_aggregates = nullptr;
+    bool m_aggregateTriggersChecked = false;
+    QThread* m_verifierThread = nullptr;
+    AggregateVerifier* m_aggregateVerifier = nullptr;
+
+    // 热点库存计数（数据库线程）
+    StockCounterPolicy m_stockPolicy;
+    StockCounterCache* m_stockCounters = nullptr;
+    std::atomic<quint64> m_stockSequence { 0 };
+
+    // 当前在线备份（同一时间只允许一个）
+    DatabaseBackup* m_activeBackup = nullptr;
 };
 
 #endif // SQLITE3HANDLER_H
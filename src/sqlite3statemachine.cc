@@ -11,6 +11,28 @@
 #include <qjsonarray.h>
 #include <soci/sqlite3/soci-sqlite3.h>
 
+namespace {
+// 内联自动检查点的兜底阈值（页数），正常情况下后台检查点会先于它触发
+constexpr int kWalAutoCheckpointBackstopPages = 32768;
+
+// trace 区间名只保存指针，事件名需映射到字面量
+const char* traceEventName(const QString& event)
+{
+    if (event == "check.database") {
+        return "scxml.check.database";
+    } else if (event == "start.actual.task") {
+        return "scxml.start.actual.task";
+    } else if (event == "stop.actual.task") {
+        return "scxml.stop.actual.task";
+    } else if (event == "record.state") {
+        return "scxml.record.state";
+    } else if (event == "handle.error") {
+        return "scxml.handle.error";
+    }
+    return "scxml.event";
+}
+}
+
 SQLite3StateMachine::SQLite3StateMachine(const QString& dbFile, QObject* parent)
     : QObject(parent)
     , m_dbFile(dbFile)
@@ -131,21 +153,50 @@ bool SQLite3StateMachine::isConnected() const
     return state == "idle" || state == "running";
 }
 
+bool SQLite3StateMachine::isProcessing() const
+{
+    return m_processingOperation;
+}
+
+QString SQLite3StateMachine::databaseFile() const
+{
+    return m_dbFile;
+}
+
 soci::session* SQLite3StateMachine::getSession() const
 {
     return m_dbSession.get();
 }
 
+sqlite3* SQLite3StateMachine::nativeHandle() const
+{
+    if (!m_dbSession) {
+        return nullptr;
+    }
+
+    // 不同版本的 SOCI 会把 sqlite3 声明在 sqlite_api 命名空间中，经 void* 转换到全局类型
+    auto* backend = static_cast<soci::sqlite3_session_backend*>(m_dbSession->get_backend());
+    void* handle = backend ? backend->conn_ : nullptr;
+    return static_cast<sqlite3*>(handle);
+}
+
 int SQLite3StateMachine::queueSize() const
 {
-    QMutexLocker locker(&m_queueMutex);
-    return m_operationQueue.size();
+    return m_queueDepth.load(std::memory_order_relaxed);
+}
+
+int SQLite3StateMachine::inFlightOperations() const
+{
+    return std::max(0, m_inFlight.load(std::memory_order_relaxed));
 }
 
 void SQLite3StateMachine::clearQueue()
 {
     QMutexLocker locker(&m_queueMutex);
+    // 清掉的操作不会再有完成通知
+    m_inFlight.fetch_sub(m_operationQueue.size(), std::memory_order_relaxed);
     m_operationQueue.clear();
+    m_queueDepth.store(0, std::memory_order_relaxed);
     emit queueSizeChanged(0);
 }
 
@@ -168,7 +219,8 @@ void SQLite3StateMachine::stopConnection()
     }
 }
 
-QString SQLite3StateMachine::executeQuery(const QString& query, const std::map<std::string, std::string>& params)
+QString SQLite3StateMachine::executeQuery(const QString& query, const std::map<std::string, std::string>& params,
+    const QString& operationId)
 {
     OperationRequest request("query");
     request.setStringParam("query", qstringToString(query));
@@ -178,6 +230,72 @@ QString SQLite3StateMachine::executeQuery(const QString& query, const std::map<s
         request.setStringParam(param.first, param.second);
     }
 
+    if (!operationId.isEmpty()) {
+        request.id = qstringToString(operationId);
+    }
+
+    addToQueue(request);
+    return QString::fromStdString(request.id);
+}
+
+QString SQLite3StateMachine::executeReturningQuery(const QString& query, const std::map<std::string, std::string>& params,
+    const QString& operationId)
+{
+    OperationRequest request("query");
+    request.setStringParam("query", qstringToString(query));
+    request.setBoolParam(OperationRequest::kReturnsRows, true);
+
+    for (const auto& param : params) {
+        request.setStringParam(param.first, param.second);
+    }
+
+    if (!operationId.isEmpty()) {
+        request.id = qstringToString(operationId);
+    }
+
+    addToQueue(request);
+    return QString::fromStdString(request.id);
+}
+
+QString SQLite3StateMachine::executeWrite(const QString& query, const std::map<std::string, std::string>& params,
+    const CoalesceSpec& coalesce, const QString& operationId)
+{
+    OperationRequest request("query");
+    request.setStringParam("query", qstringToString(query));
+
+    for (const auto& param : params) {
+        request.setStringParam(param.first, param.second);
+    }
+    request.coalesce = coalesce;
+
+    if (!operationId.isEmpty()) {
+        request.id = qstringToString(operationId);
+    }
+
+    addToQueue(request);
+    return QString::fromStdString(request.id);
+}
+
+QString SQLite3StateMachine::enqueueRequest(const OperationRequest& request)
+{
+    addToQueue(request);
+    return QString::fromStdString(request.id);
+}
+
+QString SQLite3StateMachine::executeScalarQuery(const QString& query, const std::map<std::string, std::string>& params,
+    const QString& operationId)
+{
+    OperationRequest request("scalar");
+    request.setStringParam("query", qstringToString(query));
+
+    for (const auto& param : params) {
+        request.setStringParam(param.first, param.second);
+    }
+
+    if (!operationId.isEmpty()) {
+        request.id = qstringToString(operationId);
+    }
+
     addToQueue(request);
     return QString::fromStdString(request.id);
 }
@@ -202,6 +320,7 @@ bool SQLite3StateMachine::executeImmediateQuery(const QString& query, const std:
 
 void SQLite3StateMachine::handleStateMachineEvent(const QString& event, const QVariant& data)
 {
+    TraceRecorder::Span span(m_trace, traceEventName(event), m_currentOperationId);
     qDebug() << "处理状态机事件:" << event;
 
     if (event == "check.database") {
@@ -265,6 +384,8 @@ void SQLite3StateMachine::processNextOperation()
         return; // 已经在处理操作
     }
 
+    // 出队、执行和同线程内的完成处理都嵌套在这个区间里
+    TraceRecorder::Span span(m_trace, "processNextOperation");
     OperationRequest request = dequeue();
     if (request.id.empty()) {
         // 队列为空，停止任务
@@ -275,11 +396,14 @@ void SQLite3StateMachine::processNextOperation()
     m_processingOperation = true;
     m_currentOperationId = QString::fromStdString(request.id);
     m_currentRequest = request;
+    span.setOperationId(m_currentOperationId);
 
     emit operationStarted(m_currentOperationId);
 
     if (request.isQueryType()) {
         handleQueryExecution(request);
+    } else if (request.isScalarType()) {
+        handleScalarExecution(request);
     }
     // 可以添加其他操作类型的处理
 }
@@ -377,6 +501,23 @@ bool SQLite3StateMachine::connectToDatabase()
 
         m_dbSession = std::make_unique<soci::session>(soci::sqlite3, qstringToString(m_dbFile));
 
+        // 启用 WAL；提交时的内联自动检查点只保留一个很大的兜底阈值，
+        // 日常检查点由 WalCheckpointer 在后台低优先级线程中调度，避免卡住写入
+        try {
+            // auto_vacuum 必须在写入库头之前设置，只对新库生效，供 RetentionManager 归还空间
+            if (!dbExists) {
+                *m_dbSession << "PRAGMA auto_vacuum = INCREMENTAL";
+            }
+
+            std::string journalMode;
+            *m_dbSession << "PRAGMA journal_mode = WAL", soci::into(journalMode);
+            *m_dbSession << "PRAGMA wal_autocheckpoint = " + std::to_string(kWalAutoCheckpointBackstopPages);
+            *m_dbSession << "PRAGMA busy_timeout = 5000";
+            qDebug() << "日志模式:" << QString::fromStdString(journalMode);
+        } catch (const std::exception& e) {
+            qWarning() << "设置 WAL 模式失败:" << e.what();
+        }
+
         // 无论数据库是否存在，都执行创建表语句
         std::vector<std::string> createTableStatements = {
             R"(CREATE TABLE IF NOT EXISTS app_state (
@@ -433,6 +574,8 @@ bool SQLite3StateMachine::connectToDatabase()
             }
         }
 
+        ensureFullTextIndexes();
+
         if (!dbExists) {
             qDebug() << "新数据库已创建并连接:" << m_dbFile;
         } else {
@@ -447,6 +590,76 @@ bool SQLite3StateMachine::connectToDatabase()
     }
 }
 
+// users.name/email 与 products.name 的 FTS5 trigram 影子索引，由触发器与主表保持同步
+// trigram 分词支持任意子串匹配，可替代 LIKE '%x%' 的全表扫描
+void SQLite3StateMachine::ensureFullTextIndexes()
+{
+    m_fullTextSearch = false;
+
+    int existing = 0;
+    try {
+        *m_dbSession << "SELECT COUNT(*) FROM sqlite_master WHERE type = 'table' AND name IN ('users_fts', 'products_fts')",
+            soci::into(existing);
+    } catch (const std::exception& e) {
+        qWarning() << "检查全文索引失败:" << e.what();
+        return;
+    }
+
+    const std::vector<std::string> statements = {
+        R"(CREATE VIRTUAL TABLE IF NOT EXISTS users_fts USING fts5(
+            name, email, content='users', content_rowid='id', tokenize='trigram'
+        ))",
+        R"(CREATE TRIGGER IF NOT EXISTS users_fts_ai AFTER INSERT ON users BEGIN
+            INSERT INTO users_fts(rowid, name, email) VALUES (new.id, new.name, new.email);
+        END)",
+        R"(CREATE TRIGGER IF NOT EXISTS users_fts_ad AFTER DELETE ON users BEGIN
+            INSERT INTO users_fts(users_fts, rowid, name, email) VALUES ('delete', old.id, old.name, old.email);
+        END)",
+        R"(CREATE TRIGGER IF NOT EXISTS users_fts_au AFTER UPDATE OF name, email ON users BEGIN
+            INSERT INTO users_fts(users_fts, rowid, name, email) VALUES ('delete', old.id, old.name, old.email);
+            INSERT INTO users_fts(rowid, name, email) VALUES (new.id, new.name, new.email);
+        END)",
+
+        R"(CREATE VIRTUAL TABLE IF NOT EXISTS products_fts USING fts5(
+            name, content='products', content_rowid='id', tokenize='trigram'
+        ))",
+        R"(CREATE TRIGGER IF NOT EXISTS products_fts_ai AFTER INSERT ON products BEGIN
+            INSERT INTO products_fts(rowid, name) VALUES (new.id, new.name);
+        END)",
+        R"(CREATE TRIGGER IF NOT EXISTS products_fts_ad AFTER DELETE ON products BEGIN
+            INSERT INTO products_fts(products_fts, rowid, name) VALUES ('delete', old.id, old.name);
+        END)",
+        R"(CREATE TRIGGER IF NOT EXISTS products_fts_au AFTER UPDATE OF name ON products BEGIN
+            INSERT INTO products_fts(products_fts, rowid, name) VALUES ('delete', old.id, old.name);
+            INSERT INTO products_fts(rowid, name) VALUES (new.id, new.name);
+        END)"
+    };
+
+    try {
+        soci::transaction tr(*m_dbSession);
+        for (const auto& stmt : statements) {
+            *m_dbSession << stmt;
+        }
+
+        // 旧库第一次建索引时需要从主表重建
+        if (existing < 2) {
+            qDebug() << "重建全文索引...";
+            *m_dbSession << "INSERT INTO users_fts(users_fts) VALUES ('rebuild')";
+            *m_dbSession << "INSERT INTO products_fts(products_fts) VALUES ('rebuild')";
+        }
+        tr.commit();
+        m_fullTextSearch = true;
+    } catch (const std::exception& e) {
+        // 没有编译 FTS5 时退回 LIKE 查询
+        qWarning() << "创建全文索引失败，名称搜索将使用 LIKE:" << e.what();
+    }
+}
+
+bool SQLite3StateMachine::hasFullTextSearch() const
+{
+    return m_fullTextSearch;
+}
+
 void SQLite3StateMachine::disconnectDatabase()
 {
     if (m_dbSession) {
@@ -457,11 +670,26 @@ void SQLite3StateMachine::disconnectDatabase()
 
 void SQLite3StateMachine::addToQueue(const OperationRequest& request)
 {
+    const bool tracing = m_trace && m_trace->isEnabled();
+    const QString traceId = tracing ? QString::fromStdString(request.id) : QString();
+    TraceRecorder::Span span(m_trace, "addToQueue", traceId);
+    const auto lockRequestedAt = tracing ? TraceRecorder::Clock::now() : TraceRecorder::Clock::time_point();
+
     QMutexLocker locker(&m_queueMutex);
+    if (tracing) {
+        m_trace->record("queue.lock", lockRequestedAt, TraceRecorder::Clock::now(), traceId);
+    }
     m_operationQueue.enqueue(request);
+    m_queueDepth.store(m_operationQueue.size(), std::memory_order_relaxed);
+    m_inFlight.fetch_add(1, std::memory_order_relaxed);
+    if (m_capture) {
+        // 在队列锁内录制，录制顺序与入队顺序一致
+        m_capture->capture(request);
+    }
 
     // 保存到数据库（可选）
     if (m_dbSession) {
+        TraceRecorder::Span persistSpan(m_trace, "queue.persist", traceId);
         try {
             std::string operationId = request.id;
             std::string operationType = request.type;
@@ -490,6 +718,7 @@ void SQLite3StateMachine::addToQueue(const OperationRequest& request)
 
     // 如果状态机在idle状态，启动任务处理
     if (currentState() == "idle") {
+        TraceRecorder::Span submitSpan(m_trace, "scxml.submit", traceId);
         m_stateMachine->submitEvent("start");
     }
 }
@@ -502,6 +731,15 @@ OperationRequest SQLite3StateMachine::dequeue()
     }
 
     OperationRequest request = m_operationQueue.dequeue();
+    request.dequeued_at = std::chrono::steady_clock::now();
+    if (m_trace && m_trace->isEnabled()) {
+        // 排队等待不占用线程，按操作记为异步区间
+        m_trace->recordAsync("queue.wait", request.enqueued_at, request.dequeued_at, QString::fromStdString(request.id));
+    }
+    if (m_writeCoalescing && request.coalesce.isEnabled()) {
+        coalescePendingWrites(request);
+    }
+    m_queueDepth.store(m_operationQueue.size(), std::memory_order_relaxed);
     emit queueSizeChanged(m_operationQueue.size());
 
     // 更新数据库状态（可选）
@@ -518,6 +756,149 @@ OperationRequest SQLite3StateMachine::dequeue()
     return request;
 }
 
+// 写合并：从队头向后找同一行、同一种类的写入并入 head。
+// 其他行的带键写入与 head 互不影响，可以越过；遇到不带键的操作（可能读写任意行）
+// 或同一行上的其他种类写入时停止，保证合并不会改变任何可观察的顺序
+void SQLite3StateMachine::coalescePendingWrites(OperationRequest& head)
+{
+    constexpr int kMaxScan = 256; // 持锁扫描的上限
+
+    m_coalescibleWrites.fetch_add(1, std::memory_order_relaxed);
+    const std::size_t mergedBefore = head.merged_ids.size();
+
+    for (int i = 0; i < m_operationQueue.size() && i < kMaxScan;) {
+        const OperationRequest& next = m_operationQueue.at(i);
+        if (!next.coalesce.isEnabled()) {
+            break;
+        }
+        if (next.coalesce.row != head.coalesce.row) {
+            ++i;
+            continue;
+        }
+        if (next.coalesce.key != head.coalesce.key || next.coalesce.deltaParam != head.coalesce.deltaParam) {
+            break;
+        }
+
+        if (head.coalesced_members.empty()) {
+            // 合并语句失败时按原样逐条重做：在改写参数之前保存 head 自己的请求
+            head.coalesced_members.push_back(head);
+        }
+        head.coalesced_members.push_back(next);
+
+        if (head.coalesce.deltaParam.empty()) {
+            // 覆盖写：后来的语句和参数胜出
+            head.string_params = next.string_params;
+        } else {
+            // 增量写：参数求和
+            const std::string& param = head.coalesce.deltaParam;
+            const long long sum = std::stoll(head.getStringParam(param, "0")) + std::stoll(next.getStringParam(param, "0"));
+            head.setStringParam(param, std::to_string(sum));
+        }
+        head.merged_ids.push_back(next.id);
+        for (const std::string& id : next.merged_ids) {
+            head.merged_ids.push_back(id);
+        }
+        m_coalescibleWrites.fetch_add(1, std::memory_order_relaxed);
+        m_operationQueue.removeAt(i);
+    }
+
+    const std::size_t merged = head.merged_ids.size() - mergedBefore;
+    if (merged > 0) {
+        m_coalescedWrites.fetch_add(merged, std::memory_order_relaxed);
+        m_coalesceGroups.fetch_add(1, std::memory_order_relaxed);
+
+        // 被合并的操作不会单独出队，在这里一并标记
+        if (m_dbSession) {
+            try {
+                std::string operationId;
+                soci::statement st = (m_dbSession->prepare
+                        << "UPDATE operation_queue SET status = 'coalesced', started_at = CURRENT_TIMESTAMP WHERE operation_id = ?",
+                    soci::use(operationId));
+                for (std::size_t j = mergedBefore; j < head.merged_ids.size(); ++j) {
+                    operationId = head.merged_ids[j];
+                    st.execute(true);
+                }
+            } catch (const std::exception& e) {
+                qWarning() << "更新合并操作状态失败:" << e.what();
+            }
+        }
+    }
+}
+
+// 完成通知：合并进来的操作收到与 head 相同的结果（合并语句失败时不走这里，见 handleQueryExecution）
+void SQLite3StateMachine::emitOperationCompleted(const OperationRequest& request, bool success, const QString& result,
+    std::chrono::steady_clock::time_point executedAt)
+{
+    using std::chrono::duration_cast;
+    using std::chrono::nanoseconds;
+
+    OperationTiming timing;
+    timing.completed_at = std::chrono::steady_clock::now();
+    if (executedAt == std::chrono::steady_clock::time_point()) {
+        executedAt = timing.completed_at;
+    }
+    if (request.dequeued_at != std::chrono::steady_clock::time_point()) {
+        timing.queue_wait_ns = duration_cast<nanoseconds>(request.dequeued_at - request.enqueued_at).count();
+        timing.execute_ns = duration_cast<nanoseconds>(executedAt - request.dequeued_at).count();
+    }
+    timing.serialize_ns = duration_cast<nanoseconds>(timing.completed_at - executedAt).count();
+
+    {
+        // 合并进来的操作沿用 head 的耗时
+        QMutexLocker locker(&m_timingMutex);
+        m_timings.insert(QString::fromStdString(request.id), timing);
+        for (const std::string& mergedId : request.merged_ids) {
+            m_timings.insert(QString::fromStdString(mergedId), timing);
+        }
+    }
+
+    if (m_trace && m_trace->isEnabled() && request.dequeued_at != std::chrono::steady_clock::time_point()) {
+        const QString operationId = QString::fromStdString(request.id);
+        m_trace->record("execute", request.dequeued_at, executedAt, operationId);
+        m_trace->record("serialize", executedAt, timing.completed_at, operationId);
+    }
+
+    m_inFlight.fetch_sub(1 + static_cast<int>(request.merged_ids.size()), std::memory_order_relaxed);
+    emit operationCompleted(QString::fromStdString(request.id), success, result);
+    for (const std::string& mergedId : request.merged_ids) {
+        emit operationCompleted(QString::fromStdString(mergedId), success, result);
+    }
+}
+
+bool SQLite3StateMachine::takeOperationTiming(const QString& operationId, OperationTiming& timing)
+{
+    QMutexLocker locker(&m_timingMutex);
+    auto it = m_timings.find(operationId);
+    if (it == m_timings.end()) {
+        return false;
+    }
+    timing = it.value();
+    m_timings.erase(it);
+    return true;
+}
+
+void SQLite3StateMachine::setWriteCoalescing(bool enabled)
+{
+    m_writeCoalescing = enabled;
+}
+
+QVariantMap SQLite3StateMachine::coalesceMetrics() const
+{
+    const quint64 writes = m_coalescibleWrites.load();
+    const quint64 coalesced = m_coalescedWrites.load();
+
+    QVariantMap result;
+    result["enabled"] = m_writeCoalescing.load();
+    result["coalescible_writes"] = writes;
+    result["coalesced_writes"] = coalesced;
+    result["groups"] = static_cast<quint64>(m_coalesceGroups.load());
+    result["retried_groups"] = static_cast<quint64>(m_coalesceRetries.load());
+    // 合并掉的写入占可合并写入的比例，以及实际执行的语句数与请求数之比
+    result["coalesce_ratio"] = writes > 0 ? static_cast<double>(coalesced) / writes : 0.0;
+    result["executed_ratio"] = writes > 0 ? static_cast<double>(writes - coalesced) / writes : 1.0;
+    return result;
+}
+
 void SQLite3StateMachine::handleError(const QString& errorMsg)
 {
     static int retryCount = 0;
@@ -552,12 +933,30 @@ void SQLite3StateMachine::handleError(const QString& errorMsg)
 void SQLite3StateMachine::handleQueryExecution(const OperationRequest& request)
 {
     if (!m_dbSession) {
-        emit operationCompleted(QString::fromStdString(request.id), false, "数据库连接已断开");
+        emitOperationCompleted(request, false, "数据库连接已断开");
         m_processingOperation = false;
         QTimer::singleShot(0, this, &SQLite3StateMachine::processNextOperation);
         return;
     }
 
+    if (!executeQueryRequest(request) && !request.coalesced_members.empty()) {
+        // 合并后的语句失败（例如增量之和违反 CHECK、最后一条覆盖写触发唯一约束）时，
+        // 单条语句不会留下部分结果，按入队顺序逐条重做，每个操作得到自己的结果
+        qWarning() << "合并写入失败，逐条重试" << request.coalesced_members.size() << "个操作";
+        m_coalesceRetries.fetch_add(1, std::memory_order_relaxed);
+        for (OperationRequest member : request.coalesced_members) {
+            member.dequeued_at = request.dequeued_at;
+            executeQueryRequest(member);
+        }
+    }
+
+    m_processingOperation = false;
+    QTimer::singleShot(0, this, &SQLite3StateMachine::processNextOperation);
+}
+
+// 执行一条查询并发出完成通知；合并组的 head 失败时不通知，返回 false 由调用方逐条重试
+bool SQLite3StateMachine::executeQueryRequest(const OperationRequest& request)
+{
     try {
         // 取出 SQL 文本
         const std::string query = request.getStringParam("query");
@@ -565,7 +964,6 @@ void SQLite3StateMachine::handleQueryExecution(const OperationRequest& request)
         qDebug() << "执行查询:" << qQuery;
 
         const QString trimmed = qQuery.trimmed();
-        const QString lower = trimmed.toLower();
 
         // 小工具：统一按“参数名”绑定
         auto bindParamsByName = [&](soci::statement& st) {
@@ -585,7 +983,10 @@ void SQLite3StateMachine::handleQueryExecution(const OperationRequest& request)
             }
         };
 
-        const bool isSelect = lower.startsWith(QStringLiteral("select"));
+        // 带 RETURNING 的 INSERT/UPDATE/DELETE（upsert、条件更新）由构造请求的一方标记，不解析 SQL 文本
+        const bool isSelect = request.returnsRows()
+            || trimmed.startsWith(QStringLiteral("select"), Qt::CaseInsensitive)
+            || trimmed.startsWith(QStringLiteral("with"), Qt::CaseInsensitive);
 
         if (isSelect) {
             //
@@ -602,50 +1003,59 @@ void SQLite3StateMachine::handleQueryExecution(const OperationRequest& request)
 
             QJsonArray results;
 
+            // 列名每条语句只转换一次，避免每个单元格都构造 QString
+            std::vector<QString> columnNames;
+
             while (st.fetch()) {
                 QJsonObject rowData;
 
+                if (columnNames.empty()) {
+                    columnNames.reserve(row.size());
+                    for (std::size_t i = 0; i < row.size(); ++i) {
+                        columnNames.push_back(QString::fromStdString(row.get_properties(i).get_name()));
+                    }
+                }
+
                 for (std::size_t i = 0; i < row.size(); ++i) {
                     const soci::column_properties& props = row.get_properties(i);
-                    const std::string columnName = props.get_name();
+                    const QString& columnName = columnNames[i];
 
                     if (row.get_indicator(i) == soci::i_ok) {
                         switch (props.get_data_type()) {
                         case soci::dt_string:
-                            rowData[QString::fromStdString(columnName)] = QString::fromStdString(row.get<std::string>(i));
+                            rowData.insert(columnName, QString::fromStdString(row.get<std::string>(i)));
                             break;
                         case soci::dt_integer:
-                            rowData[QString::fromStdString(columnName)] = row.get<int>(i);
+                            rowData.insert(columnName, row.get<int>(i));
                             break;
                         case soci::dt_double:
-                            rowData[QString::fromStdString(columnName)] = row.get<double>(i);
+                            rowData.insert(columnName, row.get<double>(i));
                             break;
                         case soci::dt_long_long:
-                            rowData[QString::fromStdString(columnName)] = static_cast<qint64>(row.get<long long>(i));
+                            rowData.insert(columnName, static_cast<qint64>(row.get<long long>(i)));
                             break;
                         default:
                             // 其他类型尽量按字符串取
                             try {
-                                rowData[QString::fromStdString(columnName)] = QString::fromStdString(row.get<std::string>(i));
+                                rowData.insert(columnName, QString::fromStdString(row.get<std::string>(i)));
                             } catch (...) {
-                                rowData[QString::fromStdString(columnName)] = "N/A";
+                                rowData.insert(columnName, "N/A");
                             }
                             break;
                         }
                     } else {
                         // NULL 值
-                        rowData[QString::fromStdString(columnName)] = QJsonValue::Null;
+                        rowData.insert(columnName, QJsonValue::Null);
                     }
                 }
 
                 results.append(rowData);
             }
+            const auto executedAt = std::chrono::steady_clock::now();
 
             QJsonDocument doc(results);
-            emit operationCompleted(
-                QString::fromStdString(request.id),
-                true,
-                QString::fromUtf8(doc.toJson(QJsonDocument::Compact)));
+            emitOperationCompleted(request, true,
+                QString::fromUtf8(doc.toJson(QJsonDocument::Compact)), executedAt);
 
         } else {
             //
@@ -699,7 +1109,7 @@ void SQLite3StateMachine::handleQueryExecution(const OperationRequest& request)
             resultObj["affected_rows"] = affectedRows;
 
             // 如果是 INSERT，顺便查 last_insert_rowid()
-            if (lower.startsWith(QStringLiteral("insert"))) {
+            if (trimmed.startsWith(QStringLiteral("insert"), Qt::CaseInsensitive)) {
                 long long lastId = 0;
                 try {
                     *m_dbSession << "SELECT last_insert_rowid()", soci::into(lastId);
@@ -709,17 +1119,70 @@ void SQLite3StateMachine::handleQueryExecution(const OperationRequest& request)
                 }
             }
 
+            const auto executedAt = std::chrono::steady_clock::now();
+
             QJsonDocument doc(resultObj);
-            emit operationCompleted(
-                QString::fromStdString(request.id),
-                true,
-                QString::fromUtf8(doc.toJson(QJsonDocument::Compact)));
+            emitOperationCompleted(request, true,
+                QString::fromUtf8(doc.toJson(QJsonDocument::Compact)), executedAt);
         }
 
     } catch (const std::exception& e) {
         const QString error = QStringLiteral("查询执行失败: ") + QString::fromUtf8(e.what());
+        if (!request.coalesced_members.empty()) {
+            qWarning() << error;
+            return false;
+        }
+        qCritical() << error;
+        emitOperationCompleted(request, false, error);
+        m_stateMachine->submitEvent("task.error", error);
+        return false;
+    }
+    return true;
+}
+
+void SQLite3StateMachine::handleScalarExecution(const OperationRequest& request)
+{
+    if (!m_dbSession) {
+        emitOperationCompleted(request, false, "数据库连接已断开");
+        m_processingOperation = false;
+        QTimer::singleShot(0, this, &SQLite3StateMachine::processNextOperation);
+        return;
+    }
+
+    try {
+        const std::string query = request.getStringParam("query");
+        qDebug() << "执行标量查询:" << QString::fromStdString(query);
+
+        soci::statement st = (m_dbSession->prepare << query);
+        for (const auto& p : request.string_params) {
+            if (p.first == "query") {
+                continue;
+            }
+            st.exchange(soci::use(p.second, p.first));
+        }
+
+        // 直接取到整数里，不经过 soci::row 和逐列 JSON
+        long long value = 0;
+        soci::indicator indicator = soci::i_null;
+        st.exchange(soci::into(value, indicator));
+        st.define_and_bind();
+        st.execute(true);
+        const auto executedAt = std::chrono::steady_clock::now();
+
+        QJsonObject resultObj;
+        if (indicator == soci::i_ok) {
+            resultObj["value"] = static_cast<qint64>(value);
+        } else {
+            resultObj["value"] = QJsonValue::Null;
+        }
+
+        emitOperationCompleted(request, true,
+            QString::fromUtf8(QJsonDocument(resultObj).toJson(QJsonDocument::Compact)), executedAt);
+
+    } catch (const std::exception& e) {
+        const QString error = QStringLiteral("标量查询执行失败: ") + QString::fromUtf8(e.what());
         qCritical() << error;
-        emit operationCompleted(QString::fromStdString(request.id), false, error);
+        emitOperationCompleted(request, false, error);
         m_stateMachine->submitEvent("task.error", error);
     }
 
@@ -3,16 +3,23 @@
 #define SQLITE3STATEMACHINE_H
 
 #include "operationrequest.h"
+#include "tracerecorder.h"
+#include "workloadcapture.h"
+#include <QHash>
 #include <QMutex>
 #include <QObject>
 #include <QQueue>
 #include <QScxmlStateMachine>
 #include <QTimer>
+#include <QVariantMap>
+#include <atomic>
 #include <map>
 #include <memory>
 #include <soci/soci.h>
 #include <string>
 
+struct sqlite3;
+
 class SQLite3StateMachine : public QObject {
     Q_OBJECT
 
@@ -28,22 +35,55 @@ public:
     QString currentState() const;
     bool isRunning() const;
     bool isConnected() const;
+    bool isProcessing() const;
+    bool hasFullTextSearch() const;
+    QString databaseFile() const;
 
     // 数据库操作接口
     soci::session* getSession() const;
+    // 底层 sqlite3 连接句柄，只能在数据库线程中使用
+    sqlite3* nativeHandle() const;
 
     // 队列管理
+    // 任意线程，不加锁
     int queueSize() const;
+    // 已入队、尚未发出完成通知的操作数（含正在执行的）
+    int inFlightOperations() const;
     void clearQueue();
     QString currentOperationId() const;
 
+    // 取走操作的分阶段耗时（完成信号发出前生成，每个操作只能取一次）
+    bool takeOperationTiming(const QString& operationId, OperationTiming& timing);
+
+    // 出队时合并同一行上可合并的排队写入（默认关闭）
+    void setWriteCoalescing(bool enabled);
+    QVariantMap coalesceMetrics() const;
+
+    // 链路追踪：入队加锁、SCXML 事件、出队、执行各阶段写入 recorder（可以为空）
+    void setTraceRecorder(TraceRecorder* recorder) { m_trace = recorder; }
+    // 工作负载录制：入队时把请求追加到录制日志（可以为空）
+    void setWorkloadCapture(WorkloadCapture* capture) { m_capture = capture; }
+
 public slots:
     // 状态机控制
     void startConnection();
     void stopConnection();
 
     // 异步业务操作 - 添加到队列
-    QString executeQuery(const QString& query, const std::map<std::string, std::string>& params = {});
+    // operationId 为空时自动生成；调用方预先生成 ID 时可以在入队前登记该操作
+    QString executeQuery(const QString& query, const std::map<std::string, std::string>& params = {},
+        const QString& operationId = QString());
+    // 带 RETURNING 的写入，按查询取回结果行
+    QString executeReturningQuery(const QString& query, const std::map<std::string, std::string>& params = {},
+        const QString& operationId = QString());
+    // 只返回单个整数（COUNT/EXISTS 等），不构造行对象
+    QString executeScalarQuery(const QString& query, const std::map<std::string, std::string>& params = {},
+        const QString& operationId = QString());
+    // 可合并的单行写入，coalesce 描述合并规则
+    QString executeWrite(const QString& query, const std::map<std::string, std::string>& params, const CoalesceSpec& coalesce,
+        const QString& operationId = QString());
+    // 按原样入队已构造好的请求（工作负载回放），调用方负责 ID 唯一
+    QString enqueueRequest(const OperationRequest& request);
 
     // 直接操作（绕过队列）
     bool executeImmediateQuery(const QString& query, const std::map<std::string, std::string>& params = {});
@@ -68,12 +108,24 @@ private slots:
     void processNextOperation();
 
 private:
+    // bench/qt_app_bench.cc 与 tests/ 直接驱动入队、出队与语句执行
+    friend struct SQLite3StateMachineBenchAccess;
+    friend struct SQLite3StateMachineTestAccess;
+
     void setupConnections();
     bool connectToDatabase();
     void disconnectDatabase();
+    void ensureFullTextIndexes();
     void handleQueryExecution(const OperationRequest& request);
+    bool executeQueryRequest(const OperationRequest& request);
+    void handleScalarExecution(const OperationRequest& request);
     void addToQueue(const OperationRequest& request);
     OperationRequest dequeue();
+    // 调用方持有 m_queueMutex
+    void coalescePendingWrites(OperationRequest& head);
+    // executedAt 为 SQL 执行完成的时刻，缺省时整段计入执行阶段
+    void emitOperationCompleted(const OperationRequest& request, bool success, const QString& result,
+        std::chrono::steady_clock::time_point executedAt = std::chrono::steady_clock::time_point());
     // 添加错误处理函数声明
     void handleError(const QString& errorMsg);
 
@@ -89,9 +141,26 @@ private:
     // 队列相关
     mutable QMutex m_queueMutex;
     QQueue<OperationRequest> m_operationQueue;
-    bool m_processingOperation = false;
+    std::atomic<bool> m_processingOperation { false };
+    std::atomic<bool> m_fullTextSearch { false };
+    std::atomic<bool> m_writeCoalescing { false };
+    // 队列长度与未完成操作数的无锁副本，供指标采集读取
+    std::atomic<int> m_queueDepth { 0 };
+    std::atomic<int> m_inFlight { 0 };
+    TraceRecorder* m_trace = nullptr;
+    WorkloadCapture* m_capture = nullptr;
+
+    // 写合并指标
+    std::atomic<quint64> m_coalescibleWrites { 0 };
+    std::atomic<quint64> m_coalescedWrites { 0 };
+    std::atomic<quint64> m_coalesceGroups { 0 };
+    std::atomic<quint64> m_coalesceRetries { 0 }; // 合并语句失败后逐条重试的组数
     QString m_currentOperationId;
 
+    // 已完成、等待处理器取走的分阶段耗时
+    QMutex m_timingMutex;
+    QHash<QString, OperationTiming> m_timings;
+
     // 当前操作
     OperationRequest m_currentRequest;
 
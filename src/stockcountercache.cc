@@ -0,0 +1,468 @@
+// stockcountercache.cc
+#include "stockcountercache.h"
+#include "sqlite3statemachine.h"
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <algorithm>
+#include <map>
+
+StockCounterCache::StockCounterCache(SQLite3StateMachine* stateMachine, const QString& journalFile, QObject* parent)
+    : QObject(parent)
+    , m_stateMachine(stateMachine)
+    , m_journalFile(journalFile)
+{
+    connect(&m_timer, &QTimer::timeout, this, [this]() { flush(); });
+}
+
+StockCounterCache::~StockCounterCache()
+{
+    m_journal.close();
+}
+
+void StockCounterCache::setFlushInterval(int intervalMs)
+{
+    m_flushIntervalMs = std::max(1, intervalMs);
+    if (m_timer.isActive()) {
+        m_timer.start(m_flushIntervalMs);
+    }
+}
+
+bool StockCounterCache::start()
+{
+    soci::session* session = m_stateMachine->getSession();
+    if (!session) {
+        return false;
+    }
+
+    try {
+        *session << R"(CREATE TABLE IF NOT EXISTS stock_counter_state (
+            id INTEGER PRIMARY KEY CHECK (id = 1),
+            applied_seq INTEGER NOT NULL
+        ))";
+    } catch (const std::exception& e) {
+        qWarning() << "创建库存计数状态表失败:" << e.what();
+        return false;
+    }
+
+    if (!recover()) {
+        return false;
+    }
+
+    const QList<int> segments = journalSegments();
+    if (!openSegment(segments.isEmpty() ? 1 : segments.last() + 1)) {
+        return false;
+    }
+
+    m_timer.start(m_flushIntervalMs);
+    qDebug() << "热点库存计数已启动，回写周期:" << m_flushIntervalMs << "ms";
+    return true;
+}
+
+void StockCounterCache::stop()
+{
+    m_timer.stop();
+    if (m_stateMachine->isConnected()) {
+        flush();
+    }
+}
+
+void StockCounterCache::resume()
+{
+    if (!m_timer.isActive()) {
+        m_timer.start(m_flushIntervalMs);
+    }
+}
+
+StockCounterCache::ApplyResult StockCounterCache::applyDelta(int productId, int delta, const QString& operationId, qint64* stock)
+{
+    Shard& shard = shardFor(productId);
+    QMutexLocker locker(&shard.mutex);
+
+    auto it = shard.entries.find(productId);
+    if (it == shard.entries.end()) {
+        Entry entry;
+        entry.pending.append({ operationId, delta });
+        shard.entries.insert(productId, entry);
+        m_loads.fetch_add(1, std::memory_order_relaxed);
+        return ApplyResult::NeedsLoad;
+    }
+
+    if (it->loading) {
+        it->pending.append({ operationId, delta });
+        return ApplyResult::Pending;
+    }
+
+    return tryApply(*it, productId, delta, stock) ? ApplyResult::Applied : ApplyResult::Insufficient;
+}
+
+bool StockCounterCache::contains(int productId) const
+{
+    const Shard& shard = shardFor(productId);
+    QMutexLocker locker(&shard.mutex);
+    return shard.entries.contains(productId);
+}
+
+bool StockCounterCache::isEmpty() const
+{
+    for (const Shard& shard : m_shards) {
+        QMutexLocker locker(&shard.mutex);
+        if (!shard.entries.isEmpty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+QVariantMap StockCounterCache::metrics() const
+{
+    qsizetype cached = 0;
+    for (const Shard& shard : m_shards) {
+        QMutexLocker locker(&shard.mutex);
+        cached += shard.entries.size();
+    }
+
+    QVariantMap result;
+    result["cached_products"] = static_cast<qint64>(cached);
+    result["applied"] = static_cast<quint64>(m_applied.load());
+    result["rejected"] = static_cast<quint64>(m_rejected.load());
+    result["loads"] = static_cast<quint64>(m_loads.load());
+    result["flushes"] = static_cast<quint64>(m_flushes.load());
+    result["flushed_rows"] = static_cast<quint64>(m_flushedRows.load());
+    result["last_flush_ms"] = static_cast<qint64>(m_lastFlushMs.load());
+    result["recovered_entries"] = static_cast<quint64>(m_recoveredEntries.load());
+    return result;
+}
+
+QList<StockCounterCache::Resolution> StockCounterCache::completeLoad(int productId, bool found, qint64 stock)
+{
+    QList<Resolution> resolutions;
+    bool evictNow = false;
+
+    {
+        Shard& shard = shardFor(productId);
+        QMutexLocker locker(&shard.mutex);
+
+        auto it = shard.entries.find(productId);
+        if (it == shard.entries.end()) {
+            return resolutions;
+        }
+
+        if (!found) {
+            // 产品不存在：挂起的操作全部按未生效返回，不缓存
+            for (const Pending& pending : it->pending) {
+                resolutions.append({ pending.operationId, false, 0 });
+            }
+            shard.entries.erase(it);
+            return resolutions;
+        }
+
+        it->base = stock;
+        it->loading = false;
+        for (const Pending& pending : it->pending) {
+            Resolution resolution;
+            resolution.operationId = pending.operationId;
+            resolution.applied = tryApply(*it, productId, pending.delta, &resolution.stock);
+            resolutions.append(resolution);
+        }
+        it->pending.clear();
+        evictNow = it->evictAfterLoad;
+    }
+
+    if (evictNow) {
+        evict(productId);
+    }
+    return resolutions;
+}
+
+bool StockCounterCache::tryApply(Entry& entry, int productId, int delta, qint64* stock)
+{
+    const qint64 newStock = entry.base + entry.delta + delta;
+    if (newStock < 0) {
+        m_rejected.fetch_add(1, std::memory_order_relaxed);
+        if (stock) {
+            *stock = entry.base + entry.delta;
+        }
+        return false;
+    }
+
+    entry.delta += delta;
+    appendJournal(productId, delta);
+    m_applied.fetch_add(1, std::memory_order_relaxed);
+    if (stock) {
+        *stock = newStock;
+    }
+    return true;
+}
+
+void StockCounterCache::appendJournal(int productId, int delta)
+{
+    QMutexLocker locker(&m_journalMutex);
+    const QByteArray line = QByteArray::number(m_nextSeq++) + ' ' + QByteArray::number(productId) + ' '
+        + QByteArray::number(delta) + '\n';
+    // 写入后立即交给操作系统，进程崩溃不会丢失；掉电保护依赖文件系统
+    m_journal.write(line);
+    m_journal.flush();
+}
+
+bool StockCounterCache::flush()
+{
+    soci::session* session = m_stateMachine->getSession();
+    if (!session) {
+        return false;
+    }
+
+    // 快照：锁住全部分片（固定顺序）和日志，取出增量并切换日志段，
+    // 之后的增量序号都大于 snapshotSeq，写在新日志段里
+    std::map<int, qint64> deltas;
+    qint64 snapshotSeq = 0;
+    int flushedSegment = 0;
+    {
+        for (Shard& shard : m_shards) {
+            shard.mutex.lock();
+        }
+
+        for (Shard& shard : m_shards) {
+            for (auto it = shard.entries.begin(); it != shard.entries.end(); ++it) {
+                if (!it->loading && it->delta != 0) {
+                    deltas[it.key()] = it->delta;
+                    it->base += it->delta;
+                    it->delta = 0;
+                }
+            }
+        }
+
+        if (!deltas.empty()) {
+            QMutexLocker journalLocker(&m_journalMutex);
+            snapshotSeq = m_nextSeq - 1;
+            flushedSegment = m_segment;
+            openSegment(m_segment + 1);
+        }
+
+        for (Shard& shard : m_shards) {
+            shard.mutex.unlock();
+        }
+    }
+
+    if (deltas.empty()) {
+        return true;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    try {
+        soci::transaction tr(*session);
+
+        int id = 0;
+        long long delta = 0;
+        soci::statement st = (session->prepare << "UPDATE products SET stock = stock + :delta WHERE id = :id",
+            soci::use(delta), soci::use(id));
+        for (const auto& item : deltas) {
+            id = item.first;
+            delta = item.second;
+            st.execute(true);
+        }
+
+        long long seq = snapshotSeq;
+        *session << "INSERT INTO stock_counter_state (id, applied_seq) VALUES (1, :seq)"
+                    " ON CONFLICT(id) DO UPDATE SET applied_seq = excluded.applied_seq",
+            soci::use(seq);
+
+        tr.commit();
+    } catch (const std::exception& e) {
+        qWarning() << "库存增量回写失败:" << e.what();
+
+        // 放回内存，下次回写重试；旧日志段保留，序号仍然覆盖这些增量
+        for (const auto& item : deltas) {
+            Shard& shard = shardFor(item.first);
+            QMutexLocker locker(&shard.mutex);
+            auto it = shard.entries.find(item.first);
+            if (it != shard.entries.end()) {
+                it->base -= item.second;
+                it->delta += item.second;
+            }
+        }
+        return false;
+    }
+
+    // 已应用的日志段可以删除
+    for (int segment : journalSegments()) {
+        if (segment <= flushedSegment) {
+            QFile::remove(segmentPath(segment));
+        }
+    }
+
+    m_flushes.fetch_add(1, std::memory_order_relaxed);
+    m_flushedRows.fetch_add(deltas.size(), std::memory_order_relaxed);
+    m_lastFlushMs = timer.elapsed();
+    return true;
+}
+
+void StockCounterCache::evict(int productId)
+{
+    {
+        Shard& shard = shardFor(productId);
+        QMutexLocker locker(&shard.mutex);
+        auto it = shard.entries.find(productId);
+        if (it == shard.entries.end()) {
+            return;
+        }
+        if (it->loading) {
+            // 加载操作排在这次写入之前，加载完成后再回写并移除
+            it->evictAfterLoad = true;
+            return;
+        }
+    }
+
+    // 其他写入会覆盖库存，必须先把增量落库；失败时保留条目，避免增量丢失
+    if (!flush()) {
+        qWarning() << "移出热点库存前回写失败，产品:" << productId;
+        return;
+    }
+
+    Shard& shard = shardFor(productId);
+    QMutexLocker locker(&shard.mutex);
+    auto it = shard.entries.find(productId);
+    if (it != shard.entries.end() && !it->loading && it->delta == 0) {
+        shard.entries.erase(it);
+    }
+}
+
+void StockCounterCache::evictAll()
+{
+    if (!flush()) {
+        qWarning() << "移出全部热点库存前回写失败";
+        return;
+    }
+
+    for (Shard& shard : m_shards) {
+        QMutexLocker locker(&shard.mutex);
+        for (auto it = shard.entries.begin(); it != shard.entries.end();) {
+            if (it->loading) {
+                it->evictAfterLoad = true;
+                ++it;
+            } else if (it->delta == 0) {
+                it = shard.entries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+}
+
+// 重放上次运行未回写的日志条目：序号大于 applied_seq 的增量按产品合并后一次写入
+bool StockCounterCache::recover()
+{
+    soci::session* session = m_stateMachine->getSession();
+
+    long long appliedSeq = 0;
+    soci::indicator indicator = soci::i_null;
+    try {
+        *session << "SELECT applied_seq FROM stock_counter_state WHERE id = 1", soci::into(appliedSeq, indicator);
+    } catch (const std::exception& e) {
+        qWarning() << "读取库存日志进度失败:" << e.what();
+        return false;
+    }
+    if (indicator != soci::i_ok) {
+        appliedSeq = 0;
+    }
+
+    const QList<int> segments = journalSegments();
+    std::map<int, long long> deltas;
+    qint64 maxSeq = appliedSeq;
+    quint64 entries = 0;
+
+    for (int segment : segments) {
+        QFile file(segmentPath(segment));
+        if (!file.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+        while (!file.atEnd()) {
+            const QList<QByteArray> fields = file.readLine().trimmed().split(' ');
+            if (fields.size() != 3) {
+                continue; // 崩溃时可能留下半行
+            }
+            bool okSeq = false, okId = false, okDelta = false;
+            const qint64 seq = fields[0].toLongLong(&okSeq);
+            const int id = fields[1].toInt(&okId);
+            const int delta = fields[2].toInt(&okDelta);
+            if (!okSeq || !okId || !okDelta || seq <= appliedSeq) {
+                continue;
+            }
+            deltas[id] += delta;
+            maxSeq = std::max(maxSeq, seq);
+            ++entries;
+        }
+    }
+
+    if (!deltas.empty()) {
+        try {
+            soci::transaction tr(*session);
+
+            int id = 0;
+            long long delta = 0;
+            soci::statement st = (session->prepare << "UPDATE products SET stock = stock + :delta WHERE id = :id",
+                soci::use(delta), soci::use(id));
+            for (const auto& item : deltas) {
+                id = item.first;
+                delta = item.second;
+                st.execute(true);
+            }
+
+            long long seq = maxSeq;
+            *session << "INSERT INTO stock_counter_state (id, applied_seq) VALUES (1, :seq)"
+                        " ON CONFLICT(id) DO UPDATE SET applied_seq = excluded.applied_seq",
+                soci::use(seq);
+
+            tr.commit();
+        } catch (const std::exception& e) {
+            qCritical() << "库存日志重放失败:" << e.what();
+            return false;
+        }
+        qDebug() << "已重放库存日志条目:" << entries << "涉及产品:" << deltas.size();
+        m_recoveredEntries = entries;
+    }
+
+    for (int segment : segments) {
+        QFile::remove(segmentPath(segment));
+    }
+
+    m_nextSeq = maxSeq + 1;
+    return true;
+}
+
+bool StockCounterCache::openSegment(int segment)
+{
+    m_journal.close();
+    m_journal.setFileName(segmentPath(segment));
+    if (!m_journal.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qCritical() << "无法打开库存日志:" << m_journal.fileName() << m_journal.errorString();
+        return false;
+    }
+    m_segment = segment;
+    return true;
+}
+
+QList<int> StockCounterCache::journalSegments() const
+{
+    const QFileInfo info(m_journalFile);
+    const QStringList files = info.dir().entryList({ info.fileName() + ".*" }, QDir::Files);
+
+    QList<int> segments;
+    for (const QString& file : files) {
+        bool ok = false;
+        const int segment = file.mid(info.fileName().size() + 1).toInt(&ok);
+        if (ok) {
+            segments.append(segment);
+        }
+    }
+    std::sort(segments.begin(), segments.end());
+    return segments;
+}
+
+QString StockCounterCache::segmentPath(int segment) const
+{
+    return m_journalFile + "." + QString::number(segment);
+}
@@ -0,0 +1,125 @@
+// stockcountercache.h
+#ifndef STOCKCOUNTERCACHE_H
+#define STOCKCOUNTERCACHE_H
+
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <QVariantMap>
+#include <atomic>
+
+class SQLite3StateMachine;
+
+// 热点库存计数策略
+struct StockCounterPolicy {
+    bool enabled = false;
+    int flushIntervalMs = 200; // 回写周期
+    QString journalFile; // 为空时使用 <数据库文件>-stockjournal
+};
+
+// 热点库存计数器
+// 库存增减直接在内存中按产品原子地完成（扣减时立即检查 stock >= quantity），
+// 数据库线程定期把累计的增量在一个事务里回写 products；
+// 每个被接受的增量先追加到日志（带序号），回写事务同时记录已应用的最大序号，
+// 崩溃后重启时重放序号更大的日志条目
+class StockCounterCache : public QObject {
+    Q_OBJECT
+
+public:
+    enum class ApplyResult {
+        Applied, // 已在内存中生效
+        Insufficient, // 库存不足，未生效
+        Pending, // 该产品正在加载，等加载完成后再判定
+        NeedsLoad, // 首次访问，调用方需要发起加载
+    };
+
+    // 加载完成后判定的挂起操作
+    struct Resolution {
+        QString operationId;
+        bool applied = false;
+        qint64 stock = 0;
+    };
+
+    StockCounterCache(SQLite3StateMachine* stateMachine, const QString& journalFile, QObject* parent = nullptr);
+    ~StockCounterCache();
+
+    void setFlushInterval(int intervalMs);
+
+    // 任意线程调用
+    ApplyResult applyDelta(int productId, int delta, const QString& operationId, qint64* stock);
+    bool contains(int productId) const;
+    bool isEmpty() const;
+    QVariantMap metrics() const;
+
+    // 以下在数据库线程调用
+    QList<Resolution> completeLoad(int productId, bool found, qint64 stock);
+    bool flush();
+    void evict(int productId);
+    void evictAll();
+
+public slots:
+    bool start();
+    // 停止周期回写并把内存中的增量落库；重连后调用 resume() 恢复（日志与内存状态不变）
+    void stop();
+    void resume();
+
+private:
+    static constexpr int kShardCount = 16;
+
+    struct Pending {
+        QString operationId;
+        int delta;
+    };
+
+    struct Entry {
+        qint64 base = 0; // 已回写到数据库的库存
+        qint64 delta = 0; // 尚未回写的增量
+        bool loading = true;
+        bool evictAfterLoad = false;
+        QList<Pending> pending;
+    };
+
+    struct Shard {
+        mutable QMutex mutex;
+        QHash<int, Entry> entries;
+    };
+
+    Shard& shardFor(int productId) { return m_shards[static_cast<unsigned>(productId) % kShardCount]; }
+    const Shard& shardFor(int productId) const { return m_shards[static_cast<unsigned>(productId) % kShardCount]; }
+
+    // 调用方持有对应分片的锁
+    bool tryApply(Entry& entry, int productId, int delta, qint64* stock);
+    void appendJournal(int productId, int delta);
+
+    bool recover();
+    bool openSegment(int segment);
+    QList<int> journalSegments() const;
+    QString segmentPath(int segment) const;
+
+    SQLite3StateMachine* m_stateMachine;
+    QString m_journalFile;
+    QTimer m_timer;
+    int m_flushIntervalMs = 200;
+
+    Shard m_shards[kShardCount];
+
+    // 日志：序号分配与写入在同一把锁下，文件顺序即序号顺序
+    QMutex m_journalMutex;
+    QFile m_journal;
+    int m_segment = 0;
+    qint64 m_nextSeq = 1;
+
+    std::atomic<quint64> m_applied { 0 };
+    std::atomic<quint64> m_rejected { 0 };
+    std::atomic<quint64> m_loads { 0 };
+    std::atomic<quint64> m_flushes { 0 };
+    std::atomic<quint64> m_flushedRows { 0 };
+    std::atomic<qint64> m_lastFlushMs { 0 };
+    std::atomic<quint64> m_recoveredEntries { 0 };
+};
+
+#endif // STOCKCOUNTERCACHE_H
@@ -0,0 +1,377 @@
+// tracerecorder.cc
+#include "tracerecorder.h"
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QThread>
+#include <QThreadPool>
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+
+std::atomic<uint64_t> g_nextInstanceId { 1 };
+
+// 每个线程在每个记录器上的环形缓冲；以实例 ID 为键，记录器销毁后旧条目不会被误用
+thread_local std::unordered_map<uint64_t, void*> t_rings;
+
+int64_t toNanos(std::chrono::steady_clock::duration duration)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+}
+
+// Chrome trace 的时间单位是微秒，保留纳秒精度
+QByteArray micros(int64_t nanos)
+{
+    return QByteArray::number(nanos / 1000.0, 'f', 3);
+}
+
+QByteArray quoted(const QByteArray& text)
+{
+    QByteArray result;
+    result.reserve(text.size() + 2);
+    result.append('"');
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            result.append('\\');
+        }
+        if (static_cast<unsigned char>(c) >= 0x20) {
+            result.append(c);
+        }
+    }
+    result.append('"');
+    return result;
+}
+
+} // namespace
+
+TraceRecorder::Span::Span(TraceRecorder* recorder, const char* name, const QString& operationId)
+    : m_recorder(recorder && recorder->isEnabled() ? recorder : nullptr)
+    , m_name(name)
+{
+    if (m_recorder) {
+        m_operationId = operationId;
+        m_start = Clock::now();
+    }
+}
+
+TraceRecorder::Span::~Span()
+{
+    if (m_recorder) {
+        m_recorder->record(m_name, m_start, Clock::now(), m_operationId);
+    }
+}
+
+TraceRecorder::TraceRecorder()
+    : m_instanceId(g_nextInstanceId.fetch_add(1, std::memory_order_relaxed))
+    , m_origin(Clock::now())
+{
+}
+
+TraceRecorder::~TraceRecorder()
+{
+    // 后台转储仍在读取缓冲
+    while (m_pendingDumps.load() > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+}
+
+void TraceRecorder::setEnabled(bool enabled)
+{
+    m_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void TraceRecorder::record(const char* name, Clock::time_point start, Clock::time_point end, const QString& operationId)
+{
+    if (isEnabled()) {
+        write(name, start, end, operationId, false);
+    }
+}
+
+void TraceRecorder::recordAsync(const char* name, Clock::time_point start, Clock::time_point end, const QString& operationId)
+{
+    if (isEnabled() && !operationId.isEmpty()) {
+        write(name, start, end, operationId, true);
+    }
+}
+
+void TraceRecorder::write(const char* name, Clock::time_point start, Clock::time_point end, const QString& operationId, bool async)
+{
+    Ring* ring = localRing();
+    if (!ring) {
+        return;
+    }
+
+    // 操作 ID 只含 ASCII，按字节打包进定长字段
+    std::array<char, kIdWords * sizeof(uint64_t)> bytes {};
+    const int length = std::min<int>(operationId.size(), static_cast<int>(bytes.size()));
+    for (int i = 0; i < length; ++i) {
+        bytes[i] = static_cast<char>(operationId.at(i).unicode());
+    }
+
+    const uint64_t index = ring->head.load(std::memory_order_relaxed);
+    Slot& slot = ring->slots[index % kRingCapacity];
+    slot.seq.store(index * 2 + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.startNanos.store(toNanos(start - m_origin), std::memory_order_relaxed);
+    slot.durationNanos.store(std::max<int64_t>(0, toNanos(end - start)), std::memory_order_relaxed);
+    slot.async.store(async, std::memory_order_relaxed);
+    for (int word = 0; word < kIdWords; ++word) {
+        uint64_t value = 0;
+        std::memcpy(&value, bytes.data() + word * sizeof(uint64_t), sizeof(uint64_t));
+        slot.id[word].store(value, std::memory_order_relaxed);
+    }
+
+    slot.seq.store(index * 2 + 2, std::memory_order_release);
+    ring->head.store(index + 1, std::memory_order_release);
+}
+
+TraceRecorder::Ring* TraceRecorder::localRing()
+{
+    auto it = t_rings.find(m_instanceId);
+    if (it != t_rings.end()) {
+        return static_cast<Ring*>(it->second);
+    }
+
+    QThread* thread = QThread::currentThread();
+    QString threadName = thread ? thread->objectName() : QString();
+    if (threadName.isEmpty() && QCoreApplication::instance() && thread == QCoreApplication::instance()->thread()) {
+        threadName = QStringLiteral("main");
+    }
+
+    Ring* ring = nullptr;
+    {
+        QMutexLocker locker(&m_registryMutex);
+        const int index = m_ringCount.load(std::memory_order_relaxed);
+        if (index < kMaxThreads) {
+            m_ownedRings.push_back(std::make_unique<Ring>());
+            ring = m_ownedRings.back().get();
+            ring->threadId = index + 1;
+            ring->threadName = threadName.isEmpty() ? QString("thread-%1").arg(index + 1) : threadName;
+            m_rings[index].store(ring, std::memory_order_release);
+            m_ringCount.store(index + 1, std::memory_order_release);
+        } else {
+            m_droppedThreads.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    // 超限的线程也缓存空指针，之后直接跳过
+    t_rings.emplace(m_instanceId, ring);
+    return ring;
+}
+
+std::vector<TraceRecorder::Event> TraceRecorder::collect() const
+{
+    std::vector<Event> events;
+    const int ringCount = m_ringCount.load(std::memory_order_acquire);
+    for (int r = 0; r < ringCount; ++r) {
+        const Ring* ring = m_rings[r].load(std::memory_order_acquire);
+        const uint64_t head = ring->head.load(std::memory_order_acquire);
+        const uint64_t first = head > static_cast<uint64_t>(kRingCapacity) ? head - kRingCapacity : 0;
+        for (uint64_t index = first; index < head; ++index) {
+            const Slot& slot = ring->slots[index % kRingCapacity];
+            const uint64_t seq = slot.seq.load(std::memory_order_acquire);
+            if (seq != index * 2 + 2) {
+                continue; // 已被覆盖或正在写
+            }
+
+            Event event;
+            event.name = slot.name.load(std::memory_order_relaxed);
+            event.startNanos = slot.startNanos.load(std::memory_order_relaxed);
+            event.durationNanos = slot.durationNanos.load(std::memory_order_relaxed);
+            event.async = slot.async.load(std::memory_order_relaxed);
+            event.threadId = ring->threadId;
+            char bytes[kIdWords * sizeof(uint64_t)];
+            for (int word = 0; word < kIdWords; ++word) {
+                const uint64_t value = slot.id[word].load(std::memory_order_relaxed);
+                std::memcpy(bytes + word * sizeof(uint64_t), &value, sizeof(uint64_t));
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) != seq) {
+                continue;
+            }
+            event.operationId = QByteArray(bytes, static_cast<int>(strnlen(bytes, sizeof(bytes))));
+            events.push_back(std::move(event));
+        }
+    }
+    return events;
+}
+
+QByteArray TraceRecorder::exportChromeTrace(const QString& operationId) const
+{
+    std::vector<Event> events = collect();
+
+    if (!operationId.isEmpty()) {
+        // 该操作的时间窗：它自己的区间 + 窗口内其他区间
+        const QByteArray target = operationId.toLatin1().left(kIdWords * sizeof(uint64_t));
+        int64_t windowStart = INT64_MAX;
+        int64_t windowEnd = INT64_MIN;
+        for (const Event& event : events) {
+            if (event.operationId == target) {
+                windowStart = std::min(windowStart, event.startNanos);
+                windowEnd = std::max(windowEnd, event.startNanos + event.durationNanos);
+            }
+        }
+        events.erase(std::remove_if(events.begin(), events.end(),
+                         [&](const Event& event) {
+                             if (event.operationId == target) {
+                                 return false;
+                             }
+                             // 其他操作的异步区间只会干扰阅读
+                             return event.async || event.startNanos + event.durationNanos < windowStart
+                                 || event.startNanos > windowEnd;
+                         }),
+            events.end());
+    }
+    std::sort(events.begin(), events.end(),
+        [](const Event& a, const Event& b) { return a.startNanos < b.startNanos; });
+
+    QByteArray out;
+    out.reserve(static_cast<int>(events.size()) * 160 + 1024);
+    out.append("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    bool first = true;
+    auto append = [&](const QByteArray& event) {
+        if (!first) {
+            out.append(",\n");
+        }
+        first = false;
+        out.append(event);
+    };
+
+    const int ringCount = m_ringCount.load(std::memory_order_acquire);
+    for (int r = 0; r < ringCount; ++r) {
+        const Ring* ring = m_rings[r].load(std::memory_order_acquire);
+        append("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + QByteArray::number(ring->threadId)
+            + ",\"args\":{\"name\":" + quoted(ring->threadName.toUtf8()) + "}}");
+    }
+
+    // 同一操作的线程区间按时间先后用 flow 箭头串起来，跨线程的信号投递一目了然
+    QHash<QByteArray, int> flowIds;
+    QHash<QByteArray, int> remaining;
+    for (const Event& event : events) {
+        if (!event.async && !event.operationId.isEmpty()) {
+            remaining[event.operationId]++;
+        }
+    }
+
+    for (const Event& event : events) {
+        const QByteArray name = quoted(event.name ? QByteArray(event.name) : QByteArray("unknown"));
+        const QByteArray tid = QByteArray::number(event.threadId);
+        const QByteArray args = event.operationId.isEmpty()
+            ? QByteArray("{}")
+            : "{\"op\":" + quoted(event.operationId) + "}";
+
+        if (event.async) {
+            const QByteArray common = ",\"cat\":\"op\",\"id\":" + quoted(event.operationId) + ",\"pid\":1,\"tid\":" + tid;
+            append("{\"name\":" + name + ",\"ph\":\"b\",\"ts\":" + micros(event.startNanos) + common + ",\"args\":" + args + "}");
+            append("{\"name\":" + name + ",\"ph\":\"e\",\"ts\":" + micros(event.startNanos + event.durationNanos) + common + "}");
+            continue;
+        }
+
+        append("{\"name\":" + name + ",\"cat\":\"pipeline\",\"ph\":\"X\",\"ts\":" + micros(event.startNanos)
+            + ",\"dur\":" + micros(event.durationNanos) + ",\"pid\":1,\"tid\":" + tid + ",\"args\":" + args + "}");
+
+        if (event.operationId.isEmpty() || remaining.value(event.operationId) == 0) {
+            continue;
+        }
+        const int left = --remaining[event.operationId];
+        const bool started = flowIds.contains(event.operationId);
+        if (!started && left == 0) {
+            continue; // 只有一个区间，无需连线
+        }
+        if (!started) {
+            flowIds.insert(event.operationId, flowIds.size() + 1);
+        }
+        const char* phase = !started ? "s" : (left == 0 ? "f" : "t");
+        append(QByteArray("{\"name\":\"op\",\"cat\":\"flow\",\"ph\":\"") + phase + "\",\"bp\":\"e\",\"id\":"
+            + QByteArray::number(flowIds.value(event.operationId)) + ",\"ts\":" + micros(event.startNanos)
+            + ",\"pid\":1,\"tid\":" + tid + "}");
+    }
+
+    out.append("]}\n");
+    return out;
+}
+
+bool TraceRecorder::dumpToFile(const QString& path, const QString& operationId) const
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "写入 trace 文件失败:" << path << file.errorString();
+        return false;
+    }
+    file.write(exportChromeTrace(operationId));
+    return true;
+}
+
+void TraceRecorder::setSlowOperationTrigger(qint64 thresholdMicros, const QString& directory, int minIntervalMs)
+{
+    {
+        QMutexLocker locker(&m_triggerMutex);
+        m_dumpDirectory = directory;
+        m_dumpIntervalMs = std::max(0, minIntervalMs);
+    }
+    if (thresholdMicros > 0 && !directory.isEmpty()) {
+        QDir().mkpath(directory);
+    }
+    m_slowThresholdNanos.store(thresholdMicros > 0 ? thresholdMicros * 1000 : 0, std::memory_order_relaxed);
+}
+
+void TraceRecorder::checkSlowOperation(const QString& operationId, const QString& operationType, qint64 totalNanos)
+{
+    const qint64 threshold = m_slowThresholdNanos.load(std::memory_order_relaxed);
+    if (threshold <= 0 || totalNanos < threshold || !isEnabled()) {
+        return;
+    }
+
+    QString directory;
+    int64_t interval = 0;
+    {
+        QMutexLocker locker(&m_triggerMutex);
+        directory = m_dumpDirectory;
+        interval = static_cast<int64_t>(m_dumpIntervalMs) * 1000000;
+    }
+    const int64_t now = toNanos(Clock::now() - m_origin);
+    int64_t last = m_lastDumpNanos.load(std::memory_order_relaxed);
+    do {
+        if (last != 0 && now - last < interval) {
+            return;
+        }
+    } while (!m_lastDumpNanos.compare_exchange_weak(last, now, std::memory_order_relaxed));
+
+    const QString path = QDir(directory).filePath(QString("trace-%1-%2.json")
+                                                      .arg(QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss-zzz"))
+                                                      .arg(operationType.isEmpty() ? QStringLiteral("unknown") : operationType));
+    qWarning() << "慢操作" << operationId << operationType << "耗时" << totalNanos / 1000 << "us，写出 trace:" << path;
+
+    // 导出与写文件放到后台线程，不占用调用方（通常是数据库线程）
+    m_pendingDumps.fetch_add(1);
+    m_slowDumps.fetch_add(1, std::memory_order_relaxed);
+    QThreadPool::globalInstance()->start([this, path, operationId]() {
+        dumpToFile(path, operationId);
+        m_pendingDumps.fetch_sub(1);
+    });
+}
+
+QVariantMap TraceRecorder::metrics() const
+{
+    quint64 recorded = 0;
+    const int ringCount = m_ringCount.load(std::memory_order_acquire);
+    for (int r = 0; r < ringCount; ++r) {
+        recorded += m_rings[r].load(std::memory_order_acquire)->head.load(std::memory_order_relaxed);
+    }
+
+    QVariantMap result;
+    result["enabled"] = isEnabled();
+    result["threads"] = ringCount;
+    result["recorded"] = recorded;
+    result["dropped_threads"] = static_cast<quint64>(m_droppedThreads.load());
+    result["slow_dumps"] = static_cast<quint64>(m_slowDumps.load());
+    return result;
+}
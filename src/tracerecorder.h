@@ -0,0 +1,130 @@
+// tracerecorder.h
+#ifndef TRACERECORDER_H
+#define TRACERECORDER_H
+
+#include <QByteArray>
+#include <QMutex>
+#include <QString>
+#include <QVariantMap>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// 请求处理链路的时间区间（入队加锁、SCXML 事件、SQL 执行、完成信号跨线程投递、消费方处理），
+// 导出为 Chrome trace JSON，可直接在 chrome://tracing 或 Perfetto 中查看某个操作的完整时间线
+// 每个线程写自己的环形缓冲（写满后覆盖最旧的区间），记录路径无锁；
+// 未开启时每个埋点只有一次原子读。导出时逐槽位校验序号，跳过正在被覆盖的区间
+class TraceRecorder {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // 作用域区间：构造时记下起点，析构时写入；构造时未开启则什么也不做
+    class Span {
+    public:
+        // name 必须是字符串字面量（只保存指针）；recorder 可以为空
+        Span(TraceRecorder* recorder, const char* name, const QString& operationId = QString());
+        ~Span();
+
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+
+        // 区间开始时还不知道操作 ID 的（例如出队），在结束前补上
+        void setOperationId(const QString& operationId) { m_operationId = operationId; }
+
+    private:
+        TraceRecorder* m_recorder;
+        const char* m_name;
+        QString m_operationId;
+        Clock::time_point m_start;
+    };
+
+    TraceRecorder();
+    ~TraceRecorder();
+
+    TraceRecorder(const TraceRecorder&) = delete;
+    TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+    // 任意线程：线程上的区间，同一线程上的区间需要正确嵌套
+    void record(const char* name, Clock::time_point start, Clock::time_point end, const QString& operationId = QString());
+    // 任意线程：不占用线程的操作级区间（例如排队等待），在查看器中按操作单独成轨
+    void recordAsync(const char* name, Clock::time_point start, Clock::time_point end, const QString& operationId);
+
+    // 任意线程：operationId 为空时导出全部区间；
+    // 否则导出该操作的区间，以及同一时间窗内其他线程上的区间（用于查看锁竞争等上下文）
+    QByteArray exportChromeTrace(const QString& operationId = QString()) const;
+    bool dumpToFile(const QString& path, const QString& operationId = QString()) const;
+
+    // 慢操作触发：操作总耗时超过 thresholdMicros 时在后台把它的时间线写到 directory，
+    // 两次转储至少间隔 minIntervalMs；thresholdMicros <= 0 表示关闭
+    void setSlowOperationTrigger(qint64 thresholdMicros, const QString& directory, int minIntervalMs = 10000);
+    // 任意线程：操作完成时调用，只在开启且超过阈值时才有开销
+    void checkSlowOperation(const QString& operationId, const QString& operationType, qint64 totalNanos);
+
+    // {enabled, threads, recorded, dropped_threads, slow_dumps}
+    QVariantMap metrics() const;
+
+private:
+    static constexpr int kMaxThreads = 64; // 超出的线程不再记录
+    static constexpr int kRingCapacity = 8192; // 每个线程保留的区间数
+    static constexpr int kIdWords = 5; // 操作 ID 最多 40 个字符（UUID 为 36 或 38 个）
+
+    // 所有字段都是原子量：写者先把 seq 置为奇数，写完后置为 2 * (序号 + 1)，
+    // 读者前后两次读到相同的偶数 seq 才采用
+    struct Slot {
+        std::atomic<uint64_t> seq { 0 };
+        std::atomic<const char*> name { nullptr };
+        std::atomic<int64_t> startNanos { 0 };
+        std::atomic<int64_t> durationNanos { 0 };
+        std::atomic<bool> async { false };
+        std::array<std::atomic<uint64_t>, kIdWords> id {};
+    };
+
+    struct Ring {
+        std::unique_ptr<Slot[]> slots { new Slot[kRingCapacity] };
+        std::atomic<uint64_t> head { 0 }; // 已写入的区间总数，只有所属线程写
+        int threadId = 0;
+        QString threadName;
+    };
+
+    // 导出时的一份副本
+    struct Event {
+        const char* name;
+        int64_t startNanos;
+        int64_t durationNanos;
+        bool async;
+        int threadId;
+        QByteArray operationId;
+    };
+
+    void write(const char* name, Clock::time_point start, Clock::time_point end, const QString& operationId, bool async);
+    Ring* localRing();
+    std::vector<Event> collect() const;
+
+    const uint64_t m_instanceId;
+    const Clock::time_point m_origin;
+    std::atomic<bool> m_enabled { false };
+
+    // 只在线程首次记录时加锁；读者按 acquire 读到的计数遍历，不碰这把锁
+    QMutex m_registryMutex;
+    std::vector<std::unique_ptr<Ring>> m_ownedRings;
+    std::array<std::atomic<Ring*>, kMaxThreads> m_rings {};
+    std::atomic<int> m_ringCount { 0 };
+    std::atomic<quint64> m_droppedThreads { 0 };
+
+    // 慢操作触发
+    std::atomic<qint64> m_slowThresholdNanos { 0 };
+    std::atomic<int64_t> m_lastDumpNanos { 0 };
+    std::atomic<int> m_pendingDumps { 0 };
+    std::atomic<quint64> m_slowDumps { 0 };
+    int m_dumpIntervalMs = 10000;
+    QMutex m_triggerMutex;
+    QString m_dumpDirectory;
+};
+
+#endif // TRACERECORDER_H
@@ -0,0 +1,246 @@
+// walcheckpointer.cc
+#include "walcheckpointer.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <sqlite3.h>
+
+WalCheckpointer::WalCheckpointer(const QString& dbFile, QObject* parent)
+    : QObject(parent)
+    , m_dbFile(dbFile)
+{
+}
+
+WalCheckpointer::~WalCheckpointer()
+{
+    closeConnection();
+}
+
+void WalCheckpointer::setPolicy(const WalCheckpointPolicy& policy)
+{
+    m_policy = policy;
+}
+
+void WalCheckpointer::setIdleProbe(std::function<bool()> probe)
+{
+    m_idleProbe = std::move(probe);
+}
+
+QVariantMap WalCheckpointer::metrics() const
+{
+    QVariantMap result;
+    result["wal_size_bytes"] = static_cast<qint64>(m_walSizeBytes.load());
+    result["last_checkpoint_mode"] = modeName(m_lastMode.load());
+    result["last_checkpoint_duration_us"] = static_cast<qint64>(m_lastDurationUs.load());
+    result["max_checkpoint_duration_us"] = static_cast<qint64>(m_maxDurationUs.load());
+    result["last_frames_logged"] = m_lastFramesLogged.load();
+    result["last_frames_checkpointed"] = m_lastFramesCheckpointed.load();
+    result["total_frames_checkpointed"] = static_cast<qint64>(m_totalFramesCheckpointed.load());
+    result["passive_checkpoints"] = static_cast<quint64>(m_passiveCount.load());
+    result["restart_checkpoints"] = static_cast<quint64>(m_restartCount.load());
+    result["truncate_checkpoints"] = static_cast<quint64>(m_truncateCount.load());
+    result["busy_checkpoints"] = static_cast<quint64>(m_busyCount.load());
+    return result;
+}
+
+qint64 WalCheckpointer::walSizeBytes() const
+{
+    return m_walSizeBytes.load();
+}
+
+void WalCheckpointer::start()
+{
+    if (m_timer) {
+        return;
+    }
+
+    if (!openConnection()) {
+        return;
+    }
+
+    m_timer = new QTimer(this);
+    connect(m_timer, &QTimer::timeout, this, &WalCheckpointer::onTimer);
+    m_timer->start(m_policy.intervalMs);
+    qDebug() << "WAL 检查点调度器已启动，周期:" << m_policy.intervalMs << "ms";
+}
+
+void WalCheckpointer::stop()
+{
+    if (m_timer) {
+        m_timer->stop();
+        m_timer->deleteLater();
+        m_timer = nullptr;
+    }
+    closeConnection();
+}
+
+void WalCheckpointer::onTimer()
+{
+    const qint64 walSize = currentWalSize();
+    m_walSizeBytes = walSize;
+
+    if (walSize <= 0) {
+        return;
+    }
+
+    // 其他连接没有新提交、上次检查点也已全部回写时跳过
+    const qint64 dataVersion = readDataVersion();
+    if (dataVersion == m_lastDataVersion && m_pendingFrames == 0) {
+        return;
+    }
+
+    // WAL 压力优先：超过阈值且文件在上次检查点后继续增长（或上次没回写完）时才升级，
+    // RESTART 之后文件大小不变，写入会从头复用，不需要每个周期都升级
+    const bool pressure = walSize > m_lastWalSize || m_pendingFrames != 0;
+    int mode = -1;
+    if (pressure && walSize >= m_policy.truncateThresholdBytes) {
+        mode = SQLITE_CHECKPOINT_TRUNCATE;
+    } else if (pressure && walSize >= m_policy.restartThresholdBytes) {
+        mode = SQLITE_CHECKPOINT_RESTART;
+    } else if (!m_idleProbe || m_idleProbe()) {
+        mode = SQLITE_CHECKPOINT_PASSIVE;
+    }
+
+    if (mode < 0) {
+        return; // 队列繁忙且没有压力，等下一个周期
+    }
+
+    if (runCheckpoint(mode)) {
+        m_lastDataVersion = dataVersion;
+    }
+}
+
+qint64 WalCheckpointer::readDataVersion()
+{
+    if (!m_dataVersionStmt) {
+        return -1;
+    }
+
+    qint64 version = -1;
+    if (sqlite3_step(m_dataVersionStmt) == SQLITE_ROW) {
+        version = sqlite3_column_int64(m_dataVersionStmt, 0);
+    }
+    sqlite3_reset(m_dataVersionStmt);
+    return version;
+}
+
+bool WalCheckpointer::openConnection()
+{
+    if (m_db) {
+        return true;
+    }
+
+    const QByteArray path = m_dbFile.toUtf8();
+    int rc = sqlite3_open_v2(path.constData(), &m_db, SQLITE_OPEN_READWRITE, nullptr);
+    if (rc != SQLITE_OK) {
+        const QString error = QString("检查点连接打开失败: %1").arg(m_db ? sqlite3_errmsg(m_db) : sqlite3_errstr(rc));
+        qCritical() << error;
+        closeConnection();
+        emit errorOccurred(error);
+        return false;
+    }
+
+    sqlite3_busy_timeout(m_db, m_policy.busyTimeoutMs);
+
+    // PRAGMA data_version 在其他连接提交后会变化，用来判断是否有新帧
+    if (sqlite3_prepare_v2(m_db, "PRAGMA data_version", -1, &m_dataVersionStmt, nullptr) != SQLITE_OK) {
+        qWarning() << "准备 data_version 语句失败:" << sqlite3_errmsg(m_db);
+        m_dataVersionStmt = nullptr;
+    }
+    return true;
+}
+
+void WalCheckpointer::closeConnection()
+{
+    if (m_dataVersionStmt) {
+        sqlite3_finalize(m_dataVersionStmt);
+        m_dataVersionStmt = nullptr;
+    }
+    if (m_db) {
+        sqlite3_close_v2(m_db);
+        m_db = nullptr;
+    }
+}
+
+bool WalCheckpointer::runCheckpoint(int mode)
+{
+    if (!m_db) {
+        return false;
+    }
+
+    int framesLogged = 0;
+    int framesCheckpointed = 0;
+
+    QElapsedTimer timer;
+    timer.start();
+    const int rc = sqlite3_wal_checkpoint_v2(m_db, nullptr, mode, &framesLogged, &framesCheckpointed);
+    const qint64 durationUs = timer.nsecsElapsed() / 1000;
+
+    m_lastMode = mode;
+    m_lastDurationUs = durationUs;
+    if (durationUs > m_maxDurationUs.load()) {
+        m_maxDurationUs = durationUs;
+    }
+
+    if (rc == SQLITE_BUSY) {
+        // RESTART/TRUNCATE 在超时内没拿到锁，部分帧可能已经回写，下个周期再试
+        m_busyCount.fetch_add(1, std::memory_order_relaxed);
+        qDebug() << "检查点繁忙:" << modeName(mode) << "耗时" << durationUs << "us";
+    } else if (rc != SQLITE_OK) {
+        const QString error = QString("检查点执行失败(%1): %2").arg(modeName(mode)).arg(sqlite3_errmsg(m_db));
+        qWarning() << error;
+        emit errorOccurred(error);
+        return false;
+    }
+
+    if (framesLogged >= 0) {
+        m_lastFramesLogged = framesLogged;
+        m_lastFramesCheckpointed = framesCheckpointed;
+        m_totalFramesCheckpointed.fetch_add(framesCheckpointed, std::memory_order_relaxed);
+        m_pendingFrames = framesLogged - framesCheckpointed;
+    } else {
+        m_pendingFrames = 0; // 数据库不是 WAL 模式
+    }
+
+    switch (mode) {
+    case SQLITE_CHECKPOINT_PASSIVE:
+        m_passiveCount.fetch_add(1, std::memory_order_relaxed);
+        break;
+    case SQLITE_CHECKPOINT_RESTART:
+        m_restartCount.fetch_add(1, std::memory_order_relaxed);
+        break;
+    case SQLITE_CHECKPOINT_TRUNCATE:
+        m_truncateCount.fetch_add(1, std::memory_order_relaxed);
+        break;
+    default:
+        break;
+    }
+
+    m_lastWalSize = currentWalSize();
+    m_walSizeBytes = m_lastWalSize;
+
+    emit checkpointCompleted(modeName(mode), framesLogged, framesCheckpointed, durationUs);
+    return rc == SQLITE_OK;
+}
+
+qint64 WalCheckpointer::currentWalSize() const
+{
+    QFileInfo walFile(m_dbFile + "-wal");
+    return walFile.exists() ? walFile.size() : 0;
+}
+
+QString WalCheckpointer::modeName(int mode)
+{
+    switch (mode) {
+    case SQLITE_CHECKPOINT_PASSIVE:
+        return "passive";
+    case SQLITE_CHECKPOINT_FULL:
+        return "full";
+    case SQLITE_CHECKPOINT_RESTART:
+        return "restart";
+    case SQLITE_CHECKPOINT_TRUNCATE:
+        return "truncate";
+    default:
+        return "none";
+    }
+}
@@ -0,0 +1,86 @@
+// walcheckpointer.h
+#ifndef WALCHECKPOINTER_H
+#define WALCHECKPOINTER_H
+
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <QVariantMap>
+#include <atomic>
+#include <functional>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+// 后台检查点调度策略
+struct WalCheckpointPolicy {
+    int intervalMs = 1000; // 调度周期
+    qint64 restartThresholdBytes = 16 * 1024 * 1024; // WAL 超过该大小时升级为 RESTART
+    qint64 truncateThresholdBytes = 64 * 1024 * 1024; // WAL 超过该大小时升级为 TRUNCATE
+    int busyTimeoutMs = 200; // RESTART/TRUNCATE 等待读者/写者的最长时间
+};
+
+// WAL 检查点调度器，运行在独立的低优先级线程中，使用自己的数据库连接
+// 队列空闲时执行 PASSIVE 检查点，只有 WAL 文件超过阈值时才升级为 RESTART/TRUNCATE
+class WalCheckpointer : public QObject {
+    Q_OBJECT
+
+public:
+    explicit WalCheckpointer(const QString& dbFile, QObject* parent = nullptr);
+    ~WalCheckpointer();
+
+    // 以下设置需在 start() 之前调用
+    void setPolicy(const WalCheckpointPolicy& policy);
+    void setIdleProbe(std::function<bool()> probe);
+
+    // 线程安全的指标读取
+    QVariantMap metrics() const;
+    qint64 walSizeBytes() const;
+
+public slots:
+    void start();
+    void stop();
+
+signals:
+    void checkpointCompleted(const QString& mode, int framesLogged, int framesCheckpointed, qint64 durationUs);
+    void errorOccurred(const QString& error);
+
+private slots:
+    void onTimer();
+
+private:
+    bool openConnection();
+    void closeConnection();
+    bool runCheckpoint(int mode);
+    qint64 currentWalSize() const;
+    qint64 readDataVersion();
+
+    static QString modeName(int mode);
+
+    QString m_dbFile;
+    WalCheckpointPolicy m_policy;
+    std::function<bool()> m_idleProbe;
+    sqlite3* m_db = nullptr;
+    sqlite3_stmt* m_dataVersionStmt = nullptr;
+    QTimer* m_timer = nullptr;
+
+    // 上一次检查点后尚未回写的帧数、当时的 WAL 文件大小和 data_version
+    int m_pendingFrames = -1;
+    qint64 m_lastWalSize = -1;
+    qint64 m_lastDataVersion = -1;
+
+    // 指标（跨线程读取）
+    std::atomic<qint64> m_walSizeBytes { 0 };
+    std::atomic<qint64> m_lastDurationUs { 0 };
+    std::atomic<qint64> m_maxDurationUs { 0 };
+    std::atomic<int> m_lastMode { -1 };
+    std::atomic<int> m_lastFramesLogged { 0 };
+    std::atomic<int> m_lastFramesCheckpointed { 0 };
+    std::atomic<qint64> m_totalFramesCheckpointed { 0 };
+    std::atomic<quint64> m_passiveCount { 0 };
+    std::atomic<quint64> m_restartCount { 0 };
+    std::atomic<quint64> m_truncateCount { 0 };
+    std::atomic<quint64> m_busyCount { 0 };
+};
+
+#endif // WALCHECKPOINTER_H
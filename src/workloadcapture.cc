@@ -0,0 +1,459 @@
+// workloadcapture.cc
+#include "workloadcapture.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QFile>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace {
+
+constexpr char kMagic[4] = { 'Q', 'T', 'W', 'L' };
+constexpr uint8_t kVersion = 1;
+constexpr uint8_t kStatementRecord = 1;
+constexpr uint8_t kRequestRecord = 2;
+constexpr std::size_t kFlushThreshold = 64 * 1024;
+constexpr std::size_t kMaxPendingBuffers = 64; // 录制线程最多积压 4MB，再多说明磁盘跟不上
+
+// 参数类型标记，与 OperationRequest 的各个参数表一一对应
+enum ParamTag : uint8_t {
+    StringParam = 1,
+    IntParam = 2,
+    DoubleParam = 3,
+    BoolParam = 4,
+    StringArrayParam = 5,
+    IntArrayParam = 6,
+};
+
+void putVarint(std::string& out, uint64_t value)
+{
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+void putSigned(std::string& out, int64_t value)
+{
+    putVarint(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+void putString(std::string& out, const std::string& value)
+{
+    putVarint(out, value.size());
+    out.append(value);
+}
+
+void putDouble(std::string& out, double value)
+{
+    uint64_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(bits));
+    for (int i = 0; i < 8; ++i) {
+        out.push_back(static_cast<char>((bits >> (8 * i)) & 0xff));
+    }
+}
+
+// 读取游标：越界时 ok 置为 false，之后的读取都返回零值
+struct Reader {
+    const char* data;
+    std::size_t size;
+    std::size_t pos = 0;
+    bool ok = true;
+
+    bool atEnd() const { return pos >= size; }
+
+    uint8_t byte()
+    {
+        if (pos >= size) {
+            ok = false;
+            return 0;
+        }
+        return static_cast<uint8_t>(data[pos++]);
+    }
+
+    uint64_t varint()
+    {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            const uint8_t b = byte();
+            if (!ok) {
+                return 0;
+            }
+            value |= static_cast<uint64_t>(b & 0x7f) << shift;
+            if (!(b & 0x80)) {
+                return value;
+            }
+        }
+        ok = false;
+        return 0;
+    }
+
+    int64_t signedVarint()
+    {
+        const uint64_t value = varint();
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    std::string string()
+    {
+        const uint64_t length = varint();
+        if (!ok || length > size - pos) {
+            ok = false;
+            return std::string();
+        }
+        std::string value(data + pos, length);
+        pos += length;
+        return value;
+    }
+
+    double float64()
+    {
+        uint64_t bits = 0;
+        for (int i = 0; i < 8; ++i) {
+            bits |= static_cast<uint64_t>(byte()) << (8 * i);
+        }
+        double value = 0;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+};
+
+} // namespace
+
+WorkloadCapture::~WorkloadCapture()
+{
+    stop();
+}
+
+bool WorkloadCapture::start(const QString& path, qint64 maxBytes, QString& error)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_file) {
+        error = QString("已在录制到 %1").arg(m_path);
+        return false;
+    }
+    m_file = std::fopen(QFile::encodeName(path).constData(), "wb");
+    if (!m_file) {
+        error = QString("无法创建录制文件 %1: %2").arg(path, QString::fromLocal8Bit(std::strerror(errno)));
+        return false;
+    }
+
+    m_path = path;
+    m_maxBytes = maxBytes;
+    m_statementIds.clear();
+    m_requests = 0;
+    m_dropped = 0;
+    m_lastArrival = std::chrono::steady_clock::time_point();
+    m_buffer.assign(kMagic, sizeof(kMagic));
+    m_buffer.push_back(static_cast<char>(kVersion));
+    putVarint(m_buffer, static_cast<uint64_t>(QDateTime::currentMSecsSinceEpoch()));
+    m_bytes = static_cast<qint64>(m_buffer.size());
+    m_pending.clear();
+    m_stopping = false;
+    m_writer = std::thread(&WorkloadCapture::writerLoop, this);
+    m_enabled.store(true, std::memory_order_relaxed);
+    qDebug() << "工作负载录制开始:" << path;
+    return true;
+}
+
+void WorkloadCapture::stop()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_enabled.store(false, std::memory_order_relaxed);
+        if (!m_file || m_stopping) {
+            return;
+        }
+        handOffLocked();
+        m_stopping = true;
+        m_pendingChanged.wakeAll();
+    }
+    // 录制线程写完积压的缓冲后退出；等待期间不持锁，capture 只会看到 m_stopping 并直接返回
+    m_writer.join();
+
+    QMutexLocker locker(&m_mutex);
+    std::fclose(m_file);
+    m_file = nullptr;
+    m_stopping = false;
+    qDebug() << "工作负载录制结束:" << m_path << "请求" << m_requests << "条，语句" << m_statementIds.size()
+             << "条，" << m_bytes << "字节，丢弃" << m_dropped << "条";
+}
+
+void WorkloadCapture::capture(const OperationRequest& request)
+{
+    if (!isEnabled()) {
+        return;
+    }
+    QMutexLocker locker(&m_mutex);
+    if (!m_file || m_stopping) {
+        return;
+    }
+
+    const std::size_t recordStart = m_buffer.size();
+    uint32_t statementId = 0;
+    auto query = request.string_params.find("query");
+    if (query != request.string_params.end()) {
+        auto known = m_statementIds.find(query->second);
+        if (known != m_statementIds.end()) {
+            statementId = known->second;
+        } else {
+            statementId = static_cast<uint32_t>(m_statementIds.size() + 1);
+            m_buffer.push_back(static_cast<char>(kStatementRecord));
+            putVarint(m_buffer, statementId);
+            putString(m_buffer, query->second);
+        }
+    }
+
+    // 第一条请求的间隔记为 0；enqueued_at 在构造时取得，比入队加锁早，可能略早于上一条
+    int64_t deltaUs = 0;
+    if (m_lastArrival != std::chrono::steady_clock::time_point()) {
+        deltaUs = std::max<int64_t>(0,
+            std::chrono::duration_cast<std::chrono::microseconds>(request.enqueued_at - m_lastArrival).count());
+    }
+
+    m_buffer.push_back(static_cast<char>(kRequestRecord));
+    putVarint(m_buffer, static_cast<uint64_t>(deltaUs));
+    putString(m_buffer, request.type);
+    putVarint(m_buffer, statementId);
+    putString(m_buffer, request.coalesce.row);
+    putString(m_buffer, request.coalesce.key);
+    putString(m_buffer, request.coalesce.deltaParam);
+
+    const std::size_t paramCount = request.string_params.size() - (statementId ? 1 : 0) + request.int_params.size()
+        + request.double_params.size() + request.bool_params.size() + request.string_array_params.size()
+        + request.int_array_params.size();
+    putVarint(m_buffer, paramCount);
+    for (const auto& param : request.string_params) {
+        if (statementId && param.first == "query") {
+            continue;
+        }
+        m_buffer.push_back(static_cast<char>(StringParam));
+        putString(m_buffer, param.first);
+        putString(m_buffer, param.second);
+    }
+    for (const auto& param : request.int_params) {
+        m_buffer.push_back(static_cast<char>(IntParam));
+        putString(m_buffer, param.first);
+        putSigned(m_buffer, param.second);
+    }
+    for (const auto& param : request.double_params) {
+        m_buffer.push_back(static_cast<char>(DoubleParam));
+        putString(m_buffer, param.first);
+        putDouble(m_buffer, param.second);
+    }
+    for (const auto& param : request.bool_params) {
+        m_buffer.push_back(static_cast<char>(BoolParam));
+        putString(m_buffer, param.first);
+        m_buffer.push_back(param.second ? 1 : 0);
+    }
+    for (const auto& param : request.string_array_params) {
+        m_buffer.push_back(static_cast<char>(StringArrayParam));
+        putString(m_buffer, param.first);
+        putVarint(m_buffer, param.second.size());
+        for (const std::string& value : param.second) {
+            putString(m_buffer, value);
+        }
+    }
+    for (const auto& param : request.int_array_params) {
+        m_buffer.push_back(static_cast<char>(IntArrayParam));
+        putString(m_buffer, param.first);
+        putVarint(m_buffer, param.second.size());
+        for (int value : param.second) {
+            putSigned(m_buffer, value);
+        }
+    }
+
+    const qint64 recordBytes = static_cast<qint64>(m_buffer.size() - recordStart);
+    const bool backlogFull = m_pending.size() >= kMaxPendingBuffers;
+    if (m_dropped > 0 || backlogFull || (m_maxBytes > 0 && m_bytes + recordBytes > m_maxBytes)) {
+        // 超出上限：撤回本条（包括随它写入的语句定义），之后的请求都计入丢弃，保证日志是连续的前缀
+        if (m_dropped == 0 && backlogFull) {
+            qWarning() << "录制文件写入跟不上入队速度，停止追加:" << m_path;
+        }
+        m_buffer.resize(recordStart);
+        ++m_dropped;
+        return;
+    }
+    if (statementId == m_statementIds.size() + 1) {
+        m_statementIds.emplace(query->second, statementId);
+    }
+    m_bytes += recordBytes;
+    m_lastArrival = request.enqueued_at;
+    ++m_requests;
+    if (m_buffer.size() >= kFlushThreshold) {
+        handOffLocked();
+        m_pendingChanged.wakeOne();
+    }
+}
+
+// 把正在编码的缓冲移交给录制线程
+void WorkloadCapture::handOffLocked()
+{
+    if (m_buffer.empty()) {
+        return;
+    }
+    m_pending.push_back(std::move(m_buffer));
+    m_buffer = std::string();
+    m_buffer.reserve(kFlushThreshold);
+}
+
+// 录制线程：取走积压的缓冲后在锁外写盘；stop() 置位 m_stopping 后写完剩余缓冲再退出
+void WorkloadCapture::writerLoop()
+{
+    QMutexLocker locker(&m_mutex);
+    bool failed = false;
+    for (;;) {
+        while (m_pending.empty() && !m_stopping) {
+            m_pendingChanged.wait(&m_mutex);
+        }
+        if (m_pending.empty()) {
+            return;
+        }
+        std::vector<std::string> batch;
+        batch.swap(m_pending);
+        locker.unlock();
+
+        // 写失败后丢弃后续缓冲，文件保持为失败前的前缀
+        const bool failedBefore = failed;
+        for (const std::string& chunk : batch) {
+            failed = failed || std::fwrite(chunk.data(), 1, chunk.size(), m_file) != chunk.size();
+        }
+        failed = failed || std::fflush(m_file) != 0;
+
+        locker.relock();
+        if (failed && !failedBefore) {
+            m_enabled.store(false, std::memory_order_relaxed);
+            qWarning() << "写入录制文件失败，停止录制:" << m_path;
+        }
+    }
+}
+
+QVariantMap WorkloadCapture::metrics() const
+{
+    QMutexLocker locker(&m_mutex);
+    return QVariantMap {
+        { "enabled", isEnabled() },
+        { "path", m_path },
+        { "requests", m_requests },
+        { "statements", static_cast<qulonglong>(m_statementIds.size()) },
+        { "bytes", m_bytes },
+        { "dropped", m_dropped },
+    };
+}
+
+namespace WorkloadLog {
+
+bool read(const QString& path, CapturedWorkload& workload, QString& error)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = QString("无法打开录制文件 %1: %2").arg(path, file.errorString());
+        return false;
+    }
+    const QByteArray bytes = file.readAll();
+    Reader reader { bytes.constData(), static_cast<std::size_t>(bytes.size()) };
+
+    if (bytes.size() < 5 || std::memcmp(bytes.constData(), kMagic, sizeof(kMagic)) != 0) {
+        error = QString("%1 不是工作负载录制文件").arg(path);
+        return false;
+    }
+    reader.pos = sizeof(kMagic);
+    const uint8_t version = reader.byte();
+    if (version != kVersion) {
+        error = QString("不支持的录制文件版本 %1").arg(version);
+        return false;
+    }
+
+    workload = CapturedWorkload();
+    workload.startedAtMs = static_cast<int64_t>(reader.varint());
+    int64_t arrivalUs = 0;
+    while (reader.ok && !reader.atEnd()) {
+        const uint8_t tag = reader.byte();
+        if (tag == kStatementRecord) {
+            const uint64_t id = reader.varint();
+            std::string text = reader.string();
+            if (!reader.ok) {
+                break;
+            }
+            if (id != workload.statements.size() + 1) {
+                error = QString("语句 ID %1 不连续（偏移 %2）").arg(id).arg(reader.pos);
+                return false;
+            }
+            workload.statements.push_back(std::move(text));
+            continue;
+        }
+        if (tag != kRequestRecord) {
+            error = QString("未知记录类型 %1（偏移 %2）").arg(tag).arg(reader.pos - 1);
+            return false;
+        }
+
+        CapturedRequest entry;
+        const int64_t deltaUs = static_cast<int64_t>(reader.varint());
+        OperationRequest& request = entry.request;
+        request.type = reader.string();
+        entry.statementId = static_cast<uint32_t>(reader.varint());
+        request.coalesce.row = reader.string();
+        request.coalesce.key = reader.string();
+        request.coalesce.deltaParam = reader.string();
+        if (reader.ok && entry.statementId > workload.statements.size()) {
+            error = QString("请求引用了未定义的语句 %1").arg(entry.statementId);
+            return false;
+        }
+        if (reader.ok && entry.statementId) {
+            request.string_params["query"] = workload.statements[entry.statementId - 1];
+        }
+
+        const uint64_t paramCount = reader.varint();
+        for (uint64_t i = 0; i < paramCount && reader.ok; ++i) {
+            const uint8_t paramTag = reader.byte();
+            const std::string key = reader.string();
+            switch (paramTag) {
+            case StringParam:
+                request.string_params[key] = reader.string();
+                break;
+            case IntParam:
+                request.int_params[key] = static_cast<int>(reader.signedVarint());
+                break;
+            case DoubleParam:
+                request.double_params[key] = reader.float64();
+                break;
+            case BoolParam:
+                request.bool_params[key] = reader.byte() != 0;
+                break;
+            case StringArrayParam: {
+                std::vector<std::string>& values = request.string_array_params[key];
+                const uint64_t count = reader.varint();
+                for (uint64_t j = 0; j < count && reader.ok; ++j) {
+                    values.push_back(reader.string());
+                }
+                break;
+            }
+            case IntArrayParam: {
+                std::vector<int>& values = request.int_array_params[key];
+                const uint64_t count = reader.varint();
+                for (uint64_t j = 0; j < count && reader.ok; ++j) {
+                    values.push_back(static_cast<int>(reader.signedVarint()));
+                }
+                break;
+            }
+            default:
+                error = QString("未知参数类型 %1（偏移 %2）").arg(paramTag).arg(reader.pos);
+                return false;
+            }
+        }
+        if (!reader.ok) {
+            break;
+        }
+
+        arrivalUs += deltaUs;
+        entry.arrivalUs = arrivalUs;
+        request.id.clear();
+        workload.requests.push_back(std::move(entry));
+    }
+    workload.truncated = !reader.ok;
+    return true;
+}
+
+} // namespace WorkloadLog
@@ -0,0 +1,89 @@
+// workloadcapture.h
+#ifndef WORKLOADCAPTURE_H
+#define WORKLOADCAPTURE_H
+
+#include "operationrequest.h"
+#include <QMutex>
+#include <QString>
+#include <QVariantMap>
+#include <QWaitCondition>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// 工作负载录制：SQLite3StateMachine::addToQueue 在队列锁内把每个请求（类型、语句 ID、带类型的参数、到达时刻）
+// 编码进内存缓冲，满 64KB 后交给录制线程写盘，录制顺序即入队顺序；
+// bench/workload_replay.cc 读取后按原节奏、N 倍速或尽快回放
+//
+// 文件格式（整数均为 LEB128 变长编码，有符号数先做 zigzag）：
+//   文件头  "QTWL" 版本(1 字节) 录制开始的墙钟毫秒
+//   语句    标记 1  语句ID 文本                 —— 每条 SQL 文本第一次出现时写一次，ID 从 1 开始
+//   请求    标记 2  距上一请求的微秒数 类型 语句ID（0 表示无） 合并规则(row key deltaParam)
+//                  参数个数 { 参数类型(1 字节) 键 值 }...
+// 字符串为 长度+字节；double 为 8 字节小端。进程异常退出时最后一条记录可能不完整，读取时丢弃
+class WorkloadCapture {
+public:
+    WorkloadCapture() = default;
+    ~WorkloadCapture();
+
+    WorkloadCapture(const WorkloadCapture&) = delete;
+    WorkloadCapture& operator=(const WorkloadCapture&) = delete;
+
+    // 任意线程：开始录制到 path（覆盖已有文件）并启动录制线程；
+    // 文件达到 maxBytes 或录制线程积压过多时停止追加，之后的请求计入 dropped
+    bool start(const QString& path, qint64 maxBytes, QString& error);
+    // 任意线程：交出剩余缓冲，等录制线程写完后关闭文件
+    void stop();
+    bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+    // 入队时调用（调用方持有队列锁）；只做内存编码，不碰磁盘；未开启时只有一次原子读
+    void capture(const OperationRequest& request);
+
+    // {enabled, path, requests, statements, bytes, dropped}
+    QVariantMap metrics() const;
+
+private:
+    void handOffLocked();
+    void writerLoop();
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_pendingChanged;
+    std::atomic<bool> m_enabled { false };
+    std::FILE* m_file = nullptr; // start() 与 stop() 之间只由录制线程写入
+    std::thread m_writer;
+    bool m_stopping = false;
+    QString m_path;
+    std::string m_buffer; // 正在编码的缓冲
+    std::vector<std::string> m_pending; // 等待录制线程写出的缓冲
+    std::unordered_map<std::string, uint32_t> m_statementIds;
+    std::chrono::steady_clock::time_point m_lastArrival;
+    qint64 m_maxBytes = 0;
+    qint64 m_bytes = 0;
+    quint64 m_requests = 0;
+    quint64 m_dropped = 0;
+};
+
+// 读出的一条请求：arrivalUs 为距第一条请求的微秒数，request.id 为空，由回放方分配
+struct CapturedRequest {
+    int64_t arrivalUs = 0;
+    uint32_t statementId = 0; // 0 表示请求不带 query 参数
+    OperationRequest request { "" };
+};
+
+struct CapturedWorkload {
+    int64_t startedAtMs = 0; // 录制开始的墙钟时间
+    std::vector<std::string> statements; // 下标为语句 ID - 1
+    std::vector<CapturedRequest> requests;
+    bool truncated = false; // 末尾有不完整的记录
+};
+
+namespace WorkloadLog {
+bool read(const QString& path, CapturedWorkload& workload, QString& error);
+}
+
+#endif // WORKLOADCAPTURE_H
@@ -0,0 +1,145 @@
+// coalesce_retry_test.cc
+// 写合并的失败回退：合并后的语句违反 CHECK 时，组内每个操作按入队时自己的参数逐条重做，
+// 各自得到自己的结果（同一操作不会执行两次，head 也不会沿用合并语句的失败）
+// 用法: coalesce_retry_test（数据库建在临时目录中），失败时返回非 0
+#include "sqlite3statemachine.h"
+#include <sqlite3.h>
+
+#include <QCoreApplication>
+#include <QHash>
+#include <QList>
+#include <QTemporaryDir>
+#include <cstdio>
+#include <string>
+
+// 状态机的入队、出队与执行是私有的，经这里直接调用
+struct SQLite3StateMachineTestAccess {
+    static bool connect(SQLite3StateMachine& machine) { return machine.connectToDatabase(); }
+    static void addToQueue(SQLite3StateMachine& machine, const OperationRequest& request) { machine.addToQueue(request); }
+    static OperationRequest dequeue(SQLite3StateMachine& machine) { return machine.dequeue(); }
+    static void execute(SQLite3StateMachine& machine, const OperationRequest& request) { machine.handleQueryExecution(request); }
+};
+
+namespace {
+
+using Access = SQLite3StateMachineTestAccess;
+
+int g_failures = 0;
+
+void expect(bool condition, const char* what)
+{
+    if (!condition) {
+        std::fprintf(stderr, "失败: %s\n", what);
+        ++g_failures;
+    }
+}
+
+OperationRequest makeWrite(const std::string& query, const std::string& key, const std::string& deltaParam,
+    const std::string& param, int value)
+{
+    OperationRequest request("query");
+    request.setStringParam("query", query);
+    request.setStringParam("id", "1");
+    request.setStringParam(param, std::to_string(value));
+    request.coalesce.row = "products:1";
+    request.coalesce.key = key;
+    request.coalesce.deltaParam = deltaParam;
+    return request;
+}
+
+OperationRequest makeDelta(int quantity)
+{
+    return makeWrite("UPDATE products SET stock = stock + :quantity WHERE id = :id", "add:stock", "quantity",
+        "quantity", quantity);
+}
+
+OperationRequest makeSet(int stock)
+{
+    return makeWrite("UPDATE products SET stock = :stock WHERE id = :id", "set:stock", std::string(), "stock", stock);
+}
+
+int readStock(const QString& dbFile)
+{
+    sqlite3* db = nullptr;
+    sqlite3_stmt* stmt = nullptr;
+    int stock = -1;
+    if (sqlite3_open_v2(dbFile.toUtf8().constData(), &db, SQLITE_OPEN_READONLY, nullptr) == SQLITE_OK
+        && sqlite3_prepare_v2(db, "SELECT stock FROM products WHERE id = 1", -1, &stmt, nullptr) == SQLITE_OK
+        && sqlite3_step(stmt) == SQLITE_ROW) {
+        stock = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+    return stock;
+}
+
+// 两个写入一起入队后出队一次，合并为一组执行，返回每个操作 ID 收到的完成结果
+QHash<QString, QList<bool>> runGroup(SQLite3StateMachine& machine, const OperationRequest& first, const OperationRequest& second)
+{
+    QHash<QString, QList<bool>> results;
+    const auto connection = QObject::connect(&machine, &SQLite3StateMachine::operationCompleted, &machine,
+        [&results](const QString& operationId, bool success, const QString&) { results[operationId].append(success); });
+    Access::addToQueue(machine, first);
+    Access::addToQueue(machine, second);
+    const OperationRequest head = Access::dequeue(machine);
+    expect(head.merged_ids.size() == 1, "两个写入应合并为一组");
+    Access::execute(machine, head);
+    QObject::disconnect(connection);
+    return results;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QTemporaryDir tempDir;
+    if (!tempDir.isValid()) {
+        return 1;
+    }
+    const QString dbFile = tempDir.filePath("coalesce.db");
+    SQLite3StateMachine machine(dbFile);
+    if (!Access::connect(machine)) {
+        std::fprintf(stderr, "无法连接数据库: %s\n", qPrintable(dbFile));
+        return 1;
+    }
+    machine.setWriteCoalescing(true);
+
+    OperationRequest insert("query");
+    insert.setStringParam("query", "INSERT INTO products (name, price, stock) VALUES ('coalesce', 1.0, 10)");
+    Access::addToQueue(machine, insert);
+    Access::execute(machine, Access::dequeue(machine));
+    expect(readStock(dbFile) == 10, "预置库存应为 10");
+
+    // 增量组：-6 与 -5 之和使库存为负，违反 CHECK；逐条重做时 -6 成功（剩 4），-5 失败
+    {
+        const OperationRequest a = makeDelta(-6);
+        const OperationRequest b = makeDelta(-5);
+        const QHash<QString, QList<bool>> results = runGroup(machine, a, b);
+        expect(results.size() == 2, "增量组只应有这两个操作的完成");
+        expect(results.value(QString::fromStdString(a.id)) == QList<bool> { true }, "增量组的第一个操作应单独执行一次并成功");
+        expect(results.value(QString::fromStdString(b.id)) == QList<bool> { false }, "增量组的第二个操作应执行一次并失败");
+        expect(readStock(dbFile) == 4, "增量组重做后库存应为 4");
+    }
+
+    // 覆盖组：最后一个值为负，合并语句失败；逐条重做时 head 的 7 写入成功，-1 失败
+    {
+        const OperationRequest a = makeSet(7);
+        const OperationRequest b = makeSet(-1);
+        const QHash<QString, QList<bool>> results = runGroup(machine, a, b);
+        expect(results.size() == 2, "覆盖组只应有这两个操作的完成");
+        expect(results.value(QString::fromStdString(a.id)) == QList<bool> { true }, "覆盖组的 head 应以自己的值执行一次并成功");
+        expect(results.value(QString::fromStdString(b.id)) == QList<bool> { false }, "覆盖组的第二个操作应执行一次并失败");
+        expect(readStock(dbFile) == 7, "覆盖组重做后库存应为 7");
+    }
+
+    expect(machine.coalesceMetrics().value("retried_groups").toULongLong() == 2, "两组都应逐条重试");
+
+    if (g_failures > 0) {
+        std::fprintf(stderr, "%d 项检查失败\n", g_failures);
+        return 1;
+    }
+    std::printf("写合并失败回退: 全部通过\n");
+    return 0;
+}